@@ -25,8 +25,11 @@
 
 #include <CLRX/Config.h>
 #include <cstdint>
+#include <new>
 #include <vector>
+#include <algorithm>
 #include <utility>
+#include <initializer_list>
 #include <list>
 #include <unordered_map>
 #include <CLRX/utils/Utilities.h>
@@ -136,6 +139,176 @@ struct AsmExprSymbolOccurrence
     { return expression==b.expression && opIndex==b.opIndex && argIndex==b.argIndex; }
 };
 
+/// memory pool for small objects (expression storage and occurrence lists)
+/** memory is allocated from large chunks and freed at once while pool destruction.
+ * freed blocks are held in free lists (for every size class) and reused. */
+class AsmMemoryPool: public NonCopyableAndNonMovable
+{
+private:
+    static const size_t chunkSize = 65536;
+    static const size_t classShift = 4; // size class granularity: 16 bytes
+    static const size_t classesNum = 32; // max block size in pool: 512 bytes
+    
+    std::vector<cxbyte*> chunks;
+    cxbyte* chunkPos;
+    cxbyte* chunkEnd;
+    void* freeLists[classesNum];
+public:
+    /// constructor
+    AsmMemoryPool();
+    /// destructor
+    ~AsmMemoryPool();
+    
+    /// allocate memory block
+    void* allocate(size_t size);
+    /// return memory block to pool (size must be same as in allocate)
+    void deallocate(void* ptr, size_t size);
+};
+
+/// simple vector for trivially copyable elements allocated from memory pool
+/** if pool is not set, then elements are allocated from heap */
+template<typename T>
+class AsmPoolVector
+{
+private:
+    T* ptr;
+    size_t count;
+    size_t capacityNum;
+    AsmMemoryPool* pool;
+    
+    T* allocate(size_t n)
+    { return (T*)(pool != nullptr ? pool->allocate(n*sizeof(T)) :
+                ::operator new(n*sizeof(T))); }
+    void deallocate(T* p, size_t n)
+    {
+        if (pool != nullptr)
+            pool->deallocate(p, n*sizeof(T));
+        else
+            ::operator delete(p);
+    }
+    void reserveNext()
+    {
+        const size_t newCapacity = capacityNum != 0 ? capacityNum<<1 : 2;
+        T* newPtr = allocate(newCapacity);
+        std::copy(ptr, ptr+count, newPtr);
+        if (ptr != nullptr)
+            deallocate(ptr, capacityNum);
+        ptr = newPtr;
+        capacityNum = newCapacity;
+    }
+public:
+    /// type of iterator
+    typedef T* iterator;
+    /// type of constant iterator
+    typedef const T* const_iterator;
+    
+    /// empty constructor
+    AsmPoolVector() : ptr(nullptr), count(0), capacityNum(0), pool(nullptr)
+    { }
+    /// copy constructor (deep copy, elements are allocated from heap)
+    /** copy never refers to memory pool of source, because it can outlive
+     * owner of that pool (assembler) */
+    AsmPoolVector(const AsmPoolVector& v)
+        : ptr(nullptr), count(0), capacityNum(0), pool(nullptr)
+    { *this = v; }
+    /// move constructor
+    AsmPoolVector(AsmPoolVector&& v) noexcept
+        : ptr(v.ptr), count(v.count), capacityNum(v.capacityNum), pool(v.pool)
+    {
+        v.ptr = nullptr;
+        v.count = v.capacityNum = 0;
+    }
+    /// destructor
+    ~AsmPoolVector()
+    {
+        if (ptr != nullptr)
+            deallocate(ptr, capacityNum);
+    }
+    
+    /// copy assignment (deep copy, keeps own memory pool)
+    AsmPoolVector& operator=(const AsmPoolVector& v)
+    {
+        if (this == &v)
+            return *this;
+        if (capacityNum < v.count)
+        {
+            // allocate new elements
+            if (ptr != nullptr)
+                deallocate(ptr, capacityNum);
+            ptr = nullptr;
+            capacityNum = 0;
+            ptr = allocate(v.count);
+            capacityNum = v.count;
+        }
+        std::copy(v.ptr, v.ptr+v.count, ptr);
+        count = v.count;
+        return *this;
+    }
+    /// move assignment
+    AsmPoolVector& operator=(AsmPoolVector&& v) noexcept
+    {
+        std::swap(ptr, v.ptr);
+        std::swap(count, v.count);
+        std::swap(capacityNum, v.capacityNum);
+        std::swap(pool, v.pool);
+        return *this;
+    }
+    
+    /// set memory pool (only if no elements are allocated)
+    void setPool(AsmMemoryPool* newPool)
+    {
+        if (ptr == nullptr)
+            pool = newPool;
+    }
+    /// get memory pool
+    AsmMemoryPool* getPool() const
+    { return pool; }
+    
+    /// push element to end
+    void push_back(const T& v)
+    {
+        if (count == capacityNum)
+            reserveNext();
+        ptr[count++] = v;
+    }
+    /// shrink to new size
+    void resize(size_t newSize)
+    {
+        if (newSize <= count)
+            count = newSize;
+    }
+    /// remove all elements (keep allocated memory)
+    void clear()
+    { count = 0; }
+    
+    /// returns number of elements
+    size_t size() const
+    { return count; }
+    /// returns true if empty
+    bool empty() const
+    { return count == 0; }
+    
+    /// get element
+    T& operator[](size_t i)
+    { return ptr[i]; }
+    /// get element
+    const T& operator[](size_t i) const
+    { return ptr[i]; }
+    
+    /// get iterator to first element
+    T* begin()
+    { return ptr; }
+    /// get iterator to first element
+    const T* begin() const
+    { return ptr; }
+    /// get iterator after last element
+    T* end()
+    { return ptr+count; }
+    /// get iterator after last element
+    const T* end() const
+    { return ptr+count; }
+};
+
 struct AsmRegVar;
 struct AsmScope;
 
@@ -162,7 +335,7 @@ struct AsmSymbol
     };
     
     /** list of occurrences in expressions */
-    std::vector<AsmExprSymbolOccurrence> occurrencesInExprs;
+    AsmPoolVector<AsmExprSymbolOccurrence> occurrencesInExprs;
     
     /// empty constructor
     explicit AsmSymbol(bool _onceDefined = false) :
@@ -189,8 +362,7 @@ struct AsmSymbol
     ~AsmSymbol();
     
     /// adds occurrence in expression
-    void addOccurrenceInExpr(AsmExpression* expr, size_t argIndex, size_t opIndex)
-    { occurrencesInExprs.push_back({expr, argIndex, opIndex}); }
+    void addOccurrenceInExpr(AsmExpression* expr, size_t argIndex, size_t opIndex);
     /// remove occurrence in expression
     void removeOccurrenceInExpr(AsmExpression* expr, size_t argIndex, size_t opIndex);
     /// clear list of occurrences in expression
@@ -202,8 +374,214 @@ struct AsmSymbol
     { return hasValue || expression!=nullptr; }
 };
 
+/// symbol name with precomputed hash (used to find symbol in many scopes)
+struct AsmSymbolName
+{
+    const char* name;   ///< name
+    size_t length;      ///< length of name
+    size_t hash;        ///< hash of name
+    
+    /// constructor
+    AsmSymbolName(const char* _name, size_t _length) : name(_name), length(_length)
+    {
+        // FNV-1a, all characters must affect low bits (slot index in symbol map)
+        const bool is64Bit = sizeof(size_t) >= 8;
+        const size_t prime = is64Bit ? size_t(0x100000001b3ULL) : size_t(16777619U);
+        hash = is64Bit ? size_t(0xcbf29ce484222325ULL) : size_t(2166136261U);
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ cxbyte(name[i])) * prime;
+        hash ^= hash >> (sizeof(size_t)*4);
+    }
+    /// constructor
+    explicit AsmSymbolName(const char* _name) : AsmSymbolName(_name, ::strlen(_name))
+    { }
+    /// constructor
+    explicit AsmSymbolName(const CString& _name)
+            : AsmSymbolName(_name.c_str(), _name.size())
+    { }
+};
+
 /// assembler symbol map
-typedef std::unordered_map<CString, AsmSymbol> AsmSymbolMap;
+/** open-addressing hash table (linear probing) that holds pointers to entries.
+ * entries have stable addresses and they are iterated in insertion order.
+ * every entry holds hash of its name, hence lookups compare only hashes
+ * of mismatched entries and rehashing does not recompute hashes. */
+class AsmSymbolMap
+{
+public:
+    /// value type (symbol entry)
+    typedef std::pair<const CString, AsmSymbol> value_type;
+private:
+    struct Node
+    {
+        Node* prev;
+        Node* next;
+        size_t hash;
+        value_type entry;
+        
+        Node(size_t _hash, const value_type& _entry)
+                : prev(nullptr), next(nullptr), hash(_hash), entry(_entry)
+        { }
+        Node(size_t _hash, const AsmSymbolName& name, const AsmSymbol& symbol)
+                : prev(nullptr), next(nullptr), hash(_hash),
+                  entry(CString(name.name, name.name+name.length), symbol)
+        { }
+    };
+    
+    template<typename V>
+    class IteratorBase
+    {
+    private:
+        friend class AsmSymbolMap;
+        template<typename V2> friend class IteratorBase;
+        Node* node;
+    public:
+        /// constructor
+        explicit IteratorBase(Node* _node = nullptr) : node(_node)
+        { }
+        /// conversion constructor
+        template<typename V2>
+        IteratorBase(const IteratorBase<V2>& it) : node(it.node)
+        { }
+        /// get entry
+        V& operator*() const
+        { return node->entry; }
+        /// get entry
+        V* operator->() const
+        { return &node->entry; }
+        /// go to next entry
+        IteratorBase& operator++()
+        {
+            node = node->next;
+            return *this;
+        }
+        /// go to next entry
+        IteratorBase operator++(int)
+        {
+            IteratorBase old = *this;
+            node = node->next;
+            return old;
+        }
+        /// equal operator
+        bool operator==(const IteratorBase& it) const
+        { return node == it.node; }
+        /// not-equal operator
+        bool operator!=(const IteratorBase& it) const
+        { return node != it.node; }
+    };
+public:
+    /// iterator
+    class iterator: public IteratorBase<value_type>
+    {
+    public:
+        /// constructor
+        explicit iterator(Node* node = nullptr) : IteratorBase<value_type>(node)
+        { }
+    };
+    /// constant iterator
+    class const_iterator: public IteratorBase<const value_type>
+    {
+    public:
+        /// constructor
+        explicit const_iterator(Node* node = nullptr)
+                : IteratorBase<const value_type>(node)
+        { }
+        /// constructor from iterator
+        const_iterator(const iterator& it) : IteratorBase<const value_type>(it)
+        { }
+    };
+private:
+    Node** slots;
+    size_t slotsNum;    // power of two (or zero)
+    size_t entriesNum;
+    Node* first;
+    Node* last;
+    
+    size_t findSlot(const AsmSymbolName& name) const;
+    void rehash(size_t newSlotsNum);
+    std::pair<iterator, bool> insertNode(size_t slot, Node* node);
+public:
+    /// empty constructor
+    AsmSymbolMap() : slots(nullptr), slotsNum(0), entriesNum(0),
+                first(nullptr), last(nullptr)
+    { }
+    /// constructor with initializer list
+    AsmSymbolMap(std::initializer_list<value_type> list)
+            : slots(nullptr), slotsNum(0), entriesNum(0), first(nullptr), last(nullptr)
+    {
+        for (const value_type& entry: list)
+            insert(entry);
+    }
+    /// copy constructor
+    AsmSymbolMap(const AsmSymbolMap& map);
+    /// move constructor
+    AsmSymbolMap(AsmSymbolMap&& map) noexcept;
+    /// destructor
+    ~AsmSymbolMap();
+    
+    /// copy assignment
+    AsmSymbolMap& operator=(const AsmSymbolMap& map);
+    /// move assignment
+    AsmSymbolMap& operator=(AsmSymbolMap&& map) noexcept;
+    
+    /// find entry by name with hash
+    iterator find(const AsmSymbolName& name)
+    {
+        const size_t slot = findSlot(name);
+        return iterator(slotsNum != 0 ? slots[slot] : nullptr);
+    }
+    /// find entry by name with hash
+    const_iterator find(const AsmSymbolName& name) const
+    {
+        const size_t slot = findSlot(name);
+        return const_iterator(slotsNum != 0 ? slots[slot] : nullptr);
+    }
+    /// find entry by name
+    iterator find(const CString& name)
+    { return find(AsmSymbolName(name)); }
+    /// find entry by name
+    const_iterator find(const CString& name) const
+    { return find(AsmSymbolName(name)); }
+    /// find entry by name
+    iterator find(const char* name)
+    { return find(AsmSymbolName(name)); }
+    /// find entry by name
+    const_iterator find(const char* name) const
+    { return find(AsmSymbolName(name)); }
+    
+    /// insert entry if not exists, returns entry and true if inserted
+    std::pair<iterator, bool> insert(const value_type& entry);
+    /// insert symbol if not exists (name is copied only if symbol is inserted)
+    std::pair<iterator, bool> insert(const AsmSymbolName& name, const AsmSymbol& symbol);
+    /// get symbol by name (inserts empty symbol if not exists)
+    AsmSymbol& operator[](const CString& name)
+    { return insert(AsmSymbolName(name), AsmSymbol()).first->second; }
+    /// erase entry, returns iterator to next entry
+    iterator erase(iterator it);
+    /// remove all entries
+    void clear();
+    
+    /// get number of entries
+    size_t size() const
+    { return entriesNum; }
+    /// return true if empty
+    bool empty() const
+    { return entriesNum == 0; }
+    
+    /// get iterator to first entry
+    iterator begin()
+    { return iterator(first); }
+    /// get iterator to first entry
+    const_iterator begin() const
+    { return const_iterator(first); }
+    /// get iterator after last entry
+    iterator end()
+    { return iterator(); }
+    /// get iterator after last entry
+    const_iterator end() const
+    { return const_iterator(); }
+};
+
 /// assembler symbol entry
 typedef AsmSymbolMap::value_type AsmSymbolEntry;
 
@@ -287,15 +665,22 @@ class AsmExpression: public NonCopyableAndNonMovable
 {
 private:
     class TempSymbolSnapshotMap;
+    struct Code;
     
     AsmExprTarget target;
     AsmSourcePos sourcePos;
     size_t symOccursNum;
     bool relativeSymOccurs;
     bool baseExpr;
-    Array<AsmExprOp> ops;
-    std::unique_ptr<LineCol[]> messagePositions;    ///< for every potential message
-    std::unique_ptr<AsmExprArg[]> args;
+    AsmMemoryPool* memoryPool;  ///< pool for storage (if null, then heap is used)
+    void* storage;  ///< storage for arguments, message positions and operators
+    size_t opsNum;
+    size_t opPosNum;
+    size_t argsNum;
+    AsmExprOp* ops;
+    LineCol* messagePositions;    ///< for every potential message
+    AsmExprArg* args;
+    Code* code; ///< compiled code (constant-folded), null if not compiled
     
     AsmSourcePos getSourcePos(size_t msgPosIndex) const
     {
@@ -309,10 +694,13 @@ private:
                TempSymbolSnapshotMap* snapshotMap, const AsmSymbolEntry& symEntry,
                AsmSymbolEntry*& outSymEntry, const AsmSourcePos* topParentSourcePos);
     
-    AsmExpression();
+    explicit AsmExpression(AsmMemoryPool* memoryPool);
+    void allocateStorage(size_t opsNum, size_t opPosNum, size_t argsNum);
     void setParams(size_t symOccursNum, bool relativeSymOccurs,
             size_t _opsNum, const AsmExprOp* ops, size_t opPosNum, const LineCol* opPos,
             size_t argsNum, const AsmExprArg* args, bool baseExpr = false);
+    void compileCode();
+    void copyCode(const AsmExpression& expr);
 public:
     /// constructor of expression (helper)
     AsmExpression(const AsmSourcePos& pos, size_t symOccursNum, bool relativeSymOccurs,
@@ -327,7 +715,7 @@ public:
     
     /// return true if expression is empty
     bool isEmpty() const
-    { return ops.empty(); }
+    { return opsNum == 0; }
     
     /// helper to create symbol snapshot. Creates initial expression for symbol snapshot
     AsmExpression* createForSnapshot(const AsmSourcePos* exprSourcePos) const;
@@ -359,7 +747,7 @@ public:
      */
     AsmTryStatus tryEvaluate(Assembler& assembler, uint64_t& value, AsmSectionId& sectionId,
                     bool withSectionDiffs = false) const
-    { return tryEvaluate(assembler, 0, ops.size(), value, sectionId, withSectionDiffs); }
+    { return tryEvaluate(assembler, 0, opsNum, value, sectionId, withSectionDiffs); }
     
     /// try to evaluate expression
     /**
@@ -369,7 +757,7 @@ public:
      * \return true if evaluated
      */
     bool evaluate(Assembler& assembler, uint64_t& value, AsmSectionId& sectionId) const
-    { return tryEvaluate(assembler, 0, ops.size(), value, sectionId) !=
+    { return tryEvaluate(assembler, 0, opsNum, value, sectionId) !=
                     AsmTryStatus::FAILED; }
     
     /// try to evaluate expression
@@ -436,15 +824,21 @@ public:
     /// replace symbol in expression
     void replaceOccurrenceSymbol(AsmExprSymbolOccurrence occurrence,
                     AsmSymbolEntry* newSymEntry);
+    /// get operators number
+    size_t getOpsNum() const
+    { return opsNum; }
     /// get operators list
-    const Array<AsmExprOp>& getOps() const
+    const AsmExprOp* getOps() const
     { return ops; }
     /// get argument list
     const AsmExprArg* getArgs() const
-    { return args.get(); }
+    { return args; }
     /// get source position
     const AsmSourcePos& getSourcePos() const
     { return sourcePos; }
+    /// get memory pool used by expression (null if heap is used)
+    AsmMemoryPool* getMemoryPool() const
+    { return memoryPool; }
     
     /// for internal usage
     size_t toTop(size_t opIndex) const;
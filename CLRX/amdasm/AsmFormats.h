@@ -212,9 +212,16 @@ public:
     /// write binary to array
     virtual void writeBinary(Array<cxbyte>& array) const = 0;
     
+    /// reset handler to state after construction (to reuse it by next assembling)
+    /** detected driver and compiler versions are kept */
+    virtual void reset() = 0;
+    
     /// prepare before section diference resolving
     virtual bool prepareSectionDiffsResolving();
     virtual void setCodeFlags(Flags codeFlags);
+    /// set numbers of used registers by kernel (after register allocation)
+    /** numbers can be lower than numbers of registers used before allocation */
+    virtual void updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum);
 };
 
 /// format handler with Kcode (kernel-code) handling
@@ -232,10 +239,13 @@ protected:
     
     void restoreKcodeCurrentAllocRegs();
     void saveKcodeCurrentAllocRegs();
+    // clear kcode state (while resetting handler)
+    void resetKcodeState();
     // prepare kcode state while preparing binary
     void prepareKcodeState();
 public:
     void handleLabel(const CString& label);
+    void updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum);
     
     /// return true if current section is code section
     virtual bool isCodeSection() const = 0;
@@ -256,6 +266,8 @@ public:
     /// destructor
     ~AsmRawCodeHandler() = default;
     
+    void reset();
+    
     AsmKernelId addKernel(const char* kernelName);
     AsmSectionId addSection(const char* sectionName, AsmKernelId kernelId);
 
@@ -329,6 +341,8 @@ public:
     /// destructor
     ~AsmAmdHandler();
     
+    void reset();
+    
     AsmKernelId addKernel(const char* kernelName);
     AsmSectionId addSection(const char* sectionName, AsmKernelId kernelId);
     
@@ -343,6 +357,7 @@ public:
     bool prepareBinary();
     void writeBinary(std::ostream& os) const;
     void writeBinary(Array<cxbyte>& array) const;
+    void updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum);
     /// get output structure pointer
     const AmdInput* getOutput() const
     { return &output; }
@@ -444,6 +459,8 @@ public:
     /// destructor
     ~AsmAmdCL2Handler();
     
+    void reset();
+    
     AsmKernelId addKernel(const char* kernelName);
     AsmSectionId addSection(const char* sectionName, AsmKernelId kernelId);
     
@@ -461,6 +478,7 @@ public:
     bool prepareBinary();
     void writeBinary(std::ostream& os) const;
     void writeBinary(Array<cxbyte>& array) const;
+    void updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum);
     /// get output structure pointer
     const AmdCL2Input* getOutput() const
     { return &output; }
@@ -530,6 +548,8 @@ public:
     /// destructor
     ~AsmGalliumHandler();
     
+    void reset();
+    
     AsmKernelId addKernel(const char* kernelName);
     AsmSectionId addSection(const char* sectionName, AsmKernelId kernelId);
     
@@ -613,6 +633,8 @@ public:
     /// destructor
     ~AsmROCmHandler();
     
+    void reset();
+    
     AsmKernelId addKernel(const char* kernelName);
     AsmSectionId addSection(const char* sectionName, AsmKernelId kernelId);
     
@@ -25,6 +25,7 @@
 
 #include <CLRX/Config.h>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <istream>
 #include <ostream>
@@ -186,6 +187,45 @@ public:
         LineNo lineNo;    ///< line number
         RefPtr<const AsmSource> source; ///< source
     };
+    
+    /// type of part of compiled macro line
+    enum class PartType: cxbyte
+    {
+        TEXT = 0,   ///< text from content
+        ARG,        ///< macro argument value
+        COUNTER     ///< macro substitution counter
+    };
+    
+    /// part of compiled macro line
+    struct LinePart
+    {
+        PartType type;  ///< type of part
+        size_t pos;     ///< position in content or index of argument in sorted arg map
+        size_t size;    ///< size of text
+    };
+    
+    /// column translation of compiled macro line
+    /** destination position is textPos plus sizes of first slotsNum substitutions */
+    struct LinePartTrans
+    {
+        size_t textPos;     ///< position without substitutions
+        size_t slotsNum;    ///< number of substitutions before position
+        LineNo lineNo;      ///< line number
+    };
+    
+    /// compiled macro line (used if no altmacro mode)
+    struct CompiledLine
+    {
+        size_t partsEnd;    ///< end of parts of this line
+        size_t colTransEnd; ///< end of column translations of this line
+        size_t nextPos;     ///< position of next line in content
+        LineNo firstLineNo; ///< line number of first column translation
+        LineNo lineNo;      ///< line number after reading this line
+        size_t lineStartTextPos;    ///< text position of start of real line
+        size_t lineStartSlotsNum;   ///< substitutions before start of real line
+        bool resetLinePos;  ///< real new line inside this line
+        cxbyte nextLinePos; ///< 0 - keep, 1 - reset, 2 - add line size to real line pos
+    };
 private:
     LineNo contentLineNo;
     AsmSourcePos sourcePos;
@@ -193,6 +233,9 @@ private:
     std::vector<char> content;
     std::vector<SourceTrans> sourceTranslations;
     std::vector<LineTrans> colTranslations;
+    std::vector<CompiledLine> compiledLines;
+    std::vector<LinePart> lineParts;
+    std::vector<LinePartTrans> linePartTrans;
 public:
     /// constructor
     AsmMacro(const AsmSourcePos& pos, const Array<AsmMacroArg>& args);
@@ -209,9 +252,20 @@ public:
      */
     void addLine(RefPtr<const AsmMacroSubst> macro, RefPtr<const AsmSource> source,
              const std::vector<LineTrans>& colTrans, size_t lineSize, const char* line);
+    /// compile content to lines of text and substitutions (after adding all lines)
+    void compile();
     /// get column translations
     const std::vector<LineTrans>& getColTranslations() const
     { return colTranslations; }
+    /// get compiled lines
+    const std::vector<CompiledLine>& getCompiledLines() const
+    { return compiledLines; }
+    /// get parts of compiled lines
+    const std::vector<LinePart>& getLineParts() const
+    { return lineParts; }
+    /// get column translations of compiled lines
+    const std::vector<LinePartTrans>& getLinePartTrans() const
+    { return linePartTrans; }
     /// get content vector
     const std::vector<char>& getContent() const
     { return content; }
@@ -346,6 +400,41 @@ enum class AsmInputFilterType
     MACROSUBST  ///< AsmMacroInputFilter
 };
 
+/// statement of repetition line cached between iterations
+/** statement is valid for line if line's beginning (to the arguments) is same as
+ * the prefix. Lines with labels and assignments are not cached */
+struct AsmCachedStmt
+{
+    /// type of cached statement
+    enum Type: cxbyte
+    {
+        NONE = 0,   ///< not cached
+        PSEUDOOP,   ///< pseudo-op
+        INSTRUCTION ///< processor instruction
+    };
+    Type type;      ///< type of statement
+    std::string prefix; ///< beginning of line (with first character of arguments)
+    size_t stmtPos; ///< position of statement name in line
+    size_t argsPos; ///< position of arguments in line
+    CString name;   ///< statement name (lower case)
+    size_t id;      ///< pseudo-op index or instruction id
+    
+    /// constructor
+    AsmCachedStmt() : type(NONE)
+    { }
+    
+    /// returns true if statement is cached for this line
+    bool match(const char* line, size_t lineSize) const
+    {
+        return type != NONE && lineSize >= prefix.size() &&
+            (lineSize > argsPos) == (prefix.size() > argsPos) &&
+            ::memcmp(line, prefix.c_str(), prefix.size()) == 0;
+    }
+    /// set cached statement for line
+    void set(Type type, const char* line, size_t lineSize, const char* stmtPlace,
+             const char* argsPlace, const CString& name, size_t id);
+};
+
 /// assembler input filter for reading lines
 class AsmInputFilter: public NonCopyableAndNonMovable
 {
@@ -373,6 +462,9 @@ public:
     /// read line and returns line except newline character
     virtual const char* readLine(Assembler& assembler, size_t& lineSize) = 0;
     
+    /// get cached statement of last read line (null if filter doesn't cache)
+    virtual AsmCachedStmt* getCachedStmt();
+    
     /// get current line number after reading line
     LineNo getLineNo() const
     { return lineNo; }
@@ -409,7 +501,8 @@ public:
 /// assembler input layout filter
 /** filters input from comments and join splitted lines by backslash.
  * readLine returns prepared line which have only space (' ') and
- * non-space characters. */
+ * non-space characters. Regular source files are memory-mapped and lines
+ * that do not require filtering are returned directly from the mapping. */
 class AsmStreamInputFilter: public AsmInputFilter
 {
 private:
@@ -424,12 +517,23 @@ private:
     
     bool managed;
     std::istream* stream;
+    MappedFile* mappedFile; ///< mapped source file
+    const char* content;    ///< source in memory (if null, then stream is used)
+    size_t contentSize;     ///< size of source in memory
+    size_t contentPos;      ///< position in source in memory
     LineMode mode;
     size_t stmtPos;
     
+    void openFile(const CString& filename);
+    const char* readContentLine(size_t& lineSize);
+    size_t readContentToBuffer();
 public:
     /// constructor with input stream and their filename
     explicit AsmStreamInputFilter(std::istream& is, const CString& filename = "");
+    /// constructor with source in memory and their filename
+    /** source must be available until end of reading */
+    AsmStreamInputFilter(size_t sourceSize, const char* sourceCode,
+             const CString& filename = "");
     /// constructor with input filename
     explicit AsmStreamInputFilter(const CString& filename);
     /// constructor with source position, input stream and their filename
@@ -462,6 +566,11 @@ private:
     const LineTrans* curColTrans;
     size_t realLinePos; ///< real line size
     bool alternateMacro;
+    
+    /// read line from compiled macro content
+    const char* readCompiledLine(size_t& lineSize);
+    /// move to source translation of next line
+    void nextSourceTrans();
 public:
     /// constructor with input macro, source position and arguments map
     AsmMacroInputFilter(RefPtr<const AsmMacro> macro, const AsmSourcePos& pos,
@@ -484,12 +593,15 @@ protected:
     LineNo contentLineNo;
     size_t sourceTransIndex;
     const LineTrans* curColTrans;
+    std::vector<AsmCachedStmt> cachedStmts; ///< cached statements of lines
 public:
     /// constructor
     explicit AsmRepeatInputFilter(const AsmRepeat* repeat);
     
     const char* readLine(Assembler& assembler, size_t& lineSize);
     
+    AsmCachedStmt* getCachedStmt();
+    
     /// get current repeat count
     uint64_t getRepeatCount() const
     { return repeatCount; }
@@ -515,12 +627,15 @@ private:
     size_t sourceTransIndex;
     const LineTrans* curColTrans;
     size_t realLinePos; ///< real line size
+    std::vector<AsmCachedStmt> cachedStmts; ///< cached statements of lines
 public:
     /// constructor
     explicit AsmIRPInputFilter(const AsmIRP* irp);
     
     const char* readLine(Assembler& assembler, size_t& lineSize);
     
+    AsmCachedStmt* getCachedStmt();
+    
     /// get current repeat count
     uint64_t getRepeatCount() const
     { return repeatCount; }
@@ -562,7 +677,7 @@ public:
     { return readPos.chunkPos < chunks.size() && (readPos.chunkPos+1 != chunks.size() ||
         readPos.itemPos < chunks.back().items.size()); }
     /// get next source position with offset
-    std::pair<size_t, AsmSourcePos> nextSourcePos(ReadPos& rPos);
+    std::pair<size_t, AsmSourcePos> nextSourcePos(ReadPos& rPos) const;
     // find position by offset
     ReadPos findPositionByOffset(size_t offset) const;
 };
@@ -31,6 +31,7 @@
 #include <ostream>
 #include <iostream>
 #include <vector>
+#include <map>
 #include <utility>
 #include <stack>
 #include <list>
@@ -63,10 +64,13 @@ enum: Flags
     ASM_MACRONOCASE = 16, /// disable case-insensitive naming (default)
     ASM_OLDMODPARAM = 32,   ///< use old modifier parametrization (values 0 and 1 only)
     ASM_WAVE32 = 64, ///< use WAVESIZE32
+    ASM_REGALLOC = 128, ///< collect register usage for register allocation
+    /// insert wait instructions automatically (after assembling)
+    ASM_AUTOWAIT = 256,
     ASM_TESTRESOLVE = (1U<<30), ///< enable resolving symbols if ASM_TESTRUN enabled
     ASM_TESTRUN = (1U<<31), ///< only for running tests
     ASM_ALL = FLAGS_ALL&~(ASM_TESTRUN|ASM_TESTRESOLVE|ASM_BUGGYFPLIT|ASM_MACRONOCASE|
-                    ASM_WAVE32|ASM_OLDMODPARAM)  ///< all flags
+                    ASM_WAVE32|ASM_OLDMODPARAM|ASM_REGALLOC|ASM_AUTOWAIT)  ///< all flags
 };
 
 enum: Flags
@@ -75,6 +79,25 @@ enum: Flags
 };
 
 struct AsmRegVar;
+struct AsmSymbolDepGraph;
+
+/// map of code offsets after inserting code before some instructions
+class AsmCodeShiftMap
+{
+private:
+    // old offset of instruction and total size of inserted code to this instruction
+    std::vector<std::pair<size_t, size_t> > shifts;
+public:
+    /// add insertion of code before instruction (must be added in offset order)
+    void addInsertion(size_t offset, size_t size);
+    /// return true if no insertions
+    bool empty() const
+    { return shifts.empty(); }
+    /// get new offset of instruction (inserted code is placed before instruction)
+    size_t instrOffset(size_t offset) const;
+    /// get new offset of label (label is placed before inserted code)
+    size_t labelOffset(size_t offset) const;
+};
 
 /// ISA (register and regvar) Usage handler
 class ISAUsageHandler
@@ -126,6 +149,8 @@ public:
     AsmRegVarUsage nextUsage(ReadPos& readPos);
     // find position by offset
     ReadPos findPositionByOffset(size_t offset) const;
+    /// update offsets after inserting code
+    void shiftOffsets(const AsmCodeShiftMap& shiftMap);
     
     /// get usage dependencies around single instruction
     virtual void getUsageDependencies(cxuint rvusNum, const AsmRegVarUsage* rvus,
@@ -152,6 +177,8 @@ public:
     { return regVarLinDeps[pos]; }
     /// find position by offset
     size_t findPositionByOffset(size_t offset) const;
+    /// update offsets after inserting code
+    void shiftOffsets(const AsmCodeShiftMap& shiftMap);
     /// copy linear handler (make new copy)
     ISALinearDepHandler* copy() const;
 };
@@ -208,6 +235,10 @@ public:
     bool nextInstr(ReadPos& readPos, AsmDelayedOp& delOp, AsmWaitInstr& waitInstr);
     /// find position by offset
     ReadPos findPositionByOffset(size_t offset) const;
+    /// update offsets after inserting code
+    void shiftOffsets(const AsmCodeShiftMap& shiftMap);
+    /// add wait instructions (sorted by offset) to wait instructions
+    void addWaitInstrs(const std::vector<AsmWaitInstr>& newWaitInstrs);
     /// copy wait handler (make new copy)
     ISAWaitHandler* copy() const;
 };
@@ -237,11 +268,20 @@ public:
     virtual ~ISAAssembler();
     /// create usage handler
     virtual ISAUsageHandler* createUsageHandler() const = 0;
+    /// reset ISA assembler to state after construction (for current GPU device)
+    virtual void reset() = 0;
     
     /// assemble single line
     virtual void assemble(const CString& mnemonic, const char* mnemPlace,
               const char* linePtr, const char* lineEnd, std::vector<cxbyte>& output,
               ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler) = 0;
+    /// resolve mnemonic to instruction id (to assemble cached statements)
+    /** \return false if mnemonic is unknown or can not be resolved */
+    virtual bool resolveMnemonic(const CString& mnemonic, size_t& instrId) const;
+    /// assemble single line with instruction id returned by resolveMnemonic
+    virtual void assembleResolved(size_t instrId, const char* mnemPlace,
+              const char* linePtr, const char* lineEnd, std::vector<cxbyte>& output,
+              ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler);
     /// resolve code with location, target and value
     virtual bool resolveCode(const AsmSourcePos& sourcePos, AsmSectionId targetSectionId,
                  cxbyte* sectionData, size_t offset, AsmExprTargetType targetType,
@@ -274,6 +314,27 @@ public:
     /// get size of instruction
     virtual size_t getInstructionSize(size_t codeSize, const cxbyte* code) const = 0;
     virtual const AsmWaitConfig& getWaitConfig() const = 0;
+    /// encode wait instructions (put to output)
+    virtual void encodeWaitInstr(const AsmWaitInstr& waitInstr,
+                std::vector<cxbyte>& output) const = 0;
+    /// encode copy of register (or swap of registers) (put to output)
+    /** \param regType register type
+     * \param dstReg index of destination register (in register type)
+     * \param srcReg index of source register (in register type)
+     * \param swap if true, then registers are swapped
+     * \param output output code */
+    virtual void encodeRegCopy(cxuint regType, cxuint dstReg, cxuint srcReg, bool swap,
+                std::vector<cxbyte>& output) const = 0;
+    /// update relative target of jump instruction after inserting code
+    /** \param code section content after inserting code
+     * \param oldOffset old offset of jump instruction
+     * \param oldTarget old target of jump
+     * \param offset new offset of jump instruction
+     * \param target new target of jump
+     * \return false if new target is out of range
+     */
+    virtual bool relocateJump(cxbyte* code, size_t oldOffset, size_t oldTarget,
+                size_t offset, size_t target) const = 0;
 };
 
 /// GCN arch assembler
@@ -345,10 +406,15 @@ public:
     ~GCNAssembler();
     
     ISAUsageHandler* createUsageHandler() const;
+    void reset();
     
     void assemble(const CString& mnemonic, const char* mnemPlace, const char* linePtr,
                   const char* lineEnd, std::vector<cxbyte>& output,
                   ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler);
+    bool resolveMnemonic(const CString& mnemonic, size_t& instrId) const;
+    void assembleResolved(size_t instrId, const char* mnemPlace, const char* linePtr,
+                  const char* lineEnd, std::vector<cxbyte>& output,
+                  ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler);
     bool resolveCode(const AsmSourcePos& sourcePos, AsmSectionId targetSectionId,
                  cxbyte* sectionData, size_t offset, AsmExprTargetType targetType,
                  AsmSectionId sectionId, uint64_t value);
@@ -365,6 +431,108 @@ public:
     bool parseRegisterType(const char*& linePtr, const char* end, cxuint& type);
     size_t getInstructionSize(size_t codeSize, const cxbyte* code) const;
     const AsmWaitConfig& getWaitConfig() const;
+    void encodeWaitInstr(const AsmWaitInstr& waitInstr, std::vector<cxbyte>& output) const;
+    void encodeRegCopy(cxuint regType, cxuint dstReg, cxuint srcReg, bool swap,
+                std::vector<cxbyte>& output) const;
+    bool relocateJump(cxbyte* code, size_t oldOffset, size_t oldTarget,
+                size_t offset, size_t target) const;
+};
+
+/// interference graph of the virtual registers (used by register allocator)
+/** Graph is built in two steps: adding edges and finishing (creating adjacency lists).
+ * If number of nodes is not greater than maxBitMatrixNodes then the edges are also
+ * stored in triangular bit-matrix (every row aligned to 64-bit word). Otherwise
+ * adjacency lists are only used (duplicated edges are removed while finishing).
+ */
+class AsmInterGraph
+{
+public:
+    /// list of neighbors of the node
+    class Neighbors
+    {
+    private:
+        const size_t* first;
+        const size_t* last;
+    public:
+        /// constructor
+        Neighbors(const size_t* _first, const size_t* _last)
+            : first(_first), last(_last)
+        { }
+        /// get begin of list
+        const size_t* begin() const
+        { return first; }
+        /// get end of list
+        const size_t* end() const
+        { return last; }
+        /// get number of neighbors
+        size_t size() const
+        { return last-first; }
+        /// return true if no neighbors
+        bool empty() const
+        { return first==last; }
+    };
+    
+    /// max nodes number for bit-matrix (bit-matrix takes 4 MB for this number)
+    static const size_t maxBitMatrixNodes = 8192;
+private:
+    size_t nodesNum;
+    Array<size_t> rowOffsets;   // offsets of bit-matrix rows (in words)
+    Array<uint64_t> bitMatrix;  // row 'i' holds edges with nodes 'j<i'
+    std::vector<std::pair<size_t, size_t> > edges;  // edges before finishing
+    Array<size_t> adjOffsets;   // offsets of adjacency lists (nodesNum+1)
+    Array<size_t> adjNodes;     // adjacency lists
+public:
+    /// empty constructor
+    AsmInterGraph() : nodesNum(0)
+    { }
+    
+    /// clear graph and prepare graph with specified number of nodes
+    void reset(size_t nodesNum);
+    /// add edge between two distinct nodes (before finishing)
+    void addEdge(size_t a, size_t b)
+    {
+        if (a < b)
+            std::swap(a, b);
+        if (!rowOffsets.empty())
+        {
+            uint64_t& word = bitMatrix[rowOffsets[a] + (b>>6)];
+            const uint64_t mask = uint64_t(1)<<(b&63);
+            if ((word & mask) != 0)
+                return; // already added
+            word |= mask;
+        }
+        edges.push_back(std::make_pair(a, b));
+    }
+    /// create adjacency lists (after adding all edges)
+    void finish();
+    /// clear graph
+    void clear();
+    
+    /// return true if nodes interfere
+    bool isEdge(size_t a, size_t b) const;
+    /// get number of nodes
+    size_t size() const
+    { return nodesNum; }
+    /// get number of edges (after finishing)
+    size_t getEdgesNum() const
+    { return adjNodes.size()>>1; }
+    /// return true if graph uses bit-matrix
+    bool hasBitMatrix() const
+    { return !rowOffsets.empty(); }
+    /// get neighbors of node (after finishing)
+    Neighbors operator[](size_t node) const
+    { return Neighbors(adjNodes.data() + adjOffsets[node],
+                adjNodes.data() + adjOffsets[node+1]); }
+};
+
+/// register pressure in code block (reported if register allocation failed)
+struct AsmRegPressure
+{
+    size_t start;   ///< start offset of code block
+    size_t end;     ///< end offset of code block
+    cxuint maxLive[MAX_REGTYPES_NUM];   ///< max number of live registers
+    /// single vregs live at point of the max number of live registers
+    std::vector<AsmSingleVReg> liveSVRegs[MAX_REGTYPES_NUM];
 };
 
 class AsmRegAllocator
@@ -416,7 +584,7 @@ public:
     typedef std::pair<size_t, size_t> SSAReplace;
     typedef std::unordered_map<AsmSingleVReg, VectorSet<SSAReplace> > SSAReplacesMap;
     // interference graph type
-    typedef Array<DTreeSet<size_t> > InterGraph;
+    typedef AsmInterGraph InterGraph;
     typedef std::unordered_map<AsmSingleVReg, std::vector<size_t> > VarIndexMap;
     struct LinearDep
     {
@@ -427,7 +595,26 @@ public:
     
     struct VIdxSetEntry
     {
-        DTree<size_t> vs[MAX_REGTYPES_NUM];
+        bool used;  // true if entry is filled for this block
+        std::vector<size_t> vs[MAX_REGTYPES_NUM];  // sorted vidxes
+        
+        VIdxSetEntry() : used(false)
+        { }
+    };
+    // part of live range of split virtual register (with own color)
+    struct SplitRange
+    {
+        size_t vidx;
+        size_t start, end;  // place in code
+        cxuint color;
+    };
+    // copy between parts of split virtual register at start of code block
+    // (copies at this same offset are parallel)
+    struct SplitCopy
+    {
+        size_t offset;
+        cxuint srcColor;
+        cxuint dstColor;
     };
 private:
     Assembler& assembler;
@@ -441,16 +628,28 @@ private:
     InterGraph interGraphs[MAX_REGTYPES_NUM]; // for 2 register 
     Array<cxuint> graphColorMaps[MAX_REGTYPES_NUM];
     std::unordered_map<size_t, LinearDep> linearDepMaps[MAX_REGTYPES_NUM];
-    // key - routine block, value - set of svvregs (lv indexes) used in routine
-    std::unordered_map<size_t, VIdxSetEntry> vidxRoutineMap;
-    // key - call block, value - set of svvregs (lv indexes) used between this call point
-    std::unordered_map<size_t, VIdxSetEntry> vidxCallMap;
-    
+    // index - routine block, value - set of svvregs (lv indexes) used in routine
+    std::vector<VIdxSetEntry> vidxRoutineMap;
+    // index - call block, value - set of svvregs (lv indexes) used between this call point
+    std::vector<VIdxSetEntry> vidxCallMap;
+    // split live ranges (if register allocation needed splitting)
+    std::vector<SplitRange> splitRanges[MAX_REGTYPES_NUM];
+    std::vector<SplitCopy> splitCopies[MAX_REGTYPES_NUM];
+    // register pressure in code blocks (filled if register allocation failed)
+    std::vector<AsmRegPressure> regPressures;
+    // code offsets of instructions with failed linear dependencies
+    std::vector<size_t> linearDepErrors;
+    
+    bool splitLiveRanges(size_t regType, size_t maxColorsNum,
+                const std::vector<std::pair<uint16_t, size_t> >& realRegNodes);
+    void createRegPressures();
 public:
     AsmRegAllocator(Assembler& assembler);
     // constructor for testing
     AsmRegAllocator(Assembler& assembler, const std::vector<CodeBlock>& codeBlocks,
                 const SSAReplacesMap& ssaReplacesMap);
+    // constructor for testing (creating interference graph from livenesses)
+    AsmRegAllocator(Assembler& assembler, const Array<OutLiveness>* outLivenesses);
     
     void createCodeStructure(const std::vector<AsmCodeFlowEntry>& codeFlow,
              size_t codeSize, const cxbyte* code);
@@ -477,13 +676,34 @@ public:
     const VarIndexMap* getVregIndexMaps() const
     { return vregIndexMaps; }
     
-    const std::unordered_map<size_t, VIdxSetEntry>& getVIdxRoutineMap() const
+    const InterGraph* getInterGraphs() const
+    { return interGraphs; }
+    const Array<cxuint>* getGraphColorMaps() const
+    { return graphColorMaps; }
+    
+    const std::vector<VIdxSetEntry>& getVIdxRoutineMap() const
     { return vidxRoutineMap; }
-    const std::unordered_map<size_t, VIdxSetEntry>& getVIdxCallMap() const
+    const std::vector<VIdxSetEntry>& getVIdxCallMap() const
     { return vidxCallMap; }
+    
+    const std::vector<SplitRange>* getSplitRanges() const
+    { return splitRanges; }
+    const std::vector<SplitCopy>* getSplitCopies() const
+    { return splitCopies; }
+    const std::vector<AsmRegPressure>& getRegPressures() const
+    { return regPressures; }
+    const std::vector<size_t>& getLinearDepErrors() const
+    { return linearDepErrors; }
+    
+    /// encode parallel copies (at same place) of registers in some register type
+    /** cycles of copies are resolved by swaps. copies vector is consumed */
+    static void encodeSplitCopies(const ISAAssembler& isaAssembler, cxuint regType,
+                std::vector<SplitCopy>& copies, std::vector<cxbyte>& output);
 };
 
 /// Assembler Wait scheduler
+/** if graphColorMaps is null, dependencies are computed on registers encoded in
+ * instructions (every register of regvar is separate register) */
 class AsmWaitScheduler
 {
 private:
@@ -492,20 +712,55 @@ private:
     const std::vector<AsmRegAllocator::CodeBlock>& codeBlocks;
     const AsmRegAllocator::VarIndexMap* vregIndexMaps;
     const Array<cxuint>* graphColorMaps;
-    bool onlyWarnings;
+    const std::vector<AsmRegAllocator::SplitRange>* splitRanges;
+    cxuint maxBlockVisits;
     std::vector<AsmWaitInstr> neededWaitInstrs;
 public:
     AsmWaitScheduler(const AsmWaitConfig& asmWaitConfig, Assembler& assembler,
             const std::vector<AsmRegAllocator::CodeBlock>& codeBlocks,
             const AsmRegAllocator::VarIndexMap* vregIndexMaps,
-            const Array<cxuint>* graphColorMaps, bool onlyWarnings);
+            const Array<cxuint>* graphColorMaps,
+            const std::vector<AsmRegAllocator::SplitRange>* splitRanges = nullptr);
     
     void schedule(ISAUsageHandler& usageHandler, ISAWaitHandler& waitHandler);
     
+    /// set max number of visits of code block while scheduling
+    /** if queue states at start of block still change after that, then all
+     * operations are waited for at start of block */
+    void setMaxBlockVisits(cxuint visits)
+    { maxBlockVisits = visits; }
+    
+    /// get wait instructions that must be inserted before instructions
+    /** waits are as relaxed as allowed by dependencies between delayed operations
+     * and register accesses (wait instructions in code are respected) */
     const std::vector<AsmWaitInstr>& getNeededWaitInstrs() const
     { return neededWaitInstrs; }
 };
 
+/// result of register allocation and wait scheduling for code section
+struct AsmRegAllocResult
+{
+    AsmSectionId sectionId; ///< section id
+    /// indices of virtual registers in graph color maps
+    AsmRegAllocator::VarIndexMap vregIndexMaps[MAX_REGTYPES_NUM];
+    /// allocated registers for virtual registers (by index)
+    Array<cxuint> graphColorMaps[MAX_REGTYPES_NUM];
+    /// parts of live ranges of split virtual registers (with own colors)
+    std::vector<AsmRegAllocator::SplitRange> splitRanges[MAX_REGTYPES_NUM];
+    /// copies between parts of split virtual registers (not inserted to code)
+    std::vector<AsmRegAllocator::SplitCopy> splitCopies[MAX_REGTYPES_NUM];
+    /// register pressure in code blocks (if register allocation failed)
+    std::vector<AsmRegPressure> regPressures;
+    /// code offsets of instructions with failed linear dependencies
+    std::vector<size_t> linearDepErrors;
+    /// numbers of allocated registers (without extra registers like VCC),
+    /// registers used directly in code are counted (operands are not rewritten)
+    cxuint regsNum[MAX_REGTYPES_NUM];
+    cxuint wavesPerSIMD;    ///< achieved number of waves per SIMD (occupancy)
+    /// wait instructions needed before instructions (missing in code)
+    std::vector<AsmWaitInstr> waitInstrs;
+};
+
 /// type of clause
 enum class AsmClauseType
 {
@@ -525,6 +780,153 @@ struct AsmClause
     AsmSourcePos prevIfPos; ///< position of previous if-clause
 };
 
+/// file read while assemblying (included source file or binary file)
+/** include search also gives missing files: paths tried before found file. entry
+ * of cache is valid only if these files still do not exist (they would be found) */
+struct AsmFileDependency
+{
+    std::string path;   ///< path to file (as opened by assembler)
+    bool regular;       ///< false if file is not regular file (pipe or device)
+    uint64_t contentHash;   ///< hash of content of regular file
+    bool missing;       ///< true if file has not existed (tried by include search)
+};
+
+/// cache of include files results (for incremental assembling)
+/** Cache holds results of included files (new symbols and macros), keyed by
+ * path of file and by settings of assembler. Every entry holds global symbols and
+ * macros used by included file (with their state before inclusion). If included file
+ * and its nested included files has not been changed and these symbols and macros
+ * are same, then assembler restores these results instead parsing file again.
+ * Only files that contain declarations (macros, symbol assignments, conditionals,
+ * repetitions, nested includes) included in global scope are cached.
+ * This class is not thread-safe: cache can be used only by assemblers
+ * in one thread. */
+class AsmIncludeCache: public NonCopyableAndNonMovable
+{
+private:
+    friend class Assembler;
+    
+    // global symbol used by included file (state before inclusion)
+    struct SymbolDep
+    {
+        CString name;
+        bool exists;    // false if symbol has not existed
+        uint64_t stateHash;
+    };
+    // macro used by included file (state before inclusion)
+    struct MacroDep
+    {
+        CString name;
+        RefPtr<const AsmMacro> macro;   // null if macro has not existed
+        uint64_t macroHash;
+    };
+    
+    struct Entry
+    {
+        uint64_t contentHash;
+        // nested included files (and missing files tried by include search)
+        std::vector<AsmFileDependency> dependencies;
+        std::vector<SymbolDep> symbolDeps;
+        std::vector<MacroDep> macroDeps;
+        bool macroCountUsed;    // if file substitutes macros (uses macro counter)
+        uint64_t macroCount;
+        std::vector<std::pair<CString, AsmSymbol> > symbols;
+        // new or changed macros (null if macro has been removed)
+        std::vector<std::pair<CString, RefPtr<const AsmMacro> > > macros;
+        uint64_t macroCountDelta;
+    };
+    
+    // entries for file and settings (for different states of used symbols and macros)
+    std::map<std::pair<std::string, uint64_t>, std::vector<Entry> > entries;
+    size_t entriesNum;
+    size_t hitsNum;
+    size_t missesNum;
+public:
+    /// constructor
+    AsmIncludeCache();
+    /// destructor
+    ~AsmIncludeCache();
+    
+    /// remove all entries
+    void clear();
+    /// get number of entries
+    size_t size() const
+    { return entriesNum; }
+    /// get number of includes restored from cache
+    size_t getHitsNum() const
+    { return hitsNum; }
+    /// get number of includes that has been parsed
+    size_t getMissesNum() const
+    { return missesNum; }
+};
+
+/// persistent cache of assembled binaries (stored in directory)
+/** Entry of cache is addressed by key: the hash of source code and all settings that
+ * affect output (format, device type, bitness, flags, policy, driver and LLVM version,
+ * working directory, include directories, initial defsyms and version of CLRX).
+ * Entry holds also absolute paths and content hashes of files read while
+ * assemblying (file dependencies) and entry is used only if these files have not
+ * been changed. Entries are written
+ * to temporary files and renamed, hence many processes can share one directory. */
+class AsmBinaryCache: public NonCopyableAndNonMovable
+{
+public:
+    /// key of cache entry (128-bit hash of inputs of assembler)
+    struct Key
+    {
+        uint64_t hash[2];   ///< hash value
+        
+        /// equal operator
+        bool operator==(const Key& k) const
+        { return hash[0]==k.hash[0] && hash[1]==k.hash[1]; }
+        /// not equal operator
+        bool operator!=(const Key& k) const
+        { return hash[0]!=k.hash[0] || hash[1]!=k.hash[1]; }
+    };
+private:
+    std::string directory;
+public:
+    /// constructor (creates directory if it does not exist)
+    explicit AsmBinaryCache(const char* dirPath);
+    /// destructor
+    ~AsmBinaryCache();
+    
+    /// get directory of cache
+    const std::string& getDirectory() const
+    { return directory; }
+    /// get path to file of entry
+    std::string getEntryPath(const Key& key) const;
+    
+    /// compute key from source code and settings of assembler
+    /** if driverVersion or llvmVersion is zero, then version detected by assembler
+     * for given format is used */
+    static Key computeKey(size_t sourceSize, const char* source, BinaryFormat format,
+            GPUDeviceType deviceType, bool is64Bit, Flags flags, cxuint policyVersion,
+            uint32_t driverVersion, uint32_t llvmVersion,
+            const std::vector<CString>& includeDirs,
+            const std::vector<std::pair<CString, uint64_t> >& defSyms);
+    
+    /// load binary and messages of assembler from cache
+    /**
+     * \param key key of entry
+     * \param binary output binary
+     * \param messages output messages (warnings) printed by assembler
+     * \return true if entry is valid and its file dependencies have not been changed
+     */
+    bool load(const Key& key, Array<cxbyte>& binary, std::string& messages) const;
+    
+    /// store binary and messages of assembler in cache
+    /** throws Exception if entry can not be written
+     * \param key key of entry
+     * \param fileDeps files read by assembler (Assembler::getFileDependencies)
+     * \param binary assembled binary
+     * \param messages messages (warnings) printed by assembler
+     * \return false if entry has not been stored (file dependency is not regular file)
+     */
+    bool store(const Key& key, const std::vector<AsmFileDependency>& fileDeps,
+            const Array<cxbyte>& binary, const std::string& messages) const;
+};
+
 /// main class of assembler
 class Assembler: public NonCopyableAndNonMovable
 {
@@ -558,6 +960,13 @@ private:
     friend struct AsmROCmPseudoOps; // INTERNAL LOGIC
     friend struct GCNAsmUtils; // INTERNAL LOGIC
     
+    // memory pool for expressions (must be destroyed after all expressions)
+    AsmMemoryPool memoryPool;
+    // buffers for expression parsing (reused by next expressions)
+    std::vector<AsmExprOp> exprOpsBuffer;
+    std::vector<AsmExprArg> exprArgsBuffer;
+    std::vector<LineCol> exprMsgPositionsBuffer;
+    std::vector<LineCol> exprOutMsgPositionsBuffer;
     Array<CString> filenames;
     BinaryFormat format;
     GPUDeviceType deviceType;
@@ -571,6 +980,48 @@ private:
     bool resolvingRelocs;
     bool doNotRemoveFromSymbolClones;
     cxuint policyVersion;
+    cxuint occupancyTarget; // target waves per SIMD for register allocation
+    // settings from beginning of last assembling (restored by reset)
+    struct Settings
+    {
+        BinaryFormat format;
+        GPUDeviceType deviceType;
+        uint32_t driverVersion;
+        uint32_t llvmVersion;
+        bool _64bit;
+        bool newROCmBinFormat;
+        bool llvm10BinFormat;
+        bool rocmMetadataV3;
+        cxuint policyVersion;
+        cxuint occupancyTarget;
+    };
+    Settings initialSettings;
+    bool settingsSaved;
+    
+    // state of included file that can be stored in include cache
+    struct IncludeSnapshot
+    {
+        AsmInputFilter* filter;
+        std::string path;
+        uint64_t contentHash;
+        uint64_t settingsHash;
+        bool cacheable;
+        bool macroCountUsed;
+        uint64_t macroCount;    // macro counter before inclusion
+        // used global symbols with hash of their state at first use
+        std::unordered_map<const AsmSymbolEntry*, uint64_t> usedSymbols;
+        // names of global symbols used before their creation
+        std::unordered_set<CString> usedMissingSymbols;
+        std::vector<const AsmSymbolEntry*> newSymbols; // in creation order
+        // used macros (state at first use)
+        std::unordered_map<CString, RefPtr<const AsmMacro> > usedMacros;
+        std::vector<AsmFileDependency> dependencies;
+    };
+    AsmIncludeCache* includeCache;
+    std::vector<IncludeSnapshot> includeSnapshots;
+    bool trackFileDeps;
+    std::vector<AsmFileDependency> fileDependencies;
+    std::vector<AsmRegAllocResult> regAllocResults;
     ISAAssembler* isaAssembler;
     std::vector<DefSym> defSyms;
     std::vector<CString> includeDirs;
@@ -579,12 +1030,23 @@ private:
     std::unordered_set<AsmSymbolEntry*> symbolSnapshots;
     std::unordered_set<AsmSymbolEntry*> symbolClones;
     std::vector<AsmExpression*> unevalExpressions;
+    // range of code offsets used by evaluated expression (like label difference)
+    struct CodeOffsetsUse
+    {
+        AsmSectionId sectionId;
+        uint64_t minOffset;
+        uint64_t maxOffset;
+        AsmSourcePos sourcePos;
+    };
+    std::vector<CodeOffsetsUse> codeOffsetsUses;
     std::vector<AsmRelocation> relocations;
     std::unordered_map<const AsmRegVar*, AsmRegVarLinears> regVarLinearsMap;
     AsmScope globalScope;
     AsmMacroMap macroMap;
     std::stack<AsmScope*> scopeStack;
     std::vector<AsmScope*> abandonedScopes;
+    // dependency graph of symbols (reused by every resolving of symbols)
+    AsmSymbolDepGraph* symbolDepGraph;
     AsmScope* currentScope;
     KernelMap kernelMap;
     std::vector<AsmKernel> kernels;
@@ -616,6 +1078,10 @@ private:
     std::ostream& printStream;
     
     AsmFormatHandler* formatHandler;
+    // format handler and ISA assembler kept by reset (reused by next assembling)
+    AsmFormatHandler* savedFormatHandler;
+    BinaryFormat savedHandlerFormat;
+    ISAAssembler* savedIsaAssembler;
     
     std::stack<AsmClause> clauses;
     
@@ -636,6 +1102,11 @@ private:
     { return currentInputFilter->getSourcePos(pos); }
     AsmSourcePos getSourcePos(const char* linePtr) const
     { return getSourcePos(linePtr-line); }
+    // source position of instruction at code offset in section
+    AsmSourcePos findCodeSourcePos(const AsmSection& section, size_t offset) const;
+    // print register pressure in code blocks after failed register allocation
+    void printRegPressures(const AsmSection& section,
+                const std::vector<AsmRegPressure>& regPressures);
     
     void printWarning(const AsmSourcePos& pos, const char* message);
     void printError(const AsmSourcePos& pos, const char* message);
@@ -681,8 +1152,13 @@ private:
     bool assignOutputCounter(const char* symbolPlace, uint64_t value,
                     AsmSectionId sectionId, cxbyte fillValue = 0);
     
-    void parsePseudoOps(const CString& firstName, const char* stmtPlace,
+    // find index of pseudo-op by name (with dot)
+    size_t findPseudoOp(const CString& firstName) const;
+    void parsePseudoOps(const CString& firstName, size_t pseudoOp, const char* stmtPlace,
                 const char* linePtr);
+    // assemble statement (pseudo-op, macro or instruction) after labels
+    void assembleStatement(const CString& firstName, const char* stmtPlace,
+                const char* linePtr, AsmCachedStmt* cachedStmt, bool stmtCached);
     
     /// exitm - exit macro mode
     bool skipClauses(bool exitm = false);
@@ -691,6 +1167,17 @@ private:
     
     void initializeOutputFormat();
     
+    // update used registers of kernels by register allocation results
+    void applyRegAllocResults();
+    /* insert needed wait instructions to code sections (before preparing binary).
+     * symbols, relocations, code flow, kernel code regions, jumps and source
+     * positions are updated. already evaluated expressions (like label differences)
+     * whose values are changed by inserting are reported as errors */
+    bool insertWaitInstrs();
+    // insert wait instructions to code section, their offsets are updated
+    void insertSectionWaitInstrs(AsmSectionId sectionId,
+                std::vector<AsmWaitInstr>& waitInstrs);
+    
     bool pushClause(const char* string, AsmClauseType clauseType)
     {
         bool included; // to ignore
@@ -709,9 +1196,10 @@ private:
                     const char** lastStep = nullptr);
     // find symbol in scopes
     // internal recursive function to find symbol in scope
-    AsmSymbolEntry* findSymbolInScopeInt(AsmScope* scope, const CString& symName,
+    AsmSymbolEntry* findSymbolInScopeInt(AsmScope* scope, const AsmSymbolName& symName,
                     std::unordered_set<AsmScope*>& scopeSet);
     // scope - return scope from scoped name
+    // sameSymName - name of symbol without scope path (set only if symbol not found)
     AsmSymbolEntry* findSymbolInScope(const CString& symName, AsmScope*& scope,
                       CString& sameSymName, bool insertMode = false);
     // similar to map::insert, but returns pointer
@@ -736,6 +1224,48 @@ private:
     
     /// returns false when includeLevel is too deep, throw error if failed a file opening
     bool includeFile(const char* pseudoOpPlace, const std::string& filename);
+    // add path tried by include search (file has not been found at this path)
+    void addMissingIncludePath(const std::string& path);
+    
+    uint64_t hashIncludeSettings() const;
+    bool checkIncludeCacheEntry(const AsmIncludeCache::Entry& entry) const;
+    bool restoreIncludeFromCache(const std::string& filename, uint64_t contentHash,
+                uint64_t settingsHash);
+    void beginIncludeSnapshot(const std::string& filename, uint64_t contentHash,
+                uint64_t settingsHash, AsmInputFilter* filter);
+    void endIncludeSnapshot();
+    // mark all currently included files as not cacheable
+    void taintIncludeSnapshots()
+    {
+        for (IncludeSnapshot& snapshot: includeSnapshots)
+            snapshot.cacheable = false;
+    }
+    // record use of global symbol (entry is null if not found) by included files
+    void useIncludeSymbol(const AsmSymbolName& name, const AsmSymbolEntry* entry)
+    {
+        if (!includeSnapshots.empty())
+            useIncludeSymbolInt(name, entry);
+    }
+    void useIncludeSymbolInt(const AsmSymbolName& name, const AsmSymbolEntry* entry);
+    // record new global symbol created while including files
+    void addIncludeSymbol(const AsmSymbolEntry* entry)
+    {
+        for (IncludeSnapshot& snapshot: includeSnapshots)
+            snapshot.newSymbols.push_back(entry);
+    }
+    // record use of macro (before its definition or removal) by included files
+    void useIncludeMacro(const CString& name)
+    {
+        if (!includeSnapshots.empty())
+            useIncludeMacroInt(name);
+    }
+    void useIncludeMacroInt(const CString& name);
+    // record use of macro counter by included files
+    void useIncludeMacroCount()
+    {
+        for (IncludeSnapshot& snapshot: includeSnapshots)
+            snapshot.macroCountUsed = true;
+    }
     
     ParseState makeMacroSubstitution(const char* string);
     
@@ -788,6 +1318,7 @@ private:
     void tryToResolveSymbol(AsmSymbolEntry& symEntry);
     void tryToResolveSymbols(AsmScope* scope);
     void printUnresolvedSymbols(AsmScope* scope);
+    void printCircularDependencies(const std::vector<AsmSymbolEntry*>& symbols);
     
     bool resolveExprTarget(const AsmExpression* expr, uint64_t value,
                         AsmSectionId sectionId);
@@ -796,6 +1327,8 @@ private:
     
     void undefineSymbol(AsmSymbolEntry& symEntry);
     
+    void clearState();
+    
 protected:
     /// helper for testing
     bool readLine();
@@ -815,6 +1348,22 @@ public:
               GPUDeviceType deviceType = GPUDeviceType::CAPE_VERDE,
               std::ostream& msgStream = std::cerr, std::ostream& printStream = std::cout);
     
+    /// constructor with filename and source in memory
+    /**
+     * \param filename filename
+     * \param sourceSize size of source
+     * \param source source (must be available until end of assembling)
+     * \param flags assembler flags
+     * \param format output format type
+     * \param deviceType GPU device type
+     * \param msgStream stream for warnings and errors
+     * \param printStream stream for printing message by .print pseudo-ops
+     */
+    explicit Assembler(const CString& filename, size_t sourceSize, const char* source,
+              Flags flags = 0, BinaryFormat format = BinaryFormat::AMD,
+              GPUDeviceType deviceType = GPUDeviceType::CAPE_VERDE,
+              std::ostream& msgStream = std::cerr, std::ostream& printStream = std::cout);
+    
     /// constructor with filename and input stream
     /**
      * \param filenames filenames
@@ -834,6 +1383,27 @@ public:
     /// main routine to assemble code
     bool assemble();
     
+    /// reset assembler to assemble new source from memory
+    /** removes all results of previous assembling (symbols, sections, kernels, macros),
+     * but keeps flags, include directories and initial defsyms. Settings changed
+     * by pseudo-ops (binary format, GPU device type, bitness, versions) are restored
+     * to values from beginning of previous assembling.
+     * \param filename filename
+     * \param sourceSize size of source
+     * \param source source (must be available until end of assembling)
+     */
+    void reset(const CString& filename, size_t sourceSize, const char* source);
+    
+    /// allocate registers and schedule waits in code sections (after assembling)
+    /** every code section has own register allocator. sections are processed
+     * in parallel by threadsNum threads (0 - all processors). errors are printed
+     * in sections order. register usage must be collected (ASM_REGALLOC flag).
+     * returns true if no errors */
+    bool allocateRegisters(cxuint threadsNum = 0);
+    /// get results of register allocation (in sections order)
+    const std::vector<AsmRegAllocResult>& getRegAllocResults() const
+    { return regAllocResults; }
+    
     /// write binary to file
     void writeBinary(const char* filename) const;
     /// write binary to stream
@@ -897,6 +1467,14 @@ public:
     /// set policy version
     void setPolicyVersion(cxuint pv)
     { policyVersion = pv; }
+    /// get target number of waves per SIMD for register allocation (0 - no target)
+    cxuint getOccupancyTarget() const
+    { return occupancyTarget; }
+    /// set target number of waves per SIMD for register allocation (0 - no target)
+    /** if target is set and register usage is collected, registers are allocated
+     * while assembling and numbers of used registers of kernels are updated */
+    void setOccupancyTarget(cxuint wavesNum)
+    { occupancyTarget = wavesNum; }
     /// get flags
     Flags getFlags() const
     { return flags; }
@@ -924,6 +1502,19 @@ public:
     /// get include directory list
     const std::vector<CString>& getIncludeDirs() const
     { return includeDirs; }
+    /// get include cache
+    AsmIncludeCache* getIncludeCache() const
+    { return includeCache; }
+    /// set include cache (null disables caching)
+    /** cache must be available until end of assembling */
+    void setIncludeCache(AsmIncludeCache* cache)
+    { includeCache = cache; }
+    /// enable tracking of files read while assemblying (included and binary files)
+    void setFileDepsTracking(bool enable)
+    { trackFileDeps = enable; }
+    /// get files read while assemblying (collected only if tracking is enabled)
+    const std::vector<AsmFileDependency>& getFileDependencies() const
+    { return fileDependencies; }
     /// adds include directory
     void addIncludeDir(const CString& includeDir);
     /// get symbols map
@@ -959,6 +1550,9 @@ public:
     
     /// add initiali defsyms
     void addInitialDefSym(const CString& symName, uint64_t value);
+    /// remove all initial defsyms
+    void clearInitialDefSyms()
+    { defSyms.clear(); }
     
     /// get format handler
     const AsmFormatHandler* getFormatHandler() const
@@ -72,10 +72,11 @@ enum: Flags
     DISASM_HSACONFIG = 0x400,  ///< print HSA configuration
     DISASM_HSALAYOUT = 0x800,  ///< print in HSA layout (like Gallium or ROCm)
     DISASM_WAVE32 = 0x1000, ///< use WAVESIZE32
+    DISASM_PARALLEL = 0x2000, ///< disassemble kernels in parallel
     
     ///< all disassembler flags (without config)
     DISASM_ALL = FLAGS_ALL&(~(DISASM_CONFIG|DISASM_BUGGYFPLIT|DISASM_WAVE32|
-                    DISASM_HSACONFIG|DISASM_HSALAYOUT))
+                    DISASM_HSACONFIG|DISASM_HSALAYOUT|DISASM_PARALLEL))
 };
 
 struct GCNDisasmUtils;
@@ -377,6 +378,7 @@ class Disassembler: public NonCopyableAndNonMovable
 {
 private:
     friend class ISADisassembler;
+    friend struct DisasmParallelUtils; // INTERNAL LOGIC
     std::unique_ptr<ISADisassembler> isaDisassembler;
     bool fromBinary;
     BinaryFormat binaryFormat;
@@ -390,6 +392,7 @@ private:
     std::ostream& output;
     Flags flags;
     size_t sectionCount;
+    cxuint threadsNum;
 public:
     /// constructor for 32-bit GPU binary
     /**
@@ -501,6 +504,14 @@ public:
     void setFlags(Flags flags)
     { this->flags = flags; }
     
+    /// get threads number used while disassembling kernels in parallel
+    cxuint getThreadsNum() const
+    { return threadsNum; }
+    /// set threads number used while disassembling kernels in parallel
+    /** if threadsNum is zero, then all available processors will be used */
+    void setThreadsNum(cxuint threadsNum)
+    { this->threadsNum = threadsNum; }
+    
     /// get deviceType
     GPUDeviceType getDeviceType() const;
     
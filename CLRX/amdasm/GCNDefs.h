@@ -110,7 +110,8 @@ enum : cxbyte
     GCNWAIT_VMCNT = 0,
     GCNWAIT_LGKMCNT,
     GCNWAIT_EXPCNT,
-    GCNWAIT_MAX = GCNWAIT_EXPCNT
+    GCNWAIT_VSCNT,  ///< only for GCN 1.5
+    GCNWAIT_MAX = GCNWAIT_VSCNT
 };
 
 enum : cxbyte
@@ -122,7 +123,8 @@ enum : cxbyte
     GCNDELOP_SMEMOP,
     GCNDELOP_EXPVMWRITE,
     GCNDELOP_EXPORT,
-    GCNDELOP_MAX = GCNDELOP_EXPORT,
+    GCNDELOP_VMSTOREOP, ///< vector memory store (only for GCN 1.5)
+    GCNDELOP_MAX = GCNDELOP_VMSTOREOP,
     GCNDELOP_NONE = ASMDELOP_NONE
 };
 
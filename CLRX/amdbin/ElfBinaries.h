@@ -30,6 +30,7 @@
 #include <string>
 #include <utility>
 #include <ostream>
+#include <memory>
 #include <CLRX/amdbin/Elf.h>
 #include <CLRX/utils/MemAccess.h>
 #include <CLRX/utils/Utilities.h>
@@ -51,6 +52,11 @@ enum: cxuint {
     BINGEN_NOTSUPPLIED  = UINT_MAX-1 ///< if set in field then field has been ignored
 };
 
+enum: cxuint {
+    /// size of buffer for writing binary to output stream
+    BINGEN_OUTBUFFER_SIZE = 65536
+};
+
 enum: uint64_t {
     BINGEN64_DEFAULT = UINT64_MAX,    ///< if set in field then field has been filled later
     BINGEN64_NOTSUPPLIED  = UINT64_MAX-1 ///< if set in field then field has been ignored
@@ -70,7 +76,9 @@ enum : Flags {
     ELF_CREATE_SECTIONMAP = 1,  ///< create map of sections
     ELF_CREATE_SYMBOLMAP = 2,   ///< create map of symbols
     ELF_CREATE_DYNSYMMAP = 4,   ///< create map of dynamic symbols
-    ELF_CREATE_ALL = 0xf  ///< creation flags for ELF binaries
+    ELF_CREATE_ALL = 0xf,  ///< creation flags for ELF binaries
+    /// find names by hash index (not included in any ALL flags)
+    ELF_CREATE_HASHINDEX = 0x80000000U
 };
 
 /// Bin exception class
@@ -139,6 +147,9 @@ struct Elf64Types
     static const cxuint relSymShift = 32;
 };
 
+/// hash index of section and symbol names (internal)
+struct ElfHashIndex;
+
 /// ELF binary class
 /** This object doesn't copy binary code content.
  * Only it takes and uses a binary code.
@@ -165,6 +176,8 @@ protected:
     SectionIndexMap sectionIndexMap;    ///< section's index map
     SymbolIndexMap symbolIndexMap;      ///< symbol's index map
     SymbolIndexMap dynSymIndexMap;      ///< dynamic symbol's index map
+    /// hash index of names (built once at first lookup, thread-safe)
+    std::unique_ptr<ElfHashIndex> hashIndex;
     
     typename Types::Size symbolsNum;    ///< symbols number
     typename Types::Size dynSymbolsNum; ///< dynamic symbols number
@@ -174,6 +187,8 @@ protected:
     uint16_t dynSymEntSize; ///< dynamic symbol entry size in a dynamic symbol's table
     typename Types::Size dynamicEntSize; ///< get dynamic entry size
     
+    /// build hash index of names (called once by first lookup)
+    void buildHashIndex() const;
 public:
     ElfBinaryTemplate();
     /** constructor.
@@ -184,6 +199,10 @@ public:
     ElfBinaryTemplate(size_t binaryCodeSize, cxbyte* binaryCode,
                 Flags creationFlags = ELF_CREATE_ALL);
     virtual ~ElfBinaryTemplate();
+    /// copy constructor (copy builds own hash index at first lookup)
+    ElfBinaryTemplate(const ElfBinaryTemplate& b);
+    /// copy assignment (copy builds own hash index at first lookup)
+    ElfBinaryTemplate& operator=(const ElfBinaryTemplate& b);
     
     /// get creation flags
     Flags getCreationFlags() const
@@ -201,6 +220,10 @@ public:
     bool hasDynSymbolMap() const
     { return (creationFlags & ELF_CREATE_DYNSYMMAP) != 0; }
     
+    /// returns true if object looks up names by hash index
+    bool hasHashIndex() const
+    { return (creationFlags & ELF_CREATE_HASHINDEX) != 0; }
+    
     /// get size of binaries
     size_t getSize() const
     { return binaryCodeSize; }
@@ -342,10 +365,11 @@ public:
     /// get section index with specified name
     uint16_t getSectionIndex(const char* name) const;
     
-    /// get symbol index with specified name (requires symbol index map)
+    /// get symbol index with specified name (requires symbol index map or hash index)
     typename Types::Size getSymbolIndex(const char* name) const;
     
-    /// get dynamic symbol index with specified name (requires dynamic symbol index map)
+    /// get dynamic symbol index with specified name
+    /** requires dynamic symbol index map or hash index */
     typename Types::Size getDynSymbolIndex(const char* name) const;
     
     /// get end iterator of symbol index map
@@ -904,7 +928,7 @@ public:
     /// generate binary
     void generate(std::ostream& os)
     {
-        FastOutputBuffer fob(256, os);
+        FastOutputBuffer fob(BINGEN_OUTBUFFER_SIZE, os);
         generate(fob);
     }
     
@@ -371,7 +371,8 @@ inline bool operator<=(const CLRX::CString& s1, const CLRX::CString& s2)
 inline bool operator>=(const CLRX::CString& s1, const CLRX::CString& s2)
 { return ::strcmp(s1.c_str(), s2.c_str())>=0; }
 
-}
+/* comparison operators for std::string and C-style strings must be in CLRX namespace,
+ * otherwise code inside this namespace converts second operand to CString */
 
 /// equal operator
 inline bool operator==(const CLRX::CString& s1, const std::string& s2)
@@ -473,6 +474,8 @@ inline bool operator>=(const char* s1, const CLRX::CString& s2)
 inline std::ostream& operator<<(std::ostream& os, const CLRX::CString& cstr)
 { return os<<cstr.c_str(); }
 
+}
+
 namespace std
 {
 
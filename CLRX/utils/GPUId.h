@@ -226,6 +226,18 @@ struct AMDGPUArchVersion
     uint32_t stepping;  ///< arch stepping number
 };
 
+/// get maximum number of waves per SIMD for GPU architecture
+extern cxuint getGPUMaxWavesPerSIMD(GPUArchitecture architecture);
+
+/// get maximum number of registers (with extra registers) that allows to run
+/// wavesNum waves per SIMD (type: 0 - scalar, 1 - vector)
+extern cxuint getGPUMaxRegistersNumForWaves(GPUArchitecture architecture,
+              cxuint regType, cxuint wavesNum, Flags flags = 0);
+
+/// get number of waves per SIMD (occupancy) for numbers of used registers
+extern cxuint getGPUWavesPerSIMD(GPUArchitecture architecture, cxuint sgprsNum,
+              cxuint vgprsNum);
+
 /// calculate PGMRSRC1 register value
 extern uint32_t calculatePgmRSrc1(GPUArchitecture arch, cxuint vgprsNum, cxuint sgprsNum,
             cxuint priority, cxuint floatMode, bool privMode, bool dx10clamp,
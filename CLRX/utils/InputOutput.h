@@ -347,38 +347,61 @@ public:
 };
 
 /// fast and direct output buffer
+/** buffer writes content to output stream or directly to preallocated memory
+ * (without copying through buffer) */
 class FastOutputBuffer: public NonCopyableAndNonMovable
 {
 private:
-    std::ostream& os;
-    cxuint endPos;
-    cxuint bufSize;
-    std::unique_ptr<char[]> buffer;
+    std::ostream* os;   // output stream (null if output to memory)
+    size_t endPos;
+    size_t bufSize;
+    std::unique_ptr<char[]> bufferHolder;
+    char* buffer;
     uint64_t written;
+    
+    // flush buffer or throw exception if output memory is too small
+    void makeSpace()
+    {
+        if (os == nullptr)
+            throw Exception("Output memory is too small");
+        flush();
+    }
 public:
     /// constructor with inBufSize and output
     /**
      * \param _bufSize max buffer size
      * \param output output stream
      */
-    FastOutputBuffer(cxuint _bufSize, std::ostream& output) : os(output), endPos(0),
-            bufSize(_bufSize), buffer(new char[_bufSize]), written(0)
+    FastOutputBuffer(cxuint _bufSize, std::ostream& output) : os(&output), endPos(0),
+            bufSize(_bufSize), bufferHolder(new char[_bufSize]),
+            buffer(bufferHolder.get()), written(0)
+    { }
+    /// constructor with output memory
+    /**
+     * \param outputSize size of output memory
+     * \param output output memory
+     */
+    FastOutputBuffer(size_t outputSize, char* output) : os(nullptr), endPos(0),
+            bufSize(outputSize), buffer(output), written(0)
     { }
     /// destructor
     ~FastOutputBuffer()
     { 
         flush();
-        os.flush();
+        if (os != nullptr)
+            os->flush();
     }
     
     /// get written bytes number
     uint64_t getWritten() const
     { return written; }
     
-    /// write output buffer
+    /// write output buffer (nothing if output to memory)
     void flush()
     {
-        os.write(buffer.get(), endPos);
+        if (os == nullptr)
+            return;
+        os->write(buffer, endPos);
         endPos = 0;
     }
     
@@ -386,8 +409,8 @@ public:
     char* reserve(cxuint toReserve)
     {
         if (toReserve > bufSize-endPos)
-            flush();
-        return buffer.get() + endPos;
+            makeSpace();
+        return buffer + endPos;
     }
     
     /// finish reservation and go forward
@@ -402,12 +425,13 @@ public:
     {
         if (length > bufSize-endPos)
         {
-            flush();
-            os.write(string, length);
+            // write directly to output stream
+            makeSpace();
+            os->write(string, length);
         }
         else
         {
-            ::memcpy(buffer.get()+endPos, string, length);
+            ::memcpy(buffer+endPos, string, length);
             endPos += length;
         }
         written += length;
@@ -431,7 +455,7 @@ public:
     void put(char c)
     {
         if (endPos == bufSize)
-            flush();
+            makeSpace();
         buffer[endPos++] = c;
         written++;
     }
@@ -439,11 +463,13 @@ public:
     /// fill (put num c character)
     void fill(size_t num, char c)
     {
+        if (os == nullptr && num > bufSize-endPos)
+            makeSpace();
         size_t count = num;
         while (count != 0)
         {
-             size_t bufNum = std::min(size_t(bufSize-endPos), count);
-             ::memset(buffer.get()+endPos, c, bufNum);
+             size_t bufNum = std::min(bufSize-endPos, count);
+             ::memset(buffer+endPos, c, bufNum);
              count -= bufNum;
              endPos += bufNum;
              if (endPos == bufSize)
@@ -452,12 +478,16 @@ public:
         written += num;
     }
     
-    /// get output stream
+    /// return true if output to memory
+    bool isOutputToMemory() const
+    { return os == nullptr; }
+    
+    /// get output stream (only if output to stream)
     const std::ostream& getOStream() const
-    { return os; }
-    /// get output stream
+    { return *os; }
+    /// get output stream (only if output to stream)
     std::ostream& getOStream()
-    { return os; }
+    { return *os; }
 };
 
 };
@@ -32,6 +32,7 @@
 #include <cstdint>
 #include <mutex>
 #include <atomic>
+#include <thread>
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
@@ -778,6 +779,50 @@ extern bool isFileExists(const char* path);
  */
 extern Array<cxbyte> loadDataFromFile(const char* filename);
 
+/// memory-mapped file (private copy-on-write mapping, changes are not written to file)
+class MappedFile: public NonCopyableAndNonMovable
+{
+private:
+    cxbyte* content;
+    size_t size;
+    bool mapped;
+    Array<cxbyte> loadedData;   ///< content of file that can not be mapped
+#ifdef HAVE_WINDOWS
+    void* mapHandle;
+#endif
+public:
+    /// empty constructor
+    MappedFile();
+    /// constructor - maps file, throws Exception if file can't be mapped
+    explicit MappedFile(const char* filename);
+    /// destructor
+    ~MappedFile();
+    
+    /// map file
+    /**
+     * \param filename filename
+     * \return true if mapped, false if file is not regular file (pipe or device)
+     */
+    bool map(const char* filename);
+    /// map file or load its content if file is not regular file (pipe or device)
+    void mapOrLoad(const char* filename);
+    /// unmap file
+    void unmap();
+    
+    /// returns true if mapped
+    bool isMapped() const
+    { return mapped; }
+    /// get content of file
+    const cxbyte* getContent() const
+    { return content; }
+    /// get content of file
+    cxbyte* getContent()
+    { return content; }
+    /// get size of file
+    size_t getSize() const
+    { return size; }
+};
+
 /// convert to filesystem from unified path (with slashes)
 extern void filesystemPath(char* path);
 /// convert to filesystem from unified path (with slashes)
@@ -791,6 +836,10 @@ extern uint64_t getFileTimestamp(const char* filename);
 
 /// get user's home directory
 extern std::string getHomeDir();
+/// get current working directory (throws Exception if failed)
+extern std::string getCurrentDir();
+/// get absolute path (relative path is joined with current working directory)
+extern std::string getAbsolutePath(const std::string& path);
 /// create directory
 extern void makeDir(const char* dirname);
 /// run executable with output, returns array of output
@@ -1057,8 +1106,16 @@ struct OnceFlag: std::atomic<int>
 template<class Callable, class... Args>
 inline void callOnce(OnceFlag& flag, Callable&& f, Args&&... args)
 {
-    if (flag.exchange(1) == 0)
+    int expected = 0;
+    if (flag.compare_exchange_strong(expected, 1))
+    {
         f(args...);
+        flag.store(2); // done
+    }
+    else
+        // other thread can still call function, wait for it
+        while (flag.load() != 2)
+            std::this_thread::yield();
 }
 #endif
 
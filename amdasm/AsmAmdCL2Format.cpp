@@ -133,13 +133,7 @@ AsmAmdCL2Handler::AsmAmdCL2Handler(Assembler& assembler) : AsmKcodeHandler(assem
         samplerInitSection(ASMSECT_NONE), extraSectionCount(0),
         innerExtraSectionCount(0), hsaLayout(false)
 {
-    output.archMinor = output.archStepping = UINT32_MAX;
-    assembler.currentKernel = ASMKERN_GLOBAL;
-    assembler.currentSection = 0;
-    // add .rodata section (will be default)
-    sections.push_back({ ASMKERN_INNER, AsmSectionType::DATA, ELFSECTID_RODATA,
-            ".rodata" });
-    savedSection = innerSavedSection = 0;
+    reset();
     // detect driver version once for using many times
     detectedDriverVersion = detectAmdDriverVersion();
 }
@@ -150,6 +144,30 @@ AsmAmdCL2Handler::~AsmAmdCL2Handler()
         delete kernel;
 }
 
+void AsmAmdCL2Handler::reset()
+{
+    resetKcodeState();
+    for (Kernel* kernel: kernelStates)
+        delete kernel;
+    kernelStates.clear();
+    sections.clear();
+    relocsMap.clear();
+    extraSectionMap.clear();
+    innerExtraSectionMap.clear();
+    output = AmdCL2Input{};
+    rodataSection = 0;
+    dataSection = bssSection = samplerInitSection = ASMSECT_NONE;
+    extraSectionCount = innerExtraSectionCount = 0;
+    hsaLayout = false;
+    output.archMinor = output.archStepping = UINT32_MAX;
+    assembler.currentKernel = ASMKERN_GLOBAL;
+    assembler.currentSection = 0;
+    // add .rodata section (will be default)
+    sections.push_back({ ASMKERN_INNER, AsmSectionType::DATA, ELFSECTID_RODATA,
+            ".rodata" });
+    savedSection = innerSavedSection = 0;
+}
+
 void AsmAmdCL2Handler::saveCurrentSection()
 {
     /// save previous section
@@ -1822,6 +1840,22 @@ bool AsmAmdCL2Handler::parsePseudoOp(const CString& firstName,
     return true;
 }
 
+void AsmAmdCL2Handler::updateKernelRegisters(AsmKernelId kernelId,
+            const cxuint* regsNum)
+{
+    if (hsaLayout)
+    {
+        AsmKcodeHandler::updateKernelRegisters(kernelId, regsNum);
+        return;
+    }
+    // registers of current kernel are held by ISA assembler
+    saveCurrentAllocRegs();
+    cxuint* allocRegs = kernelStates[kernelId]->allocRegs;
+    for (cxuint i = 0; i < MAX_REGTYPES_NUM; i++)
+        allocRegs[i] = regsNum[i];
+    restoreCurrentAllocRegs();
+}
+
 bool AsmAmdCL2Handler::prepareBinary()
 {
     bool good = true;
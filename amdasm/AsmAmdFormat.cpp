@@ -77,11 +77,7 @@ enum
 AsmAmdHandler::AsmAmdHandler(Assembler& assembler) : AsmFormatHandler(assembler),
                 output{}, dataSection(0), extraSectionCount(0)
 {
-    assembler.currentKernel = ASMKERN_GLOBAL;
-    assembler.currentSection = 0;
-    // first, add global data section (will be default)
-    sections.push_back({ ASMKERN_GLOBAL, AsmSectionType::DATA, ELFSECTID_UNDEF, nullptr });
-    savedSection = 0;
+    reset();
     // detect amd driver version once, for using many times
     detectedDriverVersion = detectAmdDriverVersion();
 }
@@ -92,6 +88,23 @@ AsmAmdHandler::~AsmAmdHandler()
         delete kernel;
 }
 
+void AsmAmdHandler::reset()
+{
+    for (Kernel* kernel: kernelStates)
+        delete kernel;
+    kernelStates.clear();
+    sections.clear();
+    extraSectionMap.clear();
+    output = AmdInput{};
+    dataSection = 0;
+    extraSectionCount = 0;
+    assembler.currentKernel = ASMKERN_GLOBAL;
+    assembler.currentSection = 0;
+    // first, add global data section (will be default)
+    sections.push_back({ ASMKERN_GLOBAL, AsmSectionType::DATA, ELFSECTID_UNDEF, nullptr });
+    savedSection = 0;
+}
+
 // routine to deterime driver version while assemblying
 cxuint AsmAmdHandler::determineDriverVersion() const
 {
@@ -1696,6 +1709,16 @@ bool AsmAmdHandler::parsePseudoOp(const CString& firstName,
     return true;
 }
 
+void AsmAmdHandler::updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum)
+{
+    // registers of current kernel are held by ISA assembler
+    saveCurrentAllocRegs();
+    cxuint* allocRegs = kernelStates[kernelId]->allocRegs;
+    for (cxuint i = 0; i < MAX_REGTYPES_NUM; i++)
+        allocRegs[i] = regsNum[i];
+    restoreCurrentAllocRegs();
+}
+
 bool AsmAmdHandler::prepareBinary()
 {
     if (assembler.isaAssembler!=nullptr)
@@ -0,0 +1,384 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#ifdef HAVE_WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/utils/MemAccess.h>
+#include <CLRX/amdbin/AmdBinGen.h>
+#include <CLRX/amdbin/GalliumBinaries.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "AsmInternals.h"
+
+using namespace CLRX;
+
+/* binary cache entry file (all values in little-endian):
+ * magic (8 bytes), key (16 bytes), dependencies number (uint32),
+ * dependencies: path size (uint32), absolute path, content hash (uint64),
+ * missing flag (uint32, 1 if file has not existed while assemblying),
+ * messages size (uint64), messages, binary size (uint64), binary,
+ * checksum of all previous bytes (uint64) */
+
+static const char binCacheMagic[8] = { 'C', 'L', 'R', 'X', 'A', 'B', 'C', '2' };
+
+// two lanes of FNV-1a hash (with different initial values and primes)
+struct CLRX_INTERNAL BinCacheHasher
+{
+    uint64_t hash[2];
+    
+    BinCacheHasher()
+    {
+        hash[0] = 0xcbf29ce484222325ULL;
+        hash[1] = 0x84222325cbf29ce4ULL;
+    }
+    
+    void addBytes(const void* data, size_t size)
+    {
+        const cxbyte* bytes = reinterpret_cast<const cxbyte*>(data);
+        uint64_t h0 = hash[0], h1 = hash[1];
+        for (size_t i = 0; i < size; i++)
+        {
+            h0 = (h0 ^ bytes[i]) * 0x100000001b3ULL;
+            h1 = (h1 ^ bytes[i]) * 0x9e3779b97f4a7c15ULL;
+        }
+        hash[0] = h0;
+        hash[1] = h1;
+    }
+    
+    void addValue(uint64_t value)
+    {
+        uint64_t v;
+        SLEV(v, value);
+        addBytes(&v, 8);
+    }
+    
+    // add string with size (separates next strings)
+    void addString(const char* str, size_t size)
+    {
+        addValue(size);
+        addBytes(str, size);
+    }
+    
+    // mix all bits of lanes (FNV-1a weakly mixes low bits)
+    static uint64_t finalize(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+    
+    AsmBinaryCache::Key getKey() const
+    { return { { finalize(hash[0]), finalize(hash[1]) } }; }
+};
+
+static inline void putValue32(std::string& out, uint32_t value)
+{
+    uint32_t v;
+    SLEV(v, value);
+    out.append(reinterpret_cast<const char*>(&v), 4);
+}
+
+static inline void putValue64(std::string& out, uint64_t value)
+{
+    uint64_t v;
+    SLEV(v, value);
+    out.append(reinterpret_cast<const char*>(&v), 8);
+}
+
+// reader of entry content, returns false if data is too short
+struct CLRX_INTERNAL BinCacheReader
+{
+    const cxbyte* data;
+    size_t size;
+    size_t pos;
+    
+    bool getValue32(uint32_t& value)
+    {
+        if (size-pos < 4)
+            return false;
+        uint32_t v;
+        ::memcpy(&v, data+pos, 4);
+        value = ULEV(v);
+        pos += 4;
+        return true;
+    }
+    
+    bool getValue64(uint64_t& value)
+    {
+        if (size-pos < 8)
+            return false;
+        uint64_t v;
+        ::memcpy(&v, data+pos, 8);
+        value = ULEV(v);
+        pos += 8;
+        return true;
+    }
+    
+    bool getBytes(uint64_t bytesNum, const cxbyte*& bytes)
+    {
+        if (size-pos < bytesNum)
+            return false;
+        bytes = data+pos;
+        pos += bytesNum;
+        return true;
+    }
+};
+
+static uint64_t entryChecksum(const cxbyte* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+AsmBinaryCache::AsmBinaryCache(const char* dirPath) : directory(dirPath)
+{
+    if (directory.empty())
+        throw Exception("Directory of binary cache is empty");
+    if (!isFileExists(dirPath))
+    {
+        try
+        { makeDir(dirPath); }
+        catch(const Exception& ex)
+        {
+            // other process can create directory at this same time
+            if (!isFileExists(dirPath))
+                throw;
+        }
+    }
+    if (!isDirectory(dirPath))
+        throw Exception("Path of binary cache is not directory");
+}
+
+AsmBinaryCache::~AsmBinaryCache()
+{ }
+
+std::string AsmBinaryCache::getEntryPath(const Key& key) const
+{
+    char name[40];
+    for (cxuint i = 0; i < 32; i++)
+    {
+        const cxuint digit = (key.hash[i>>4] >> ((15-(i&15))<<2)) & 15;
+        name[i] = (digit < 10) ? '0'+digit : 'a'+digit-10;
+    }
+    ::memcpy(name+32, ".bin", 5);
+    return joinPaths(directory, name);
+}
+
+AsmBinaryCache::Key AsmBinaryCache::computeKey(size_t sourceSize, const char* source,
+            BinaryFormat format, GPUDeviceType deviceType, bool is64Bit, Flags flags,
+            cxuint policyVersion, uint32_t driverVersion, uint32_t llvmVersion,
+            const std::vector<CString>& includeDirs,
+            const std::vector<std::pair<CString, uint64_t> >& defSyms)
+{
+    // versions detected by format handlers while assemblying
+    if (driverVersion == 0)
+    {
+        if (format == BinaryFormat::AMD || format == BinaryFormat::AMDCL2)
+            driverVersion = detectAmdDriverVersion();
+        else if (format == BinaryFormat::GALLIUM)
+            driverVersion = detectMesaDriverVersion();
+    }
+    if (llvmVersion == 0 && format == BinaryFormat::GALLIUM)
+        llvmVersion = detectLLVMCompilerVersion();
+    
+    BinCacheHasher hasher;
+    hasher.addString(CLRX_VERSION, ::strlen(CLRX_VERSION));
+    hasher.addValue(cxuint(format) | (uint64_t(deviceType)<<8) | (uint64_t(is64Bit)<<16));
+    hasher.addValue(flags);
+    hasher.addValue(policyVersion);
+    hasher.addValue(driverVersion | (uint64_t(llvmVersion)<<32));
+    // relative paths of included files are resolved from working directory
+    std::string currentDir;
+    try
+    { currentDir = getCurrentDir(); }
+    catch(const Exception& ex)
+    { }
+    hasher.addString(currentDir.c_str(), currentDir.size());
+    hasher.addValue(includeDirs.size());
+    for (const CString& incDir: includeDirs)
+        hasher.addString(incDir.c_str(), incDir.size());
+    hasher.addValue(defSyms.size());
+    for (const auto& defSym: defSyms)
+    {
+        hasher.addString(defSym.first.c_str(), defSym.first.size());
+        hasher.addValue(defSym.second);
+    }
+    hasher.addString(source, sourceSize);
+    return hasher.getKey();
+}
+
+bool AsmBinaryCache::load(const Key& key, Array<cxbyte>& binary,
+            std::string& messages) const
+{
+    const std::string entryPath = getEntryPath(key);
+    if (!isFileExists(entryPath.c_str()))
+        return false;
+    Array<cxbyte> content;
+    try
+    { content = loadDataFromFile(entryPath.c_str()); }
+    catch(const Exception& ex)
+    { return false; }   // removed by other process
+    
+    // check magic, key and checksum (entry can be corrupted)
+    if (content.size() < 8+16+8 || ::memcmp(content.data(), binCacheMagic, 8) != 0)
+        return false;
+    const size_t checksumPos = content.size()-8;
+    uint64_t checksum;
+    ::memcpy(&checksum, content.data()+checksumPos, 8);
+    if (ULEV(checksum) != entryChecksum(content.data(), checksumPos))
+        return false;
+    
+    BinCacheReader reader{ content.data(), checksumPos, 8 };
+    Key entryKey;
+    reader.getValue64(entryKey.hash[0]);
+    reader.getValue64(entryKey.hash[1]);
+    if (entryKey != key)
+        return false;
+    
+    // check whether file dependencies have been changed
+    uint32_t depsNum;
+    if (!reader.getValue32(depsNum))
+        return false;
+    for (uint32_t i = 0; i < depsNum; i++)
+    {
+        uint32_t pathSize, missing;
+        const cxbyte* path;
+        uint64_t contentHash;
+        if (!reader.getValue32(pathSize) || !reader.getBytes(pathSize, path) ||
+            !reader.getValue64(contentHash) || !reader.getValue32(missing))
+            return false;
+        try
+        {
+            bool regular;
+            const std::string depPath(reinterpret_cast<const char*>(path), pathSize);
+            if (missing != 0)
+            {
+                // new file shadows file found by include search
+                if (isFileExists(depPath.c_str()))
+                    return false;
+            }
+            else if (hashIncludeFile(depPath, &regular) != contentHash || !regular)
+                return false;
+        }
+        catch(const Exception& ex)
+        { return false; }
+    }
+    
+    uint64_t messagesSize, binarySize;
+    const cxbyte* messagesData;
+    const cxbyte* binaryData;
+    if (!reader.getValue64(messagesSize) || !reader.getBytes(messagesSize, messagesData) ||
+        !reader.getValue64(binarySize) || !reader.getBytes(binarySize, binaryData) ||
+        reader.pos != checksumPos)
+        return false;
+    messages.assign(reinterpret_cast<const char*>(messagesData), messagesSize);
+    binary.assign(binaryData, binaryData + binarySize);
+    return true;
+}
+
+static std::atomic<uint64_t> binCacheTempCounter(0);
+
+bool AsmBinaryCache::store(const Key& key, const std::vector<AsmFileDependency>& fileDeps,
+            const Array<cxbyte>& binary, const std::string& messages) const
+{
+    for (const AsmFileDependency& dep: fileDeps)
+        if (!dep.regular)
+            return false;
+    
+    std::string content(binCacheMagic, 8);
+    putValue64(content, key.hash[0]);
+    putValue64(content, key.hash[1]);
+    putValue32(content, fileDeps.size());
+    for (const AsmFileDependency& dep: fileDeps)
+    {
+        // dependencies are checked by other processes (with other working directory)
+        const std::string depPath = getAbsolutePath(dep.path);
+        putValue32(content, depPath.size());
+        content.append(depPath);
+        putValue64(content, dep.contentHash);
+        putValue32(content, dep.missing ? 1 : 0);
+    }
+    putValue64(content, messages.size());
+    content.append(messages);
+    putValue64(content, binary.size());
+    content.append(reinterpret_cast<const char*>(binary.data()), binary.size());
+    putValue64(content, entryChecksum(
+            reinterpret_cast<const cxbyte*>(content.data()), content.size()));
+    
+    // write to temporary file (unique in all processes) and rename it atomically
+    const std::string entryPath = getEntryPath(key);
+    std::string tempPath = entryPath + ".tmp";
+    {
+        char numBuf[32];
+#ifdef HAVE_WINDOWS
+        itocstrCStyle(uint64_t(GetCurrentProcessId()), numBuf, 32);
+#else
+        itocstrCStyle(uint64_t(::getpid()), numBuf, 32);
+#endif
+        tempPath += numBuf;
+        tempPath += '_';
+        itocstrCStyle(binCacheTempCounter.fetch_add(1), numBuf, 32);
+        tempPath += numBuf;
+    }
+    
+    bool written = false;
+    {
+        std::ofstream ofs(tempPath.c_str(), std::ios::binary);
+        if (ofs)
+        {
+            ofs.write(content.data(), content.size());
+            ofs.close();
+            written = bool(ofs);
+        }
+    }
+    if (!written)
+    {
+        std::remove(tempPath.c_str());
+        throw Exception("Can't write binary cache entry");
+    }
+#ifdef HAVE_WINDOWS
+    const bool renamed = MoveFileExA(tempPath.c_str(), entryPath.c_str(),
+                MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool renamed = std::rename(tempPath.c_str(), entryPath.c_str()) == 0;
+#endif
+    if (!renamed)
+    {
+        std::remove(tempPath.c_str());
+        throw Exception("Can't rename binary cache entry");
+    }
+    return true;
+}
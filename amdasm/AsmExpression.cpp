@@ -42,10 +42,167 @@ static const uint64_t operatorWithMessage =
         (1ULL<<int(AsmExprOp::SHIFT_LEFT)) | (1ULL<<int(AsmExprOp::SHIFT_RIGHT)) |
         (1ULL<<int(AsmExprOp::SIGNED_SHIFT_RIGHT));
 
-AsmExpression::AsmExpression() : symOccursNum(0), relativeSymOccurs(false),
-            baseExpr(false)
+// messages that can be given by operators
+enum : cxbyte
+{
+    ASMXMSG_NONE = 0,
+    ASMXMSG_DIVISION_BY_ZERO,
+    ASMXMSG_SHIFT_OUT_OF_RANGE
+};
+
+// apply unary or binary operator to absolute values (value2 is first binary argument)
+static uint64_t applyAbsoluteOp(AsmExprOp op, uint64_t value2, uint64_t value,
+                cxbyte& message)
+{
+    message = ASMXMSG_NONE;
+    switch (op)
+    {
+        case AsmExprOp::NEGATE:
+            return -value;
+        case AsmExprOp::BIT_NOT:
+            return ~value;
+        case AsmExprOp::LOGICAL_NOT:
+            return !value;
+        case AsmExprOp::ADDITION:
+            return value2 + value;
+        case AsmExprOp::SUBTRACT:
+            return value2 - value;
+        case AsmExprOp::MULTIPLY:
+            return value2 * value;
+        case AsmExprOp::DIVISION:
+        case AsmExprOp::SIGNED_DIVISION:
+        case AsmExprOp::MODULO:
+        case AsmExprOp::SIGNED_MODULO:
+            if (value == 0)
+            {
+                message = ASMXMSG_DIVISION_BY_ZERO;
+                return 0;
+            }
+            if (op == AsmExprOp::DIVISION)
+                return value2 / value;
+            if (op == AsmExprOp::SIGNED_DIVISION)
+                return int64_t(value2) / int64_t(value);
+            if (op == AsmExprOp::MODULO)
+                return value2 % value;
+            return int64_t(value2) % int64_t(value);
+        case AsmExprOp::BIT_AND:
+            return value2 & value;
+        case AsmExprOp::BIT_OR:
+            return value2 | value;
+        case AsmExprOp::BIT_XOR:
+            return value2 ^ value;
+        case AsmExprOp::BIT_ORNOT:
+            return value2 | ~value;
+        case AsmExprOp::SHIFT_LEFT:
+        case AsmExprOp::SHIFT_RIGHT:
+        case AsmExprOp::SIGNED_SHIFT_RIGHT:
+            if (value >= 64)
+            {
+                message = ASMXMSG_SHIFT_OUT_OF_RANGE;
+                if (op == AsmExprOp::SIGNED_SHIFT_RIGHT)
+                    return (value2>=(1ULL<<63)) ? UINT64_MAX : 0;
+                return 0;
+            }
+            if (op == AsmExprOp::SHIFT_LEFT)
+                return value2 << value;
+            if (op == AsmExprOp::SHIFT_RIGHT)
+                return value2 >> value;
+            return int64_t(value2) >> value;
+        case AsmExprOp::LOGICAL_AND:
+            return value2 && value;
+        case AsmExprOp::LOGICAL_OR:
+            return value2 || value;
+        case AsmExprOp::EQUAL:
+            return (value2 == value) ? UINT64_MAX : 0;
+        case AsmExprOp::NOT_EQUAL:
+            return (value2 != value) ? UINT64_MAX : 0;
+        case AsmExprOp::LESS:
+            return (int64_t(value2) < int64_t(value))? UINT64_MAX: 0;
+        case AsmExprOp::LESS_EQ:
+            return (int64_t(value2) <= int64_t(value)) ? UINT64_MAX : 0;
+        case AsmExprOp::GREATER:
+            return (int64_t(value2) > int64_t(value)) ? UINT64_MAX : 0;
+        case AsmExprOp::GREATER_EQ:
+            return (int64_t(value2) >= int64_t(value)) ? UINT64_MAX : 0;
+        case AsmExprOp::BELOW:
+            return (value2 < value)? UINT64_MAX: 0;
+        case AsmExprOp::BELOW_EQ:
+            return (value2 <= value) ? UINT64_MAX : 0;
+        case AsmExprOp::ABOVE:
+            return (value2 > value) ? UINT64_MAX : 0;
+        case AsmExprOp::ABOVE_EQ:
+            return (value2 >= value) ? UINT64_MAX : 0;
+        default:
+            return value;
+    }
+}
+
+// maximal number of registers used by compiled expression
+static const cxuint asmExprCodeMaxRegs = 64;
+
+/// compiled absolute expression: constant-folded register code
+/** all subexpressions without symbols are folded while compiling, the rest
+ * is a sequence of instructions that put results to registers */
+struct CLRX_INTERNAL CLRX::AsmExpression::Code
+{
+    /// operand types
+    enum : cxbyte
+    {
+        OPND_CONST = 0, ///< constant from constant table
+        OPND_ARG,       ///< argument of expression (resolved symbol)
+        OPND_REG        ///< register
+    };
+    
+    /// instruction: dest = op(sources)
+    struct Instr
+    {
+        AsmExprOp op;
+        cxbyte srcTypes;    ///< types of sources (2 bits per source)
+        uint16_t dest;      ///< destination register
+        uint32_t src[3];    ///< sources (third is message index if operator gives message)
+    };
+    
+    size_t size;        ///< size of whole code in bytes
+    uint32_t constsNum; ///< constants number
+    uint32_t instrsNum; ///< instructions number
+    cxbyte resultType;  ///< type of result operand
+    uint32_t result;    ///< result operand
+    
+    /// get constant table (placed after this structure)
+    const uint64_t* consts() const
+    { return reinterpret_cast<const uint64_t*>(this+1); }
+    /// get instructions (placed after constant table)
+    const Instr* instrs() const
+    { return reinterpret_cast<const Instr*>(consts() + constsNum); }
+    
+    /// get operand value
+    uint64_t get(cxbyte type, uint32_t index, const AsmExprArg* args,
+                 const uint64_t* regs) const
+    { return (type == OPND_CONST) ? consts()[index] :
+            (type == OPND_ARG) ? args[index].value : regs[index]; }
+};
+
+AsmExpression::AsmExpression(AsmMemoryPool* _memoryPool) : symOccursNum(0),
+          relativeSymOccurs(false), baseExpr(false), memoryPool(_memoryPool),
+          storage(nullptr), opsNum(0), opPosNum(0), argsNum(0), ops(nullptr),
+          messagePositions(nullptr), args(nullptr), code(nullptr)
 { }
 
+// allocate one storage for arguments, message positions and operators
+void AsmExpression::allocateStorage(size_t _opsNum, size_t _opPosNum, size_t _argsNum)
+{
+    const size_t size = sizeof(AsmExprArg)*_argsNum + sizeof(LineCol)*_opPosNum +
+                sizeof(AsmExprOp)*_opsNum;
+    storage = (memoryPool != nullptr) ? memoryPool->allocate(size) :
+                ::operator new(size);
+    opsNum = _opsNum;
+    opPosNum = _opPosNum;
+    argsNum = _argsNum;
+    args = reinterpret_cast<AsmExprArg*>(storage);
+    messagePositions = reinterpret_cast<LineCol*>(args + _argsNum);
+    ops = reinterpret_cast<AsmExprOp*>(messagePositions + _opPosNum);
+}
+
 // set symbol occurrences, operators and arguments, line positions for messages
 void AsmExpression::setParams(size_t _symOccursNum,
           bool _relativeSymOccurs, size_t _opsNum, const AsmExprOp* _ops, size_t _opPosNum,
@@ -54,11 +211,10 @@ void AsmExpression::setParams(size_t _symOccursNum,
     symOccursNum = _symOccursNum;
     relativeSymOccurs = _relativeSymOccurs;
     baseExpr = _baseExpr;
-    args.reset(new AsmExprArg[_argsNum]);
-    ops.assign(_ops, _ops+_opsNum);
-    messagePositions.reset(new LineCol[_opPosNum]);
-    std::copy(_args, _args+_argsNum, args.get());
-    std::copy(_opPos, _opPos+_opPosNum, messagePositions.get());
+    allocateStorage(_opsNum, _opPosNum, _argsNum);
+    std::copy(_ops, _ops+_opsNum, ops);
+    std::copy(_args, _args+_argsNum, args);
+    std::copy(_opPos, _opPos+_opPosNum, messagePositions);
 }
 
 AsmExpression::AsmExpression(const AsmSourcePos& _pos, size_t _symOccursNum,
@@ -66,22 +222,21 @@ AsmExpression::AsmExpression(const AsmSourcePos& _pos, size_t _symOccursNum,
           const LineCol* _opPos, size_t _argsNum, const AsmExprArg* _args,
           bool _baseExpr)
         : sourcePos(_pos), symOccursNum(_symOccursNum), relativeSymOccurs(_relSymOccurs),
-          baseExpr(_baseExpr), ops(_ops, _ops+_opsNum)
+          baseExpr(_baseExpr), memoryPool(nullptr), code(nullptr)
 {
-    args.reset(new AsmExprArg[_argsNum]);
-    messagePositions.reset(new LineCol[_opPosNum]);
-    std::copy(_args, _args+_argsNum, args.get());
-    std::copy(_opPos, _opPos+_opPosNum, messagePositions.get());
+    allocateStorage(_opsNum, _opPosNum, _argsNum);
+    std::copy(_ops, _ops+_opsNum, ops);
+    std::copy(_args, _args+_argsNum, args);
+    std::copy(_opPos, _opPos+_opPosNum, messagePositions);
 }
 
 AsmExpression::AsmExpression(const AsmSourcePos& _pos, size_t _symOccursNum,
             bool _relSymOccurs, size_t _opsNum, size_t _opPosNum, size_t _argsNum,
             bool _baseExpr)
         : sourcePos(_pos), symOccursNum(_symOccursNum), relativeSymOccurs(_relSymOccurs),
-          baseExpr(_baseExpr), ops(_opsNum)
+          baseExpr(_baseExpr), memoryPool(nullptr), code(nullptr)
 {
-    args.reset(new AsmExprArg[_argsNum]);
-    messagePositions.reset(new LineCol[_opPosNum]);
+    allocateStorage(_opsNum, _opPosNum, _argsNum);
 }
 
 AsmExpression::~AsmExpression()
@@ -89,7 +244,7 @@ AsmExpression::~AsmExpression()
     if (!baseExpr)
     {
         // delete all occurrences in expression at that place
-        for (size_t i = 0, j = 0; i < ops.size(); i++)
+        for (size_t i = 0, j = 0; i < opsNum; i++)
             if (ops[i] == AsmExprOp::ARG_SYMBOL)
             {
                 args[j].symbol->second.removeOccurrenceInExpr(this, j, i);
@@ -98,6 +253,218 @@ AsmExpression::~AsmExpression()
             else if (ops[i]==AsmExprOp::ARG_VALUE)
                 j++;
     }
+    if (memoryPool != nullptr)
+    {
+        memoryPool->deallocate(storage, sizeof(AsmExprArg)*argsNum +
+                    sizeof(LineCol)*opPosNum + sizeof(AsmExprOp)*opsNum);
+        if (code != nullptr)
+            memoryPool->deallocate(code, code->size);
+    }
+    else
+    {
+        ::operator delete(storage);
+        ::operator delete(code);
+    }
+}
+
+// compile expression with absolute values into constant-folded register code
+void AsmExpression::compileCode()
+{
+    if (opsNum == 0 || relativeSymOccurs)
+        return;
+    struct Operand
+    {
+        cxbyte type;
+        uint64_t value; // constant value or argument/register index
+    };
+    /* temporary tables have bounded sizes (stack and instructions: opsNum,
+     * constants: opsNum+1), hence one block from memory pool holds all them */
+    const size_t tempSize = sizeof(uint64_t)*(opsNum+1) + sizeof(Operand)*opsNum +
+                sizeof(Code::Instr)*opsNum;
+    struct TempBlock
+    {
+        AsmMemoryPool* pool;
+        size_t size;
+        void* ptr;
+        TempBlock(AsmMemoryPool* _pool, size_t _size) : pool(_pool), size(_size),
+                ptr(_pool != nullptr ? _pool->allocate(_size) : ::operator new(_size))
+        { }
+        ~TempBlock()
+        {
+            if (pool != nullptr)
+                pool->deallocate(ptr, size);
+            else
+                ::operator delete(ptr);
+        }
+    } tempBlock(memoryPool, tempSize);
+    uint64_t* consts = reinterpret_cast<uint64_t*>(tempBlock.ptr);
+    Operand* stack = reinterpret_cast<Operand*>(consts + opsNum+1);
+    Code::Instr* instrs = reinterpret_cast<Code::Instr*>(stack + opsNum);
+    size_t stackSize = 0;
+    size_t constsNum = 0;
+    size_t instrsNum = 0;
+    cxuint regsNum = 0;
+    cxuint regTop = 0;
+    size_t argPos = 0;
+    size_t messagePosIndex = 0;
+    for (size_t i = 0; i < opsNum; i++)
+    {
+        const AsmExprOp op = ops[i];
+        if (isArg(op))
+        {
+            // values at this time are constants, symbols will be resolved later
+            if (op == AsmExprOp::ARG_VALUE)
+                stack[stackSize++] = { Code::OPND_CONST, args[argPos].value };
+            else
+                stack[stackSize++] = { Code::OPND_ARG, argPos };
+            argPos++;
+            continue;
+        }
+        const bool withMessage = (operatorWithMessage & (1ULL<<cxuint(op)))!=0;
+        const cxuint srcsNum = (op == AsmExprOp::CHOICE) ? 3 : isBinaryOp(op) ? 2 : 1;
+        const Operand* srcs = stack + stackSize-srcsNum;
+        bool allConsts = true;
+        for (cxuint k = 0; k < srcsNum; k++)
+            if (srcs[k].type != Code::OPND_CONST)
+                allConsts = false;
+        
+        cxbyte message = ASMXMSG_NONE;
+        uint64_t value = 0;
+        if (allConsts)
+            value = (op == AsmExprOp::CHOICE) ?
+                    (srcs[0].value ? srcs[1].value : srcs[2].value) :
+                    applyAbsoluteOp(op, (srcsNum == 2) ? srcs[0].value : 0,
+                            srcs[srcsNum-1].value, message);
+        if (allConsts && message == ASMXMSG_NONE)
+        {
+            // fold operator
+            stackSize -= srcsNum;
+            stack[stackSize++] = { Code::OPND_CONST, value };
+        }
+        else
+        {
+            // operators with message always are evaluated later
+            Code::Instr instr;
+            instr.op = op;
+            instr.srcTypes = 0;
+            instr.src[2] = messagePosIndex;
+            for (cxuint k = 0; k < srcsNum; k++)
+            {
+                if (srcs[k].type == Code::OPND_CONST)
+                {
+                    instr.src[k] = constsNum;
+                    consts[constsNum++] = srcs[k].value;
+                }
+                else
+                    instr.src[k] = srcs[k].value;
+                if (srcs[k].type == Code::OPND_REG)
+                    regTop--; // free register
+                instr.srcTypes |= srcs[k].type<<(k<<1);
+            }
+            if (regTop == asmExprCodeMaxRegs)
+                return; // too many registers, do not compile
+            instr.dest = regTop++;
+            regsNum = std::max(regsNum, regTop);
+            instrs[instrsNum++] = instr;
+            stackSize -= srcsNum;
+            stack[stackSize++] = { Code::OPND_REG, instr.dest };
+        }
+        if (withMessage)
+            messagePosIndex++;
+    }
+    if (stackSize != 1)
+        return;
+    
+    cxbyte resultType = stack[0].type;
+    uint32_t result = stack[0].value;
+    if (resultType == Code::OPND_CONST)
+    {
+        result = constsNum;
+        consts[constsNum++] = stack[0].value;
+    }
+    const size_t size = sizeof(Code) + sizeof(uint64_t)*constsNum +
+                sizeof(Code::Instr)*instrsNum;
+    code = reinterpret_cast<Code*>((memoryPool != nullptr) ?
+                memoryPool->allocate(size) : ::operator new(size));
+    code->size = size;
+    code->constsNum = constsNum;
+    code->instrsNum = instrsNum;
+    code->resultType = resultType;
+    code->result = result;
+    std::copy(consts, consts+constsNum, const_cast<uint64_t*>(code->consts()));
+    std::copy(instrs, instrs+instrsNum, const_cast<Code::Instr*>(code->instrs()));
+}
+
+// copy compiled code from other expression with this same operators
+void AsmExpression::copyCode(const AsmExpression& expr)
+{
+    if (expr.code == nullptr)
+        return;
+    const size_t size = expr.code->size;
+    code = reinterpret_cast<Code*>((memoryPool != nullptr) ?
+                memoryPool->allocate(size) : ::operator new(size));
+    std::copy(reinterpret_cast<const cxbyte*>(expr.code),
+              reinterpret_cast<const cxbyte*>(expr.code) + size,
+              reinterpret_cast<cxbyte*>(code));
+}
+
+/*
+ * memory pool
+ */
+
+AsmMemoryPool::AsmMemoryPool() : chunkPos(nullptr), chunkEnd(nullptr)
+{
+    std::fill(freeLists, freeLists+classesNum, nullptr);
+}
+
+AsmMemoryPool::~AsmMemoryPool()
+{
+    for (cxbyte* chunk: chunks)
+        delete[] chunk;
+}
+
+void* AsmMemoryPool::allocate(size_t size)
+{
+    if (size == 0)
+        return nullptr;
+    if (size > (classesNum<<classShift))
+        // too big block, get it from heap
+        return ::operator new(size);
+    const size_t sizeClass = (size-1)>>classShift;
+    void* block = freeLists[sizeClass];
+    if (block != nullptr)
+    {
+        // get block from free list
+        freeLists[sizeClass] = *reinterpret_cast<void**>(block);
+        return block;
+    }
+    const size_t blockSize = (sizeClass+1)<<classShift;
+    if (size_t(chunkEnd-chunkPos) < blockSize)
+    {
+        // allocate new chunk
+        chunks.push_back(nullptr);
+        chunks.back() = new cxbyte[chunkSize];
+        chunkPos = chunks.back();
+        chunkEnd = chunkPos + chunkSize;
+    }
+    block = chunkPos;
+    chunkPos += blockSize;
+    return block;
+}
+
+void AsmMemoryPool::deallocate(void* ptr, size_t size)
+{
+    if (ptr == nullptr)
+        return;
+    if (size > (classesNum<<classShift))
+    {
+        ::operator delete(ptr);
+        return;
+    }
+    // put block to free list
+    const size_t sizeClass = (size-1)>>classShift;
+    *reinterpret_cast<void**>(ptr) = freeLists[sizeClass];
+    freeLists[sizeClass] = ptr;
 }
 
 // helper for handling errors
@@ -212,209 +579,106 @@ AsmTryStatus AsmExpression::tryEvaluate(Assembler& assembler, size_t opStart, si
     if (!relativeSymOccurs)
     {
         // all value is absolute
-        std::stack<uint64_t> stack;
-        
-        size_t argPos = 0;
-        size_t opPos = 0;
-        size_t messagePosIndex = 0;
+        // print message given by operator
+        auto printOpMessage = [this, &assembler, &failed](cxbyte message,
+                        size_t messagePosIndex)
+        {
+            if (message == ASMXMSG_DIVISION_BY_ZERO)
+                ASMX_FAILED_BY_ERROR(getSourcePos(messagePosIndex), "Division by zero")
+            else if (message == ASMXMSG_SHIFT_OUT_OF_RANGE)
+                assembler.printWarning(getSourcePos(messagePosIndex),
+                        "Shift count out of range (between 0 and 63)");
+        };
         
-        // move messagePosIndex and argument position to opStart position
-        for (opPos = 0; opPos < opStart; opPos++)
+        if (code != nullptr && opStart == 0 && opEnd == opsNum)
         {
-            if (ops[opPos]==AsmExprOp::ARG_VALUE)
-                argPos++;
-            if ((operatorWithMessage & (1ULL<<cxuint(ops[opPos])))!=0)
-                messagePosIndex++;
+            // execute compiled code (registers in local array)
+            uint64_t regs[asmExprCodeMaxRegs];
+            const Code::Instr* instrs = code->instrs();
+            for (size_t i = 0; i < code->instrsNum; i++)
+            {
+                const Code::Instr& instr = instrs[i];
+                const uint64_t src0 = code->get(instr.srcTypes&3, instr.src[0], args, regs);
+                if (instr.op == AsmExprOp::CHOICE)
+                    value = src0 ?
+                        code->get((instr.srcTypes>>2)&3, instr.src[1], args, regs) :
+                        code->get(instr.srcTypes>>4, instr.src[2], args, regs);
+                else
+                {
+                    cxbyte message;
+                    if (isBinaryOp(instr.op))
+                        value = applyAbsoluteOp(instr.op, src0,
+                            code->get((instr.srcTypes>>2)&3, instr.src[1], args, regs),
+                            message);
+                    else
+                        value = applyAbsoluteOp(instr.op, 0, src0, message);
+                    if (message != ASMXMSG_NONE)
+                        printOpMessage(message, instr.src[2]);
+                }
+                regs[instr.dest] = value;
+            }
+            value = code->get(code->resultType, code->result, args, regs);
         }
-        
-        while (opPos < opEnd)
+        else
         {
-            const AsmExprOp op = ops[opPos++];
-            if (op == AsmExprOp::ARG_VALUE)
+            std::stack<uint64_t> stack;
+            
+            size_t argPos = 0;
+            size_t opPos = 0;
+            size_t messagePosIndex = 0;
+            
+            // move messagePosIndex and argument position to opStart position
+            for (opPos = 0; opPos < opStart; opPos++)
             {
-                // push argument to stack
-                stack.push(args[argPos++].value);
-                continue;
+                if (ops[opPos]==AsmExprOp::ARG_VALUE)
+                    argPos++;
+                if ((operatorWithMessage & (1ULL<<cxuint(ops[opPos])))!=0)
+                    messagePosIndex++;
             }
-            value = stack.top();
-            stack.pop();
-            if (isUnaryOp(op))
+            
+            while (opPos < opEnd)
             {
-                // unary operator (-,~,!)
-                switch (op)
+                const AsmExprOp op = ops[opPos++];
+                if (op == AsmExprOp::ARG_VALUE)
                 {
-                    case AsmExprOp::NEGATE:
-                        value = -value;
-                        break;
-                    case AsmExprOp::BIT_NOT:
-                        value = ~value;
-                        break;
-                    case AsmExprOp::LOGICAL_NOT:
-                        value = !value;
-                        break;
-                    default:
-                        break;
+                    // push argument to stack
+                    stack.push(args[argPos++].value);
+                    continue;
                 }
-            }
-            else if (isBinaryOp(op))
-            {
-                // get first argument (second in stack)
-                uint64_t value2 = stack.top();
+                value = stack.top();
                 stack.pop();
-                switch (op)
+                if (op == AsmExprOp::CHOICE)
                 {
-                    case AsmExprOp::ADDITION:
-                        value = value2 + value;
-                        break;
-                    case AsmExprOp::SUBTRACT:
-                        value = value2 - value;
-                        break;
-                    case AsmExprOp::MULTIPLY:
-                        value = value2 * value;
-                        break;
-                    case AsmExprOp::DIVISION:
-                        if (value != 0)
-                            value = value2 / value;
-                        else // error
-                        {
-                            ASMX_FAILED_BY_ERROR(getSourcePos(messagePosIndex),
-                                   "Division by zero")
-                            value = 0;
-                        }
-                        messagePosIndex++;
-                        break;
-                    case AsmExprOp::SIGNED_DIVISION:
-                        if (value != 0)
-                            value = int64_t(value2) / int64_t(value);
-                        else // error
-                        {
-                            ASMX_FAILED_BY_ERROR(getSourcePos(messagePosIndex),
-                                   "Division by zero")
-                            value = 0;
-                        }
-                        messagePosIndex++;
-                        break;
-                    case AsmExprOp::MODULO:
-                        if (value != 0)
-                            value = value2 % value;
-                        else // error
-                        {
-                            ASMX_FAILED_BY_ERROR(getSourcePos(messagePosIndex),
-                                   "Division by zero")
-                            value = 0;
-                        }
-                        messagePosIndex++;
-                        break;
-                    case AsmExprOp::SIGNED_MODULO:
-                        if (value != 0)
-                            value = int64_t(value2) % int64_t(value);
-                        else // error
-                        {
-                            ASMX_FAILED_BY_ERROR(getSourcePos(messagePosIndex),
-                                   "Division by zero")
-                            value = 0;
-                        }
-                        messagePosIndex++;
-                        break;
-                    case AsmExprOp::BIT_AND:
-                        value = value2 & value;
-                        break;
-                    case AsmExprOp::BIT_OR:
-                        value = value2 | value;
-                        break;
-                    case AsmExprOp::BIT_XOR:
-                        value = value2 ^ value;
-                        break;
-                    case AsmExprOp::BIT_ORNOT:
-                        value = value2 | ~value;
-                        break;
-                    case AsmExprOp::SHIFT_LEFT:
-                        if (value < 64)
-                            value = value2 << value;
-                        else
-                        {
-                            assembler.printWarning(getSourcePos(messagePosIndex),
-                                   "Shift count out of range (between 0 and 63)");
-                            value = 0;
-                        }
-                        messagePosIndex++;
-                        break;
-                    case AsmExprOp::SHIFT_RIGHT:
-                        if (value < 64)
-                            value = value2 >> value;
-                        else
-                        {
-                            assembler.printWarning(getSourcePos(messagePosIndex),
-                                   "Shift count out of range (between 0 and 63)");
-                            value = 0;
-                        }
-                        messagePosIndex++;
-                        break;
-                    case AsmExprOp::SIGNED_SHIFT_RIGHT:
-                        if (value < 64)
-                            value = int64_t(value2) >> value;
-                        else
-                        {
-                            assembler.printWarning(getSourcePos(messagePosIndex),
-                                   "Shift count out of range (between 0 and 63)");
-                            value = (value2>=(1ULL<<63)) ? UINT64_MAX : 0;
-                        }
+                    // get second and first (second and third in stack)
+                    const uint64_t value2 = stack.top();
+                    stack.pop();
+                    const uint64_t value3 = stack.top();
+                    stack.pop();
+                    value = value3 ? value2 : value;
+                }
+                else
+                {
+                    // get first argument (second in stack) if binary operator
+                    uint64_t value2 = 0;
+                    if (isBinaryOp(op))
+                    {
+                        value2 = stack.top();
+                        stack.pop();
+                    }
+                    cxbyte message;
+                    value = applyAbsoluteOp(op, value2, value, message);
+                    if ((operatorWithMessage & (1ULL<<cxuint(op)))!=0)
+                    {
+                        printOpMessage(message, messagePosIndex);
                         messagePosIndex++;
-                        break;
-                    case AsmExprOp::LOGICAL_AND:
-                        value = value2 && value;
-                        break;
-                    case AsmExprOp::LOGICAL_OR:
-                        value = value2 || value;
-                        break;
-                    case AsmExprOp::EQUAL:
-                        value = (value2 == value) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::NOT_EQUAL:
-                        value = (value2 != value) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::LESS:
-                        value = (int64_t(value2) < int64_t(value))? UINT64_MAX: 0;
-                        break;
-                    case AsmExprOp::LESS_EQ:
-                        value = (int64_t(value2) <= int64_t(value)) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::GREATER:
-                        value = (int64_t(value2) > int64_t(value)) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::GREATER_EQ:
-                        value = (int64_t(value2) >= int64_t(value)) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::BELOW:
-                        value = (value2 < value)? UINT64_MAX: 0;
-                        break;
-                    case AsmExprOp::BELOW_EQ:
-                        value = (value2 <= value) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::ABOVE:
-                        value = (value2 > value) ? UINT64_MAX : 0;
-                        break;
-                    case AsmExprOp::ABOVE_EQ:
-                        value = (value2 >= value) ? UINT64_MAX : 0;
-                        break;
-                    default:
-                        break;
+                    }
                 }
+                stack.push(value);
             }
-            else if (op == AsmExprOp::CHOICE)
-            {
-                // get second and first (second and third in stack)
-                const uint64_t value2 = stack.top();
-                stack.pop();
-                const uint64_t value3 = stack.top();
-                stack.pop();
-                value = value3 ? value2 : value;
-            }
-            stack.push(value);
+            
+            if (!stack.empty())
+                value = stack.top();
         }
-        
-        if (!stack.empty())
-            value = stack.top();
         sectionId = ASMSECT_ABS;
     }
     else
@@ -452,6 +716,9 @@ AsmTryStatus AsmExpression::tryEvaluate(Assembler& assembler, size_t opStart, si
         const std::vector<Array<AsmSectionId> >& relSpacesSects =
                     assembler.relSpacesSections;
         const std::vector<AsmSection>& sections = assembler.sections;
+        // code offsets used by expression (wait instructions can be inserted later)
+        const bool trackCodeOffsets = (assembler.flags & ASM_AUTOWAIT) != 0;
+        std::vector<std::pair<AsmSectionId, uint64_t> > codeOffsets;
         
         while (opPos < opEnd)
         {
@@ -462,6 +729,8 @@ AsmTryStatus AsmExpression::tryEvaluate(Assembler& assembler, size_t opStart, si
                 {
                     uint64_t ovalue = args[argPos].relValue.value;
                     AsmSectionId osectId = args[argPos].relValue.sectionId;
+                    if (trackCodeOffsets && sections[osectId].type == AsmSectionType::CODE)
+                        codeOffsets.push_back(std::make_pair(osectId, ovalue));
                     if (sectDiffsPrepared && sections[osectId].relSpace!=UINT_MAX)
                     {
                         // resolve section in relspace
@@ -945,6 +1214,23 @@ AsmTryStatus AsmExpression::tryEvaluate(Assembler& assembler, size_t opStart, si
             value += sections[sectionId].relAddress - sections[newSectionId].relAddress;
             sectionId = newSectionId;
         }
+        
+        if (!failed && !tryLater && codeOffsets.size() > 1)
+        {
+            // remember range of code offsets in every section (checked after
+            // inserting wait instructions)
+            std::sort(codeOffsets.begin(), codeOffsets.end());
+            for (size_t i = 0; i < codeOffsets.size();)
+            {
+                size_t j = i+1;
+                for (; j < codeOffsets.size() &&
+                        codeOffsets[j].first == codeOffsets[i].first; j++);
+                if (codeOffsets[i].second != codeOffsets[j-1].second)
+                    assembler.codeOffsetsUses.push_back({ codeOffsets[i].first,
+                            codeOffsets[i].second, codeOffsets[j-1].second, sourcePos });
+                i = j;
+            }
+        }
     }
     if (tryLater)
         return AsmTryStatus::TRY_LATER;
@@ -1025,22 +1311,21 @@ class CLRX_INTERNAL CLRX::AsmExpression::TempSymbolSnapshotMap:
 
 AsmExpression* AsmExpression::createForSnapshot(const AsmSourcePos* exprSourcePos) const
 {
-    std::unique_ptr<AsmExpression> expr(new AsmExpression);
+    std::unique_ptr<AsmExpression> expr(new AsmExpression(memoryPool));
     size_t argsNum = 0;
     size_t msgPosNum = 0;
-    for (AsmExprOp op: ops)
-        if (AsmExpression::isArg(op))
+    for (size_t i = 0; i < opsNum; i++)
+        if (AsmExpression::isArg(ops[i]))
             argsNum++;
-        else if (operatorWithMessage & (1ULL<<int(op)))
+        else if (operatorWithMessage & (1ULL<<int(ops[i])))
             msgPosNum++;
     expr->sourcePos = sourcePos;
     expr->sourcePos.exprSourcePos = exprSourcePos;
-    expr->ops = ops;
-    expr->args.reset(new AsmExprArg[argsNum]);
-    std::copy(args.get(), args.get()+argsNum, expr->args.get());
-    expr->messagePositions.reset(new LineCol[msgPosNum]);
-    std::copy(messagePositions.get(), messagePositions.get()+msgPosNum,
-              expr->messagePositions.get());
+    expr->allocateStorage(opsNum, msgPosNum, argsNum);
+    std::copy(ops, ops+opsNum, expr->ops);
+    std::copy(args, args+argsNum, expr->args);
+    std::copy(messagePositions, messagePositions+msgPosNum, expr->messagePositions);
+    expr->copyCode(*this);
     return expr.release();
 }
 
@@ -1108,10 +1393,10 @@ bool AsmExpression::makeSymbolSnapshot(Assembler& assembler,
         size_t opIndex = se.opIndex;
         size_t argIndex = se.argIndex;
         AsmExpression* expr = se.entry->second.expression;
-        const size_t opsSize = expr->ops.size();
+        const size_t opsSize = expr->opsNum;
         
-        AsmExprArg* args = expr->args.get();
-        AsmExprOp* ops = expr->ops.data();
+        AsmExprArg* args = expr->args;
+        AsmExprOp* ops = expr->ops;
         if (opIndex < opsSize)
         {
             for (; opIndex < opsSize; opIndex++)
@@ -1261,20 +1546,23 @@ AsmExpression* AsmExpression::createExprToEvaluate(Assembler& assembler) const
     {
     size_t argsNum = 0;
     size_t msgPosNum = 0;
-    for (AsmExprOp op: ops)
-        if (AsmExpression::isArg(op))
+    for (size_t i = 0; i < opsNum; i++)
+        if (AsmExpression::isArg(ops[i]))
             argsNum++;
-    else if (operatorWithMessage & (1ULL<<int(op)))
+    else if (operatorWithMessage & (1ULL<<int(ops[i])))
         msgPosNum++;
-    std::unique_ptr<AsmExpression> newExpr(new AsmExpression(
-            sourcePos, symOccursNum, relativeSymOccurs, ops.size(), ops.data(),
-            msgPosNum, messagePositions.get(), argsNum, args.get(), false));
+    std::unique_ptr<AsmExpression> newExpr(new AsmExpression(memoryPool));
+    newExpr->sourcePos = sourcePos;
+    newExpr->setParams(symOccursNum, relativeSymOccurs, opsNum, ops,
+            msgPosNum, messagePositions, argsNum, args, false);
+    newExpr->copyCode(*this);
     argsNum = 0;
     bool good = true;
     // try to resolve symbols
-    for (AsmExprOp& op: newExpr->ops)
-        if (AsmExpression::isArg(op))
+    for (size_t i = 0; i < newExpr->opsNum; i++)
+        if (AsmExpression::isArg(newExpr->ops[i]))
         {
+            AsmExprOp& op = newExpr->ops[i];
             if (op == AsmExprOp::ARG_SYMBOL) // if
             {
                 AsmExprArg& arg = newExpr->args[argsNum];
@@ -1356,11 +1644,42 @@ AsmExpression* AsmExpression::parse(Assembler& assembler, const char*& linePtr,
         size_t lineColPos;
     };
 
-    std::stack<ConExprOpEntry> stack;
-    std::vector<AsmExprOp> ops;
-    std::vector<AsmExprArg> args;
-    std::vector<LineCol> messagePositions;
-    std::vector<LineCol> outMsgPositions;
+    // take buffers from assembler and give them back at end
+    // (nested parsing gets empty buffers)
+    struct ParseBuffers
+    {
+        Assembler& assembler;
+        std::vector<AsmExprOp> ops;
+        std::vector<AsmExprArg> args;
+        std::vector<LineCol> messagePositions;
+        std::vector<LineCol> outMsgPositions;
+        
+        explicit ParseBuffers(Assembler& _assembler) : assembler(_assembler)
+        {
+            ops.swap(assembler.exprOpsBuffer);
+            args.swap(assembler.exprArgsBuffer);
+            messagePositions.swap(assembler.exprMsgPositionsBuffer);
+            outMsgPositions.swap(assembler.exprOutMsgPositionsBuffer);
+            ops.clear();
+            args.clear();
+            messagePositions.clear();
+            outMsgPositions.clear();
+        }
+        ~ParseBuffers()
+        {
+            ops.swap(assembler.exprOpsBuffer);
+            args.swap(assembler.exprArgsBuffer);
+            messagePositions.swap(assembler.exprMsgPositionsBuffer);
+            outMsgPositions.swap(assembler.exprOutMsgPositionsBuffer);
+        }
+    } buffers(assembler);
+    
+    // stack in vector (deque allocates big block at start)
+    std::stack<ConExprOpEntry, std::vector<ConExprOpEntry> > stack;
+    std::vector<AsmExprOp>& ops = buffers.ops;
+    std::vector<AsmExprArg>& args = buffers.args;
+    std::vector<LineCol>& messagePositions = buffers.messagePositions;
+    std::vector<LineCol>& outMsgPositions = buffers.outMsgPositions;
     
     TempSymbolSnapshotMap symbolSnapshots;
     
@@ -1381,7 +1700,7 @@ AsmExpression* AsmExpression::parse(Assembler& assembler, const char*& linePtr,
         XT_ARG = 2  // expected argument
     };
     ExpectedToken expectedToken = XT_FIRST;
-    std::unique_ptr<AsmExpression> expr(new AsmExpression);
+    std::unique_ptr<AsmExpression> expr(new AsmExpression(&assembler.memoryPool));
     expr->sourcePos = assembler.getSourcePos(startString);
     
     while (linePtr != end)
@@ -1819,6 +2138,7 @@ AsmExpression* AsmExpression::parse(Assembler& assembler, const char*& linePtr,
         expr->setParams(symOccursNum, relativeSymOccurs,
                   ops.size(), ops.data(), outMsgPositions.size(), outMsgPositions.data(),
                   argsNum, args.data(), makeBase);
+        expr->compileCode();
         if (!makeBase)
         {
             // add expression into symbol occurrences in expressions
@@ -72,6 +72,9 @@ void AsmFormatHandler::handleLabel(const CString& label)
 void AsmFormatHandler::setCodeFlags(Flags codeFlags)
 { }
 
+void AsmFormatHandler::updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum)
+{ }
+
 bool AsmFormatHandler::resolveSymbol(const AsmSymbol& symbol, uint64_t& value,
                  AsmSectionId& sectionId)
 {
@@ -103,25 +106,26 @@ bool AsmFormatHandler::resolveLoHiRelocExpression(const AsmExpression* expr,
                 "code section");
         return false;
     }
-    const Array<AsmExprOp>& ops = expr->getOps();
+    const AsmExprOp* ops = expr->getOps();
+    const size_t opsNum = expr->getOpsNum();
     
     size_t relOpStart = 0;
-    size_t relOpEnd = ops.size();
+    size_t relOpEnd = opsNum;
     relType = RELTYPE_LOW_32BIT;
     // checking what is expression
     // get () OP () - operator between two parts
-    AsmExprOp lastOp = ops.back();
+    AsmExprOp lastOp = ops[opsNum-1];
     if (lastOp==AsmExprOp::BIT_AND || lastOp==AsmExprOp::MODULO ||
         lastOp==AsmExprOp::SIGNED_MODULO || lastOp==AsmExprOp::DIVISION ||
         lastOp==AsmExprOp::SIGNED_DIVISION || lastOp==AsmExprOp::SHIFT_RIGHT)
     {
         // check low or high relocation
         relOpStart = 0;
-        relOpEnd = expr->toTop(ops.size()-2);
+        relOpEnd = expr->toTop(opsNum-2);
         /// evaluate second argument
         AsmSectionId tmpSectionId;
         uint64_t secondArg;
-        if (!expr->evaluate(assembler, relOpEnd, ops.size()-1, secondArg, tmpSectionId))
+        if (!expr->evaluate(assembler, relOpEnd, opsNum-1, secondArg, tmpSectionId))
             return false;
         if (tmpSectionId!=ASMSECT_ABS)
         {
@@ -183,6 +187,14 @@ AsmKcodeHandler::AsmKcodeHandler(Assembler& assembler) : AsmFormatHandler(assemb
         currentKcodeKernel(ASMKERN_GLOBAL), codeSection(ASMSECT_NONE)
 { }
 
+void AsmKcodeHandler::resetKcodeState()
+{
+    kcodeSelection.clear();
+    kcodeSelStack = std::stack<std::vector<AsmKernelId> >();
+    currentKcodeKernel = ASMKERN_GLOBAL;
+    codeSection = ASMSECT_NONE;
+}
+
 void AsmKcodeHandler::restoreKcodeCurrentAllocRegs()
 {
     if (currentKcodeKernel != ASMKERN_GLOBAL)
@@ -226,6 +238,19 @@ void AsmKcodeHandler::prepareKcodeState()
     }
 }
 
+void AsmKcodeHandler::updateKernelRegisters(AsmKernelId kernelId, const cxuint* regsNum)
+{
+    // registers of current kernel are held by ISA assembler (outside kcode)
+    const bool currentKernel = kcodeSelection.empty() && kernelId == currentKcodeKernel;
+    if (currentKernel)
+        saveKcodeCurrentAllocRegs();
+    KernelBase& kernel = getKernelBase(kernelId);
+    for (cxuint i = 0; i < MAX_REGTYPES_NUM; i++)
+        kernel.allocRegs[i] = regsNum[i];
+    if (currentKernel)
+        restoreKcodeCurrentAllocRegs();
+}
+
 void AsmKcodeHandler::handleLabel(const CString& label)
 {
     if (assembler.sections[assembler.currentSection].type != AsmSectionType::CODE)
@@ -420,6 +445,11 @@ void AsmKcodePseudoOps::doKCodeEnd(AsmKcodeHandler& handler, const char* pseudoO
 /* raw code handler */
 
 AsmRawCodeHandler::AsmRawCodeHandler(Assembler& assembler): AsmFormatHandler(assembler)
+{
+    reset();
+}
+
+void AsmRawCodeHandler::reset()
 {
     assembler.currentKernel = ASMKERN_GLOBAL;
     assembler.currentSection = 0;
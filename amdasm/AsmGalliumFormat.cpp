@@ -143,14 +143,7 @@ AsmGalliumHandler::AsmGalliumHandler(Assembler& assembler):
              commentSection(ASMSECT_NONE), scratchSection(ASMSECT_NONE),
              extraSectionCount(0), archMinor(BINGEN_DEFAULT), archStepping(BINGEN_DEFAULT)
 {
-    codeSection = 0;
-    assembler.currentKernel = ASMKERN_GLOBAL;
-    assembler.currentSection = 0;
-    // define .text section (will be first section)
-    sections.push_back({ ASMKERN_GLOBAL, AsmSectionType::CODE,
-                ELFSECTID_TEXT, ".text" });
-    inside = Inside::MAINLAYOUT;
-    savedSection = 0;
+    reset();
     // detect driver and LLVM version once for using many times
     detectedLLVMVersion = detectLLVMCompilerVersion();
     detectedDriverVersion = detectMesaDriverVersion();
@@ -162,6 +155,28 @@ AsmGalliumHandler::~AsmGalliumHandler()
         delete kernel;
 }
 
+void AsmGalliumHandler::reset()
+{
+    resetKcodeState();
+    for (Kernel* kernel: kernelStates)
+        delete kernel;
+    kernelStates.clear();
+    sections.clear();
+    extraSectionMap.clear();
+    output = GalliumInput{};
+    dataSection = commentSection = scratchSection = ASMSECT_NONE;
+    extraSectionCount = 0;
+    archMinor = archStepping = BINGEN_DEFAULT;
+    codeSection = 0;
+    assembler.currentKernel = ASMKERN_GLOBAL;
+    assembler.currentSection = 0;
+    // define .text section (will be first section)
+    sections.push_back({ ASMKERN_GLOBAL, AsmSectionType::CODE,
+                ELFSECTID_TEXT, ".text" });
+    inside = Inside::MAINLAYOUT;
+    savedSection = 0;
+}
+
 // determine LLVM version from assembler settings or CLRX settings
 cxuint AsmGalliumHandler::determineLLVMVersion() const
 {
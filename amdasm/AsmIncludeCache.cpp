@@ -0,0 +1,376 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_set>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "AsmInternals.h"
+
+using namespace CLRX;
+
+/* include cache: results of the included file are stored only if file contains
+ * declarations (checked while parsing statements). settings hash is a part of key.
+ * global symbols and macros used by file are recorded at first use (before any
+ * change made by file), and entry is restored only if they have same state,
+ * hence restored results are same as results of parsing */
+
+// FNV-1a hash
+static const uint64_t hashInitValue = 0xcbf29ce484222325ULL;
+
+static inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const cxbyte* bytes = reinterpret_cast<const cxbyte*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static inline uint64_t hashValue(uint64_t hash, uint64_t value)
+{ return hashBytes(hash, &value, sizeof(uint64_t)); }
+
+// hash string with null-terminator (separates next strings)
+static inline uint64_t hashString(uint64_t hash, const CString& str)
+{ return hashBytes(hash, str.c_str(), str.size()+1); }
+
+namespace CLRX
+{
+    
+uint64_t hashIncludeFile(const std::string& filename, bool* regular)
+{
+    MappedFile file;
+    if (!file.map(filename.c_str()))
+    {
+        // content of pipe or device can be read only once (by input filter)
+        if (regular != nullptr)
+            *regular = false;
+        return 0;
+    }
+    if (regular != nullptr)
+        *regular = true;
+    return hashBytes(hashInitValue, file.getContent(), file.getSize());
+}
+
+};
+
+// hash state of symbol (value and flags)
+static uint64_t hashSymbol(const AsmSymbolEntry& symEntry)
+{
+    const AsmSymbol& symbol = symEntry.second;
+    uint64_t hash = hashString(hashInitValue, symEntry.first);
+    hash = hashValue(hash, symbol.hasValue ? symbol.value : 0);
+    hash = hashValue(hash, symbol.size);
+    return hashValue(hash, (uint64_t(symbol.sectionId)<<32) |
+            (uint64_t(symbol.info)<<24) | (uint64_t(symbol.other)<<16) |
+            (symbol.hasValue) | (symbol.onceDefined<<1) | (symbol.base<<2) |
+            (symbol.snapshot<<3) | (symbol.regRange<<4) | (symbol.detached<<5) |
+            (symbol.withUnevalExpr<<6) | ((symbol.expression!=nullptr)<<7));
+}
+
+// hash definition of macro (arguments and content)
+static uint64_t hashMacro(const AsmMacro& macro)
+{
+    uint64_t hash = hashInitValue;
+    for (size_t i = 0; i < macro.getArgsNum(); i++)
+    {
+        const AsmMacroArg& arg = macro.getArg(i);
+        hash = hashString(hash, arg.name);
+        hash = hashString(hash, arg.defaultValue);
+        hash = hashValue(hash, arg.vararg | (arg.required<<1));
+    }
+    const std::vector<char>& content = macro.getContent();
+    return hashBytes(hash, content.data(), content.size());
+}
+
+// maximal number of entries for this same file and settings
+static const size_t maxIncludeCacheVariants = 8;
+
+AsmIncludeCache::AsmIncludeCache() : entriesNum(0), hitsNum(0), missesNum(0)
+{ }
+
+AsmIncludeCache::~AsmIncludeCache()
+{ }
+
+void AsmIncludeCache::clear()
+{
+    entries.clear();
+    entriesNum = hitsNum = missesNum = 0;
+}
+
+// hash settings and numbers of objects (sections, kernels, scopes, clauses)
+uint64_t Assembler::hashIncludeSettings() const
+{
+    uint64_t hash = hashInitValue;
+    hash = hashValue(hash, uint64_t(format) | (uint64_t(deviceType)<<8) |
+            (uint64_t(_64bit)<<16) | (uint64_t(newROCmBinFormat)<<17) |
+            (uint64_t(llvm10BinFormat)<<18) | (uint64_t(rocmMetadataV3)<<19) |
+            (uint64_t(alternateMacro)<<20) | (uint64_t(buggyFPLit)<<21) |
+            (uint64_t(macroCase)<<22) | (uint64_t(oldModParam)<<23) |
+            (uint64_t(formatHandler!=nullptr)<<24) | (uint64_t(policyVersion)<<32));
+    hash = hashValue(hash, driverVersion | (uint64_t(llvmVersion)<<32));
+    hash = hashValue(hash, occupancyTarget);
+    hash = hashValue(hash, flags | (uint64_t(codeFlags)<<32));
+    // current section and kernel are set after initializing format handler
+    if (formatHandler != nullptr)
+        hash = hashValue(hash, currentSection | (uint64_t(currentKernel)<<32));
+    hash = hashValue(hash, sections.size());
+    hash = hashValue(hash, kernels.size());
+    hash = hashValue(hash, clauses.size());
+    hash = hashValue(hash, scopeStack.size());
+    hash = hashValue(hash, globalScope.scopeMap.size());
+    hash = hashValue(hash, globalScope.regVarMap.size());
+    hash = hashValue(hash, symbolClones.size());
+    hash = hashValue(hash, symbolSnapshots.size());
+    hash = hashValue(hash, unevalExpressions.size());
+    hash = hashValue(hash, relocations.size());
+    hash = hashValue(hash, localCount);
+    for (const CString& incDir: includeDirs)
+        hash = hashString(hash, incDir);
+    return hash;
+}
+
+void Assembler::useIncludeSymbolInt(const AsmSymbolName& name,
+                const AsmSymbolEntry* entry)
+{
+    if (entry == nullptr)
+    {
+        for (IncludeSnapshot& snapshot: includeSnapshots)
+            snapshot.usedMissingSymbols.insert(CString(name.name, name.length));
+        return;
+    }
+    bool hashed = false;
+    uint64_t stateHash = 0;
+    for (IncludeSnapshot& snapshot: includeSnapshots)
+    {
+        auto res = snapshot.usedSymbols.insert(std::make_pair(entry, uint64_t(0)));
+        if (!res.second)
+            continue; // already used
+        if (!hashed)
+        {
+            stateHash = hashSymbol(*entry);
+            hashed = true;
+        }
+        res.first->second = stateHash;
+    }
+}
+
+void Assembler::useIncludeMacroInt(const CString& name)
+{
+    AsmMacroMap::const_iterator it = macroMap.end();
+    bool found = false;
+    for (IncludeSnapshot& snapshot: includeSnapshots)
+    {
+        if (snapshot.usedMacros.find(name) != snapshot.usedMacros.end())
+            continue; // already used
+        if (!found)
+        {
+            it = macroMap.find(name);
+            found = true;
+        }
+        snapshot.usedMacros.insert(std::make_pair(name, (it != macroMap.end()) ?
+                    it->second : RefPtr<const AsmMacro>()));
+    }
+}
+
+// check whether used symbols, macros and nested included files are unchanged
+bool Assembler::checkIncludeCacheEntry(const AsmIncludeCache::Entry& entry) const
+{
+    for (const AsmIncludeCache::SymbolDep& dep: entry.symbolDeps)
+    {
+        AsmSymbolMap::const_iterator it = globalScope.symbolMap.find(dep.name);
+        if (dep.exists != (it != globalScope.symbolMap.end()) ||
+            (dep.exists && hashSymbol(*it) != dep.stateHash))
+            return false;
+    }
+    for (const AsmIncludeCache::MacroDep& dep: entry.macroDeps)
+    {
+        AsmMacroMap::const_iterator it = macroMap.find(dep.name);
+        if (!dep.macro)
+        {
+            if (it != macroMap.end())
+                return false;
+        }
+        // macro can be defined again by other assembler (compare definitions)
+        else if (it == macroMap.end() || (it->second != dep.macro &&
+                hashMacro(*it->second.get()) != dep.macroHash))
+            return false;
+    }
+    if (entry.macroCountUsed && entry.macroCount != macroCount)
+        return false;
+    // check whether nested included files has been changed
+    for (const AsmFileDependency& dep: entry.dependencies)
+        try
+        {
+            if (dep.missing)
+            {
+                // new file would be included instead of previously found file
+                if (isFileExists(dep.path.c_str()))
+                    return false;
+            }
+            else if (hashIncludeFile(dep.path) != dep.contentHash)
+                return false;
+        }
+        catch(const Exception& ex)
+        { return false; }
+    return true;
+}
+
+bool Assembler::restoreIncludeFromCache(const std::string& filename,
+                uint64_t contentHash, uint64_t settingsHash)
+{
+    auto it = includeCache->entries.find(std::make_pair(filename, settingsHash));
+    if (it == includeCache->entries.end())
+        return false;
+    const AsmIncludeCache::Entry* foundEntry = nullptr;
+    for (const AsmIncludeCache::Entry& entry: it->second)
+        if (entry.contentHash == contentHash && checkIncludeCacheEntry(entry))
+        {
+            foundEntry = &entry;
+            break;
+        }
+    if (foundEntry == nullptr)
+        return false;
+    const AsmIncludeCache::Entry& entry = *foundEntry;
+    
+    // this file and its nested files are dependencies of all currently included files
+    for (IncludeSnapshot& snapshot: includeSnapshots)
+    {
+        snapshot.dependencies.push_back({ filename, true, contentHash, false });
+        snapshot.dependencies.insert(snapshot.dependencies.end(),
+                    entry.dependencies.begin(), entry.dependencies.end());
+    }
+    // symbols and macros used by this file are used by all currently included files
+    for (const AsmIncludeCache::SymbolDep& dep: entry.symbolDeps)
+    {
+        const AsmSymbolName symName(dep.name);
+        useIncludeSymbol(symName, dep.exists ? &*globalScope.symbolMap.find(symName) :
+                    nullptr);
+    }
+    for (const AsmIncludeCache::MacroDep& dep: entry.macroDeps)
+        useIncludeMacro(dep.name);
+    if (entry.macroCountUsed)
+        useIncludeMacroCount();
+    // nested files are not opened, but they are read by assembler
+    if (trackFileDeps)
+        fileDependencies.insert(fileDependencies.end(), entry.dependencies.begin(),
+                    entry.dependencies.end());
+    
+    for (const auto& symEntry: entry.symbols)
+        addIncludeSymbol(&*globalScope.symbolMap.insert(
+                    AsmSymbolName(symEntry.first), symEntry.second).first);
+    for (const auto& macroEntry: entry.macros)
+        if (macroEntry.second)
+            macroMap[macroEntry.first] = macroEntry.second;
+        else // macro removed by included file
+            macroMap.erase(macroEntry.first);
+    macroCount += entry.macroCountDelta;
+    includeCache->hitsNum++;
+    return true;
+}
+
+void Assembler::beginIncludeSnapshot(const std::string& filename, uint64_t contentHash,
+                uint64_t settingsHash, AsmInputFilter* filter)
+{
+    includeCache->missesNum++;
+    // this file is dependency of all currently included files
+    for (IncludeSnapshot& snapshot: includeSnapshots)
+        snapshot.dependencies.push_back({ filename, true, contentHash, false });
+    
+    IncludeSnapshot snapshot;
+    snapshot.filter = filter;
+    snapshot.path = filename;
+    snapshot.contentHash = contentHash;
+    snapshot.settingsHash = settingsHash;
+    snapshot.cacheable = good;
+    snapshot.macroCountUsed = false;
+    snapshot.macroCount = macroCount;
+    includeSnapshots.push_back(std::move(snapshot));
+}
+
+void Assembler::endIncludeSnapshot()
+{
+    IncludeSnapshot snapshot = std::move(includeSnapshots.back());
+    includeSnapshots.pop_back();
+    if (!snapshot.cacheable || !good || hashIncludeSettings() != snapshot.settingsHash)
+        return;
+    
+    AsmIncludeCache::Entry entry;
+    entry.contentHash = snapshot.contentHash;
+    entry.dependencies = std::move(snapshot.dependencies);
+    entry.macroCountUsed = snapshot.macroCountUsed;
+    entry.macroCount = snapshot.macroCount;
+    entry.macroCountDelta = macroCount - snapshot.macroCount;
+    
+    // included file can only add new symbols (used old symbols must be unchanged)
+    const std::unordered_set<const AsmSymbolEntry*> newSymbolSet(
+                snapshot.newSymbols.begin(), snapshot.newSymbols.end());
+    for (const auto& used: snapshot.usedSymbols)
+    {
+        if (newSymbolSet.find(used.first) != newSymbolSet.end())
+            continue;
+        if (hashSymbol(*used.first) != used.second)
+            return; // symbol changed by included file
+        entry.symbolDeps.push_back({ used.first->first, true, used.second });
+    }
+    for (const AsmSymbolEntry* symEntry: snapshot.newSymbols)
+    {
+        const AsmSymbol& symbol = symEntry->second;
+        if (symbol.expression != nullptr || !symbol.occurrencesInExprs.empty() ||
+            symbol.base || symbol.snapshot || symbol.regRange || symbol.detached ||
+            symbol.withUnevalExpr)
+            return; // symbol depends on unresolved symbols
+        // new symbol must not exist before inclusion
+        snapshot.usedMissingSymbols.insert(symEntry->first);
+        // copy only value (without occurrences)
+        AsmSymbol newSymbol(symbol.sectionId, symbol.value, symbol.onceDefined);
+        newSymbol.hasValue = symbol.hasValue;
+        newSymbol.info = symbol.info;
+        newSymbol.other = symbol.other;
+        newSymbol.size = symbol.size;
+        entry.symbols.push_back(std::make_pair(symEntry->first, newSymbol));
+    }
+    for (const CString& name: snapshot.usedMissingSymbols)
+        entry.symbolDeps.push_back({ name, false, 0 });
+    
+    for (const auto& used: snapshot.usedMacros)
+    {
+        AsmMacroMap::const_iterator it = macroMap.find(used.first);
+        RefPtr<const AsmMacro> macro = (it != macroMap.end()) ? it->second :
+                    RefPtr<const AsmMacro>();
+        entry.macroDeps.push_back({ used.first, used.second,
+                    used.second ? hashMacro(*used.second.get()) : 0 });
+        if (macro != used.second)
+            entry.macros.push_back(std::make_pair(used.first, macro));
+    }
+    
+    std::vector<AsmIncludeCache::Entry>& variants = includeCache->entries[
+                std::make_pair(snapshot.path, snapshot.settingsHash)];
+    if (variants.size() == maxIncludeCacheVariants)
+    {
+        // remove oldest entry
+        variants.erase(variants.begin());
+        includeCache->entriesNum--;
+    }
+    variants.push_back(std::move(entry));
+    includeCache->entriesNum++;
+}
@@ -326,6 +326,8 @@ struct CLRX_INTERNAL AsmPseudoOps: AsmParseUtils
     static void doEnum(Assembler& asmr, const char* linePtr);
     // set policy version
     static void setPolicyVersion(Assembler& asmr, const char* linePtr);
+    // set occupancy target for register allocation
+    static void setOccupancyTarget(Assembler& asmr, const char* linePtr);
     
     static void ignoreString(Assembler& asmr, const char* linePtr);
     
@@ -380,6 +382,11 @@ struct CLRX_INTERNAL AsmKcodePseudoOps : AsmParseUtils
 
 extern CLRX_INTERNAL cxbyte cstrtobyte(const char*& str, const char* end);
 
+// hash of content of included file (for include cache and file dependencies)
+// regular is set to false if file is pipe or device (then content is not hashed)
+extern CLRX_INTERNAL uint64_t hashIncludeFile(const std::string& filename,
+                bool* regular = nullptr);
+
 extern const cxbyte tokenCharTable[96] CLRX_INTERNAL;
 
 };
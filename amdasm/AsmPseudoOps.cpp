@@ -113,7 +113,7 @@ static const char* pseudoOpNamesTbl[] =
     "line", "ln", "local", "long",
     "macro", "macrocase", "main", "noaltmacro",
     "nobuggyfplit", "nomacrocase", "nooldmodparam",
-    "nowave32", "octa", "offset", "oldmodparam", "org",
+    "nowave32", "occupancy", "octa", "offset", "oldmodparam", "org",
     "p2align", "policy", "print", "purgem", "quad",
     "rawcode", "regvar", "rept", "rocm", "rodata",
     "rvlin", "rvlin_once", "sbttl", "scope", "section", "set",
@@ -156,7 +156,7 @@ enum
     ASMOP_LINE, ASMOP_LN, ASMOP_LOCAL, ASMOP_LONG,
     ASMOP_MACRO, ASMOP_MACROCASE, ASMOP_MAIN, ASMOP_NOALTMACRO,
     ASMOP_NOBUGGYFPLIT, ASMOP_NOMACROCASE, ASMOP_NOOLDMODPARAM,
-    ASMOP_NOWAVE32, ASMOP_OCTA, ASMOP_OFFSET, ASMOP_OLDMODPARAM, ASMOP_ORG,
+    ASMOP_NOWAVE32, ASMOP_OCCUPANCY, ASMOP_OCTA, ASMOP_OFFSET, ASMOP_OLDMODPARAM, ASMOP_ORG,
     ASMOP_P2ALIGN, ASMOP_POLICY, ASMOP_PRINT, ASMOP_PURGEM, ASMOP_QUAD,
     ASMOP_RAWCODE, ASMOP_REGVAR, ASMOP_REPT, ASMOP_ROCM, ASMOP_RODATA,
     ASMOP_RVLIN, ASMOP_RVLIN_ONCE, ASMOP_SBTTL, ASMOP_SCOPE, ASMOP_SECTION, ASMOP_SET,
@@ -195,12 +195,52 @@ bool AsmPseudoOps::checkPseudoOpName(const CString& string)
 };
 
 
-void Assembler::parsePseudoOps(const CString& firstName,
-       const char* stmtPlace, const char* linePtr)
+// returns true if pseudo-op only declares macros or symbols
+// (results of included files with these pseudo-ops can be cached)
+static bool isDeclarativePseudoOp(size_t pseudoOp)
 {
-    const size_t pseudoOp = binaryFind(pseudoOpNamesTbl, pseudoOpNamesTbl +
+    if ((pseudoOp >= ASMOP_ELSE && pseudoOp <= ASMOP_ELSEIFNOTDEF) ||
+        (pseudoOp >= ASMOP_IF && pseudoOp <= ASMOP_IFNOTDEF) ||
+        (pseudoOp >= ASMOP_GET_64BIT && pseudoOp <= ASMOP_GET_VERSION))
+        return true;
+    switch(pseudoOp)
+    {
+        case ASMOP_ENDIF:
+        case ASMOP_ENDM:
+        case ASMOP_ENDMACRO:
+        case ASMOP_ENDR:
+        case ASMOP_ENDREPT:
+        case ASMOP_EQU:
+        case ASMOP_EQUIV:
+        case ASMOP_EQV:
+        case ASMOP_FOR:
+        case ASMOP_INCLUDE:
+        case ASMOP_IRP:
+        case ASMOP_IRPC:
+        case ASMOP_MACRO:
+        case ASMOP_PURGEM:
+        case ASMOP_REPT:
+        case ASMOP_SET:
+        case ASMOP_UNDEF:
+        case ASMOP_WHILE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t Assembler::findPseudoOp(const CString& firstName) const
+{
+    return binaryFind(pseudoOpNamesTbl, pseudoOpNamesTbl +
                     sizeof(pseudoOpNamesTbl)/sizeof(char*), firstName.c_str()+1,
                    CStringLess()) - pseudoOpNamesTbl;
+}
+
+void Assembler::parsePseudoOps(const CString& firstName, size_t pseudoOp,
+       const char* stmtPlace, const char* linePtr)
+{
+    if (!includeSnapshots.empty() && !isDeclarativePseudoOp(pseudoOp))
+        taintIncludeSnapshots();
     
     switch(pseudoOp)
     {
@@ -622,6 +662,9 @@ void Assembler::parsePseudoOps(const CString& firstName,
         case ASMOP_OCTA:
             AsmPseudoOps::putUInt128s(*this, stmtPlace, linePtr);
             break;
+        case ASMOP_OCCUPANCY:
+            AsmPseudoOps::setOccupancyTarget(*this, linePtr);
+            break;
         case ASMOP_OFFSET:
             AsmPseudoOps::setAbsoluteOffset(*this, linePtr);
             break;
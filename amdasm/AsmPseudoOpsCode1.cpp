@@ -311,7 +311,10 @@ void AsmPseudoOps::includeFile(Assembler& asmr, const char* pseudoOpPlace,
             return;
         }
         catch(const Exception& ex)
-        { failedOpen = true; }
+        {
+            failedOpen = true;
+            asmr.addMissingIncludePath(sysfilename);
+        }
         
         // find in include paths
         for (const CString& incDir: asmr.includeDirs)
@@ -320,14 +323,18 @@ void AsmPseudoOps::includeFile(Assembler& asmr, const char* pseudoOpPlace,
             std::string incDirPath(incDir.c_str());
             // convert path to system path (with system dir separators)
             filesystemPath(incDirPath);
+            const std::string filePath = joinPaths(std::string(incDirPath.c_str()),
+                        sysfilename);
             try
             {
-                asmr.includeFile(pseudoOpPlace, joinPaths(
-                            std::string(incDirPath.c_str()), sysfilename));
+                asmr.includeFile(pseudoOpPlace, filePath);
                 break;
             }
             catch(const Exception& ex)
-            { failedOpen = true; }
+            {
+                failedOpen = true;
+                asmr.addMissingIncludePath(filePath);
+            }
         }
         // if not found
         if (failedOpen)
@@ -396,18 +403,22 @@ void AsmPseudoOps::includeBinFile(Assembler& asmr, const char* pseudoOpPlace,
     std::ifstream ifs;
     sysfilename = filename;
     filesystemPath(sysfilename);
+    std::string filePath = sysfilename;
     // try in this directory
     ifs.open(sysfilename.c_str(), std::ios::binary);
     if (!ifs)
     {
+        asmr.addMissingIncludePath(sysfilename);
         // find in include paths
         for (const CString& incDir: asmr.includeDirs)
         {
             std::string incDirPath(incDir.c_str());
             filesystemPath(incDirPath);
-            ifs.open(joinPaths(incDirPath.c_str(), sysfilename).c_str(), std::ios::binary);
+            filePath = joinPaths(incDirPath.c_str(), sysfilename);
+            ifs.open(filePath.c_str(), std::ios::binary);
             if (ifs)
                 break;
+            asmr.addMissingIncludePath(filePath);
         }
     }
     if (!ifs)
@@ -425,6 +436,18 @@ void AsmPseudoOps::includeBinFile(Assembler& asmr, const char* pseudoOpPlace,
         ifs.clear();
     }
     ifs.exceptions(std::ios::badbit);  // exceptions for reading
+    if (asmr.trackFileDeps)
+    {
+        // whole content of regular file is hashed (pipes are not hashed)
+        bool regular = false;
+        uint64_t contentHash = 0;
+        if (seekingIsWorking)
+            try
+            { contentHash = hashIncludeFile(filePath, &regular); }
+            catch(const Exception& ex)
+            { regular = false; }
+        asmr.fileDependencies.push_back({ filePath, regular, contentHash, false });
+    }
     if (seekingIsWorking)
     {
         /* for regular files */
@@ -1558,6 +1581,7 @@ void AsmPseudoOps::doMacro(Assembler& asmr, const char* pseudoOpPlace, const cha
     bool good = true;
     bool haveVarArg = false;
     
+    asmr.useIncludeMacro(macroName);
     if (asmr.macroMap.find(macroName) != asmr.macroMap.end())
         ASM_NOTGOOD_BY_ERROR(macroNamePlace, (std::string("Macro '") + macroName.c_str() +
                 "' is already defined").c_str())
@@ -1654,6 +1678,7 @@ void AsmPseudoOps::doMacro(Assembler& asmr, const char* pseudoOpPlace, const cha
         asmr.pushClause(pseudoOpPlace, AsmClauseType::MACRO);
         if (!asmr.putMacroContent(macro.constCast<AsmMacro>()))
             return;
+        macro.constCast<AsmMacro>()->compile();
         asmr.macroMap.insert(std::make_pair(std::move(macroName), std::move(macro)));
     }
 }
@@ -1880,6 +1905,7 @@ void AsmPseudoOps::purgeMacro(Assembler& asmr, const char* linePtr)
     if (asmr.macroCase)
         toLowerString(macroName); // macro name is lowered
     
+    asmr.useIncludeMacro(macroName);
     if (!asmr.macroMap.erase(macroName))
         asmr.printWarning(macroNamePlace, (std::string("Macro '")+macroName.c_str()+
                 "' already doesn't exist").c_str());
@@ -2267,6 +2293,24 @@ void AsmPseudoOps::setPolicyVersion(Assembler& asmr, const char* linePtr)
     asmr.setPolicyVersion(value);
 }
 
+void AsmPseudoOps::setOccupancyTarget(Assembler& asmr, const char* linePtr)
+{
+    const char* end = asmr.line + asmr.lineSize;
+    skipSpacesToEnd(linePtr, end);
+    uint64_t value = 0;
+    const char* valuePlace = linePtr;
+    if (!getAbsoluteValueArg(asmr, value, linePtr, true))
+        return;
+    if (!checkGarbagesAtEnd(asmr, linePtr))
+        return;
+    
+    const cxuint maxWavesNum = getGPUMaxWavesPerSIMD(
+                getGPUArchitectureFromDeviceType(asmr.deviceType));
+    if (value > maxWavesNum)
+        ASM_RETURN_BY_ERROR(valuePlace, "Occupancy target out of range")
+    asmr.setOccupancyTarget(value);
+}
+
 void AsmPseudoOps::ignoreString(Assembler& asmr, const char* linePtr)
 {
     const char* end = asmr.line+asmr.lineSize;
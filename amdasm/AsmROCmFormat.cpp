@@ -138,8 +138,33 @@ AsmROCmHandler::AsmROCmHandler(Assembler& assembler):
              gotSection(ASMSECT_NONE), extraSectionCount(0),
              prevSymbolsCount(0), unresolvedGlobals(false), good(true)
 {
-    codeSection = 0;
     sectionDiffsResolvable = true;
+    reset();
+}
+
+AsmROCmHandler::~AsmROCmHandler()
+{
+    for (Kernel* kernel: kernelStates)
+        delete kernel;
+}
+
+void AsmROCmHandler::reset()
+{
+    resetKcodeState();
+    for (Kernel* kernel: kernelStates)
+        delete kernel;
+    kernelStates.clear();
+    sections.clear();
+    gotSymbols.clear();
+    extraSectionMap.clear();
+    binGen.reset();
+    output = ROCmInput{};
+    commentSection = metadataSection = dataSection = gotSection = ASMSECT_NONE;
+    extraSectionCount = 0;
+    prevSymbolsCount = 0;
+    unresolvedGlobals = false;
+    good = true;
+    codeSection = 0;
     output.newBinFormat = assembler.isNewROCmBinFormat();
     output.llvm10BinFormat = assembler.isLLVM10BinFormat();
     output.metadataV3Format = assembler.isROCmMetadataV3();
@@ -154,12 +179,6 @@ AsmROCmHandler::AsmROCmHandler(Assembler& assembler):
     savedSection = 0;
 }
 
-AsmROCmHandler::~AsmROCmHandler()
-{
-    for (Kernel* kernel: kernelStates)
-        delete kernel;
-}
-
 AsmKernelId AsmROCmHandler::addKernel(const char* kernelName)
 {
     AsmKernelId thisKernel = output.symbols.size();
@@ -1853,7 +1872,7 @@ void AsmROCmPseudoOps::addGotSymbol(AsmROCmHandler& handler,
     // parse symbol
     skipSpacesToEnd(linePtr, end);
     const char* symNamePlace = linePtr;
-    AsmSymbolEntry* entry;
+    AsmSymbolEntry* entry = nullptr;
     bool good = true;
     const CString symName = extractScopedSymName(linePtr, end, false);
     if (symName.empty())
@@ -1904,7 +1923,7 @@ void AsmROCmPseudoOps::addGotSymbol(AsmROCmHandler& handler,
     }
     // add GOT symbol
     size_t gotSymbolIndex = handler.gotSymbols.size();
-    handler.gotSymbols.push_back(sameSymName);
+    handler.gotSymbols.push_back(entry->first);
     
     if (handler.gotSection == ASMSECT_NONE)
     {
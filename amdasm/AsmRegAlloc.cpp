@@ -30,6 +30,12 @@
 #include <set>
 #include <unordered_map>
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <string>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/utils/Containers.h>
 #include <CLRX/amdasm/Assembler.h>
@@ -121,6 +127,20 @@ ISAUsageHandler::ReadPos ISAUsageHandler::findPositionByOffset(size_t offset) co
     return ReadPos{ chunkPos, itemPos };
 }
 
+void ISAUsageHandler::shiftOffsets(const AsmCodeShiftMap& shiftMap)
+{
+    std::vector<AsmRegVarUsage> rvus;
+    ReadPos readPos{ 0, 0 };
+    while (hasNext(readPos))
+        rvus.push_back(nextUsage(readPos));
+    // push usages again with new offsets (chunks can be changed)
+    chunks.clear();
+    for (AsmRegVarUsage& rvu: rvus)
+    {
+        rvu.offset = shiftMap.instrOffset(rvu.offset);
+        pushUsage(rvu);
+    }
+}
 
 ISALinearDepHandler::ISALinearDepHandler()
 { }
@@ -133,6 +153,12 @@ size_t ISALinearDepHandler::findPositionByOffset(size_t offset) const
             { return a.offset < b.offset; }) - regVarLinDeps.begin();
 }
 
+void ISALinearDepHandler::shiftOffsets(const AsmCodeShiftMap& shiftMap)
+{
+    for (AsmRegVarLinearDep& linearDep: regVarLinDeps)
+        linearDep.offset = shiftMap.instrOffset(linearDep.offset);
+}
+
 ISALinearDepHandler* ISALinearDepHandler::copy() const
 {
     return new ISALinearDepHandler(*this);
@@ -142,14 +168,27 @@ ISALinearDepHandler* ISALinearDepHandler::copy() const
  * Asm register allocator stuff
  */
 
-AsmRegAllocator::AsmRegAllocator(Assembler& _assembler) : assembler(_assembler)
+AsmRegAllocator::AsmRegAllocator(Assembler& _assembler) : assembler(_assembler),
+        regTypesNum(0)
 { }
 
 AsmRegAllocator::AsmRegAllocator(Assembler& _assembler,
         const std::vector<CodeBlock>& _codeBlocks, const SSAReplacesMap& _ssaReplacesMap)
-        : assembler(_assembler), codeBlocks(_codeBlocks), ssaReplacesMap(_ssaReplacesMap)
+        : assembler(_assembler), codeBlocks(_codeBlocks), ssaReplacesMap(_ssaReplacesMap),
+          regTypesNum(0)
 { }
 
+AsmRegAllocator::AsmRegAllocator(Assembler& _assembler,
+        const Array<OutLiveness>* _outLivenesses)
+        : assembler(_assembler), regTypesNum(MAX_REGTYPES_NUM)
+{
+    for (size_t i = 0; i < MAX_REGTYPES_NUM; i++)
+    {
+        outLivenesses[i] = _outLivenesses[i];
+        graphVregsCounts[i] = outLivenesses[i].size();
+    }
+}
+
 static inline bool codeBlockStartLess(const AsmRegAllocator::CodeBlock& c1,
                   const AsmRegAllocator::CodeBlock& c2)
 { return c1.start < c2.start; }
@@ -567,61 +606,123 @@ void AsmRegAllocator::applySSAReplaces()
     ssaReplacesMap.clear();
 }
 
-void AsmRegAllocator::createInterferenceGraph()
+const size_t AsmInterGraph::maxBitMatrixNodes;
+
+void AsmInterGraph::reset(size_t _nodesNum)
 {
-    /// construct liveBlockMaps
-    std::set<LiveBlock> liveBlockMaps[MAX_REGTYPES_NUM];
-    for (size_t regType = 0; regType < regTypesNum; regType++)
+    clear();
+    nodesNum = _nodesNum;
+    if (nodesNum <= maxBitMatrixNodes)
     {
-        std::set<LiveBlock>& liveBlockMap = liveBlockMaps[regType];
-        Array<OutLiveness>& liveness = outLivenesses[regType];
-        for (size_t li = 0; li < liveness.size(); li++)
+        // triangular bit-matrix, row 'i' has 'i' bits
+        rowOffsets.resize(nodesNum);
+        size_t wordsNum = 0;
+        for (size_t i = 0; i < nodesNum; i++)
         {
-            OutLiveness& lv = liveness[li];
-            for (const std::pair<size_t, size_t>& blk: lv)
-                if (blk.first != blk.second)
-                    liveBlockMap.insert({ blk.first, blk.second, li });
-            lv.clear();
+            rowOffsets[i] = wordsNum;
+            wordsNum += (i+63)>>6;
         }
-        liveness.clear();
+        bitMatrix.resize(wordsNum);
+        std::fill(bitMatrix.begin(), bitMatrix.end(), uint64_t(0));
     }
-    
-    // create interference graphs
+}
+
+void AsmInterGraph::finish()
+{
+    if (rowOffsets.empty())
+    {
+        // no bit-matrix: remove duplicates
+        std::sort(edges.begin(), edges.end());
+        edges.resize(std::unique(edges.begin(), edges.end()) - edges.begin());
+    }
+    // count degrees and create adjacency lists
+    adjOffsets.resize(nodesNum+1);
+    std::fill(adjOffsets.begin(), adjOffsets.end(), size_t(0));
+    for (const auto& edge: edges)
+    {
+        adjOffsets[edge.first+1]++;
+        adjOffsets[edge.second+1]++;
+    }
+    for (size_t i = 0; i < nodesNum; i++)
+        adjOffsets[i+1] += adjOffsets[i];
+    adjNodes.resize(edges.size()<<1);
+    Array<size_t> fillPos(adjOffsets.begin(), adjOffsets.end()-1);
+    for (const auto& edge: edges)
+    {
+        adjNodes[fillPos[edge.first]++] = edge.second;
+        adjNodes[fillPos[edge.second]++] = edge.first;
+    }
+    edges.clear();
+    edges.shrink_to_fit();
+}
+
+void AsmInterGraph::clear()
+{
+    nodesNum = 0;
+    rowOffsets.clear();
+    bitMatrix.clear();
+    edges.clear();
+    adjOffsets.clear();
+    adjNodes.clear();
+}
+
+bool AsmInterGraph::isEdge(size_t a, size_t b) const
+{
+    if (a == b)
+        return false;
+    if (a < b)
+        std::swap(a, b);
+    if (!rowOffsets.empty())
+        return ((bitMatrix[rowOffsets[a] + (b>>6)] >> (b&63)) & 1) != 0;
+    // adjacency lists are sorted if no bit-matrix
+    const Neighbors nbs = (*this)[a];
+    return std::binary_search(nbs.begin(), nbs.end(), b);
+}
+
+// create interference graph: sweep line over starts of live blocks
+static void createGraphFromLiveBlocks(std::vector<LiveBlock>& liveBlocks,
+            std::vector<LiveBlock>& activeBlocks, size_t nodesNum,
+            AsmRegAllocator::InterGraph& interGraph)
+{
+    std::sort(liveBlocks.begin(), liveBlocks.end());
+    interGraph.reset(nodesNum);
+    activeBlocks.clear();
+    for (const LiveBlock& blk: liveBlocks)
+    {
+        // remove ended live blocks and add edges to overlapping blocks
+        for (size_t i = 0; i < activeBlocks.size(); )
+            if (activeBlocks[i].end <= blk.start)
+            {
+                activeBlocks[i] = activeBlocks.back();
+                activeBlocks.pop_back();
+            }
+            else
+            {
+                if (activeBlocks[i].vidx != blk.vidx)
+                    interGraph.addEdge(activeBlocks[i].vidx, blk.vidx);
+                i++;
+            }
+        activeBlocks.push_back(blk);
+    }
+    interGraph.finish();
+}
+
+void AsmRegAllocator::createInterferenceGraph()
+{
+    std::vector<LiveBlock> liveBlocks;
+    std::vector<LiveBlock> activeBlocks;
     for (size_t regType = 0; regType < regTypesNum; regType++)
     {
-        InterGraph& interGraph = interGraphs[regType];
-        interGraph.resize(graphVregsCounts[regType]);
-        std::set<LiveBlock>& liveBlockMap = liveBlockMaps[regType];
+        /// construct live blocks (livenesses are kept for splitting live ranges)
+        liveBlocks.clear();
+        const Array<OutLiveness>& liveness = outLivenesses[regType];
+        for (size_t li = 0; li < liveness.size(); li++)
+            for (const std::pair<size_t, size_t>& blk: liveness[li])
+                if (blk.first != blk.second)
+                    liveBlocks.push_back({ blk.first, blk.second, li });
         
-        auto lit = liveBlockMap.begin();
-        size_t rangeStart = 0;
-        if (lit != liveBlockMap.end())
-            rangeStart = lit->start;
-        while (lit != liveBlockMap.end())
-        {
-            const size_t blkStart = lit->start;
-            const size_t blkEnd = lit->end;
-            size_t rangeEnd = blkEnd;
-            auto liStart = liveBlockMap.lower_bound({ rangeStart, 0, 0 });
-            auto liEnd = liveBlockMap.lower_bound({ rangeEnd, 0, 0 });
-            // collect from this range, variable indices
-            std::set<size_t> varIndices;
-            for (auto lit2 = liStart; lit2 != liEnd; ++lit2)
-                varIndices.insert(lit2->vidx);
-            // push to intergraph as full subgGraph
-            for (auto vit = varIndices.begin(); vit != varIndices.end(); ++vit)
-                for (auto vit2 = varIndices.begin(); vit2 != varIndices.end(); ++vit2)
-                    if (vit != vit2)
-                        interGraph[*vit].insert(*vit2);
-            // go to next live blocks
-            rangeStart = rangeEnd;
-            for (; lit != liveBlockMap.end(); ++lit)
-                if (lit->start != blkStart && lit->end != blkEnd)
-                    break;
-            if (lit == liveBlockMap.end())
-                break; // 
-            rangeStart = std::max(rangeStart, lit->start);
-        }
+        createGraphFromLiveBlocks(liveBlocks, activeBlocks, graphVregsCounts[regType],
+                    interGraphs[regType]);
     }
 }
 
@@ -634,94 +735,455 @@ void AsmRegAllocator::createInterferenceGraph()
  *               try to link free ends of two distinct regranges
  */
 
-void AsmRegAllocator::colorInterferenceGraph()
+/* DSatur coloring: node with highest saturation (number of distinct colors of
+ * neighbors) and highest degree is colored as first by lowest free color.
+ * forbidden colors (colors of neighbors) are stored in bitsets, and uncolored nodes
+ * are stored in buckets of saturation, hence coloring takes O(E) operations.
+ * if affinities are given, then node gets color of already colored affine node
+ * (if this color is free). returns false if colors are not enough */
+static bool colorGraphDSatur(const AsmRegAllocator::InterGraph& interGraph,
+            size_t maxColorsNum, const std::vector<size_t>& precoloredNodes,
+            Array<cxuint>& gcMap, const std::vector<std::vector<size_t> >* affinities)
 {
-    const GPUArchitecture arch = getGPUArchitectureFromDeviceType(
-                    assembler.deviceType);
+    const size_t nodesNum = interGraph.size();
+    gcMap.resize(nodesNum);
+    std::fill(gcMap.begin(), gcMap.end(), cxuint(UINT_MAX));
+    if (nodesNum == 0)
+        return true;
     
-    for (size_t regType = 0; regType < regTypesNum; regType++)
+    // order nodes by decreasing degree (counting sort)
+    size_t maxDegree = 0;
+    for (size_t i = 0; i < nodesNum; i++)
+        maxDegree = std::max(maxDegree, interGraph[i].size());
+    Array<size_t> degreePos(maxDegree+2);
+    std::fill(degreePos.begin(), degreePos.end(), size_t(0));
+    for (size_t i = 0; i < nodesNum; i++)
+        degreePos[maxDegree - interGraph[i].size() + 1]++;
+    for (size_t d = 0; d <= maxDegree; d++)
+        degreePos[d+1] += degreePos[d];
+    Array<size_t> rankNodes(nodesNum);
+    Array<size_t> nodeRanks(nodesNum);
+    for (size_t i = 0; i < nodesNum; i++)
     {
-        const size_t maxColorsNum = getGPUMaxRegistersNum(arch, regType);
-        InterGraph& interGraph = interGraphs[regType];
-        const VarIndexMap& vregIndexMap = vregIndexMaps[regType];
-        Array<cxuint>& gcMap = graphColorMaps[regType];
-        
-        const size_t nodesNum = interGraph.size();
-        gcMap.resize(nodesNum);
-        std::fill(gcMap.begin(), gcMap.end(), cxuint(UINT_MAX));
-        Array<size_t> sdoCounts(nodesNum);
-        std::fill(sdoCounts.begin(), sdoCounts.end(), 0);
-        
-        SDOLDOCompare compare(interGraph, sdoCounts);
-        std::set<size_t, SDOLDOCompare> nodeSet(compare);
-        for (size_t i = 0; i < nodesNum; i++)
-            nodeSet.insert(i);
-        
-        cxuint colorsNum = 0;
-        // firstly, allocate real registers
-        for (const auto& entry: vregIndexMap)
-            if (entry.first.regVar == nullptr)
-                gcMap[entry.second[0]] = colorsNum++;
-        
-        for (size_t colored = 0; colored < nodesNum; colored++)
+        const size_t rank = degreePos[maxDegree - interGraph[i].size()]++;
+        rankNodes[rank] = i;
+        nodeRanks[i] = rank;
+    }
+    
+    const size_t colorWordsNum = (maxColorsNum+63)>>6;
+    Array<uint64_t> forbiddenColors(nodesNum*colorWordsNum);
+    std::fill(forbiddenColors.begin(), forbiddenColors.end(), uint64_t(0));
+    Array<size_t> saturations(nodesNum);
+    std::fill(saturations.begin(), saturations.end(), size_t(0));
+    SaturationBuckets buckets(nodesNum, maxColorsNum+1);
+    bool nodesInBuckets = false;
+    
+    // set color and update forbidden colors and saturations of neighbors
+    auto setColor = [&](size_t node, cxuint color)
+    {
+        gcMap[node] = color;
+        const uint64_t mask = uint64_t(1)<<(color&63);
+        for (size_t nb: interGraph[node])
         {
-            size_t node = *nodeSet.begin();
-            if (gcMap[node] != UINT_MAX)
-                continue; // already colored
-            size_t color = 0;
-            
-            for (color = 0; color <= colorsNum; color++)
+            if (gcMap[nb] != UINT_MAX)
+                continue;
+            uint64_t& word = forbiddenColors[nb*colorWordsNum + (color>>6)];
+            if ((word & mask) != 0)
+                continue; // color already used by other neighbor
+            word |= mask;
+            if (nodesInBuckets)
             {
-                // find first usable color
-                bool thisSame = false;
-                for (size_t nb: interGraph[node])
-                    if (gcMap[nb] == color)
-                    {
-                        thisSame = true;
-                        break;
-                    }
-                if (!thisSame)
-                    break;
+                buckets.erase(saturations[nb], nodeRanks[nb]);
+                buckets.insert(saturations[nb]+1, nodeRanks[nb]);
             }
-            if (color==colorsNum) // add new color if needed
+            saturations[nb]++;
+        }
+    };
+    
+    // firstly, allocate precolored nodes (real registers)
+    cxuint colorsNum = 0;
+    for (size_t node: precoloredNodes)
+        setColor(node, colorsNum++);
+    
+    for (size_t i = 0; i < nodesNum; i++)
+        if (gcMap[i] == UINT_MAX)
+            buckets.insert(saturations[i], nodeRanks[i]);
+    nodesInBuckets = true;
+    
+    while (!buckets.empty())
+    {
+        const size_t node = rankNodes[buckets.popMax()];
+        const uint64_t* forbidden = forbiddenColors.data() + node*colorWordsNum;
+        size_t color = maxColorsNum;
+        // try color of affine node
+        if (affinities != nullptr)
+            for (size_t anode: (*affinities)[node])
             {
-                if (colorsNum >= maxColorsNum)
-                    throw AsmException("Too many register is needed");
-                colorsNum++;
+                const cxuint acolor = gcMap[anode];
+                if (acolor != UINT_MAX &&
+                    ((forbidden[acolor>>6] >> (acolor&63)) & 1) == 0)
+                {
+                    color = acolor;
+                    break;
+                }
             }
-            
-            gcMap[node] = color;
-            // update SDO for node
-            bool colorExists = false;
-            for (size_t nb: interGraph[node])
-                if (gcMap[nb] == color)
+        // find first usable color
+        if (color >= maxColorsNum)
+            for (size_t w = 0; w < colorWordsNum; w++)
+                if (forbidden[w] != UINT64_MAX)
                 {
-                    colorExists = true;
+                    color = (w<<6) + CTZ64(~forbidden[w]);
                     break;
                 }
-            if (!colorExists)
-                sdoCounts[node]++;
-            // update SDO for neighbors
-            for (size_t nb: interGraph[node])
+        if (color >= maxColorsNum)
+            return false;
+        setColor(node, color);
+    }
+    return true;
+}
+
+/* split live ranges at boundaries of the code blocks (if graph coloring failed).
+ * every live range is divided into parts (one part per code block), and then parts
+ * are joined if value flows between them and copy can not be placed:
+ * if code block have many predecessors, parts from predecessors are joined with part
+ * in this code block. if code block is called routine or return point
+ * of the call, then live range is not split.
+ * otherwise (one predecessor), copy is placed at start of code block.
+ * returns false if coloring fails also after splitting */
+bool AsmRegAllocator::splitLiveRanges(size_t regType, size_t maxColorsNum,
+            const std::vector<std::pair<uint16_t, size_t> >& realRegNodes)
+{
+    const Array<OutLiveness>& liveness = outLivenesses[regType];
+    const size_t blocksNum = codeBlocks.size();
+    const size_t vregsNum = liveness.size();
+    if (blocksNum == 0 || vregsNum == 0)
+        return false;
+    
+    // predecessors of the code blocks (without calls and returns)
+    std::vector<std::vector<size_t> > preds(blocksNum);
+    std::vector<bool> callRelated(blocksNum, false);
+    for (size_t b = 0; b < blocksNum; b++)
+    {
+        const CodeBlock& cblock = codeBlocks[b];
+        for (const NextBlock& next: cblock.nexts)
+            if (next.isCall)
+                callRelated[next.block] = true;
+            else
+                preds[next.block].push_back(b);
+        if ((cblock.nexts.empty() || cblock.haveCalls) &&
+            !cblock.haveReturn && !cblock.haveEnd && b+1 < blocksNum)
+        {
+            if (cblock.haveCalls)
+                callRelated[b+1] = true; // return point
+            preds[b+1].push_back(b);
+        }
+    }
+    
+    // divide live ranges into parts (in code blocks)
+    struct Part
+    {
+        size_t vidx;
+        size_t block;
+        size_t start, end;
+    };
+    std::vector<Part> parts;
+    std::vector<LiveBlock> liveBlocks; // vidx - part index
+    Array<size_t> vidxParts(vregsNum+1); // first part of vidx
+    for (size_t vidx = 0; vidx < vregsNum; vidx++)
+    {
+        vidxParts[vidx] = parts.size();
+        for (const std::pair<size_t, size_t>& blk: liveness[vidx])
+            for (size_t pos = blk.first; pos < blk.second; )
             {
-                colorExists = false;
-                for (size_t nb2: interGraph[nb])
-                    if (gcMap[nb2] == color)
-                    {
-                        colorExists = true;
-                        break;
-                    }
-                if (!colorExists)
+                // find code block of position
+                auto cbit = std::upper_bound(codeBlocks.begin(), codeBlocks.end(), pos,
+                        [](size_t p, const CodeBlock& c) { return p < c.start; });
+                const size_t b = (cbit != codeBlocks.begin()) ?
+                            cbit - codeBlocks.begin() - 1 : 0;
+                const size_t end = (b+1 < blocksNum) ?
+                        std::min(blk.second, std::max(codeBlocks[b+1].start, pos+1)) :
+                        blk.second;
+                if (parts.size() == vidxParts[vidx] || parts.back().block != b)
+                    parts.push_back({ vidx, b, pos, end });
+                else
+                    parts.back().end = end;
+                liveBlocks.push_back({ pos, end, parts.size()-1 });
+                pos = end;
+            }
+        if (parts.size() == vidxParts[vidx])
+            // empty live range
+            parts.push_back({ vidx, SIZE_MAX, 0, 0 });
+    }
+    vidxParts[vregsNum] = parts.size();
+    
+    // find part of vidx in code block
+    auto findPart = [&parts, &vidxParts](size_t vidx, size_t block) -> size_t
+    {
+        auto pit = std::lower_bound(parts.begin() + vidxParts[vidx],
+                    parts.begin() + vidxParts[vidx+1], block,
+                    [](const Part& p, size_t b) { return p.block < b; });
+        return (pit != parts.begin() + vidxParts[vidx+1] && pit->block == block) ?
+                pit - parts.begin() : SIZE_MAX;
+    };
+    
+    Array<size_t> partRoots(parts.size());
+    for (size_t i = 0; i < parts.size(); i++)
+        partRoots[i] = i;
+    auto findRoot = [&partRoots](size_t p) -> size_t
+    {
+        while (partRoots[p] != p)
+            p = partRoots[p] = partRoots[partRoots[p]];
+        return p;
+    };
+    auto joinParts = [&partRoots, &findRoot](size_t p1, size_t p2)
+    {
+        p1 = findRoot(p1);
+        p2 = findRoot(p2);
+        if (p1 != p2)
+            partRoots[std::max(p1, p2)] = std::min(p1, p2);
+    };
+    
+    // do not split real registers
+    std::vector<bool> noSplitVIdxes(vregsNum, false);
+    for (const auto& entry: realRegNodes)
+        noSplitVIdxes[entry.second] = true;
+    // copies: first - source part, second - destination part
+    std::vector<std::pair<size_t, size_t> > copies;
+    for (size_t pi = 0; pi < parts.size(); pi++)
+    {
+        const Part& part = parts[pi];
+        if (part.block == SIZE_MAX || part.start != codeBlocks[part.block].start)
+            continue; // not live at start of code block
+        if (callRelated[part.block])
+        {
+            noSplitVIdxes[part.vidx] = true;
+            continue;
+        }
+        const std::vector<size_t>& bpreds = preds[part.block];
+        if (bpreds.size() == 1)
+        {
+            const size_t predPart = findPart(part.vidx, bpreds[0]);
+            if (predPart != SIZE_MAX &&
+                parts[predPart].end >= codeBlocks[bpreds[0]].end)
+                copies.push_back({ predPart, pi });
+            else // value from unknown place
+                noSplitVIdxes[part.vidx] = true;
+        }
+        else
+            for (size_t pred: bpreds)
+            {
+                const size_t predPart = findPart(part.vidx, pred);
+                if (predPart != SIZE_MAX && parts[predPart].end >= codeBlocks[pred].end)
+                    joinParts(predPart, pi);
+            }
+    }
+    for (size_t vidx = 0; vidx < vregsNum; vidx++)
+        if (noSplitVIdxes[vidx])
+            for (size_t pi = vidxParts[vidx]+1; pi < vidxParts[vidx+1]; pi++)
+                joinParts(vidxParts[vidx], pi);
+    
+    // number of split groups of the parts
+    Array<size_t> partGroups(parts.size());
+    size_t groupsNum = 0;
+    for (size_t pi = 0; pi < parts.size(); pi++)
+        partGroups[pi] = (findRoot(pi) == pi) ? groupsNum++ : partGroups[findRoot(pi)];
+    if (groupsNum == vregsNum)
+        return false; // nothing to split
+    
+    // create interference graph for split groups
+    for (LiveBlock& blk: liveBlocks)
+        blk.vidx = partGroups[blk.vidx];
+    std::vector<LiveBlock> activeBlocks;
+    InterGraph splitGraph;
+    createGraphFromLiveBlocks(liveBlocks, activeBlocks, groupsNum, splitGraph);
+    liveBlocks.clear();
+    
+    std::vector<std::vector<size_t> > affinities(groupsNum);
+    for (const auto& copy: copies)
+    {
+        const size_t g1 = partGroups[copy.first];
+        const size_t g2 = partGroups[copy.second];
+        if (g1 != g2)
+        {
+            affinities[g1].push_back(g2);
+            affinities[g2].push_back(g1);
+        }
+    }
+    std::vector<size_t> precoloredNodes;
+    for (const auto& entry: realRegNodes)
+        precoloredNodes.push_back(partGroups[vidxParts[entry.second]]);
+    
+    Array<cxuint> groupColors;
+    if (!colorGraphDSatur(splitGraph, maxColorsNum, precoloredNodes, groupColors,
+                &affinities))
+        return false;
+    
+    // put colors of first parts and split ranges
+    Array<cxuint>& gcMap = graphColorMaps[regType];
+    gcMap.resize(vregsNum);
+    std::vector<SplitRange>& ranges = splitRanges[regType];
+    for (size_t vidx = 0; vidx < vregsNum; vidx++)
+    {
+        const size_t firstPart = vidxParts[vidx];
+        gcMap[vidx] = groupColors[partGroups[firstPart]];
+        bool split = false;
+        for (size_t pi = firstPart+1; pi < vidxParts[vidx+1]; pi++)
+            if (groupColors[partGroups[pi]] != gcMap[vidx])
+                split = true;
+        if (!split)
+            continue;
+        for (size_t pi = firstPart; pi < vidxParts[vidx+1]; pi++)
+        {
+            const cxuint color = groupColors[partGroups[pi]];
+            if (ranges.empty() || ranges.back().vidx != vidx ||
+                ranges.back().color != color || ranges.back().end != parts[pi].start)
+                ranges.push_back({ vidx, parts[pi].start, parts[pi].end, color });
+            else // join with previous range
+                ranges.back().end = parts[pi].end;
+        }
+    }
+    std::vector<SplitCopy>& outCopies = splitCopies[regType];
+    for (const auto& copy: copies)
+    {
+        const cxuint srcColor = groupColors[partGroups[copy.first]];
+        const cxuint dstColor = groupColors[partGroups[copy.second]];
+        if (srcColor != dstColor)
+            outCopies.push_back({ parts[copy.second].start, srcColor, dstColor });
+    }
+    std::stable_sort(outCopies.begin(), outCopies.end(),
+            [](const SplitCopy& c1, const SplitCopy& c2)
+            { return c1.offset < c2.offset; });
+    return true;
+}
+
+// create register pressure report (max live registers in code blocks)
+void AsmRegAllocator::createRegPressures()
+{
+    const size_t blocksNum = codeBlocks.size();
+    regPressures.resize(blocksNum);
+    for (size_t b = 0; b < blocksNum; b++)
+    {
+        AsmRegPressure& pressure = regPressures[b];
+        pressure.start = codeBlocks[b].start;
+        pressure.end = codeBlocks[b].end;
+        std::fill(pressure.maxLive, pressure.maxLive+MAX_REGTYPES_NUM, cxuint(0));
+    }
+    if (blocksNum == 0)
+        return;
+    
+    auto findBlock = [this](size_t pos) -> size_t
+    {
+        auto cbit = std::upper_bound(codeBlocks.begin(), codeBlocks.end(), pos,
+                    [](size_t p, const CodeBlock& c) { return p < c.start; });
+        return (cbit != codeBlocks.begin()) ? cbit - codeBlocks.begin() - 1 : 0;
+    };
+    
+    std::vector<std::pair<size_t, int> > events;
+    Array<size_t> maxPositions(blocksNum);
+    for (size_t regType = 0; regType < regTypesNum; regType++)
+    {
+        const Array<OutLiveness>& liveness = outLivenesses[regType];
+        // events: first - position, second - change of live registers number
+        events.clear();
+        for (const OutLiveness& lv: liveness)
+            for (const std::pair<size_t, size_t>& blk: lv)
+                if (blk.first != blk.second)
                 {
-                    if (gcMap[nb] == UINT_MAX)
-                        nodeSet.erase(nb);  // before update we erase from nodeSet
-                    sdoCounts[nb]++;
-                    if (gcMap[nb] == UINT_MAX)
-                        nodeSet.insert(nb); // after update, insert again
+                    events.push_back({ blk.first, 1 });
+                    events.push_back({ blk.second, -1 });
                 }
+        std::sort(events.begin(), events.end());
+        
+        std::fill(maxPositions.begin(), maxPositions.end(), size_t(SIZE_MAX));
+        cxuint liveNum = 0;
+        for (const auto& event: events)
+        {
+            liveNum += event.second;
+            if (event.second < 0)
+                continue;
+            const size_t b = findBlock(event.first);
+            if (liveNum > regPressures[b].maxLive[regType])
+            {
+                regPressures[b].maxLive[regType] = liveNum;
+                maxPositions[b] = event.first;
             }
-            
-            gcMap[node] = color;
+        }
+        
+        // svregs of vidxes
+        std::vector<AsmSingleVReg> vidxSVRegs(liveness.size(), AsmSingleVReg{});
+        for (const auto& entry: vregIndexMaps[regType])
+            for (size_t vidx: entry.second)
+                if (vidx < vidxSVRegs.size())
+                    vidxSVRegs[vidx] = entry.first;
+        // collect svregs live at points of max pressure
+        for (size_t vidx = 0; vidx < liveness.size(); vidx++)
+            for (const std::pair<size_t, size_t>& blk: liveness[vidx])
+            {
+                if (blk.first == blk.second)
+                    continue;
+                for (size_t b = findBlock(blk.first); b < blocksNum &&
+                            (b == 0 || codeBlocks[b].start < blk.second); b++)
+                    if (maxPositions[b] != SIZE_MAX && blk.first <= maxPositions[b] &&
+                        maxPositions[b] < blk.second)
+                        regPressures[b].liveSVRegs[regType].push_back(vidxSVRegs[vidx]);
+            }
+        for (AsmRegPressure& pressure: regPressures)
+        {
+            std::vector<AsmSingleVReg>& svregs = pressure.liveSVRegs[regType];
+            std::sort(svregs.begin(), svregs.end());
+            svregs.resize(std::unique(svregs.begin(), svregs.end()) - svregs.begin());
+        }
+    }
+}
+
+void AsmRegAllocator::colorInterferenceGraph()
+{
+    const GPUArchitecture arch = getGPUArchitectureFromDeviceType(
+                    assembler.deviceType);
+    
+    for (size_t regType = 0; regType < regTypesNum; regType++)
+    {
+        const size_t maxColorsNum = getGPUMaxRegistersNum(arch, regType);
+        const VarIndexMap& vregIndexMap = vregIndexMaps[regType];
+        splitRanges[regType].clear();
+        splitCopies[regType].clear();
+        
+        // firstly, allocate real registers (in registers order,
+        // because order of the unordered map is not deterministic)
+        std::vector<std::pair<uint16_t, size_t> > realRegNodes;
+        for (const auto& entry: vregIndexMap)
+            if (entry.first.regVar == nullptr)
+                realRegNodes.push_back(std::make_pair(entry.first.index,
+                            entry.second[0]));
+        std::sort(realRegNodes.begin(), realRegNodes.end());
+        std::vector<size_t> precoloredNodes;
+        for (const auto& entry: realRegNodes)
+            precoloredNodes.push_back(entry.second);
+        
+        // number of registers that allows to achieve occupancy target
+        size_t targetColorsNum = maxColorsNum;
+        if (assembler.occupancyTarget != 0 && regType <= REGTYPE_VGPR)
+        {
+            const cxuint extraRegsNum = getGPUExtraRegsNum(arch, regType, GCN_VCC);
+            const cxuint targetRegsNum = getGPUMaxRegistersNumForWaves(arch, regType,
+                        assembler.occupancyTarget);
+            targetColorsNum = std::min(maxColorsNum, size_t(targetRegsNum -
+                        std::min(targetRegsNum, extraRegsNum)));
+        }
+        // firstly, try to color graph under register budget of occupancy target
+        if (targetColorsNum < maxColorsNum && realRegNodes.size() <= targetColorsNum &&
+            (colorGraphDSatur(interGraphs[regType], targetColorsNum, precoloredNodes,
+                    graphColorMaps[regType], nullptr) ||
+             splitLiveRanges(regType, targetColorsNum, realRegNodes)))
+            continue;
+        
+        if (realRegNodes.size() > maxColorsNum ||
+            (!colorGraphDSatur(interGraphs[regType], maxColorsNum, precoloredNodes,
+                    graphColorMaps[regType], nullptr) &&
+             !splitLiveRanges(regType, maxColorsNum, realRegNodes)))
+        {
+            createRegPressures();
+            throw AsmException("Too many register is needed");
         }
     }
 }
@@ -737,8 +1199,12 @@ void AsmRegAllocator::allocateRegisters(AsmSectionId sectionId)
         interGraphs[i].clear();
         linearDepMaps[i].clear();
         graphColorMaps[i].clear();
+        splitRanges[i].clear();
+        splitCopies[i].clear();
     }
     ssaReplacesMap.clear();
+    regPressures.clear();
+    linearDepErrors.clear();
     cxuint maxRegs[MAX_REGTYPES_NUM];
     assembler.isaAssembler->getMaxRegistersNum(regTypesNum, maxRegs);
     
@@ -750,4 +1216,278 @@ void AsmRegAllocator::allocateRegisters(AsmSectionId sectionId)
     createLivenesses(*section.usageHandler, *section.linearDepHandler);
     createInterferenceGraph();
     colorInterferenceGraph();
+    // livenesses are no longer needed
+    for (size_t i = 0; i < MAX_REGTYPES_NUM; i++)
+        outLivenesses[i].clear();
+}
+
+/* find source position of instruction at code offset (source positions are collected
+ * if ASM_REGALLOC or ASM_AUTOWAIT is enabled), otherwise returns position of kernel */
+AsmSourcePos Assembler::findCodeSourcePos(const AsmSection& section, size_t offset) const
+{
+    AsmSourcePosHandler::ReadPos readPos{ 0, 0 };
+    AsmSourcePos sourcePos{};
+    bool found = false;
+    while (section.sourcePosHandler.hasNext(readPos))
+    {
+        const std::pair<size_t, AsmSourcePos> next =
+                section.sourcePosHandler.nextSourcePos(readPos);
+        if (next.first > offset)
+            break;
+        sourcePos = next.second;
+        found = true;
+    }
+    if (!found && section.kernelId != ASMKERN_GLOBAL)
+        sourcePos = kernels[section.kernelId].sourcePos;
+    return sourcePos;
+}
+
+// collect names of regvars from scope and its subscopes
+static void collectRegVarNames(const AsmScope& scope, const std::string& prefix,
+            std::unordered_map<const AsmRegVar*, std::string>& regVarNames)
+{
+    for (const auto& entry: scope.regVarMap)
+        regVarNames.insert({ &entry.second, prefix + entry.first.c_str() });
+    for (const auto& entry: scope.scopeMap)
+        collectRegVarNames(*entry.second, prefix + entry.first.c_str() + "::",
+                    regVarNames);
+}
+
+// print live registers (compressed to ranges: 'name[first:last]')
+static void printLiveSVRegs(std::ostream& os, cxuint regType, cxuint regStart,
+            const std::vector<AsmSingleVReg>& svregs,
+            const std::unordered_map<const AsmRegVar*, std::string>& regVarNames)
+{
+    // name, size (0 - real register) and index
+    std::vector<std::tuple<std::string, uint16_t, uint16_t> > regs;
+    for (const AsmSingleVReg& svreg: svregs)
+        if (svreg.regVar == nullptr)
+            regs.push_back(std::make_tuple(std::string(regType == REGTYPE_SGPR ?
+                        "s" : "v"), uint16_t(0), uint16_t(svreg.index - regStart)));
+        else
+        {
+            auto it = regVarNames.find(svreg.regVar);
+            regs.push_back(std::make_tuple(it != regVarNames.end() ? it->second :
+                        std::string("?"), svreg.regVar->size, svreg.index));
+        }
+    // sort by name (order of regvar pointers is not deterministic)
+    std::sort(regs.begin(), regs.end());
+    for (size_t i = 0; i < regs.size(); )
+    {
+        size_t j = i+1;
+        while (j < regs.size() && std::get<0>(regs[j]) == std::get<0>(regs[i]) &&
+                std::get<2>(regs[j]) == std::get<2>(regs[j-1])+1)
+            j++;
+        os << (i != 0 ? ", " : "") << std::get<0>(regs[i]);
+        const bool realReg = std::get<1>(regs[i]) == 0;
+        if (j-i > 1)
+            os << '[' << std::get<2>(regs[i]) << ':' << std::get<2>(regs[j-1]) << ']';
+        else if (realReg)
+            os << std::get<2>(regs[i]);
+        else if (std::get<1>(regs[i]) > 1)
+            os << '[' << std::get<2>(regs[i]) << ']';
+        i = j;
+    }
+}
+
+// max number of code blocks reported after failed register allocation
+static const size_t maxReportedRegPressures = 8;
+
+void Assembler::printRegPressures(const AsmSection& section,
+            const std::vector<AsmRegPressure>& regPressures)
+{
+    if (regPressures.empty())
+        return;
+    const GPUArchitecture arch = getGPUArchitectureFromDeviceType(deviceType);
+    size_t regTypesNum;
+    cxuint regRanges[MAX_REGTYPES_NUM*2];
+    isaAssembler->getRegisterRanges(regTypesNum, regRanges);
+    regTypesNum = std::min(regTypesNum, size_t(REGTYPE_VGPR+1));
+    
+    // report blocks that need too many registers
+    std::vector<size_t> blocks;
+    for (size_t b = 0; b < regPressures.size(); b++)
+        for (cxuint r = 0; r < regTypesNum; r++)
+            if (regPressures[b].maxLive[r] > getGPUMaxRegistersNum(arch, r))
+            {
+                blocks.push_back(b);
+                break;
+            }
+    if (blocks.empty())
+    {
+        // otherwise report blocks with greatest number of live registers
+        for (cxuint r = 0; r < regTypesNum; r++)
+        {
+            size_t maxBlock = 0;
+            for (size_t b = 1; b < regPressures.size(); b++)
+                if (regPressures[b].maxLive[r] > regPressures[maxBlock].maxLive[r])
+                    maxBlock = b;
+            if (regPressures[maxBlock].maxLive[r] != 0)
+                blocks.push_back(maxBlock);
+        }
+        std::sort(blocks.begin(), blocks.end());
+        blocks.resize(std::unique(blocks.begin(), blocks.end()) - blocks.begin());
+    }
+    
+    std::unordered_map<const AsmRegVar*, std::string> regVarNames;
+    collectRegVarNames(globalScope, "", regVarNames);
+    for (size_t i = 0; i < std::min(blocks.size(), maxReportedRegPressures); i++)
+    {
+        const AsmRegPressure& pressure = regPressures[blocks[i]];
+        char buf[32];
+        findCodeSourcePos(section, pressure.start).print(messageStream);
+        messageStream << ": Note: Max live registers in block ";
+        itocstrCStyle(pressure.start, buf, 32, 16);
+        messageStream << buf << '-';
+        itocstrCStyle(pressure.end, buf, 32, 16);
+        messageStream << buf << ": SGPRs: " << pressure.maxLive[REGTYPE_SGPR] <<
+                ", VGPRs: " << pressure.maxLive[REGTYPE_VGPR];
+        for (cxuint r = 0; r < regTypesNum; r++)
+            if (!pressure.liveSVRegs[r].empty())
+            {
+                messageStream << (r == REGTYPE_SGPR ? "; live SGPRs: " :
+                        "; live VGPRs: ");
+                printLiveSVRegs(messageStream, r, regRanges[r<<1],
+                        pressure.liveSVRegs[r], regVarNames);
+            }
+        messageStream << '\n';
+    }
+}
+
+void Assembler::applyRegAllocResults()
+{
+    if (formatHandler == nullptr)
+        return;
+    for (const AsmRegAllocResult& result: regAllocResults)
+    {
+        const AsmKernelId kernelId = sections[result.sectionId].kernelId;
+        if (kernelId == ASMKERN_GLOBAL)
+            // code section shared by all kernels
+            for (AsmKernelId k = 0; k < kernels.size(); k++)
+                formatHandler->updateKernelRegisters(k, result.regsNum);
+        else if (kernelId < kernels.size())
+            formatHandler->updateKernelRegisters(kernelId, result.regsNum);
+    }
+}
+
+bool Assembler::allocateRegisters(cxuint threadsNum)
+{
+    regAllocResults.clear();
+    if (isaAssembler == nullptr)
+        return good;
+    // collect code sections
+    for (AsmSectionId i = 0; i < sections.size(); i++)
+        if (sections[i].type == AsmSectionType::CODE &&
+            sections[i].usageHandler != nullptr && sections[i].getSize() != 0)
+        {
+            regAllocResults.push_back(AsmRegAllocResult());
+            regAllocResults.back().sectionId = i;
+        }
+    
+    const size_t sectionsNum = regAllocResults.size();
+    if (sectionsNum == 0)
+        return good;
+    std::unique_ptr<std::exception_ptr[]> sectionErrors(
+                new std::exception_ptr[sectionsNum]);
+    const AsmWaitConfig& waitConfig = isaAssembler->getWaitConfig();
+    const GPUArchitecture arch = getGPUArchitectureFromDeviceType(deviceType);
+    cxuint regRanges[MAX_REGTYPES_NUM*2];
+    size_t regTypesNum;
+    isaAssembler->getRegisterRanges(regTypesNum, regRanges);
+    const cxuint maxSGPRsNum = getGPUMaxRegistersNum(arch, REGTYPE_SGPR);
+    
+    if (threadsNum == 0)
+        threadsNum = std::max(std::thread::hardware_concurrency(), 1U);
+    threadsNum = std::min(size_t(threadsNum), sectionsNum);
+    std::atomic<size_t> nextSection(0);
+    auto worker = [&]()
+    {
+        size_t i;
+        while ((i = nextSection.fetch_add(1)) < sectionsNum)
+        {
+            // every section has own register allocator and wait scheduler
+            AsmRegAllocResult& result = regAllocResults[i];
+            AsmRegAllocator regAlloc(*this);
+            try
+            {
+                AsmSection& section = sections[result.sectionId];
+                regAlloc.allocateRegisters(result.sectionId);
+                AsmWaitScheduler waitScheduler(waitConfig, *this,
+                        regAlloc.getCodeBlocks(), regAlloc.getVregIndexMaps(),
+                        regAlloc.getGraphColorMaps(), regAlloc.getSplitRanges());
+                waitScheduler.schedule(*section.usageHandler, *section.waitHandler);
+                for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+                {
+                    result.vregIndexMaps[r] = regAlloc.getVregIndexMaps()[r];
+                    result.graphColorMaps[r] = regAlloc.getGraphColorMaps()[r];
+                    result.splitRanges[r] = regAlloc.getSplitRanges()[r];
+                    result.splitCopies[r] = regAlloc.getSplitCopies()[r];
+                    // number of registers is greatest color + 1
+                    result.regsNum[r] = 0;
+                    for (cxuint color: result.graphColorMaps[r])
+                        result.regsNum[r] = std::max(result.regsNum[r], color+1);
+                    if (r >= regTypesNum)
+                        continue;
+                    /* operands are not rewritten to allocated registers, hence
+                     * registers encoded in code are counted (like by ISA assembler) */
+                    for (const auto& entry: result.vregIndexMaps[r])
+                        if (entry.first.regVar == nullptr)
+                        {
+                            const cxuint reg = entry.first.index - regRanges[2*r];
+                            if (r != REGTYPE_SGPR)
+                                result.regsNum[r] = std::max(result.regsNum[r], reg+1);
+                            else if (reg < maxSGPRsNum) // not special register
+                                result.regsNum[r] = std::max(result.regsNum[r],
+                                        std::min(reg+1, maxSGPRsNum-2));
+                        }
+                }
+                // occupancy (extra registers like VCC are counted)
+                result.wavesPerSIMD = getGPUWavesPerSIMD(arch,
+                        result.regsNum[REGTYPE_SGPR] +
+                        getGPUExtraRegsNum(arch, REGTYPE_SGPR, GCN_VCC),
+                        result.regsNum[REGTYPE_VGPR]);
+                result.waitInstrs = waitScheduler.getNeededWaitInstrs();
+            }
+            catch(...)
+            {
+                sectionErrors[i] = std::current_exception();
+                // report register pressure (if allocation failed)
+                result.regPressures = regAlloc.getRegPressures();
+            }
+            // errors are printed by calling thread
+            result.linearDepErrors = regAlloc.getLinearDepErrors();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (cxuint i = 1; i < threadsNum; i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (std::thread& thread: threads)
+        thread.join();
+    
+    // print errors in sections order (like in sequential processing)
+    for (size_t i = 0; i < sectionsNum; i++)
+    {
+        const AsmSection& section = sections[regAllocResults[i].sectionId];
+        for (size_t offset: regAllocResults[i].linearDepErrors)
+            printError(findCodeSourcePos(section, offset), "Linear deps failed");
+        if (sectionErrors[i])
+            try
+            { std::rethrow_exception(sectionErrors[i]); }
+            catch(const std::exception& ex)
+            {
+                if (section.kernelId != ASMKERN_GLOBAL)
+                {
+                    // print position of kernel
+                    kernels[section.kernelId].sourcePos.print(messageStream);
+                    messageStream << ": ";
+                }
+                messageStream << "Error: Register allocation in section '" <<
+                        (section.name != nullptr ? section.name : "") << "': " <<
+                        ex.what() << '\n';
+                good = false;
+                printRegPressures(section, regAllocResults[i].regPressures);
+            }
+    }
+    return good;
 }
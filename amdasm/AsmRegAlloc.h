@@ -27,6 +27,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
+#include <memory>
 #include <algorithm>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/utils/Containers.h>
@@ -233,10 +234,27 @@ struct CLRX_INTERNAL LastVRegStackPos
     bool inSubroutines; // true if last access in some called subroutine
 };
 
-typedef std::unordered_map<AsmSingleVReg, VectorSet<LastAccessBlockPos> > LastAccessMap;
-typedef std::unordered_map<AsmSingleVReg, LastAccessBlockPos> RoutineCurAccessMap;
+/* createLivenesses uses dense numbering of the single vregs (svreg ids, ordered like
+ * svregs), hence all maps keyed by svreg are vectors indexed by svreg id
+ * or vectors of pairs (svreg id, value) */
+
+// key - svreg id, value - list of the last codeblocks where is svreg (sorted by key)
+typedef std::vector<std::pair<size_t, VectorSet<LastAccessBlockPos> > > LastAccessMap;
+
+// key - svreg id, value - ssaId (used by caches of joins and as rbw map of routines)
+class CLRX_INTERNAL SVIdSSAIdMap: public std::vector<std::pair<size_t, size_t> >
+{
+public:
+    SVIdSSAIdMap()
+    { }
+    
+    size_t weight() const
+    { return size(); }
+};
+
+// key - svreg id, value - last position in flowStack (used by cache of joins)
 class CLRX_INTERNAL LastStackPosMap
-        : public std::unordered_map<AsmSingleVReg, LastVRegStackPos>
+        : public std::vector<std::pair<size_t, LastVRegStackPos> >
 {
 public:
     LastStackPosMap()
@@ -250,14 +268,15 @@ public:
 // last access of the svregs
 struct CLRX_INTERNAL RoutineDataLv
 {
-    SVRegMap rbwSSAIdMap;
-    // holds all vreg SSA's used in routine (used while creating call point)
-    // includes subroutines called in this routines
-    std::unordered_set<size_t> allSSAs[MAX_REGTYPES_NUM];
-    // key - svreg, value - list of the last codeblocks where is svreg
+    // key - svreg id, value - ssaId of first read before write (sorted by key)
+    SVIdSSAIdMap rbwSSAIdMap;
+    // key - svreg id, value - list of the last codeblocks where is svreg
     LastAccessMap lastAccessMap;
     std::unordered_set<size_t> haveReturnBlocks;
     bool fromSecondPass;
+    
+    RoutineDataLv() : fromSecondPass(false)
+    { }
 };
 
 // used by createSSAData
@@ -293,7 +312,8 @@ struct CLRX_INTERNAL FlowStackEntry4
     size_t nextIndex;
     bool isCall;
     bool haveReturn;
-    RoutineCurAccessMap prevCurSVRegMap;
+    // previous current accesses of svregs (svreg id, access) to revert
+    std::vector<std::pair<size_t, LastAccessBlockPos> > prevCurSVRegs;
 };
 
 struct CLRX_INTERNAL CallStackEntry
@@ -304,7 +324,8 @@ struct CLRX_INTERNAL CallStackEntry
 };
 
 typedef std::unordered_map<BlockIndex, RoutineData> RoutineMap;
-typedef std::unordered_map<BlockIndex, RoutineDataLv> RoutineLvMap;
+// index - routine block, value - routine data (or null)
+typedef std::vector<std::unique_ptr<RoutineDataLv> > RoutineLvMap;
 
 typedef std::unordered_map<size_t, std::pair<size_t, size_t> > PrevWaysIndexMap;
 
@@ -430,8 +451,8 @@ typedef AsmRegAllocator::VarIndexMap VarIndexMap;
 
 typedef std::deque<FlowStackEntry3>::const_iterator FlowStackCIter;
 
-// key - singlevreg, value - code block chain
-typedef std::unordered_map<AsmSingleVReg, std::vector<LastVRegStackPos> > LastVRegMap;
+// index - svreg id, value - code block chain
+typedef std::vector<std::vector<LastVRegStackPos> > LastVRegMap;
 
 struct CLRX_INTERNAL LiveBlock
 {
@@ -452,20 +473,66 @@ typedef std::unordered_map<size_t, LinearDep> LinearDepMap;
 
 typedef AsmRegAllocator::InterGraph InterGraph;
 
-struct CLRX_INTERNAL SDOLDOCompare
+/* uncolored nodes for DSatur coloring: one bucket for every saturation degree.
+ * bucket is two-level bitset of node ranks (nodes ordered by decreasing degree),
+ * hence lowest rank in highest bucket is node with highest saturation and degree */
+class CLRX_INTERNAL SaturationBuckets
 {
-    const InterGraph& interGraph;
-    const Array<size_t>& sdoCounts;
+private:
+    size_t wordsNum;    // words of bucket
+    size_t sumWordsNum; // summary words of bucket (bit per word)
+    Array<uint64_t> words;
+    Array<uint64_t> sumWords;
+    size_t maxBucket;   // highest non-empty bucket (or higher)
+    size_t count;
+public:
+    SaturationBuckets(size_t ranksNum, size_t bucketsNum)
+        : wordsNum((ranksNum+63)>>6), sumWordsNum((wordsNum+63)>>6),
+          words(wordsNum*bucketsNum), sumWords(sumWordsNum*bucketsNum),
+          maxBucket(0), count(0)
+    {
+        std::fill(words.begin(), words.end(), uint64_t(0));
+        std::fill(sumWords.begin(), sumWords.end(), uint64_t(0));
+    }
     
-    SDOLDOCompare(const InterGraph& _interGraph, const Array<size_t>&_sdoCounts)
-        : interGraph(_interGraph), sdoCounts(_sdoCounts)
-    { }
+    bool empty() const
+    { return count==0; }
     
-    bool operator()(size_t a, size_t b) const
+    void insert(size_t bucket, size_t rank)
     {
-        if (sdoCounts[a] > sdoCounts[b])
-            return true;
-        return interGraph[a].size() > interGraph[b].size();
+        const size_t w = bucket*wordsNum + (rank>>6);
+        words[w] |= uint64_t(1)<<(rank&63);
+        sumWords[bucket*sumWordsNum + (rank>>12)] |= uint64_t(1)<<((rank>>6)&63);
+        maxBucket = std::max(maxBucket, bucket);
+        count++;
+    }
+    
+    void erase(size_t bucket, size_t rank)
+    {
+        const size_t w = bucket*wordsNum + (rank>>6);
+        words[w] &= ~(uint64_t(1)<<(rank&63));
+        if (words[w] == 0)
+            sumWords[bucket*sumWordsNum + (rank>>12)] &= ~(uint64_t(1)<<((rank>>6)&63));
+        count--;
+    }
+    
+    // remove and return lowest rank from highest bucket (must not be empty)
+    size_t popMax()
+    {
+        while (true)
+        {
+            const uint64_t* sumBucket = sumWords.data() + maxBucket*sumWordsNum;
+            for (size_t sw = 0; sw < sumWordsNum; sw++)
+                if (sumBucket[sw] != 0)
+                {
+                    const size_t wi = (sw<<6) + CTZ64(sumBucket[sw]);
+                    const size_t rank = (wi<<6) +
+                            CTZ64(words[maxBucket*wordsNum + wi]);
+                    erase(maxBucket, rank);
+                    return rank;
+                }
+            maxBucket--; // bucket is empty
+        }
     }
 };
 
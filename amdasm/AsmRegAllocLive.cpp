@@ -20,7 +20,6 @@
 #include <CLRX/Config.h>
 #include <assert.h>
 #include <iostream>
-#include <stack>
 #include <deque>
 #include <vector>
 #include <utility>
@@ -41,7 +40,130 @@ using namespace CLRX;
 
 namespace CLRX
 {
-
+    
+/* sparse map indexed by svreg id: positions is dense (index - svreg id),
+ * entries holds only added svregs (order of entries is not sorted).
+ * clear() and iterating are proportional to number of entries */
+template<typename T>
+class CLRX_INTERNAL SVIdSparseMap
+{
+public:
+    typedef std::pair<size_t, T> Entry;
+    typedef typename std::vector<Entry>::const_iterator const_iterator;
+private:
+    std::vector<size_t> positions;
+    std::vector<Entry> entries;
+public:
+    explicit SVIdSparseMap(size_t svregsNum = 0) : positions(svregsNum, SIZE_MAX)
+    { }
+    
+    bool empty() const
+    { return entries.empty(); }
+    const_iterator begin() const
+    { return entries.begin(); }
+    const_iterator end() const
+    { return entries.end(); }
+    
+    const T* find(size_t svId) const
+    {
+        const size_t pos = positions[svId];
+        return (pos != SIZE_MAX) ? &entries[pos].second : nullptr;
+    }
+    
+    T* find(size_t svId)
+    {
+        const size_t pos = positions[svId];
+        return (pos != SIZE_MAX) ? &entries[pos].second : nullptr;
+    }
+    
+    // insert if not present, returns true if inserted
+    bool insert(size_t svId, const T& value)
+    {
+        if (positions[svId] != SIZE_MAX)
+            return false;
+        positions[svId] = entries.size();
+        entries.push_back({ svId, value });
+        return true;
+    }
+    
+    // insert or replace value
+    void set(size_t svId, const T& value)
+    {
+        if (!insert(svId, value))
+            entries[positions[svId]].second = value;
+    }
+    
+    void erase(size_t svId)
+    {
+        const size_t pos = positions[svId];
+        if (pos == SIZE_MAX)
+            return;
+        if (pos+1 != entries.size())
+        {
+            // move last entry to erased place
+            entries[pos] = entries.back();
+            positions[entries[pos].first] = pos;
+        }
+        entries.pop_back();
+        positions[svId] = SIZE_MAX;
+    }
+    
+    void clear()
+    {
+        for (const Entry& entry: entries)
+            positions[entry.first] = SIZE_MAX;
+        entries.clear();
+    }
+    
+    // replace content by content of map (vector of pairs)
+    template<typename M>
+    void assign(const M& map)
+    {
+        clear();
+        for (const auto& entry: map)
+            set(entry.first, entry.second);
+    }
+    
+    // store content to map (vector of pairs, not sorted)
+    template<typename M>
+    void store(M& map) const
+    { map.assign(entries.begin(), entries.end()); }
+};
+    
+// temporary svreg maps for createRoutineDataLv (reused between calls)
+struct CLRX_INTERNAL RoutineLvTemps
+{
+    // already read in current path, value - source block where vreg found
+    SVIdSparseMap<size_t> alreadyReadMap;
+    SVIdSparseMap<size_t> rbwSSAIdMap;
+    // value - position in routine lastAccessMap
+    SVIdSparseMap<size_t> lastAccessPos;
+    SVIdSparseMap<LastAccessBlockPos> curSVRegMap;
+    SVIdSparseMap<cxbyte> vregsNotInAllRets;
+    SVIdSparseMap<cxbyte> vregsInFirstReturn;
+    
+    explicit RoutineLvTemps(size_t n) : alreadyReadMap(n), rbwSSAIdMap(n),
+            lastAccessPos(n), curSVRegMap(n), vregsNotInAllRets(n),
+            vregsInFirstReturn(n)
+    { }
+};
+    
+// temporary svreg maps for joinRegVarLivenesses and addJoinSecCacheEntry
+struct CLRX_INTERNAL JoinLvTemps
+{
+    SVIdSparseMap<LastVRegStackPos> stackVarMap;
+    // already read in current path, value - source block where vreg found
+    SVIdSparseMap<size_t> alreadyReadMap;
+    SVIdSparseMap<size_t> secPoints;
+    // used by addJoinSecCacheEntry
+    SVIdSparseMap<size_t> cacheAlreadyReadMap;
+    SVIdSparseMap<size_t> cacheSecPoints;
+    
+    explicit JoinLvTemps(size_t n) : stackVarMap(n), alreadyReadMap(n), secPoints(n),
+            cacheAlreadyReadMap(n), cacheSecPoints(n)
+    { }
+};
+    
 struct CLRX_INTERNAL LivenessState
 {
     const std::deque<FlowStackEntry3>& flowStack;
@@ -50,14 +172,18 @@ struct CLRX_INTERNAL LivenessState
     ResSecondPointsToCache& cblocksToCache;
     PrevWaysIndexMap& prevWaysIndexMap;
     std::vector<Liveness>* livenesses;
-    const VarIndexMap* vregIndexMaps;
-    std::unordered_map<size_t, VIdxSetEntry>& vidxCallMap;
-    std::unordered_map<size_t, VIdxSetEntry>& vidxRoutineMap;
+    // svreg ids of ssaInfoMap entries (index - block)
+    const std::vector<Array<size_t> >& blockSVIds;
+    const std::vector<AsmSingleVReg>& svregs; // index - svreg id
+    const std::vector<cxuint>& svregTypes; // index - svreg id
+    const std::vector<std::vector<size_t> >& svregVIdxes; // index - svreg id
+    std::vector<VIdxSetEntry>& vidxCallMap; // index - block
+    std::vector<VIdxSetEntry>& vidxRoutineMap; // index - routine block
     RoutineLvMap& routineMap;
-    size_t regTypesNum;
-    const cxuint* regRanges;
+    RoutineLvTemps* routineTemps;
+    JoinLvTemps* joinTemps;
 };
-
+    
 };
 
 static cxuint getRegType(size_t regTypesNum, const cxuint* regRanges,
@@ -74,12 +200,29 @@ static cxuint getRegType(size_t regTypesNum, const cxuint* regRanges,
     return regType;
 }
 
-static void getVIdx(const AsmSingleVReg& svreg, size_t ssaIdIdx,
-        const AsmRegAllocator::SSAInfo& ssaInfo, LivenessState& ls,
+// find index of ssaInfoMap entry by svreg id (SIZE_MAX if not found)
+static inline size_t findSSAInfoIndex(const LivenessState& ls, size_t blockIndex,
+            size_t svId)
+{
+    const Array<size_t>& svIds = ls.blockSVIds[blockIndex];
+    auto it = std::lower_bound(svIds.begin(), svIds.end(), svId);
+    return (it != svIds.end() && *it == svId) ? it - svIds.begin() : SIZE_MAX;
+}
+
+static inline const SSAInfo* findSSAInfo(const LivenessState& ls, size_t blockIndex,
+            size_t svId)
+{
+    const size_t index = findSSAInfoIndex(ls, blockIndex, svId);
+    return (index != SIZE_MAX) ?
+            &ls.codeBlocks[blockIndex].ssaInfoMap[index].second : nullptr;
+}
+
+static void getVIdx(size_t svId, size_t ssaIdIdx,
+        const AsmRegAllocator::SSAInfo& ssaInfo, const LivenessState& ls,
         cxuint& regType, size_t& vidx)
 {
     size_t ssaId;
-    if (svreg.regVar==nullptr)
+    if (ls.svregs[svId].regVar==nullptr)
         ssaId = 0;
     else if (ssaIdIdx==0)
         ssaId = ssaInfo.ssaIdBefore;
@@ -90,36 +233,42 @@ static void getVIdx(const AsmSingleVReg& svreg, size_t ssaIdIdx,
     else // last
         ssaId = ssaInfo.ssaIdLast;
     
-    regType = getRegType(ls.regTypesNum, ls.regRanges, svreg); // regtype
-    const VarIndexMap& vregIndexMap = ls.vregIndexMaps[regType];
-    const std::vector<size_t>& vidxes = vregIndexMap.find(svreg)->second;
-    /*ARDOut << "lvn[" << regType << "][" << vidxes[ssaId] << "]. ssaIdIdx: " <<
-            ssaIdIdx << ". ssaId: " << ssaId << ". svreg: " << svreg.regVar << ":" <<
-            svreg.index << "\n";*/
-    //return livenesses[regType][ssaIdIndices[ssaId]];
-    vidx = vidxes[ssaId];
+    regType = ls.svregTypes[svId]; // regtype
+    vidx = ls.svregVIdxes[svId][ssaId];
 }
 
-static inline Liveness& getLiveness(const AsmSingleVReg& svreg, size_t ssaIdIdx,
+static inline Liveness& getLiveness(size_t svId, size_t ssaIdIdx,
         const AsmRegAllocator::SSAInfo& ssaInfo, LivenessState& ls)
 {
     cxuint regType;
     size_t vidx;
-    getVIdx(svreg, ssaIdIdx, ssaInfo, ls, regType, vidx);
+    getVIdx(svId, ssaIdIdx, ssaInfo, ls, regType, vidx);
     return ls.livenesses[regType][vidx];
 }
 
-static void getVIdx2(const AsmSingleVReg& svreg, size_t ssaId, LivenessState& ls,
+static inline void getVIdx2(size_t svId, size_t ssaId, const LivenessState& ls,
         cxuint& regType, size_t& vidx)
 {
-    regType = getRegType(ls.regTypesNum, ls.regRanges, svreg); // regtype
-    const VarIndexMap& vregIndexMap = ls.vregIndexMaps[regType];
-    const std::vector<size_t>& vidxes = vregIndexMap.find(svreg)->second;
-    /*ARDOut << "lvn[" << regType << "][" << vidxes[ssaId] << "]. ssaId: " <<
-            ssaId << ". svreg: " << svreg.regVar << ":" << svreg.index << "\n";*/
-    vidx = vidxes[ssaId];
+    regType = ls.svregTypes[svId]; // regtype
+    vidx = ls.svregVIdxes[svId][ssaId];
 }
 
+// sort vidxes and remove duplicates
+static void sortVIdxes(std::vector<size_t>& vidxes)
+{
+    std::sort(vidxes.begin(), vidxes.end());
+    vidxes.resize(std::unique(vidxes.begin(), vidxes.end()) - vidxes.begin());
+}
+
+// add vidx to vidxes (duplicates are removed before reallocation and by sortVIdxes)
+static inline void pushVIdx(std::vector<size_t>& vidxes, size_t vidx)
+{
+    if (!vidxes.empty() && vidxes.back() == vidx)
+        return;
+    if (vidxes.size() == vidxes.capacity())
+        sortVIdxes(vidxes);
+    vidxes.push_back(vidx);
+}
 
 static void addVIdxToCallEntry(size_t blockIndex, cxuint regType, size_t vidx,
                 LivenessState& ls)
@@ -128,22 +277,24 @@ static void addVIdxToCallEntry(size_t blockIndex, cxuint regType, size_t vidx,
     if (cblock.haveCalls)
     {
         VIdxSetEntry& varCallEntry = ls.vidxCallMap[blockIndex];
+        varCallEntry.used = true;
         for (const NextBlock& next: cblock.nexts)
             if (next.isCall)
             {
-                auto vidxRIt = ls.vidxRoutineMap.find(next.block);
-                if (vidxRIt == ls.vidxRoutineMap.end())
+                const VIdxSetEntry& allLvs = ls.vidxRoutineMap[next.block];
+                if (!allLvs.used)
                     continue;
-                const auto& allLvs = vidxRIt->second;
-                if (allLvs.vs[regType].find(vidx) == allLvs.vs[regType].end())
+                // routine vidxes are sorted
+                if (!std::binary_search(allLvs.vs[regType].begin(),
+                            allLvs.vs[regType].end(), vidx))
                     // add callLiveTime only if vreg not present in routine
-                    varCallEntry.vs[regType].insert(vidx);
+                    pushVIdx(varCallEntry.vs[regType], vidx);
             }
     }
 }
 
 static void fillUpInsideRoutine(LivenessState& ls,
-            size_t startBlock, size_t routineBlock, const AsmSingleVReg& svreg,
+            size_t startBlock, size_t routineBlock, size_t svId,
             Liveness& lv, cxuint lvRType /* lv register type */, size_t vidx,
             size_t ssaId, const RoutineDataLv& rdata,
             std::unordered_set<size_t>& havePathBlocks)
@@ -159,18 +310,15 @@ static void fillUpInsideRoutine(LivenessState& ls,
     // determine first SSAId and whether filling should begin from start of the routine
     if (routineBlock == startBlock)
     {
-        const CodeBlock& cblock = ls.codeBlocks[startBlock];
-        auto sinfoIt = binaryMapFind(cblock.ssaInfoMap.begin(),
-                cblock.ssaInfoMap.end(), svreg);
-        
-        auto rbwIt = rdata.rbwSSAIdMap.find(svreg);
-        if (sinfoIt != cblock.ssaInfoMap.end())
+        const SSAInfo* sinfo = findSSAInfo(ls, startBlock, svId);
+        auto rbwIt = binaryMapFind(rdata.rbwSSAIdMap.begin(),
+                    rdata.rbwSSAIdMap.end(), svId);
+        if (sinfo != nullptr)
         {
-            const SSAInfo& sinfo = sinfoIt->second;
-            if (sinfo.readBeforeWrite && sinfo.ssaIdBefore==ssaId)
+            if (sinfo->readBeforeWrite && sinfo->ssaIdBefore==ssaId)
                 // if ssaId is first read, then we assume start at routine start pos
                 fromStartPos = true;
-            else if (sinfo.ssaIdChange == 0 || sinfo.ssaIdLast != ssaId)
+            else if (sinfo->ssaIdChange == 0 || sinfo->ssaIdLast != ssaId)
                 // do nothing (last SSAId doesnt match or no change
                 return;
         }
@@ -196,11 +344,10 @@ static void fillUpInsideRoutine(LivenessState& ls,
             if (visited.insert(entry.blockIndex.index).second &&
                 haveReturnBlocks.find(entry.blockIndex.index) != haveReturnBlocks.end())
             {
-                auto sinfoIt = binaryMapFind(cblock.ssaInfoMap.begin(),
-                            cblock.ssaInfoMap.end(), svreg);
-                if (flowStack.size() > 1 && sinfoIt != cblock.ssaInfoMap.end())
+                const SSAInfo* sinfo = findSSAInfo(ls, entry.blockIndex.index, svId);
+                if (flowStack.size() > 1 && sinfo != nullptr)
                 {
-                    if (!sinfoIt->second.readBeforeWrite)
+                    if (!sinfo->readBeforeWrite)
                     {
                         // no read before write skip this path
                         flowStack.pop_back();
@@ -258,18 +405,17 @@ static void fillUpInsideRoutine(LivenessState& ls,
             if (curHavePath)
             {
                 // fill up block when in path
-                auto sinfoIt = binaryMapFind(cblock.ssaInfoMap.begin(),
-                            cblock.ssaInfoMap.end(), svreg);
+                const SSAInfo* sinfo = findSSAInfo(ls, entry.blockIndex.index, svId);
                 size_t cbStart = cblock.start;
                 size_t cbEnd = cblock.end;
                 if (flowStack.size() == 1 && !fromStartPos)
                 {
                     // if first block, then get last occurrence in this path
-                    if (sinfoIt != cblock.ssaInfoMap.end())
-                        cbStart = sinfoIt->second.lastPos+1;
+                    if (sinfo != nullptr)
+                        cbStart = sinfo->lastPos+1;
                 }
-                if (endOfPath && sinfoIt != cblock.ssaInfoMap.end())
-                    cbEnd = sinfoIt->second.firstPos+1;
+                if (endOfPath && sinfo != nullptr)
+                    cbEnd = sinfo->firstPos+1;
                 // fill up block
                 lv.insert(cbStart, cbEnd);
                 if (cblock.end == cbEnd)
@@ -290,7 +436,7 @@ static void fillUpInsideRoutine(LivenessState& ls,
 }
 
 static void joinVRegRecur(LivenessState& ls, LastVRegStackPos flowStkStart,
-            const AsmSingleVReg& svreg, size_t ssaId, bool skipLastBlock = false)
+            size_t svId, size_t ssaId, bool skipLastBlock = false)
 {
     struct JoinEntry
     {
@@ -310,17 +456,17 @@ static void joinVRegRecur(LivenessState& ls, LastVRegStackPos flowStkStart,
         --flitEnd; // before last element
     cxuint lvRegType;
     size_t vidx;
-    getVIdx2(svreg, ssaId, ls, lvRegType, vidx);
+    getVIdx2(svId, ssaId, ls, lvRegType, vidx);
     Liveness& lv = ls.livenesses[lvRegType][vidx];
     
-    std::stack<JoinEntry> rjStack; // routine join stack
+    std::vector<JoinEntry> rjStack; // routine join stack
     if (flowStkStart.inSubroutines)
-        rjStack.push({ ls.flowStack[flowStkStart.stackPos].blockIndex.index,
+        rjStack.push_back({ ls.flowStack[flowStkStart.stackPos].blockIndex.index,
                             0, 0, true, SIZE_MAX, nullptr });
     
     while (!rjStack.empty())
     {
-        JoinEntry& entry = rjStack.top();
+        JoinEntry& entry = rjStack.back();
         const CodeBlock& cblock = ls.codeBlocks[entry.blockIndex];
         
         if (entry.inSubroutines && entry.nextIndex < cblock.nexts.size())
@@ -329,24 +475,32 @@ static void joinVRegRecur(LivenessState& ls, LastVRegStackPos flowStkStart,
             if (cblock.nexts[entry.nextIndex].isCall)
             {
                 const size_t routineBlock = cblock.nexts[entry.nextIndex].block;
-                const RoutineDataLv& rdata =
-                        ls.routineMap.find(routineBlock)->second;
-                auto lastAccessIt = rdata.lastAccessMap.find(svreg);
+                const RoutineDataLv& rdata = *ls.routineMap[routineBlock];
+                auto lastAccessIt = binaryMapFind(rdata.lastAccessMap.begin(),
+                            rdata.lastAccessMap.end(), svId);
                 if (lastAccessIt != rdata.lastAccessMap.end())
                 {
                     if (entry.lastAccessIndex < lastAccessIt->second.size())
                     {
                         // we have new path in subroutine to fill
-                        const auto& lastAccess =
+                        const LastAccessBlockPos lastAccess =
                                 lastAccessIt->second[entry.lastAccessIndex];
                         
-                        if (visited.insert(lastAccess).second)
-                            rjStack.push({ lastAccess.blockIndex, 0, 0,
-                                    lastAccess.inSubroutines, routineBlock, &rdata });
-                        
                         entry.lastAccessIndex++;
                         if (entry.lastAccessIndex == lastAccessIt->second.size())
                             doNextIndex = true;
+                        
+                        if (doNextIndex)
+                        {
+                            // to next call
+                            entry.nextIndex++;
+                            entry.lastAccessIndex = 0;
+                        }
+                        // entry can be invalidated by push_back
+                        if (visited.insert(lastAccess).second)
+                            rjStack.push_back({ lastAccess.blockIndex, 0, 0,
+                                    lastAccess.inSubroutines, routineBlock, &rdata });
+                        continue;
                     }
                     else
                         doNextIndex = true;
@@ -371,9 +525,9 @@ static void joinVRegRecur(LivenessState& ls, LastVRegStackPos flowStkStart,
              * (that with subroutines calls) will be skipped */
             if (rjStack.size() > 1)
                 fillUpInsideRoutine(ls, entry.blockIndex + (entry.inSubroutines),
-                        entry.routineBlock, svreg, lv, lvRegType, vidx, ssaId,
+                        entry.routineBlock, svId, lv, lvRegType, vidx, ssaId,
                         *entry.rdata, havePathBlocks);
-            rjStack.pop();
+            rjStack.pop_back();
         }
     }
     
@@ -392,16 +546,15 @@ static void joinVRegRecur(LivenessState& ls, LastVRegStackPos flowStkStart,
     const CodeBlock& lastBlk = ls.codeBlocks[flit->blockIndex.index];
     if (flit != flitEnd)
     {
-        auto sinfoIt = binaryMapFind(lastBlk.ssaInfoMap.begin(),
-                    lastBlk.ssaInfoMap.end(), svreg);
+        const SSAInfo* sinfo = findSSAInfo(ls, flit->blockIndex.index, svId);
         size_t lastPos = lastBlk.start;
-        if (sinfoIt != lastBlk.ssaInfoMap.end())
+        if (sinfo != nullptr)
         {
             if (flit->nextIndex > lastBlk.nexts.size())
                 // only if pass this routine
                 addVIdxToCallEntry(flit->blockIndex.index, lvRegType, vidx, ls);
             // if begin at some point at last block
-            lastPos = sinfoIt->second.lastPos;
+            lastPos = sinfo->lastPos;
             lv.insert(lastPos + 1, lastBlk.end);
             ++flit; // skip last block in stack
         }
@@ -421,26 +574,82 @@ static void joinVRegRecur(LivenessState& ls, LastVRegStackPos flowStkStart,
  * replace sets by vector, and sort and remove same values on demand
  */
 
+static inline LastVRegStackPos getLastVRegStackPos(const LastVRegMap& lastVRegMap,
+            size_t svId)
+{
+    const std::vector<LastVRegStackPos>& lastPos = lastVRegMap[svId];
+    return (!lastPos.empty()) ? lastPos.back() : LastVRegStackPos{ 0, false };
+}
+
 /* join livenesses between consecutive code blocks */
 static void putCrossBlockLivenesses(LivenessState& ls, const LastVRegMap& lastVRegMap)
 {
     ARDOut << "putCrossBlockLv block: " << ls.flowStack.back().blockIndex << "\n";
-    const CodeBlock& cblock = ls.codeBlocks[ls.flowStack.back().blockIndex.index];
-    for (const auto& entry: cblock.ssaInfoMap)
-        if (entry.second.readBeforeWrite)
-        {
+    const size_t blockIndex = ls.flowStack.back().blockIndex.index;
+    const CodeBlock& cblock = ls.codeBlocks[blockIndex];
+    const Array<size_t>& svIds = ls.blockSVIds[blockIndex];
+    for (size_t i = 0; i < cblock.ssaInfoMap.size(); i++)
+        if (cblock.ssaInfoMap[i].second.readBeforeWrite)
             // find last
-            auto lvrit = lastVRegMap.find(entry.first);
-            LastVRegStackPos flowStackStart = (lvrit != lastVRegMap.end()) ?
-                lvrit->second.back() : LastVRegStackPos{ 0, false };
-            
-            joinVRegRecur(ls, flowStackStart, entry.first, entry.second.ssaIdBefore, true);
+            joinVRegRecur(ls, getLastVRegStackPos(lastVRegMap, svIds[i]), svIds[i],
+                        cblock.ssaInfoMap[i].second.ssaIdBefore, true);
+}
+
+// add svregs from called routines to already read map (with block)
+static void addCallsToAlreadyReadMap(const LivenessState& ls, const CodeBlock& cblock,
+            size_t blockIndex, SVIdSparseMap<size_t>& alreadyReadMap)
+{
+    for (const auto& next: cblock.nexts)
+        if (next.isCall)
+        {
+            const RoutineDataLv* rdata = ls.routineMap[next.block].get();
+            if (rdata == nullptr)
+                continue;
+            for (const auto& v: rdata->rbwSSAIdMap)
+                alreadyReadMap.insert(v.first, blockIndex);
+            for (const auto& v: rdata->lastAccessMap)
+                alreadyReadMap.insert(v.first, blockIndex);
         }
 }
 
+// remove svregs (added in this block) from already read map
+static void removeBlockFromAlreadyReadMap(const LivenessState& ls,
+            const CodeBlock& cblock, size_t blockIndex,
+            SVIdSparseMap<size_t>& alreadyReadMap)
+{
+    for (const auto& next: cblock.nexts)
+        if (next.isCall)
+        {
+            const RoutineDataLv* rdata = ls.routineMap[next.block].get();
+            if (rdata == nullptr)
+                continue;
+            for (const auto& v: rdata->rbwSSAIdMap)
+            {
+                const size_t* srcBlock = alreadyReadMap.find(v.first);
+                if (srcBlock != nullptr && *srcBlock == blockIndex)
+                    alreadyReadMap.erase(v.first);
+            }
+            for (const auto& v: rdata->lastAccessMap)
+            {
+                const size_t* srcBlock = alreadyReadMap.find(v.first);
+                if (srcBlock != nullptr && *srcBlock == blockIndex)
+                    alreadyReadMap.erase(v.first);
+            }
+        }
+    
+    for (size_t svId: ls.blockSVIds[blockIndex])
+    {
+        const size_t* srcBlock = alreadyReadMap.find(svId);
+        if (srcBlock != nullptr && *srcBlock == blockIndex)
+            // remove old to resolve in leaved way to allow collecting next ssaId
+            // before write (can be different due to earlier visit)
+            alreadyReadMap.erase(svId);
+    }
+}
+
 // add new join second cache entry with readBeforeWrite for all encountered regvars
 static void addJoinSecCacheEntry(LivenessState& ls,
-                SimpleCache<size_t, SVRegMap>& joinSecondPointsCache,
+                SimpleCache<size_t, SVIdSSAIdMap>& joinSecondPointsCache,
                 size_t nextBlock)
 {
     ARDOut << "addJoinSecCacheEntry: " << nextBlock << "\n";
@@ -448,12 +657,12 @@ static void addJoinSecCacheEntry(LivenessState& ls,
     // traverse by graph from next block
     std::deque<FlowStackEntry3> flowStack;
     flowStack.push_back({ nextBlock, 0 });
-    std::unordered_set<size_t> visited;
+    std::vector<bool> visited(ls.codeBlocks.size(), false);
     
     // already read in current path
     // key - vreg, value - source block where vreg of conflict found
-    SVRegBlockMap alreadyReadMap;
-    SVRegMap cacheSecPoints;
+    SVIdSparseMap<size_t>& alreadyReadMap = ls.joinTemps->cacheAlreadyReadMap;
+    SVIdSparseMap<size_t>& cacheSecPoints = ls.joinTemps->cacheSecPoints;
     
     while (!flowStack.empty())
     {
@@ -463,35 +672,31 @@ static void addJoinSecCacheEntry(LivenessState& ls,
         if (entry.nextIndex == 0)
         {
             // process current block
-            if (visited.insert(entry.blockIndex.index).second)
+            if (!visited[entry.blockIndex.index])
             {
+                visited[entry.blockIndex.index] = true;
                 ARDOut << "  resolv (cache): " << entry.blockIndex << "\n";
                 
-                const SVRegMap* resSecondPoints =
+                const SVIdSSAIdMap* resSecondPoints =
                             joinSecondPointsCache.use(entry.blockIndex.index);
                 if (resSecondPoints == nullptr)
                 {
                     // if joinSecondPointCache not found
-                    for (auto& sentry: cblock.ssaInfoMap)
+                    const Array<size_t>& svIds = ls.blockSVIds[entry.blockIndex.index];
+                    for (size_t i = 0; i < svIds.size(); i++)
                     {
-                        const SSAInfo& sinfo = sentry.second;
-                        auto res = alreadyReadMap.insert(
-                                    { sentry.first, entry.blockIndex });
-                        
-                        if (res.second && sinfo.readBeforeWrite)
-                            cacheSecPoints[sentry.first] = sinfo.ssaIdBefore;
+                        const SSAInfo& sinfo = cblock.ssaInfoMap[i].second;
+                        if (alreadyReadMap.insert(svIds[i], entry.blockIndex.index) &&
+                            sinfo.readBeforeWrite)
+                            cacheSecPoints.set(svIds[i], sinfo.ssaIdBefore);
                     }
                 }
                 else // to use cache
                 {
                     // add to current cache sec points
                     for (const auto& rsentry: *resSecondPoints)
-                    {
-                        const bool alreadyRead =
-                            alreadyReadMap.find(rsentry.first) != alreadyReadMap.end();
-                        if (!alreadyRead)
-                            cacheSecPoints[rsentry.first] = rsentry.second;
-                    }
+                        if (alreadyReadMap.find(rsentry.first) == nullptr)
+                            cacheSecPoints.set(rsentry.first, rsentry.second);
                     flowStack.pop_back();
                     continue;
                 }
@@ -516,16 +721,7 @@ static void addJoinSecCacheEntry(LivenessState& ls,
                  !cblock.haveReturn && !cblock.haveEnd)
         {
             // add alreadyReadMap ssaIds inside called routines
-            for (const auto& next: cblock.nexts)
-                if (next.isCall)
-                {
-                    const RoutineDataLv& rdata = ls.routineMap.find(next.block)->second;
-                    for (const auto& v: rdata.rbwSSAIdMap)
-                        alreadyReadMap.insert({v.first, entry.blockIndex });
-                    for (const auto& v: rdata.lastAccessMap)
-                        alreadyReadMap.insert({v.first, entry.blockIndex });
-                }
-            
+            addCallsToAlreadyReadMap(ls, cblock, entry.blockIndex.index, alreadyReadMap);
             flowStack.push_back({ entry.blockIndex+1, 0 });
             entry.nextIndex++;
         }
@@ -533,70 +729,47 @@ static void addJoinSecCacheEntry(LivenessState& ls,
         {
             // remove old to resolve in leaved way to allow collecting next ssaId
             // before write (can be different due to earlier visit)
-            for (const auto& next: cblock.nexts)
-                if (next.isCall)
-                {
-                    const RoutineDataLv& rdata = ls.routineMap.find(next.block)->second;
-                    for (const auto& v: rdata.rbwSSAIdMap)
-                    {
-                        auto it = alreadyReadMap.find(v.first);
-                        if (it != alreadyReadMap.end() && it->second == entry.blockIndex)
-                            alreadyReadMap.erase(it);
-                    }
-                    for (const auto& v: rdata.lastAccessMap)
-                    {
-                        auto it = alreadyReadMap.find(v.first);
-                        if (it != alreadyReadMap.end() && it->second == entry.blockIndex)
-                            alreadyReadMap.erase(it);
-                    }
-                }
-            
-            for (const auto& sentry: cblock.ssaInfoMap)
-            {
-                auto it = alreadyReadMap.find(sentry.first);
-                if (it != alreadyReadMap.end() && it->second == entry.blockIndex)
-                    // remove old to resolve in leaved way to allow collecting next ssaId
-                    // before write (can be different due to earlier visit)
-                    alreadyReadMap.erase(it);
-            }
+            removeBlockFromAlreadyReadMap(ls, cblock, entry.blockIndex.index,
+                        alreadyReadMap);
             ARDOut << "  popjoin (cache)\n";
             flowStack.pop_back();
         }
     }
     
-    joinSecondPointsCache.put(nextBlock, cacheSecPoints);
+    SVIdSSAIdMap cacheEntry;
+    cacheSecPoints.store(cacheEntry);
+    joinSecondPointsCache.put(nextBlock, cacheEntry);
+    alreadyReadMap.clear();
+    cacheSecPoints.clear();
 }
 
 // apply calls (changes from these calls) from code blocks to stack var map
 static void applyCallToStackVarMap(const CodeBlock& cblock, const RoutineLvMap& routineMap,
-        LastStackPosMap& stackVarMap, size_t pfPos, size_t nextIndex)
+        SVIdSparseMap<LastVRegStackPos>& stackVarMap, size_t pfPos, size_t nextIndex)
 {
     for (const NextBlock& next: cblock.nexts)
         if (next.isCall)
         {
             ARDOut << "  japplycall: " << pfPos << ": " <<
                     nextIndex << ": " << next.block << "\n";
-            const LastAccessMap& regVarMap =
-                    routineMap.find(next.block)->second.lastAccessMap;
-            for (const auto& sentry: regVarMap)
-            {
-                // MSVC error fix
-                auto& v = stackVarMap[sentry.first];
-                v = LastVRegStackPos{ pfPos, true };
-            }
+            const RoutineDataLv* rdata = routineMap[next.block].get();
+            if (rdata == nullptr)
+                continue;
+            for (const auto& sentry: rdata->lastAccessMap)
+                stackVarMap.set(sentry.first, LastVRegStackPos{ pfPos, true });
         }
 }
 
 static void joinRegVarLivenesses(LivenessState& ls,
         SimpleCache<size_t, LastStackPosMap>& joinFirstPointsCache,
-        SimpleCache<size_t, SVRegMap>& joinSecondPointsCache)
+        SimpleCache<size_t, SVIdSSAIdMap>& joinSecondPointsCache)
 {
     size_t nextBlock = ls.flowStack.back().blockIndex.index;
     auto pfEnd = ls.flowStack.end();
     --pfEnd;
     ARDOut << "startJoinLv: " << (pfEnd-1)->blockIndex << "," << nextBlock << "\n";
     // key - varreg, value - last position in previous flowStack
-    LastStackPosMap stackVarMap;
+    SVIdSparseMap<LastVRegStackPos>& stackVarMap = ls.joinTemps->stackVarMap;
     
     size_t pfStartIndex = 0;
     {
@@ -610,7 +783,7 @@ static void joinRegVarLivenesses(LivenessState& ls,
             {
                 ARDOut << "use pfcached: " << it->second.first << ", " <<
                         it->second.second << "\n";
-                stackVarMap = *cached;
+                stackVarMap.assign(*cached);
                 pfStartIndex = it->second.second+1;
                 
                 // apply missing calls at end of the cached
@@ -629,12 +802,8 @@ static void joinRegVarLivenesses(LivenessState& ls,
     {
         const FlowStackEntry3& entry = *pfit;
         const CodeBlock& cblock = ls.codeBlocks[entry.blockIndex.index];
-        for (const auto& sentry: cblock.ssaInfoMap)
-        {
-            // MSVC error fix
-            auto& v = stackVarMap[sentry.first];
-            v = { size_t(pfit - ls.flowStack.begin()), false };
-        }
+        for (size_t svId: ls.blockSVIds[entry.blockIndex.index])
+            stackVarMap.set(svId, { size_t(pfit - ls.flowStack.begin()), false });
         
         if (entry.nextIndex > cblock.nexts.size())
             applyCallToStackVarMap(cblock, ls.routineMap, stackVarMap,
@@ -645,11 +814,13 @@ static void joinRegVarLivenesses(LivenessState& ls,
             !joinFirstPointsCache.hasKey(pfit->blockIndex.index))
         {
             ARDOut << "put pfcache " << pfit->blockIndex << "\n";
-            joinFirstPointsCache.put(pfit->blockIndex.index, stackVarMap);
+            LastStackPosMap cacheEntry;
+            stackVarMap.store(cacheEntry);
+            joinFirstPointsCache.put(pfit->blockIndex.index, cacheEntry);
         }
     }
     
-    SVRegMap cacheSecPoints;
+    SVIdSparseMap<size_t>& cacheSecPoints = ls.joinTemps->secPoints;
     const bool toCache = (!joinSecondPointsCache.hasKey(nextBlock)) &&
                 ls.cblocksToCache.count(nextBlock)>=2;
     
@@ -660,7 +831,7 @@ static void joinRegVarLivenesses(LivenessState& ls,
     
     // already read in current path
     // key - vreg, value - source block where vreg of conflict found
-    SVRegMap alreadyReadMap;
+    SVIdSparseMap<size_t>& alreadyReadMap = ls.joinTemps->alreadyReadMap;
     
     while (!flowStack.empty())
     {
@@ -675,51 +846,47 @@ static void joinRegVarLivenesses(LivenessState& ls,
                 visited[entry.blockIndex.index] = true;
                 ARDOut << "  lvjoin: " << entry.blockIndex << "\n";
                 
-                const SVRegMap* joinSecondPoints =
+                const SVIdSSAIdMap* joinSecondPoints =
                         joinSecondPointsCache.use(entry.blockIndex.index);
                 
                 if (joinSecondPoints == nullptr)
-                    for (const auto& sentry: cblock.ssaInfoMap)
+                {
+                    const Array<size_t>& svIds = ls.blockSVIds[entry.blockIndex.index];
+                    for (size_t i = 0; i < svIds.size(); i++)
                     {
-                        const SSAInfo& sinfo = sentry.second;
-                        auto res = alreadyReadMap.insert(
-                                    { sentry.first, entry.blockIndex.index });
+                        const SSAInfo& sinfo = cblock.ssaInfoMap[i].second;
+                        const bool added = alreadyReadMap.insert(svIds[i],
+                                    entry.blockIndex.index);
                         
                         if (toCache)
-                            cacheSecPoints[sentry.first] = sinfo.ssaIdBefore;
+                            cacheSecPoints.set(svIds[i], sinfo.ssaIdBefore);
                         
-                        if (res.second && sinfo.readBeforeWrite)
+                        if (added && sinfo.readBeforeWrite)
                         {
-                            auto it = stackVarMap.find(sentry.first);
-                            LastVRegStackPos stackPos = (it != stackVarMap.end() ?
-                                        it->second : LastVRegStackPos{ 0, false });
-                            
-                            joinVRegRecur(ls, stackPos, sentry.first,
-                                sentry.second.ssaIdBefore, true);
+                            const LastVRegStackPos* stackPos =
+                                    stackVarMap.find(svIds[i]);
+                            joinVRegRecur(ls, (stackPos != nullptr ? *stackPos :
+                                    LastVRegStackPos{ 0, false }), svIds[i],
+                                    sinfo.ssaIdBefore, true);
                         }
                     }
+                }
                 else
                 {
                     ARDOut << "use join secPointCache: " << entry.blockIndex << "\n";
                     // add to current cache sec points
                     for (const auto& rsentry: *joinSecondPoints)
-                    {
-                        const bool alreadyRead =
-                            alreadyReadMap.find(rsentry.first) != alreadyReadMap.end();
-                        
-                        if (!alreadyRead)
+                        if (alreadyReadMap.find(rsentry.first) == nullptr)
                         {
                             if (toCache)
-                                cacheSecPoints[rsentry.first] = rsentry.second;
-                            
-                            auto it = stackVarMap.find(rsentry.first);
-                            LastVRegStackPos stackPos = (it != stackVarMap.end() ?
-                                        it->second : LastVRegStackPos{ 0, false });
+                                cacheSecPoints.set(rsentry.first, rsentry.second);
                             
-                            joinVRegRecur(ls, stackPos, rsentry.first,
-                                          rsentry.second, true);
+                            const LastVRegStackPos* stackPos =
+                                    stackVarMap.find(rsentry.first);
+                            joinVRegRecur(ls, (stackPos != nullptr ? *stackPos :
+                                    LastVRegStackPos{ 0, false }), rsentry.first,
+                                    rsentry.second, true);
                         }
-                    }
                     flowStack.pop_back();
                     continue;
                 }
@@ -747,16 +914,7 @@ static void joinRegVarLivenesses(LivenessState& ls,
                  !cblock.haveReturn && !cblock.haveEnd)
         {
             // add alreadReadMap ssaIds inside called routines
-            for (const auto& next: cblock.nexts)
-                if (next.isCall)
-                {
-                    const RoutineDataLv& rdata = ls.routineMap.find(next.block)->second;
-                    for (const auto& v: rdata.rbwSSAIdMap)
-                        alreadyReadMap.insert({v.first, entry.blockIndex.index });
-                    for (const auto& v: rdata.lastAccessMap)
-                        alreadyReadMap.insert({v.first, entry.blockIndex.index });
-                }
-            
+            addCallsToAlreadyReadMap(ls, cblock, entry.blockIndex.index, alreadyReadMap);
             flowStack.push_back({ entry.blockIndex+1, 0 });
             entry.nextIndex++;
         }
@@ -764,34 +922,8 @@ static void joinRegVarLivenesses(LivenessState& ls,
         {
             // remove old to resolve in leaved way to allow collecting next ssaId
             // before write (can be different due to earlier visit)
-            for (const auto& next: cblock.nexts)
-                if (next.isCall)
-                {
-                    const RoutineDataLv& rdata = ls.routineMap.find(next.block)->second;
-                    for (const auto& v: rdata.rbwSSAIdMap)
-                    {
-                        auto it = alreadyReadMap.find(v.first);
-                        if (it != alreadyReadMap.end() &&
-                            it->second == entry.blockIndex.index)
-                            alreadyReadMap.erase(it);
-                    }
-                    for (const auto& v: rdata.lastAccessMap)
-                    {
-                        auto it = alreadyReadMap.find(v.first);
-                        if (it != alreadyReadMap.end() &&
-                            it->second == entry.blockIndex.index)
-                            alreadyReadMap.erase(it);
-                    }
-                }
-            
-            for (const auto& sentry: cblock.ssaInfoMap)
-            {
-                auto it = alreadyReadMap.find(sentry.first);
-                if (it != alreadyReadMap.end() && it->second == entry.blockIndex.index)
-                    // remove old to resolve in leaved way to allow collecting next ssaId
-                    // before write (can be different due to earlier visit)
-                    alreadyReadMap.erase(it);
-            }
+            removeBlockFromAlreadyReadMap(ls, cblock, entry.blockIndex.index,
+                        alreadyReadMap);
             ARDOut << "  popjoin\n";
             
             if (ls.cblocksToCache.count(entry.blockIndex)==2 &&
@@ -804,15 +936,33 @@ static void joinRegVarLivenesses(LivenessState& ls,
     }
     
     if (toCache)
-        joinSecondPointsCache.put(nextBlock, cacheSecPoints);
+    {
+        SVIdSSAIdMap cacheEntry;
+        cacheSecPoints.store(cacheEntry);
+        joinSecondPointsCache.put(nextBlock, cacheEntry);
+    }
+    stackVarMap.clear();
+    alreadyReadMap.clear();
+    cacheSecPoints.clear();
+}
+
+// find index of ssaInfoMap entry by svreg (SIZE_MAX if not found)
+static inline size_t findSSAInfoIndex(const CodeBlock& cblock, const AsmSingleVReg& svreg)
+{
+    auto it = binaryMapFind(cblock.ssaInfoMap.begin(), cblock.ssaInfoMap.end(), svreg);
+    return (it != cblock.ssaInfoMap.end()) ? it - cblock.ssaInfoMap.begin() : SIZE_MAX;
 }
 
+/* readSVRegs and writtenSVRegs hold indices of ssaInfoMap entries,
+ * ssaIdIdxs - ssaIdIdx for every ssaInfoMap entry (SIZE_MAX if not yet used) */
 static bool addUsageDeps(const cxbyte* ldeps, const std::vector<AsmRegVarUsage>& rvus,
             const std::vector<AsmRegVarLinearDep>& instrLinDeps, LinearDepMap* ldepsOut,
-            Array<std::pair<AsmSingleVReg, SSAInfo> >& ssaInfoMap,
-            const SVRegMap& ssaIdIdxMap, const std::vector<AsmSingleVReg>& readSVRegs,
-            const std::vector<AsmSingleVReg>& writtenSVRegs, LivenessState& ls)
+            size_t blockIndex, const std::vector<size_t>& ssaIdIdxs,
+            const std::vector<size_t>& readSVRegs,
+            const std::vector<size_t>& writtenSVRegs, LivenessState& ls)
 {
+    const CodeBlock& cblock = ls.codeBlocks[blockIndex];
+    const Array<size_t>& svIds = ls.blockSVIds[blockIndex];
     // add linear deps
     cxuint count = ldeps[0];
     cxuint pos = 1;
@@ -831,19 +981,18 @@ static bool addUsageDeps(const cxbyte* ldeps, const std::vector<AsmRegVarUsage>&
                 continue;
             for (uint16_t k = rvu.rstart; k < rvu.rend; k++)
             {
-                AsmSingleVReg svreg = {rvu.regVar, k};
-                auto ssaIdIdx = ssaIdIdxMap.find(svreg)->second;
-                const SSAInfo& ssaInfo = binaryMapFind(ssaInfoMap.begin(),
-                                ssaInfoMap.end(), svreg)->second;
+                const size_t sinfoIdx = findSSAInfoIndex(cblock, {rvu.regVar, k});
+                size_t ssaIdIdx = ssaIdIdxs[sinfoIdx];
+                const SSAInfo& ssaInfo = cblock.ssaInfoMap[sinfoIdx].second;
                 size_t outVIdx;
                 
                 // if read or read-write (but not same write)
                 if (checkNoWriteWithSSA(rvu) &&
                     std::find(writtenSVRegs.begin(), writtenSVRegs.end(),
-                              svreg) != writtenSVRegs.end())
+                              sinfoIdx) != writtenSVRegs.end())
                     ssaIdIdx--; // current ssaIdIdx is for write, decrement
                 
-                getVIdx(svreg, ssaIdIdx, ssaInfo, ls, regType, outVIdx);
+                getVIdx(svIds[sinfoIdx], ssaIdIdx, ssaInfo, ls, regType, outVIdx);
                 // push variable index
                 vidxes.push_back(outVIdx);
             }
@@ -868,19 +1017,18 @@ static bool addUsageDeps(const cxbyte* ldeps, const std::vector<AsmRegVarUsage>&
             cxbyte align = rvus[i].align;
             for (uint16_t k = rvu.rstart; k < rvu.rend; k++)
             {
-                AsmSingleVReg svreg = {rvu.regVar, k};
-                size_t ssaIdIdx = ssaIdIdxMap.find(svreg)->second;
-                const SSAInfo& ssaInfo = binaryMapFind(ssaInfoMap.begin(),
-                            ssaInfoMap.end(), svreg)->second;
+                const size_t sinfoIdx = findSSAInfoIndex(cblock, {rvu.regVar, k});
+                size_t ssaIdIdx = ssaIdIdxs[sinfoIdx];
+                const SSAInfo& ssaInfo = cblock.ssaInfoMap[sinfoIdx].second;
                 size_t outVIdx;
                 
                 // if read or read-write (but not same write)
                 if (checkNoWriteWithSSA(rvu) &&
                     std::find(writtenSVRegs.begin(), writtenSVRegs.end(),
-                              svreg) != writtenSVRegs.end())
+                              sinfoIdx) != writtenSVRegs.end())
                     ssaIdIdx--; // current ssaIdIdx is for write, decrement
                 
-                getVIdx(svreg, ssaIdIdx, ssaInfo, ls, regType, outVIdx);
+                getVIdx(svIds[sinfoIdx], ssaIdIdx, ssaInfo, ls, regType, outVIdx);
                 // push variable index
                 vidxes.push_back(outVIdx);
             }
@@ -901,29 +1049,27 @@ static bool addUsageDeps(const cxbyte* ldeps, const std::vector<AsmRegVarUsage>&
         bool haveReadVidxes = false;
         for (uint16_t k = ldep.rstart; k < ldep.rend; k++)
         {
-            AsmSingleVReg svreg = {ldep.regVar, k};
-            auto ssaIdxIdIt = ssaIdIdxMap.find(svreg);
-            auto ssaInfoIt = binaryMapFind(ssaInfoMap.begin(), ssaInfoMap.end(), svreg);
-            if (ssaIdxIdIt == ssaIdIdxMap.end() || ssaInfoIt == ssaInfoMap.end())
+            const size_t sinfoIdx = findSSAInfoIndex(cblock, {ldep.regVar, k});
+            if (sinfoIdx == SIZE_MAX || ssaIdIdxs[sinfoIdx] == SIZE_MAX)
                 return false; // failed
             
-            size_t ssaIdIdx = ssaIdxIdIt->second;
-            const SSAInfo& ssaInfo = ssaInfoIt->second;
+            size_t ssaIdIdx = ssaIdIdxs[sinfoIdx];
+            const SSAInfo& ssaInfo = cblock.ssaInfoMap[sinfoIdx].second;
             size_t outVIdx;
             
             // if read or read-write (but not same write)
             if (std::find(readSVRegs.begin(), readSVRegs.end(),
-                            svreg) != readSVRegs.end() &&
+                            sinfoIdx) != readSVRegs.end() &&
                 std::find(writtenSVRegs.begin(), writtenSVRegs.end(),
-                            svreg) != writtenSVRegs.end())
+                            sinfoIdx) != writtenSVRegs.end())
             {
-                getVIdx(svreg, ssaIdIdx-1, ssaInfo, ls, regType, outVIdx);
+                getVIdx(svIds[sinfoIdx], ssaIdIdx-1, ssaInfo, ls, regType, outVIdx);
                 // push variable index
                 prevVidxes.push_back(outVIdx);
                 haveReadVidxes = true;
             }
             
-            getVIdx(svreg, ssaIdIdx, ssaInfo, ls, regType, outVIdx);
+            getVIdx(svIds[sinfoIdx], ssaIdIdx, ssaInfo, ls, regType, outVIdx);
             // push variable index
             vidxes.push_back(outVIdx);
             if(vidxes.size() != prevVidxes.size())
@@ -953,49 +1099,32 @@ static bool addUsageDeps(const cxbyte* ldeps, const std::vector<AsmRegVarUsage>&
     return true;
 }
 
-static void joinRoutineDataLv(RoutineDataLv& dest, VIdxSetEntry& destVars,
-            RoutineCurAccessMap& curSVRegMap, FlowStackEntry4& entry,
-            const RoutineDataLv& src, const VIdxSetEntry& srcVars)
-{
-    dest.rbwSSAIdMap.insert(src.rbwSSAIdMap.begin(), src.rbwSSAIdMap.end());
-    for (size_t i = 0; i < MAX_REGTYPES_NUM; i++)
-        destVars.vs[i].insert(srcVars.vs[i].begin(), srcVars.vs[i].end());
-    
-    // join source lastAccessMap with curSVRegMap
-    for (const auto& sentry: src.lastAccessMap)
-    {
-        auto res = curSVRegMap.insert({ sentry.first, { entry.blockIndex, true } });
-        if (!res.second)
-        {   // not added because is present in map
-            if (res.first->second.blockIndex != entry.blockIndex)
-                entry.prevCurSVRegMap.insert(*res.first);
-            // otherwise, it is same code block but inside routines
-            // and do not change prevCurSVRegMap for revert
-            // update entry
-            res.first->second = { entry.blockIndex, true };
-        }
-        else
-            entry.prevCurSVRegMap.insert({ sentry.first, { SIZE_MAX, true } });
-    }
-}
-
 static void createRoutineDataLv(LivenessState& ls, RoutineDataLv& rdata,
         VIdxSetEntry& routineVIdxes, size_t routineBlock)
 {
     ARDOut << "--------- createRoutineDataLv(" << routineBlock << ")\n";
     std::deque<FlowStackEntry4> flowStack;
-    std::unordered_set<size_t> visited;
+    std::vector<bool> visited(ls.codeBlocks.size(), false);
     
+    RoutineLvTemps& temps = *ls.routineTemps;
     // already read in current path
     // key - vreg, value - source block where vreg of conflict found
-    SVRegMap alreadyReadMap;
-    std::unordered_set<AsmSingleVReg> vregsNotInAllRets;
-    std::unordered_set<AsmSingleVReg> vregsInFirstReturn;
+    SVIdSparseMap<size_t>& alreadyReadMap = temps.alreadyReadMap;
+    SVIdSparseMap<cxbyte>& vregsNotInAllRets = temps.vregsNotInAllRets;
+    SVIdSparseMap<cxbyte>& vregsInFirstReturn = temps.vregsInFirstReturn;
     std::unordered_set<size_t>& haveReturnBlocks = rdata.haveReturnBlocks;
+    // rbwSSAIdMap and lastAccessMap can be filled by previous pass (in recursion)
+    SVIdSparseMap<size_t>& rbwSSAIdMap = temps.rbwSSAIdMap;
+    rbwSSAIdMap.assign(rdata.rbwSSAIdMap);
+    // key - svreg id, value - position in rdata.lastAccessMap
+    SVIdSparseMap<size_t>& lastAccessPos = temps.lastAccessPos;
+    for (size_t i = 0; i < rdata.lastAccessMap.size(); i++)
+        lastAccessPos.insert(rdata.lastAccessMap[i].first, i);
     
     bool notFirstReturn = false;
     flowStack.push_back({ routineBlock, 0 });
-    RoutineCurAccessMap curSVRegMap; // key - svreg, value - block index
+    // key - svreg id, value - block index
+    SVIdSparseMap<LastAccessBlockPos>& curSVRegMap = temps.curSVRegMap;
     
     while (!flowStack.empty())
     {
@@ -1005,51 +1134,46 @@ static void createRoutineDataLv(LivenessState& ls, RoutineDataLv& rdata,
         if (entry.nextIndex == 0)
         {
             // process current block
-            if (visited.insert(entry.blockIndex).second)
+            if (!visited[entry.blockIndex])
             {
+                visited[entry.blockIndex] = true;
                 ARDOut << "  cpjproc: " << entry.blockIndex << "\n";
                 
-                for (const auto& sentry: cblock.ssaInfoMap)
+                const Array<size_t>& svIds = ls.blockSVIds[entry.blockIndex];
+                for (size_t i = 0; i < svIds.size(); i++)
                 {
-                    if (sentry.second.readBeforeWrite)
-                        if (alreadyReadMap.insert(
-                                    { sentry.first, entry.blockIndex }).second)
-                        {
-                            auto res = rdata.rbwSSAIdMap.insert({ sentry.first,
-                                        sentry.second.ssaIdBefore });
-                            if (res.second && notFirstReturn)
-                                // first readBeforeWrite and notFirstReturn
-                                vregsNotInAllRets.insert(sentry.first);
-                        }
+                    const size_t svId = svIds[i];
+                    const SSAInfo& sinfo = cblock.ssaInfoMap[i].second;
+                    if (sinfo.readBeforeWrite &&
+                        alreadyReadMap.insert(svId, entry.blockIndex) &&
+                        rbwSSAIdMap.insert(svId, sinfo.ssaIdBefore) && notFirstReturn)
+                        // first readBeforeWrite and notFirstReturn
+                        vregsNotInAllRets.insert(svId, 0);
                     
-                    auto res = curSVRegMap.insert({ sentry.first,
-                        LastAccessBlockPos{ entry.blockIndex, false } });
-                    if (!res.second)
-                    {   // not added because is present in map
-                        entry.prevCurSVRegMap.insert(*res.first);
-                        res.first->second = { entry.blockIndex, false };
+                    LastAccessBlockPos* curAccess = curSVRegMap.find(svId);
+                    if (curAccess != nullptr)
+                    {   // present in map
+                        entry.prevCurSVRegs.push_back({ svId, *curAccess });
+                        *curAccess = { entry.blockIndex, false };
                     }
                     else
-                        entry.prevCurSVRegMap.insert(
-                                        { sentry.first, { SIZE_MAX, false } });
-                    
-                    // all SSAs
-                    const SSAInfo& sinfo = sentry.second;
-                    const AsmSingleVReg& svreg = sentry.first;
-                    cxuint regType = getRegType(ls.regTypesNum, ls.regRanges, svreg);
-                    const VarIndexMap& vregIndexMap = ls.vregIndexMaps[regType];
-                    const std::vector<size_t>& vidxes =
-                                vregIndexMap.find(svreg)->second;
+                    {
+                        curSVRegMap.insert(svId, { entry.blockIndex, false });
+                        entry.prevCurSVRegs.push_back({ svId, { SIZE_MAX, false } });
+                    }
                     
-                    // add SSA indices to allSSAs
+                    // add SSA indices to routine vidxes
+                    const cxuint regType = ls.svregTypes[svId];
+                    const std::vector<size_t>& vidxes = ls.svregVIdxes[svId];
+                    std::vector<size_t>& rvidxes = routineVIdxes.vs[regType];
                     if (sinfo.readBeforeWrite)
-                        routineVIdxes.vs[regType].insert(vidxes[sinfo.ssaIdBefore]);
+                        pushVIdx(rvidxes, vidxes[sinfo.ssaIdBefore]);
                     if (sinfo.ssaIdChange != 0)
                     {
-                        routineVIdxes.vs[regType].insert(vidxes[sinfo.ssaIdFirst]);
+                        pushVIdx(rvidxes, vidxes[sinfo.ssaIdFirst]);
                         for (size_t i = 1; i < sinfo.ssaIdChange-1; i++)
-                            routineVIdxes.vs[regType].insert(vidxes[sinfo.ssaId+i]);
-                        routineVIdxes.vs[regType].insert(vidxes[sinfo.ssaIdLast]);
+                            pushVIdx(rvidxes, vidxes[sinfo.ssaId+i]);
+                        pushVIdx(rvidxes, vidxes[sinfo.ssaIdLast]);
                     }
                 }
             }
@@ -1082,18 +1206,39 @@ static void createRoutineDataLv(LivenessState& ls, RoutineDataLv& rdata,
             
             for (size_t srcRoutBlock: calledRoutines)
             {
-                auto srcRIt = ls.routineMap.find(srcRoutBlock);
-                if (srcRIt == ls.routineMap.end())
+                const RoutineDataLv* srcRdata = ls.routineMap[srcRoutBlock].get();
+                if (srcRdata == nullptr)
                     continue; // skip not initialized recursion
-                // update svregs 'not in all returns'
-                const RoutineDataLv& srcRdata = srcRIt->second;
-                if (notFirstReturn)
-                    for (const auto& vrentry: srcRdata.rbwSSAIdMap)
-                        if (rdata.rbwSSAIdMap.find(vrentry.first)==rdata.rbwSSAIdMap.end())
-                            vregsNotInAllRets.insert(vrentry.first);
+                // join source routine: first rbw ssaIds and vidxes
+                for (const auto& vrentry: srcRdata->rbwSSAIdMap)
+                    if (rbwSSAIdMap.insert(vrentry.first, vrentry.second) &&
+                        notFirstReturn)
+                        // update svregs 'not in all returns'
+                        vregsNotInAllRets.insert(vrentry.first, 0);
+                const VIdxSetEntry& srcVars = ls.vidxRoutineMap[srcRoutBlock];
+                for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+                    for (size_t vidx: srcVars.vs[r])
+                        pushVIdx(routineVIdxes.vs[r], vidx);
                 
-                joinRoutineDataLv(rdata, routineVIdxes, curSVRegMap, entry,
-                        srcRdata, ls.vidxRoutineMap.find(srcRoutBlock)->second);
+                // join source lastAccessMap with curSVRegMap
+                for (const auto& sentry: srcRdata->lastAccessMap)
+                {
+                    LastAccessBlockPos* curAccess = curSVRegMap.find(sentry.first);
+                    if (curAccess != nullptr)
+                    {   // present in map
+                        if (curAccess->blockIndex != entry.blockIndex)
+                            entry.prevCurSVRegs.push_back({ sentry.first, *curAccess });
+                        // otherwise, it is same code block but inside routines
+                        // and do not change prevCurSVRegs for revert
+                        // update entry
+                        *curAccess = { entry.blockIndex, true };
+                    }
+                    else
+                    {
+                        curSVRegMap.insert(sentry.first, { entry.blockIndex, true });
+                        entry.prevCurSVRegs.push_back({ sentry.first, { SIZE_MAX, true } });
+                    }
+                }
             }
         }
         
@@ -1116,13 +1261,13 @@ static void createRoutineDataLv(LivenessState& ls, RoutineDataLv& rdata,
             {
                 // handle return
                 // add curSVReg access positions to lastAccessMap
-                for (const auto& entry: curSVRegMap)
-                {
-                    auto res = rdata.lastAccessMap.insert({ entry.first,
-                                    { entry.second } });
-                    if (!res.second)
-                        res.first->second.insertValue(entry.second);
-                }
+                for (const auto& sentry: curSVRegMap)
+                    if (lastAccessPos.insert(sentry.first, rdata.lastAccessMap.size()))
+                        rdata.lastAccessMap.push_back({ sentry.first,
+                                    { sentry.second } });
+                    else
+                        rdata.lastAccessMap[*lastAccessPos.find(sentry.first)].
+                                second.insertValue(sentry.second);
                 
                 entry.haveReturn = true;
                 haveReturnBlocks.insert(entry.blockIndex);
@@ -1131,34 +1276,35 @@ static void createRoutineDataLv(LivenessState& ls, RoutineDataLv& rdata,
             // handle vidxes not in all paths (both end and returns)
             if (cblock.haveReturn || cblock.haveEnd)
             {
-                for (const auto& entry: curSVRegMap)
-                    if (!notFirstReturn)
-                        // fill up vregs for first return
-                        vregsInFirstReturn.insert(entry.first);
+                if (!notFirstReturn)
+                    // fill up vregs for first return
+                    for (const auto& sentry: curSVRegMap)
+                        vregsInFirstReturn.insert(sentry.first, 0);
                 if (notFirstReturn && cblock.haveReturn)
-                    for (const AsmSingleVReg& vreg: vregsInFirstReturn)
-                        if (curSVRegMap.find(vreg) == curSVRegMap.end())
+                    for (const auto& sentry: vregsInFirstReturn)
+                        if (curSVRegMap.find(sentry.first) == nullptr)
                             // not found in this path then add to 'not in all paths'
-                            vregsNotInAllRets.insert(vreg);
+                            vregsNotInAllRets.insert(sentry.first, 0);
                 notFirstReturn = true;
             }
             
             const bool curHaveReturn = entry.haveReturn;
             
-            // revert curSVRegMap
-            for (const auto& sentry: entry.prevCurSVRegMap)
-                if (sentry.second.blockIndex != SIZE_MAX)
-                    curSVRegMap.find(sentry.first)->second = sentry.second;
+            // revert curSVRegMap (in reverse order to restore first saved accesses)
+            for (auto it = entry.prevCurSVRegs.rbegin();
+                        it != entry.prevCurSVRegs.rend(); ++it)
+                if (it->second.blockIndex != SIZE_MAX)
+                    *curSVRegMap.find(it->first) = it->second;
                 else // no before that
-                    curSVRegMap.erase(sentry.first);
+                    curSVRegMap.erase(it->first);
             
-            for (const auto& sentry: cblock.ssaInfoMap)
+            for (size_t svId: ls.blockSVIds[entry.blockIndex])
             {
-                auto it = alreadyReadMap.find(sentry.first);
-                if (it != alreadyReadMap.end() && it->second == entry.blockIndex)
+                const size_t* srcBlock = alreadyReadMap.find(svId);
+                if (srcBlock != nullptr && *srcBlock == entry.blockIndex)
                     // remove old to resolve in leaved way to allow collecting next ssaId
                     // before write (can be different due to earlier visit)
-                    alreadyReadMap.erase(it);
+                    alreadyReadMap.erase(svId);
             }
             ARDOut << "  popjoin\n";
             flowStack.pop_back();
@@ -1175,27 +1321,33 @@ static void createRoutineDataLv(LivenessState& ls, RoutineDataLv& rdata,
     // handle unused svregs in this path (from routine start) and
     // used other paths and have this same ssaId as at routine start.
     // just add to lastAccessMap svreg for start to join through all routine
-    for (const AsmSingleVReg& svreg: vregsNotInAllRets)
-    {
-        auto res = rdata.lastAccessMap.insert({ svreg, { { routineBlock, false } } });
-        if (!res.second)
-        {
-            VectorSet<LastAccessBlockPos>& sset = res.first->second;
-            sset.insertValue({ routineBlock, false });
-        }
-    }
+    for (const auto& sentry: vregsNotInAllRets)
+        if (lastAccessPos.insert(sentry.first, rdata.lastAccessMap.size()))
+            rdata.lastAccessMap.push_back({ sentry.first, { { routineBlock, false } } });
+        else
+            rdata.lastAccessMap[*lastAccessPos.find(sentry.first)].second.insertValue(
+                        { routineBlock, false });
+    
+    // store results (sorted by svreg id)
+    rbwSSAIdMap.store(rdata.rbwSSAIdMap);
+    mapSort(rdata.rbwSSAIdMap.begin(), rdata.rbwSSAIdMap.end());
+    mapSort(rdata.lastAccessMap.begin(), rdata.lastAccessMap.end());
+    for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+        sortVIdxes(routineVIdxes.vs[r]);
+    
+    alreadyReadMap.clear();
+    vregsNotInAllRets.clear();
+    vregsInFirstReturn.clear();
+    rbwSSAIdMap.clear();
+    lastAccessPos.clear();
+    curSVRegMap.clear();
 }
 
-static inline void revertLastSVReg(LastVRegMap& lastVRegMap, const AsmSingleVReg& svreg)
+static inline void revertLastSVReg(LastVRegMap& lastVRegMap, size_t svId)
 {
-    auto lvrit = lastVRegMap.find(svreg);
-    if (lvrit != lastVRegMap.end())
-    {
-        std::vector<LastVRegStackPos>& lastPos = lvrit->second;
+    std::vector<LastVRegStackPos>& lastPos = lastVRegMap[svId];
+    if (!lastPos.empty())
         lastPos.pop_back();
-        if (lastPos.empty()) // just remove from lastVRegs
-            lastVRegMap.erase(lvrit);
-    }
 }
 
 void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
@@ -1205,17 +1357,46 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
     // construct var index maps
     cxuint regRanges[MAX_REGTYPES_NUM*2];
     std::fill(graphVregsCounts, graphVregsCounts+MAX_REGTYPES_NUM, size_t(0));
-    size_t regTypesNum;
     assembler.isaAssembler->getRegisterRanges(regTypesNum, regRanges);
     
+    // numbering svregs (svreg ids in svregs order)
+    std::vector<AsmSingleVReg> svregs;
     for (const CodeBlock& cblock: codeBlocks)
         for (const auto& entry: cblock.ssaInfoMap)
+            svregs.push_back(entry.first);
+    std::sort(svregs.begin(), svregs.end());
+    svregs.resize(std::unique(svregs.begin(), svregs.end()) - svregs.begin());
+    const size_t svregsNum = svregs.size();
+    
+    std::vector<Array<size_t> > blockSVIds(codeBlocks.size());
+    for (size_t bi = 0; bi < codeBlocks.size(); bi++)
+    {
+        const CodeBlock& cblock = codeBlocks[bi];
+        Array<size_t>& svIds = blockSVIds[bi];
+        svIds.resize(cblock.ssaInfoMap.size());
+        // ssaInfoMap is sorted, hence search only in rest of svregs
+        auto svit = svregs.begin();
+        for (size_t i = 0; i < cblock.ssaInfoMap.size(); i++)
+        {
+            svit = std::lower_bound(svit, svregs.end(), cblock.ssaInfoMap[i].first);
+            svIds[i] = svit - svregs.begin();
+        }
+    }
+    
+    std::vector<cxuint> svregTypes(svregsNum);
+    for (size_t svId = 0; svId < svregsNum; svId++)
+        svregTypes[svId] = getRegType(regTypesNum, regRanges, svregs[svId]);
+    
+    std::vector<std::vector<size_t> > svregVIdxes(svregsNum);
+    for (size_t bi = 0; bi < codeBlocks.size(); bi++)
+    {
+        const CodeBlock& cblock = codeBlocks[bi];
+        for (size_t i = 0; i < cblock.ssaInfoMap.size(); i++)
         {
-            const SSAInfo& sinfo = entry.second;
-            cxuint regType = getRegType(regTypesNum, regRanges, entry.first);
-            VarIndexMap& vregIndices = vregIndexMaps[regType];
-            size_t& graphVregsCount = graphVregsCounts[regType];
-            std::vector<size_t>& vidxes = vregIndices[entry.first];
+            const size_t svId = blockSVIds[bi][i];
+            const SSAInfo& sinfo = cblock.ssaInfoMap[i].second;
+            size_t& graphVregsCount = graphVregsCounts[svregTypes[svId]];
+            std::vector<size_t>& vidxes = svregVIdxes[svId];
             size_t ssaIdCount = 0;
             if (sinfo.readBeforeWrite)
                 ssaIdCount = sinfo.ssaIdBefore+1;
@@ -1227,7 +1408,7 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
             }
             // if not readBeforeWrite and neither ssaIdChanges but it is write to
             // normal register
-            if (entry.first.regVar==nullptr)
+            if (svregs[svId].regVar==nullptr)
                 ssaIdCount = 1;
             
             if (vidxes.size() < ssaIdCount)
@@ -1252,16 +1433,17 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
             }
             // if not readBeforeWrite and neither ssaIdChanges but it is write to
             // normal register
-            if (entry.first.regVar==nullptr && vidxes[0] == SIZE_MAX)
+            if (svregs[svId].regVar==nullptr && vidxes[0] == SIZE_MAX)
                 vidxes[0] = graphVregsCount++;
         }
+    }
     
     // construct vreg liveness
     std::deque<CallStackEntry> callStack;
     std::deque<FlowStackEntry3> flowStack;
     CBlockBitPool visited(codeBlocks.size(), false);
     // hold last vreg ssaId and position
-    LastVRegMap lastVRegMap;
+    LastVRegMap lastVRegMap(svregsNum);
     
     // key - current res first key, value - previous first key and its flowStack pos
     PrevWaysIndexMap prevWaysIndexMap;
@@ -1275,8 +1457,13 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
     size_t rbwCount = 0;
     size_t wrCount = 0;
     
-    RoutineLvMap routineMap;
+    RoutineLvMap routineMap(codeBlocks.size());
     std::vector<Liveness> livenesses[MAX_REGTYPES_NUM];
+    vidxCallMap.assign(codeBlocks.size(), VIdxSetEntry());
+    vidxRoutineMap.assign(codeBlocks.size(), VIdxSetEntry());
+    // svreg stamps (to skip svregs already handled for current block)
+    std::vector<size_t> svregStamps(svregsNum, SIZE_MAX);
+    size_t curStamp = 0;
     
     for (size_t i = 0; i < regTypesNum; i++)
         livenesses[i].resize(graphVregsCounts[i]);
@@ -1287,10 +1474,12 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
     size_t curLiveTime = 0;
     flowStack.push_back({ 0, 0 });
     
+    std::unique_ptr<RoutineLvTemps> routineTemps(new RoutineLvTemps(svregsNum));
     // structure to pass many arguments in compact pack
     LivenessState ls = { flowStack, codeBlocks, waysToCache, cblocksToCache,
-        prevWaysIndexMap, livenesses, vregIndexMaps, vidxCallMap, vidxRoutineMap,
-        routineMap, regTypesNum, regRanges };
+        prevWaysIndexMap, livenesses, blockSVIds, svregs, svregTypes, svregVIdxes,
+        vidxCallMap, vidxRoutineMap, routineMap,
+        routineTemps.get(), nullptr };
     
     const size_t linearDepSize = linDepHandler.size();
     
@@ -1310,28 +1499,27 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
                 if (flowStack.size() > 1)
                     putCrossBlockLivenesses(ls, lastVRegMap);
                 // update last vreg position
-                for (const auto& sentry: cblock.ssaInfoMap)
+                const Array<size_t>& svIds = blockSVIds[entry.blockIndex.index];
+                for (size_t i = 0; i < svIds.size(); i++)
                 {
-                    // update
-                    auto res = lastVRegMap.insert({ sentry.first,
-                                { { flowStack.size()-1, false } } });
-                    if (!res.second) // if not first seen, just update
-                        // update last
-                        res.first->second.push_back({ flowStack.size()-1, false });
+                    // update last
+                    lastVRegMap[svIds[i]].push_back({ flowStack.size()-1, false });
                     
                     // count read before writes (for cache weight)
-                    if (sentry.second.readBeforeWrite)
+                    if (cblock.ssaInfoMap[i].second.readBeforeWrite)
                         rbwCount++;
-                    if (sentry.second.ssaIdChange!=0)
+                    if (cblock.ssaInfoMap[i].second.ssaIdChange!=0)
                         wrCount++;
                 }
                 
                 // main routine to handle ssaInfos
-                SVRegMap ssaIdIdxMap;
+                // ssaIdIdx for every ssaInfoMap entry (SIZE_MAX if not used yet)
+                std::vector<size_t> ssaIdIdxs(cblock.ssaInfoMap.size(), SIZE_MAX);
                 std::vector<AsmRegVarUsage> instrRVUs;
                 
-                std::vector<AsmSingleVReg> readSVRegs;
-                std::vector<AsmSingleVReg> writtenSVRegs;
+                // indices of ssaInfoMap entries
+                std::vector<size_t> readSVRegs;
+                std::vector<size_t> writtenSVRegs;
                 
                 ISAUsageHandler::ReadPos usagePos = cblock.usagePos;
                 size_t oldOffset = usageHandler.hasNext(usagePos) ?
@@ -1360,26 +1548,29 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
                     {
                         ARDOut << "apply to liveness. offset: " << oldOffset << "\n";
                         // apply to liveness
-                        for (AsmSingleVReg svreg: readSVRegs)
+                        for (size_t sinfoIdx: readSVRegs)
                         {
-                            auto svrres = ssaIdIdxMap.insert({ svreg, 0 });
-                            Liveness& lv = getLiveness(svreg, svrres.first->second,
-                                    binaryMapFind(cblock.ssaInfoMap.begin(),
-                                        cblock.ssaInfoMap.end(), svreg)->second, ls);
-                            if (svrres.second)
+                            const bool firstUse = ssaIdIdxs[sinfoIdx] == SIZE_MAX;
+                            if (firstUse)
+                                ssaIdIdxs[sinfoIdx] = 0;
+                            Liveness& lv = getLiveness(svIds[sinfoIdx],
+                                    ssaIdIdxs[sinfoIdx],
+                                    cblock.ssaInfoMap[sinfoIdx].second, ls);
+                            if (firstUse)
                                 // begin region from this block
                                 lv.insert(curLiveTime, liveTime+1);
                             else
                                 lv.expand(liveTime+1);
                         }
-                        for (AsmSingleVReg svreg: writtenSVRegs)
+                        for (size_t sinfoIdx: writtenSVRegs)
                         {
-                            size_t& ssaIdIdx = ssaIdIdxMap[svreg];
-                            if (svreg.regVar != nullptr)
+                            size_t& ssaIdIdx = ssaIdIdxs[sinfoIdx];
+                            if (ssaIdIdx == SIZE_MAX)
+                                ssaIdIdx = 0;
+                            if (svregs[svIds[sinfoIdx]].regVar != nullptr)
                                 ssaIdIdx++;
-                            SSAInfo& sinfo = binaryMapFind(cblock.ssaInfoMap.begin(),
-                                        cblock.ssaInfoMap.end(), svreg)->second;
-                            Liveness& lv = getLiveness(svreg, ssaIdIdx, sinfo, ls);
+                            Liveness& lv = getLiveness(svIds[sinfoIdx], ssaIdIdx,
+                                        cblock.ssaInfoMap[sinfoIdx].second, ls);
                             // works only with ISA where smallest instruction have 2 bytes!
                             // after previous read, but not after instruction.
                             // if var is not used anywhere then this liveness region
@@ -1419,9 +1610,10 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
                                     instrRVUs.data(), lDeps);
                         
                         if (!addUsageDeps(lDeps, instrRVUs, instrLinDeps, linearDepMaps,
-                                cblock.ssaInfoMap, ssaIdIdxMap,
+                                entry.blockIndex.index, ssaIdIdxs,
                                 readSVRegs, writtenSVRegs, ls))
-                            assembler.printError(nullptr, "Linear deps failed");
+                            // reported later by caller (can be in worker thread)
+                            linearDepErrors.push_back(oldOffset);
                         
                         readSVRegs.clear();
                         writtenSVRegs.clear();
@@ -1438,11 +1630,12 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
                     for (uint16_t rindex = rvu.rstart; rindex < rvu.rend; rindex++)
                     {
                         // per register/singlvreg
-                        AsmSingleVReg svreg{ rvu.regVar, rindex };
+                        const size_t sinfoIdx = findSSAInfoIndex(cblock,
+                                    { rvu.regVar, rindex });
                         if (checkWriteWithSSA(rvu))
-                            writtenSVRegs.push_back(svreg);
+                            writtenSVRegs.push_back(sinfoIdx);
                         else // read or treat as reading // expand previous region
-                            readSVRegs.push_back(svreg);
+                            readSVRegs.push_back(sinfoIdx);
                     }
                 }
             }
@@ -1477,7 +1670,10 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
         {
             ARDOut << " ret: " << entry.blockIndex << "\n";
             const BlockIndex routineBlock = callStack.back().routineBlock;
-            auto res = routineMap.insert({ routineBlock.index, { } });
+            std::unique_ptr<RoutineDataLv>& rdata = routineMap[routineBlock.index];
+            const bool added = (rdata == nullptr);
+            if (added)
+                rdata.reset(new RoutineDataLv);
             
             // while second pass in recursion: the routine's insertion was happened
             // later in first pass (after return from second pass)
@@ -1486,25 +1682,20 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
             //           (fromSecondPass && rblock.pass==0 avoids
             //            doubles creating in second pass)
             //        create in first pass recursion
-            if (res.second || (res.first->second.fromSecondPass && routineBlock.pass==0))
+            if (added || (rdata->fromSecondPass && routineBlock.pass==0))
             {
-                res.first->second.fromSecondPass = routineBlock.pass==1;
-                auto varRes = vidxRoutineMap.insert({ routineBlock.index, VIdxSetEntry{} });
-                createRoutineDataLv(ls, res.first->second, varRes.first->second,
-                        routineBlock.index);
+                rdata->fromSecondPass = routineBlock.pass==1;
+                VIdxSetEntry& routineVIdxes = vidxRoutineMap[routineBlock.index];
+                routineVIdxes.used = true;
+                createRoutineDataLv(ls, *rdata, routineVIdxes, routineBlock.index);
             }
             else
             {
                 // already added join livenesses from all readBeforeWrites
-                for (const auto& entry: res.first->second.rbwSSAIdMap)
-                {
+                for (const auto& rbwEntry: rdata->rbwSSAIdMap)
                     // find last
-                    auto lvrit = lastVRegMap.find(entry.first);
-                    LastVRegStackPos flowStackStart = (lvrit != lastVRegMap.end()) ?
-                            lvrit->second.back() : LastVRegStackPos{ 0, false };
-                    
-                    joinVRegRecur(ls, flowStackStart, entry.first, entry.second, false);
-                }
+                    joinVRegRecur(ls, getLastVRegStackPos(lastVRegMap, rbwEntry.first),
+                                rbwEntry.first, rbwEntry.second, false);
             }
             callBlocks.erase(routineBlock);
             callStack.pop_back(); // just return from call
@@ -1553,24 +1744,20 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
         {
             if (entry.nextIndex!=0) // if back from calls (just return from calls)
             {
-                std::unordered_set<AsmSingleVReg> regSVRegs;
+                curStamp++;
                 // just add last access of svreg from call routines to lastVRegMap
                 // and join svregs from routine with svreg used at this time
                 for (const NextBlock& next: cblock.nexts)
                     if (next.isCall)
                     {
-                        auto rit = routineMap.find(next.block);
-                        if (rit == routineMap.end())
+                        const RoutineDataLv* rdata = routineMap[next.block].get();
+                        if (rdata == nullptr)
                             continue;
-                        const RoutineDataLv& rdata = rit->second;
-                        for (const auto& entry: rdata.lastAccessMap)
-                            if (regSVRegs.insert(entry.first).second)
+                        for (const auto& laEntry: rdata->lastAccessMap)
+                            if (svregStamps[laEntry.first] != curStamp)
                             {
-                                auto res = lastVRegMap.insert({ entry.first,
-                                        { { flowStack.size()-1, true } } });
-                                if (!res.second) // if not first seen, just update
-                                    // update last
-                                    res.first->second.push_back(
+                                svregStamps[laEntry.first] = curStamp;
+                                lastVRegMap[laEntry.first].push_back(
                                                 { flowStack.size()-1, true });
                             }
                     }
@@ -1585,21 +1772,23 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
             flowStack.pop_back();
             
             // revert lastVRegs in call
-            std::unordered_set<AsmSingleVReg> revertedSVRegs;
+            curStamp++;
             for (const NextBlock& next: cblock.nexts)
                 if (next.isCall)
                 {
-                    auto rit = routineMap.find(next.block);
-                    if (rit == routineMap.end())
+                    const RoutineDataLv* rdata = routineMap[next.block].get();
+                    if (rdata == nullptr)
                         continue;
-                    const RoutineDataLv& rdata = rit->second;
-                    for (const auto& entry: rdata.lastAccessMap)
-                        if (revertedSVRegs.insert(entry.first).second)
-                            revertLastSVReg(lastVRegMap, entry.first);
+                    for (const auto& laEntry: rdata->lastAccessMap)
+                        if (svregStamps[laEntry.first] != curStamp)
+                        {
+                            svregStamps[laEntry.first] = curStamp;
+                            revertLastSVReg(lastVRegMap, laEntry.first);
+                        }
                 }
             
-            for (const auto& sentry: cblock.ssaInfoMap)
-                revertLastSVReg(lastVRegMap, sentry.first);
+            for (size_t svId: blockSVIds[entry.blockIndex.index])
+                revertLastSVReg(lastVRegMap, svId);
             
             if (!flowStack.empty() && lastCommonCacheWayPoint.first != SIZE_MAX &&
                     lastCommonCacheWayPoint.second >= flowStack.size() &&
@@ -1612,11 +1801,19 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
         }
     }
     
+    // free memory used by first pass
+    routineTemps.reset();
+    ls.routineTemps = nullptr;
+    std::vector<size_t>().swap(svregStamps);
+    LastVRegMap().swap(lastVRegMap);
+    JoinLvTemps joinTemps(svregsNum);
+    ls.joinTemps = &joinTemps;
+    
     // after, that resolve joins (join with already visited code)
-    // SVRegMap in this cache: key - vreg, value - last flowStack entry position
+    // LastStackPosMap in this cache: key - vreg, value - last flowStack entry position
     SimpleCache<size_t, LastStackPosMap> joinFirstPointsCache(wrCount<<1);
-    // SVRegMap in this cache: key - vreg, value - first readBefore in second part
-    SimpleCache<size_t, SVRegMap> joinSecondPointsCache(rbwCount<<1);
+    // SVIdSSAIdMap in this cache: key - vreg, value - first readBefore in second part
+    SimpleCache<size_t, SVIdSSAIdMap> joinSecondPointsCache(rbwCount<<1);
     
     flowStack.clear();
     std::fill(visited.begin(), visited.end(), false);
@@ -1665,6 +1862,15 @@ void AsmRegAllocator::createLivenesses(ISAUsageHandler& usageHandler,
         }
     }
     
+    // sort vidxes in call entries
+    for (VIdxSetEntry& callEntry: vidxCallMap)
+        for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+            sortVIdxes(callEntry.vs[r]);
+    
+    // move vidxes to vregIndexMaps
+    for (size_t svId = 0; svId < svregsNum; svId++)
+        vregIndexMaps[svregTypes[svId]][svregs[svId]] = std::move(svregVIdxes[svId]);
+    
     // move livenesses to AsmRegAllocator outLivenesses
     for (size_t regType = 0; regType < regTypesNum; regType++)
     {
@@ -112,6 +112,155 @@ void AsmMacro::addLine(RefPtr<const AsmMacroSubst> macro, RefPtr<const AsmSource
     contentLineNo++;
 }
 
+/* compile macro content to text parts and substitutions of arguments. it follows
+ * AsmMacroInputFilter::readLine without altmacro mode, but destination positions
+ * are stored as text position and number of substitutions before it */
+void AsmMacro::compile()
+{
+    compiledLines.clear();
+    lineParts.clear();
+    linePartTrans.clear();
+    if (colTranslations.empty())
+        return; // no lines
+    // argument map in filter is sorted by name, we find index in this order
+    Array<CString> sortedArgNames(args.size());
+    for (size_t i = 0; i < args.size(); i++)
+        sortedArgNames[i] = args[i].name;
+    std::sort(sortedArgNames.begin(), sortedArgNames.end());
+    
+    const char* text = content.data();
+    const size_t contentSize = content.size();
+    const LineTrans* curColTrans = colTranslations.data();
+    const LineTrans* colTransEnd = colTranslations.data() + colTranslations.size();
+    size_t pos = 0;
+    while (pos < contentSize)
+    {
+        CompiledLine cline{};
+        cline.firstLineNo = curColTrans->lineNo;
+        size_t nextLinePos = pos;
+        while (nextLinePos < contentSize && text[nextLinePos] != '\n')
+            nextLinePos++;
+    
+        const size_t linePos = pos;
+        size_t textPos = 0; // destination position without substitutions
+        size_t slotsNum = 0;
+        size_t toCopyPos = pos;
+        size_t colTransThreshold = (curColTrans+1 != colTransEnd) ?
+                (curColTrans[1].position>0 ? curColTrans[1].position + linePos :
+                        nextLinePos) : SIZE_MAX;
+    
+        auto addText = [this, &textPos](size_t textStart, size_t textSize)
+        {
+            if (!lineParts.empty() && lineParts.back().type == PartType::TEXT &&
+                lineParts.size() > (compiledLines.empty() ? 0 :
+                        compiledLines.back().partsEnd) &&
+                lineParts.back().pos + lineParts.back().size == textStart)
+                lineParts.back().size += textSize; // join with previous text
+            else
+                lineParts.push_back({ PartType::TEXT, textStart, textSize });
+            textPos += textSize;
+        };
+        auto nextColTrans = [&](size_t destPos)
+        {
+            curColTrans++;
+            linePartTrans.push_back({ destPos, slotsNum, curColTrans->lineNo });
+            if (curColTrans->position >= 0)
+            {
+                /// real new line, reset real line position
+                cline.resetLinePos = true;
+                cline.lineStartTextPos = destPos;
+                cline.lineStartSlotsNum = slotsNum;
+            }
+            colTransThreshold = (curColTrans+1 != colTransEnd) ?
+                    (curColTrans[1].position>0 ? curColTrans[1].position + linePos :
+                            nextLinePos) : SIZE_MAX;
+        };
+    
+        while (pos < contentSize && text[pos] != '\n')
+        {
+            if (pos >= colTransThreshold)
+                nextColTrans(textPos + pos-toCopyPos);
+            if (text[pos] != '\\')
+            {
+                pos++;
+                continue;
+            }
+            // backslash: copy previous text and try to parse substitution
+            if (pos > toCopyPos)
+                addText(toCopyPos, pos-toCopyPos);
+            pos++;
+            bool skipColTransBetweenMacroArg = true;
+            if (pos < contentSize)
+            {
+                if (text[pos] == '(' && pos+1 < contentSize && text[pos+1]==')')
+                    pos += 2;   // skip this separator
+                else
+                {
+                    const char* thisPos = text + pos;
+                    const CString symName = extractSymName(thisPos, text+contentSize,
+                                false);
+                    const CString* argIt = sortedArgNames.end();
+                    if (!symName.empty())
+                        argIt = binaryFind(sortedArgNames.begin(), sortedArgNames.end(),
+                                    symName);
+                    if (argIt != sortedArgNames.end())
+                    {
+                        lineParts.push_back({ PartType::ARG,
+                                size_t(argIt - sortedArgNames.begin()), 0 });
+                        slotsNum++;
+                        pos = thisPos-text;
+                    }
+                    else if (text[pos] == '@')
+                    {
+                        lineParts.push_back({ PartType::COUNTER, 0, 0 });
+                        slotsNum++;
+                        pos++;
+                    }
+                    else
+                    {
+                        // no substitution, put backslash
+                        addText(pos-1, 1);
+                        skipColTransBetweenMacroArg = false;
+                    }
+                }
+            }
+            toCopyPos = pos;
+            // skip colTrans between macroarg or separator
+            if (skipColTransBetweenMacroArg)
+                while (pos > colTransThreshold)
+                {
+                    curColTrans++;
+                    if (curColTrans->position >= 0)
+                    {
+                        /// real new line, reset real line position
+                        cline.resetLinePos = true;
+                        cline.lineStartTextPos = textPos;
+                        cline.lineStartSlotsNum = slotsNum;
+                    }
+                    colTransThreshold = (curColTrans+1 != colTransEnd) ?
+                            curColTrans[1].position : SIZE_MAX;
+                }
+        }
+        // rest of line
+        if (pos > toCopyPos)
+            addText(toCopyPos, pos-toCopyPos);
+        if (pos < contentSize)
+        {
+            if (curColTrans+1 != colTransEnd)
+            {
+                curColTrans++;
+                cline.nextLinePos = (curColTrans->position >= 0) ? 1 : 2;
+            }
+            pos++; // skip newline
+        }
+        cline.lineNo = curColTrans->lineNo;
+        cline.nextPos = pos;
+        cline.partsEnd = lineParts.size();
+        cline.colTransEnd = linePartTrans.size();
+        compiledLines.push_back(cline);
+    }
+}
+
 /* Asm Repeat */
 AsmRepeat::AsmRepeat(const AsmSourcePos& _pos, uint64_t _repeatsNum)
         : contentLineNo(0), sourcePos(_pos), repeatsNum(_repeatsNum)
@@ -162,11 +311,28 @@ AsmIRP::AsmIRP(const AsmSourcePos& _pos, const CString& _symbolName,
           symbolName(_symbolName), symValues({_symValString})
 { }
 
+void AsmCachedStmt::set(Type _type, const char* line, size_t lineSize,
+            const char* stmtPlace, const char* argsPlace, const CString& _name, size_t _id)
+{
+    type = _type;
+    stmtPos = stmtPlace - line;
+    argsPos = argsPlace - line;
+    // include first character of arguments (or nothing if end of line)
+    prefix.assign(line, std::min(argsPos+1, lineSize));
+    name = _name;
+    id = _id;
+}
+
 /* AsmInputFilter */
 
 AsmInputFilter::~AsmInputFilter()
 { }
 
+AsmCachedStmt* AsmInputFilter::getCachedStmt()
+{
+    return nullptr;
+}
+
 LineCol AsmInputFilter::translatePos(size_t position) const
 {
     // find in reverse order with reverse comparison:
@@ -184,40 +350,78 @@ LineCol AsmInputFilter::translatePos(size_t position) const
 
 static const size_t AsmParserLineMaxSize = 200;
 
+// open source file: map it if regular file, otherwise open stream
+void AsmStreamInputFilter::openFile(const CString& filename)
+{
+    try
+    {
+        mappedFile = new MappedFile();
+        if (mappedFile->map(filename.c_str()))
+        {
+            content = reinterpret_cast<const char*>(mappedFile->getContent());
+            contentSize = mappedFile->getSize();
+            return;
+        }
+    }
+    catch(const Exception& ex)
+    {
+        throw AsmException(std::string("Can't open source file '")+
+                    filename.c_str()+"'");
+    }
+    // if not regular file (pipe or device)
+    delete mappedFile;
+    mappedFile = nullptr;
+    stream = new std::ifstream(filename.c_str(), std::ios::binary);
+    if (!*stream)
+        throw AsmException(std::string("Can't open source file '")+
+                filename.c_str()+"'");
+    stream->exceptions(std::ios::badbit);
+}
+
 AsmStreamInputFilter::AsmStreamInputFilter(const CString& filename)
     : AsmInputFilter(AsmInputFilterType::STREAM), managed(true),
-        stream(nullptr), mode(LineMode::NORMAL), stmtPos(0)
+        stream(nullptr), mappedFile(nullptr), content(nullptr),
+        contentSize(0), contentPos(0),
+        mode(LineMode::NORMAL), stmtPos(0)
 {
     try
     {
         source = RefPtr<const AsmSource>(new AsmFile(filename));
-        stream = new std::ifstream(filename.c_str(), std::ios::binary);
-        if (!*stream)
-            throw AsmException(std::string("Can't open source file '")+
-                    filename.c_str()+"'");
-        stream->exceptions(std::ios::badbit);
+        openFile(filename);
         buffer.reserve(AsmParserLineMaxSize);
     }
     catch(...)
     {
         delete stream;
+        delete mappedFile;
         throw;
     }
 }
 
 AsmStreamInputFilter::AsmStreamInputFilter(std::istream& is, const CString& filename)
     : AsmInputFilter(AsmInputFilterType::STREAM),
-      managed(false), stream(&is), mode(LineMode::NORMAL), stmtPos(0)
+      managed(false), stream(&is), mappedFile(nullptr), content(nullptr),
+      contentSize(0), contentPos(0), mode(LineMode::NORMAL), stmtPos(0)
 {
     source = RefPtr<const AsmSource>(new AsmFile(filename));
     stream->exceptions(std::ios::badbit);
     buffer.reserve(AsmParserLineMaxSize);
 }
 
+AsmStreamInputFilter::AsmStreamInputFilter(size_t sourceSize, const char* sourceCode,
+            const CString& filename) : AsmInputFilter(AsmInputFilterType::STREAM),
+      managed(false), stream(nullptr), mappedFile(nullptr), content(sourceCode),
+      contentSize(sourceSize), contentPos(0), mode(LineMode::NORMAL), stmtPos(0)
+{
+    source = RefPtr<const AsmSource>(new AsmFile(filename));
+    buffer.reserve(AsmParserLineMaxSize);
+}
+
 AsmStreamInputFilter::AsmStreamInputFilter(const AsmSourcePos& pos,
            const CString& filename)
     : AsmInputFilter(AsmInputFilterType::STREAM),
-      managed(true), stream(nullptr), mode(LineMode::NORMAL), stmtPos(0)
+      managed(true), stream(nullptr), mappedFile(nullptr), content(nullptr),
+      contentSize(0), contentPos(0), mode(LineMode::NORMAL), stmtPos(0)
 {
     try
     {
@@ -230,23 +434,22 @@ AsmStreamInputFilter::AsmStreamInputFilter(const AsmSourcePos& pos,
                      pos.lineNo, pos.colNo, filename));
         
         // open file
-        stream = new std::ifstream(filename.c_str(), std::ios::binary);
-        if (!*stream)
-            throw AsmException(std::string("Can't open source file '")+
-                        filename.c_str()+"'");
-        stream->exceptions(std::ios::badbit);
+        openFile(filename);
         buffer.reserve(AsmParserLineMaxSize);
     }
     catch(...)
     {
         delete stream;
+        delete mappedFile;
         throw;
     }
 }
 
 AsmStreamInputFilter::AsmStreamInputFilter(const AsmSourcePos& pos, std::istream& is,
         const CString& filename) : AsmInputFilter(AsmInputFilterType::STREAM),
-        managed(false), stream(&is), mode(LineMode::NORMAL), stmtPos(0)
+        managed(false), stream(&is), mappedFile(nullptr), content(nullptr),
+        contentSize(0), contentPos(0),
+        mode(LineMode::NORMAL), stmtPos(0)
 {
     if (!pos.macro)
         source = RefPtr<const AsmSource>(new AsmFile(pos.source, pos.lineNo,
@@ -263,11 +466,75 @@ AsmStreamInputFilter::~AsmStreamInputFilter()
 {
     if (managed)
         delete stream;
+    delete mappedFile;
+}
+
+// characters that require filtering (comments, strings, splitting, non-space chars)
+static inline bool isAsmSourceSpecialChar(cxbyte c)
+{
+    return c < 32 || c == '#' || c == ';' || c == '"' || c == '\'' || c == '\\';
+}
+
+/* try to get line directly from source in memory. returns nullptr and leave
+ * position unchanged if line requires filtering */
+const char* AsmStreamInputFilter::readContentLine(size_t& lineSize)
+{
+    const char* lineStart = content + contentPos;
+    const char* end = content + contentSize;
+    const char* lineEnd = (const char*)::memchr(lineStart, '\n', end-lineStart);
+    if (lineEnd == nullptr)
+        lineEnd = end;
+    for (const char* p = lineStart; p != lineEnd; p++)
+        if (isAsmSourceSpecialChar(*p) || (*p == '/' && p+1 != lineEnd && p[1] == '*'))
+            return nullptr;
+    
+    colTranslations.push_back({0, lineNo});
+    contentPos = lineEnd - content;
+    if (lineEnd != end)
+    {
+        // skip newline
+        contentPos++;
+        lineNo++;
+    }
+    lineSize = lineEnd - lineStart;
+    return lineStart;
+}
+
+// copy next physical line from source in memory to buffer,
+// returns number of copied bytes
+size_t AsmStreamInputFilter::readContentToBuffer()
+{
+    const char* start = content + contentPos;
+    const size_t remaining = contentSize - contentPos;
+    const char* lineEnd = (const char*)::memchr(start, '\n', remaining);
+    const size_t toCopy = (lineEnd != nullptr) ? lineEnd-start+1 : remaining;
+    const size_t oldSize = buffer.size();
+    buffer.resize(oldSize + toCopy);
+    std::copy(start, start + toCopy, buffer.begin() + oldSize);
+    contentPos += toCopy;
+    return toCopy;
 }
 
 const char* AsmStreamInputFilter::readLine(Assembler& assembler, size_t& lineSize)
 {
     colTranslations.clear();
+    if (content != nullptr && pos == buffer.size() && mode == LineMode::NORMAL &&
+        stmtPos == 0)
+    {
+        // buffer is empty, try to get line directly from source in memory
+        buffer.clear();
+        pos = 0;
+        if (contentPos == contentSize)
+        {
+            // end of file
+            lineSize = 0;
+            return nullptr;
+        }
+        const char* line = readContentLine(lineSize);
+        if (line != nullptr)
+            return line;
+    }
+    
     bool endOfLine = false;
     size_t lineStart = pos;
     size_t joinStart = pos; // join Start - physical line start
@@ -517,12 +784,21 @@ const char* AsmStreamInputFilter::readLine(Assembler& assembler, size_t& lineSiz
                 pos = destPos;
                 lineStart = 0;
             }
-            if (pos == buffer.size())
-                buffer.resize(std::max(AsmParserLineMaxSize, (pos>>1)+pos));
-            
-            stream->read(buffer.data()+pos, buffer.size()-pos);
-            const size_t readed = stream->gcount();
-            buffer.resize(pos+readed);
+            size_t readed;
+            if (content == nullptr)
+            {
+                if (pos == buffer.size())
+                    buffer.resize(std::max(AsmParserLineMaxSize, (pos>>1)+pos));
+                
+                stream->read(buffer.data()+pos, buffer.size()-pos);
+                readed = stream->gcount();
+                buffer.resize(pos+readed);
+            }
+            else
+            {
+                buffer.resize(pos);
+                readed = readContentToBuffer();
+            }
             if (readed == 0)
             {
                 // end of file. check comments
@@ -592,6 +868,10 @@ const char* AsmMacroInputFilter::readLine(Assembler& assembler, size_t& lineSize
         return nullptr;
     }
     
+    // without altmacro mode, just put arguments into compiled macro lines
+    if (!alternateMacro && !macro->getCompiledLines().empty())
+        return readCompiledLine(lineSize);
+    
     const char* content = macro->getContent().data();
     
     size_t nextLinePos = pos;
@@ -875,16 +1155,7 @@ const char* AsmMacroInputFilter::readLine(Assembler& assembler, size_t& lineSize
         pos++; // skip newline
     }
     lineNo = curColTrans->lineNo;
-    // move to next source translation
-    if (sourceTransIndex+1 < macro->getSourceTransSize())
-    {
-        const AsmMacro::SourceTrans& fpos = macro->getSourceTrans(sourceTransIndex+1);
-        if (fpos.lineNo == contentLineNo)
-        {
-            source = fpos.source;
-            sourceTransIndex++;
-        }
-    }
+    nextSourceTrans();
     contentLineNo++;
     if (localStmtStart!=nullptr)
     {
@@ -901,6 +1172,82 @@ const char* AsmMacroInputFilter::readLine(Assembler& assembler, size_t& lineSize
     return (!buffer.empty()) ? buffer.data() : "";
 }
 
+void AsmMacroInputFilter::nextSourceTrans()
+{
+    // move to next source translation
+    if (sourceTransIndex+1 < macro->getSourceTransSize())
+    {
+        const AsmMacro::SourceTrans& fpos = macro->getSourceTrans(sourceTransIndex+1);
+        if (fpos.lineNo == contentLineNo)
+        {
+            source = fpos.source;
+            sourceTransIndex++;
+        }
+    }
+}
+
+const char* AsmMacroInputFilter::readCompiledLine(size_t& lineSize)
+{
+    const AsmMacro::CompiledLine* clines = macro->getCompiledLines().data();
+    const AsmMacro::CompiledLine& cline = clines[contentLineNo];
+    const AsmMacro::LinePart* parts = macro->getLineParts().data();
+    const AsmMacro::LinePartTrans* partTrans = macro->getLinePartTrans().data();
+    const char* content = macro->getContent().data();
+    size_t partIndex = (contentLineNo != 0) ? clines[contentLineNo-1].partsEnd : 0;
+    size_t transIndex = (contentLineNo != 0) ? clines[contentLineNo-1].colTransEnd : 0;
+    
+    colTranslations.push_back({ ssize_t(-realLinePos), cline.firstLineNo });
+    size_t slotsNum = 0;
+    size_t substsSize = 0; // size of substituted values
+    size_t destLineStart = 0;
+    // put column translations placed before next substitution
+    auto putColTrans = [&]()
+    {
+        for (; transIndex < cline.colTransEnd &&
+                    partTrans[transIndex].slotsNum == slotsNum; transIndex++)
+            colTranslations.push_back({ ssize_t(partTrans[transIndex].textPos +
+                        substsSize), partTrans[transIndex].lineNo });
+        if (cline.lineStartSlotsNum == slotsNum)
+            destLineStart = cline.lineStartTextPos + substsSize;
+    };
+    for (; partIndex < cline.partsEnd; partIndex++)
+    {
+        const AsmMacro::LinePart& part = parts[partIndex];
+        if (part.type == AsmMacro::PartType::TEXT)
+        {
+            buffer.insert(buffer.end(), content + part.pos, content + part.pos + part.size);
+            continue;
+        }
+        putColTrans();
+        const size_t oldSize = buffer.size();
+        if (part.type == AsmMacro::PartType::ARG)
+        {
+            const CString& value = argMap[part.pos].second;
+            buffer.insert(buffer.end(), value.begin(), value.begin() + value.size());
+        }
+        else
+        {
+            char numBuf[32];
+            const size_t numLen = itocstrCStyle(macroCount, numBuf, 32);
+            buffer.insert(buffer.end(), numBuf, numBuf+numLen);
+        }
+        substsSize += buffer.size() - oldSize;
+        slotsNum++;
+    }
+    putColTrans();
+    
+    lineSize = buffer.size();
+    if (cline.resetLinePos || cline.nextLinePos == 1)
+        realLinePos = 0;
+    if (cline.nextLinePos == 2)
+        realLinePos += lineSize - destLineStart + 1;
+    pos = cline.nextPos;
+    lineNo = cline.lineNo;
+    nextSourceTrans();
+    contentLineNo++;
+    return (!buffer.empty()) ? buffer.data() : "";
+}
+
 bool AsmMacroInputFilter::addLocal(const CString& name, uint64_t localNo)
 {
     if (binaryMapFind(argMap.begin(), argMap.end(), name) != argMap.end())
@@ -981,6 +1328,16 @@ const char* AsmRepeatInputFilter::readLine(Assembler& assembler, size_t& lineSiz
     return content + oldPos;
 }
 
+AsmCachedStmt* AsmRepeatInputFilter::getCachedStmt()
+{
+    // contentLineNo is number of lines read in current iteration
+    if (contentLineNo == 0)
+        return nullptr;
+    if (cachedStmts.size() < contentLineNo)
+        cachedStmts.resize(contentLineNo);
+    return cachedStmts.data() + contentLineNo-1;
+}
+
 AsmForInputFilter::AsmForInputFilter(const AsmFor* forRpt) :
         AsmRepeatInputFilter(forRpt)
 { }
@@ -1287,6 +1644,16 @@ const char* AsmIRPInputFilter::readLine(Assembler& assembler, size_t& lineSize)
     return (!buffer.empty()) ? buffer.data() : "";
 }
 
+AsmCachedStmt* AsmIRPInputFilter::getCachedStmt()
+{
+    // lines can differ between iterations, then prefix of cached statement mismatches
+    if (contentLineNo == 0)
+        return nullptr;
+    if (cachedStmts.size() < contentLineNo)
+        cachedStmts.resize(contentLineNo);
+    return cachedStmts.data() + contentLineNo-1;
+}
+
 /*
  * source pos
  */
@@ -1562,7 +1929,7 @@ void AsmSourcePosHandler::pushSourcePos(size_t offset, const AsmSourcePos& sourc
             uint16_t(sourcePos.lineNo & 0xffff), uint16_t(sourcePos.colNo & 0xffff) });
 }
 
-std::pair<size_t, AsmSourcePos> AsmSourcePosHandler::nextSourcePos(ReadPos& rPos)
+std::pair<size_t, AsmSourcePos> AsmSourcePosHandler::nextSourcePos(ReadPos& rPos) const
 {
     const Chunk& chunk = chunks[rPos.chunkPos];
     const Item& item = chunk.items[rPos.itemPos];
@@ -18,11 +18,13 @@
  */
 
 #include <CLRX/Config.h>
+#include <string>
 #include <vector>
 #include <cstddef>
 #include <utility>
 #include <algorithm>
 #include <deque>
+#include <iterator>
 #include <unordered_set>
 #include <unordered_map>
 #include <CLRX/utils/Utilities.h>
@@ -69,6 +71,51 @@ ISAWaitHandler::ReadPos ISAWaitHandler::findPositionByOffset(size_t offset) cons
     return ISAWaitHandler::ReadPos{ dPos, wPos };
 }
 
+void ISAWaitHandler::shiftOffsets(const AsmCodeShiftMap& shiftMap)
+{
+    for (AsmDelayedOp& delOp: delayedOps)
+        delOp.offset = shiftMap.instrOffset(delOp.offset);
+    for (AsmWaitInstr& waitInstr: waitInstrs)
+        waitInstr.offset = shiftMap.instrOffset(waitInstr.offset);
+}
+
+void ISAWaitHandler::addWaitInstrs(const std::vector<AsmWaitInstr>& newWaitInstrs)
+{
+    // merge sorted wait instructions
+    const size_t oldSize = waitInstrs.size();
+    waitInstrs.insert(waitInstrs.end(), newWaitInstrs.begin(), newWaitInstrs.end());
+    std::inplace_merge(waitInstrs.begin(), waitInstrs.begin() + oldSize, waitInstrs.end(),
+            [](const AsmWaitInstr& a, const AsmWaitInstr& b)
+            { return a.offset < b.offset; });
+}
+
+/* AsmCodeShiftMap */
+
+void AsmCodeShiftMap::addInsertion(size_t offset, size_t size)
+{
+    if (!shifts.empty() && shifts.back().first == offset)
+        shifts.back().second += size;
+    else
+        shifts.push_back(std::make_pair(offset,
+                    size + (shifts.empty() ? size_t(0) : shifts.back().second)));
+}
+
+size_t AsmCodeShiftMap::instrOffset(size_t offset) const
+{
+    // last insertion before or at this instruction
+    auto it = std::upper_bound(shifts.begin(), shifts.end(),
+                std::make_pair(offset, size_t(SIZE_MAX)));
+    return offset + (it != shifts.begin() ? (it-1)->second : size_t(0));
+}
+
+size_t AsmCodeShiftMap::labelOffset(size_t offset) const
+{
+    // last insertion before this label
+    auto it = std::lower_bound(shifts.begin(), shifts.end(),
+                std::make_pair(offset, size_t(0)));
+    return offset + (it != shifts.begin() ? (it-1)->second : size_t(0));
+}
+
 /* AsmWaitScheduler */
 
 // QReg - queue register - contain - reg index and access type (read or write)
@@ -81,359 +128,240 @@ static inline bool qregWrite(uint16_t qreg)
 static inline uint16_t qregReg(uint16_t qreg)
 { return qreg & 0x7fff; }
 
-namespace CLRX
+// mix bits of value (used by hashes of queue states)
+static inline uint64_t mixWaitHash(uint64_t v)
 {
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ULL;
+    return v ^ (v >> 33);
+}
+
 
-struct QueueEntry1
+namespace CLRX
 {
-    std::unordered_set<uint16_t> regs;
-    bool haveDelayedOp;
     
-    QueueEntry1() : haveDelayedOp(false)
-    { }
+// entry of wait queue - delayed operation (counted once by wait counter)
+struct CLRX_INTERNAL WaitQueueEntry
+{
+    std::vector<uint16_t> regs; // qregs waiting for finish of operation (sorted)
+    cxbyte type;    // type of delayed operation
+    bool random;    // operation can be finished in any order
     
-    bool empty() const
-    { return haveDelayedOp || !regs.empty(); }
+    bool hasReg(uint16_t qreg) const
+    { return std::binary_search(regs.begin(), regs.end(), qreg); }
     
-    void join(const QueueEntry1& b)
+    // join with other operation (operations finished together)
+    void join(const WaitQueueEntry& b)
     {
-        regs.insert(b.regs.begin(), b.regs.end());
-        haveDelayedOp |= b.haveDelayedOp;
-    }
-
-    // toBEntry - difference offset between output orderedStartPos and
-    // b entry orderedStartPos
-    void joinWithRegPlaces(const QueueEntry1& b, uint16_t toBEntry,
-            uint16_t opos, std::unordered_map<uint16_t, uint16_t>& regPlaces)
-    {
-        for (auto e: b.regs)
-            if (regs.insert(e).second)
-            {
-                auto rres = regPlaces.insert(std::make_pair(e, opos));
-                if (rres.second && rres.first->second+toBEntry < opos)
-                    rres.first->second = opos;
-            }
-        regs.insert(b.regs.begin(), b.regs.end());
-        haveDelayedOp |= b.haveDelayedOp;
+        std::vector<uint16_t> newRegs;
+        std::set_union(regs.begin(), regs.end(), b.regs.begin(), b.regs.end(),
+                    std::back_inserter(newRegs));
+        regs.swap(newRegs);
+        // operations with different types are not ordered with other operations
+        random = random || b.random || type != b.type;
     }
     
-    size_t size() const
-    { return regs.size(); }
-};
-
-// toBEntry - difference offset between output orderedStartPos and
-// regPlaces entry orderedStartPos
-static inline void updateRegPlaces(const QueueEntry1& b, uint16_t toBEntry,
-                uint16_t opos, std::unordered_map<uint16_t, uint16_t>& regPlaces)
-{
-    for (auto e: b.regs)
+    bool operator==(const WaitQueueEntry& b) const
+    { return type == b.type && random == b.random && regs == b.regs; }
+    
+    uint64_t hash() const
     {
-        auto rres = regPlaces.insert(std::make_pair(e, opos));
-        if (rres.second && rres.first->second+toBEntry < opos)
-            rres.first->second = opos;
+        uint64_t h = mixWaitHash((uint64_t(type)<<1) | uint64_t(random));
+        for (uint16_t qreg: regs)
+            h = mixWaitHash(h + qreg);
+        return h;
     }
-}
-
-
-struct CLRX_INTERNAL QueueState1
-{
-    cxuint maxQueueSize;
-    uint16_t minQueueIndex;
-    uint16_t orderedStartPos;
-    std::deque<QueueEntry1> ordered;  // ordered items
-    QueueEntry1 random;   // items in random order
-    // register place in queue - key - reg, value - position
-    std::unordered_map<uint16_t, uint16_t> regPlaces;
-    // request queue size at start of block (by enqueuing and waiting/flushing)
-    // used while joining with previous block
-    cxuint requestedQueueSize;
-    bool firstFlush;
-    bool reallyFlushed; // if really already flushed (queue size has been shrinked)
-    
-    QueueState1(cxuint _maxQueueSize = 0) : maxQueueSize(_maxQueueSize),
-                minQueueIndex(0), orderedStartPos(0), requestedQueueSize(_maxQueueSize),
-                firstFlush(true), reallyFlushed(false)
-    { }
+};
     
-    void setMaxQueueSize(cxuint _maxQueueSize)
-    { requestedQueueSize = maxQueueSize = _maxQueueSize; }
+// state of wait queue - pending delayed operations (the oldest first)
+struct CLRX_INTERNAL WaitQueueState
+{
+    std::deque<WaitQueueEntry> entries;
     
-    void pushOrdered(uint16_t reg)
+    /* get greatest value of wait counter that guarantees finishing of all operations
+     * that conflict with access to register (UINT16_MAX if no such operation).
+     * read access waits for writes, write access waits for writes and read-outs */
+    uint16_t findWaitCount(uint16_t qreg) const
     {
-        if (reg == UINT16_MAX)
+        const uint16_t readQReg = qregVal(qregReg(qreg), false);
+        const uint16_t writeQReg = qregVal(qregReg(qreg), true);
+        const bool write = qregWrite(qreg);
+        uint16_t waitCount = UINT16_MAX;
+        // number of later ordered operations (by type)
+        cxuint orderedAfter[ASM_DELAYED_OP_MAX_TYPES_NUM] = { };
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
         {
-            // push same delayed op (no reg)
-            ordered.back().haveDelayedOp = true;
-            return;
+            if (it->hasReg(writeQReg) || (write && it->hasReg(readQReg)))
+                // ordered operation finishes before later operations with same type
+                waitCount = std::min(waitCount,
+                        uint16_t(it->random ? 0 : orderedAfter[it->type]));
+            if (!it->random)
+                orderedAfter[it->type]++;
         }
-        regPlaces[reg] = orderedStartPos + ordered.size()-1;
-        ordered.back().regs.insert(reg);
-    }
-    
-    void pushRandom(uint16_t reg)
-    {
-        if (reg != UINT16_MAX)
-            random.regs.insert(reg);
-        else
-            // push same delayed op (no reg)
-            random.haveDelayedOp = true;
+        return waitCount;
     }
     
-    void nextEntry()
+    // remove operations finished after waiting for counter value
+    void flushTo(cxuint count)
     {
-        if (ordered.empty() || !ordered.back().empty())
-            // push only if empty or previous is filled
-            ordered.push_back(QueueEntry1());
-        
-        if (ordered.size() == maxQueueSize)
+        cxuint orderedAfter[ASM_DELAYED_OP_MAX_TYPES_NUM] = { };
+        std::deque<WaitQueueEntry> newEntries;
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
         {
-            // move first entry in ordered queue to first ordered
-            QueueEntry1& firstOrdered = ordered.front();
-            orderedStartPos++; // next start pos for ordered queue for first entry
-            if (orderedStartPos-minQueueIndex > 10000)
-            {
-                for (auto e: firstOrdered.regs)
-                {
-                    auto rpit = regPlaces.find(e);
-                    // update regPlaces for firstOrdered before joining
-                    rpit->second = orderedStartPos;
-                }
-                minQueueIndex = orderedStartPos;
-            }
-            auto ordit = ordered.begin();
-            ++ordit; // second entry
-            QueueEntry1& second = *ordit;
-            // to second entry
-            second.regs.insert(firstOrdered.regs.begin(), firstOrdered.regs.end());
-            ordered.pop_front();
+            const bool finished = count == 0 ||
+                    (!it->random && orderedAfter[it->type] >= count);
+            if (!it->random)
+                orderedAfter[it->type]++;
+            if (!finished)
+                newEntries.push_front(std::move(*it));
         }
-        requestedQueueSize = std::max(requestedQueueSize+1, maxQueueSize);
+        entries.swap(newEntries);
     }
-    void flushTo(cxuint size)
+    
+    // put new operation to queue
+    void enqueue(const WaitQueueEntry& entry, cxuint maxQueueSize)
     {
-        if (firstFlush && ordered.size() < size)
-        {
-            // if higher than queue size and higher than requested queue size
-            requestedQueueSize = size;
-            firstFlush = false;
-            return;
-        }
-        reallyFlushed = (ordered.size() <= size);
-        firstFlush = false;
-        if (size == 0)
-            random.regs.clear(); // clear randomly ordered if must be empty
-        while (size < ordered.size())
+        entries.push_back(entry);
+        /* counter can not hold more operations, hence join oldest operations
+         * (waiting for them is more strict) */
+        while (entries.size() > 1 && entries.size() >= maxQueueSize)
         {
-            for (auto e: ordered.front().regs)
-            {
-                auto prit = regPlaces.find(e);
-                if (prit != regPlaces.end() && prit->second == orderedStartPos)
-                    regPlaces.erase(prit); // remove from regPlaces if in this place
-            }
-            ordered.pop_front();
-            orderedStartPos++;
+            entries[1].join(entries[0]);
+            entries.pop_front();
         }
-        minQueueIndex = orderedStartPos;
-        requestedQueueSize = std::min(size, requestedQueueSize);
     }
     
-    uint16_t findMinQueueSizeForReg(uint16_t reg) const
+    // join with queue state from other way (aligned to the newest operations)
+    void join(const WaitQueueState& b)
     {
-        auto it = regPlaces.find(reg);
-        if (it == regPlaces.end())
-            // if found, then 0 otherwize not found (UINT_MAX)
-            return random.regs.find(reg) != random.regs.end() ? 0 : UINT16_MAX;
-        const uint16_t pos = std::min(
-                    int(maxQueueSize), int(it->second - orderedStartPos));
-        return ordered.size()-1 - cxuint(pos);
+        const size_t size = entries.size();
+        const size_t bsize = b.entries.size();
+        if (bsize > size)
+            entries.insert(entries.begin(), b.entries.begin(),
+                        b.entries.begin() + (bsize-size));
+        const size_t common = std::min(size, bsize);
+        for (size_t i = 0; i < common; i++)
+            entries[entries.size()-common+i].join(b.entries[bsize-common+i]);
     }
     
-    void joinWay(const QueueState1& way)
-    {
-        random.join(way.random);
-        
-        auto oit1 = ordered.begin();
-        auto oit2 = way.ordered.begin();
-        const int queueSizeDiff = way.ordered.size() - ordered.size();
-        uint16_t qpos = orderedStartPos;
-        uint16_t wayStartPos = way.orderedStartPos;
-        if (queueSizeDiff > 0)
-        {
-            ordered.insert(ordered.begin(), way.ordered.begin(),
-                    way.ordered.begin() + queueSizeDiff);
-            oit2 += queueSizeDiff;
-            orderedStartPos -= queueSizeDiff;
-            oit1 = ordered.begin() + queueSizeDiff;
-            qpos = orderedStartPos;
-            // update regPlaces after pushing to front
-            for (auto oitx = ordered.begin(); oitx != oit1; ++oitx, ++qpos)
-                updateRegPlaces(*oitx, orderedStartPos-wayStartPos, qpos, regPlaces);
-        }
-        else
-        {
-            oit1 -= queueSizeDiff;
-            qpos -= queueSizeDiff;
-        }
-        // join entries
-        for (; oit1 != ordered.end(); ++oit1, ++oit2, ++qpos)
-            oit1->joinWithRegPlaces(*oit2, orderedStartPos-wayStartPos, qpos, regPlaces);
-        
-        firstFlush |= way.firstFlush;
-        requestedQueueSize = std::max(requestedQueueSize, way.requestedQueueSize);
-    }
+    bool operator==(const WaitQueueState& b) const
+    { return entries == b.entries; }
     
-    bool joinNext(const QueueState1& next)
+    uint64_t hash() const
     {
-        if (!reallyFlushed)
-        {
-            if (next.random.empty() && next.ordered.empty() &&
-                next.requestedQueueSize == maxQueueSize)
-                // no change
-                return false;
-            
-            cxuint nextReqQSize = std::min(next.requestedQueueSize, requestedQueueSize);
-            const cxuint oldOrderedSize = ordered.size();
-            const cxuint prevOrderedSize = (nextReqQSize!=ordered.size() ?
-                    nextReqQSize-ordered.size() : next.ordered.size());
-            ordered.erase(ordered.begin(), ordered.end()-prevOrderedSize);
-            ordered.insert(ordered.end(), next.ordered.begin(), next.ordered.end());
-            orderedStartPos += ordered.size()-oldOrderedSize;
-            uint16_t nextStartPos = next.orderedStartPos - prevOrderedSize;
-            uint16_t qpos = orderedStartPos;
-            // update regplaces for front
-            for (auto oitx = ordered.begin() + prevOrderedSize; oitx != ordered.end();
-                        ++oitx, ++qpos)
-                updateRegPlaces(*oitx, orderedStartPos-nextStartPos, qpos, regPlaces);
-            
-            if (ordered.size() > maxQueueSize)
-            {
-                // push to first ordered
-                size_t toFirst = ordered.size() - maxQueueSize;
-                auto firstOrderedIt = ordered.begin() + toFirst;
-                for (auto it = ordered.begin(); it!=firstOrderedIt; ++it)
-                    firstOrderedIt->joinWithRegPlaces(*it, 0,
-                            orderedStartPos + toFirst, regPlaces);
-                ordered.erase(ordered.begin(), firstOrderedIt);
-                orderedStartPos += toFirst;
-            }
-            random.join(next.random);
-            requestedQueueSize = std::min(nextReqQSize, maxQueueSize);
-            return true;
-        }
-        
-        return false;
+        uint64_t h = mixWaitHash(entries.size());
+        for (const WaitQueueEntry& entry: entries)
+            h = mixWaitHash(h ^ entry.hash());
+        return h;
     }
+};
     
-    size_t weight() const
-    {
-        size_t w = random.size();
-        for (const QueueEntry1& e: ordered)
-            w += e.size();
-        return w;
-    }
+// queue states of all wait queues in some place of code
+struct CLRX_INTERNAL WaitQueueStates
+{
+    WaitQueueState queues[ASM_WAIT_MAX_TYPES_NUM];
 };
-
-struct CLRX_INTERNAL WaitFirstCacheEntry
+    
+/* pool of unique queue states (hash-consing): identical queue states have
+ * same index, hence comparing of queue states is comparing of indices */
+class CLRX_INTERNAL WaitQueueStatePool
 {
-    QueueState1 queues[ASM_WAIT_MAX_TYPES_NUM];
+private:
+    const AsmWaitConfig& waitConfig;
+    std::vector<WaitQueueStates> states;
+    // key - hash of queue states, value - index of queue states
+    std::unordered_multimap<uint64_t, size_t> stateIndices;
+public:
+    explicit WaitQueueStatePool(const AsmWaitConfig& _waitConfig)
+            : waitConfig(_waitConfig)
+    { }
     
-    size_t weight() const
+    // get index of queue states (add queue states if not in pool)
+    size_t intern(const WaitQueueStates& qstates)
     {
-        size_t w = 0;
-        for (const QueueState1& q: queues)
-            w += q.weight();
-        return w;
+        uint64_t hash = 0;
+        for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
+            hash = hash*0x100000001b3ULL + qstates.queues[q].hash();
+        auto range = stateIndices.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+            if (std::equal(qstates.queues, qstates.queues + waitConfig.waitQueuesNum,
+                        states[it->second].queues))
+                return it->second;
+        states.push_back(qstates);
+        stateIndices.insert(std::make_pair(hash, states.size()-1));
+        return states.size()-1;
     }
+    
+    // reference is valid only to next interning
+    const WaitQueueStates& operator[](size_t index) const
+    { return states[index]; }
 };
-
-struct CLRX_INTERNAL RRegInfo
+    
+// instruction in code block (with register accesses and delayed operations)
+struct CLRX_INTERNAL WaitBlockInstr
 {
-    size_t offset;  /// offset where is usage
-    uint16_t qsizes[ASM_WAIT_MAX_TYPES_NUM];  /// queue sizes in this reg usage
-    uint16_t waits[ASM_WAIT_MAX_TYPES_NUM];  /// pending waits from block to this place
+    size_t offset;
+    size_t accessesEnd; // end of register accesses of instruction
+    size_t enqueuesEnd; // end of delayed operations of instruction
+    bool isWaitInstr;   // if wait instruction
+    uint16_t waits[ASM_WAIT_MAX_TYPES_NUM];
 };
-
-typedef std::unordered_map<uint16_t, RRegInfo> RRegMap;
-
-struct CLRX_INTERNAL WaitSecRRegTreeEntry
+    
+struct CLRX_INTERNAL WaitCodeBlock
 {
-    size_t blockIndex;
-    std::vector<uint16_t> firstRegs; // sorted
-    std::vector<size_t> nextBlocks;
+    std::vector<WaitBlockInstr> instrs;
+    std::vector<uint16_t> accesses; // accessed registers (qregs)
+    // delayed operations (queue, operation)
+    std::vector<std::pair<cxuint, WaitQueueEntry> > enqueues;
 };
-
-struct CLRX_INTERNAL WaitSecCacheEntry
-{
-    RRegMap firstRegs;
-    // tree of first regs, first entry is start point
-    // nextBlocks points to next points of ways
-    std::vector<WaitSecCacheEntry> firstRegsOrdering;
     
-    size_t weight() const
-    { return firstRegs.size() + firstRegsOrdering.size(); }
-};
-
-struct CLRX_INTERNAL WaitFlowStackEntry0
+// read register usages, delayed operations and wait instructions in code order
+class CLRX_INTERNAL WaitCodeReader
 {
-    size_t blockIndex;
-    size_t nextIndex;
-    bool isCall;
-    bool haveReturn;
-    
-    QueueState1 queues[ASM_WAIT_MAX_TYPES_NUM];
-    
-    WaitFlowStackEntry0(size_t _blockIndex, size_t _nextIndex,
-                        const AsmWaitConfig& waitConfig)
-            : blockIndex(_blockIndex), nextIndex(_nextIndex), isCall(false)
-    {
-        setMaxQueueSizes(waitConfig);
-    }
+private:
+    ISAUsageHandler& usageHandler;
+    ISAWaitHandler& waitHandler;
+    ISAUsageHandler::ReadPos usagePos;
+    ISAWaitHandler::ReadPos waitPos;
+public:
+    AsmRegVarUsage rvu;
+    AsmDelayedOp delayedOp;
+    AsmWaitInstr waitInstr;
+    bool isWaitInstr;
+    size_t usageOffset; // offset of current usage (SIZE_MAX if end)
+    size_t instrOffset; // offset of current delayed op or wait instr (SIZE_MAX if end)
     
-    WaitFlowStackEntry0(size_t _blockIndex, size_t _nextIndex, bool _isCall,
-                        const AsmWaitConfig& waitConfig)
-            : blockIndex(_blockIndex), nextIndex(_nextIndex), isCall(_isCall)
+    WaitCodeReader(ISAUsageHandler& _usageHandler, ISAWaitHandler& _waitHandler)
+            : usageHandler(_usageHandler), waitHandler(_waitHandler),
+              usagePos{ 0, 0 }, waitPos{ 0, 0 }, isWaitInstr(false)
     {
-        setMaxQueueSizes(waitConfig);
+        nextUsage();
+        nextInstr();
     }
     
-    WaitFlowStackEntry0(size_t _blockIndex, size_t _nextIndex,
-                        const WaitFlowStackEntry0& prev,
-                        const AsmWaitConfig& waitConfig)
-            : blockIndex(_blockIndex), nextIndex(_nextIndex)
+    void nextUsage()
     {
-        setMaxQueueSizes(waitConfig);
-        std::copy(prev.queues, prev.queues + waitConfig.waitQueuesNum, queues);
+        usageOffset = SIZE_MAX;
+        if (usageHandler.hasNext(usagePos))
+        {
+            rvu = usageHandler.nextUsage(usagePos);
+            usageOffset = rvu.offset;
+        }
     }
     
-    void setMaxQueueSizes(const AsmWaitConfig& waitConfig)
+    void nextInstr()
     {
-        for (cxuint i = 0; i < waitConfig.waitQueuesNum; i++)
-            queues[i].setMaxQueueSize(waitConfig.waitQueueSizes[i]);
+        instrOffset = SIZE_MAX;
+        if (waitHandler.hasNext(waitPos))
+        {
+            isWaitInstr = waitHandler.nextInstr(waitPos, delayedOp, waitInstr);
+            instrOffset = isWaitInstr ? waitInstr.offset : delayedOp.offset;
+        }
     }
 };
-
-struct CLRX_INTERNAL WaitInstrXInfo
-{
-    size_t offset;
-    uint16_t waits[ASM_WAIT_MAX_TYPES_NUM];
-    uint16_t qsizes[ASM_WAIT_MAX_TYPES_NUM];
-};
-
-struct CLRX_INTERNAL WaitCodeBlock
-{
-    QueueState1 queues[ASM_WAIT_MAX_TYPES_NUM];
-    std::vector<AsmWaitInstr> waitInstrs;
-    // before wait instrs for delayed op in this block
-    std::vector<WaitInstrXInfo> firstWaitInstrs;
-    std::vector<std::pair<uint16_t, RRegInfo> > firstRegs; ///< first occurence of reg
     
-    void setMaxQueueSizes(const AsmWaitConfig& waitConfig)
-    {
-        for (cxuint i = 0; i < waitConfig.waitQueuesNum; i++)
-            queues[i].setMaxQueueSize(waitConfig.waitQueueSizes[i]);
-    }
-};
-
 };
 
 static cxuint getRegType(size_t regTypesNum, const cxuint* regRanges,
@@ -476,13 +404,46 @@ static void getVIdx(const AsmSingleVReg& svreg, size_t ssaIdIdx,
     vidx = vidxes[ssaId];
 }
 
+typedef AsmRegAllocator::SplitRange SplitRange;
+
+// get color of virtual register in instruction (split register has color of its part)
+static cxuint getVIdxColor(size_t vidx, size_t offset, const Array<cxuint>& graphColorMap,
+            const std::vector<SplitRange>* splitRanges)
+{
+    if (splitRanges == nullptr || splitRanges->empty())
+        return graphColorMap[vidx];
+    // split ranges are sorted by vidx and start
+    auto rit = std::upper_bound(splitRanges->begin(), splitRanges->end(),
+            std::make_pair(vidx, offset),
+            [](const std::pair<size_t, size_t>& p, const SplitRange& r)
+            { return p.first < r.vidx || (p.first == r.vidx && p.second < r.start); });
+    if (rit == splitRanges->begin() || (rit-1)->vidx != vidx)
+        return graphColorMap[vidx]; // not split or before first range
+    return (rit-1)->color;
+}
+
+/* index of register of regvar without allocated registers: regvar operands are not
+ * rewritten to hardware registers, hence every register of regvar gets own index
+ * after hardware registers (if indices run out, they are shared: more waits) */
+static cxuint getRegVarRegIndex(const AsmSingleVReg& svreg, SVRegMap& regVarRegs,
+        cxuint firstIndex)
+{
+    auto res = regVarRegs.insert(std::make_pair(svreg, regVarRegs.size()));
+    return firstIndex + res.first->second % (0x8000 - firstIndex);
+}
+
+/* get register index of register in instruction. if graphColorMaps is null,
+ * registers are encoded in instructions (regvars are not allocated) */
 static cxuint getRRegFromSVReg(const AsmSingleVReg& svreg, size_t outSSAIdIdx,
-        const CodeBlock& cblock, const VarIndexMap* vregIndexMaps,
-        const Array<cxuint>* graphColorMaps, size_t regTypesNum, const cxuint* regRanges)
+        size_t offset, const CodeBlock& cblock, const VarIndexMap* vregIndexMaps,
+        const Array<cxuint>* graphColorMaps, const std::vector<SplitRange>* splitRanges,
+        SVRegMap& regVarRegs, size_t regTypesNum, const cxuint* regRanges)
 {
     cxuint rreg = svreg.index;
     
-    if (svreg.regVar != nullptr)
+    if (svreg.regVar != nullptr && graphColorMaps == nullptr)
+        rreg = getRegVarRegIndex(svreg, regVarRegs, regRanges[2*regTypesNum-1]);
+    else if (svreg.regVar != nullptr)
     {
         // if regvar, get vidx and get from vidx register index
         // get real register index
@@ -492,80 +453,90 @@ static cxuint getRRegFromSVReg(const AsmSingleVReg& svreg, size_t outSSAIdIdx,
         size_t vidx;
         getVIdx(svreg, outSSAIdIdx, ssaInfo, vregIndexMaps,
                 regTypesNum, regRanges, regType, vidx);
-        rreg = regRanges[2*regType] + graphColorMaps[regType][vidx];
+        rreg = regRanges[2*regType] + getVIdxColor(vidx, offset,
+                    graphColorMaps[regType], splitRanges != nullptr ?
+                    splitRanges + regType : nullptr);
     }
     
     return rreg;
 }
 
-static void processQueueBlock(const CodeBlock& cblock, WaitCodeBlock& wblock,
-        ISAWaitHandler& waitHandler, ISAWaitHandler::ReadPos& waitPos,
-        ISAUsageHandler& usageHandler, const AsmWaitConfig& waitConfig,
+// fill register accesses, delayed operations and wait instructions of code block
+static void fillWaitCodeBlock(const CodeBlock& cblock, WaitCodeBlock& wblock,
+        WaitCodeReader& reader, const AsmWaitConfig& waitConfig,
         const VarIndexMap* vregIndexMaps, const Array<cxuint>* graphColorMaps,
-        size_t regTypesNum, const cxuint* regRanges, bool onlyWarnings)
+        const std::vector<SplitRange>* splitRanges, SVRegMap& regVarRegs,
+        size_t regTypesNum, const cxuint* regRanges)
 {
-    // fill usage of registers (real access) to wCblock
-    ISAUsageHandler::ReadPos usagePos = cblock.usagePos;
+    // skip usages and instructions outside code blocks
+    while (reader.usageOffset < cblock.start)
+        reader.nextUsage();
+    while (reader.instrOffset < cblock.start)
+        reader.nextInstr();
     
     SVRegMap ssaIdIdxMap;
     SVRegMap svregWriteOffsets;
-    std::vector<AsmRegVarUsage> instrRVUs;
+    WaitQueueEntry newEntries[ASM_WAIT_MAX_TYPES_NUM];
     
-    RRegMap firstRegs;
-    // process waits and delayed ops
-    AsmWaitInstr waitInstr;
-    AsmDelayedOp delayedOp;
-    size_t instrOffset = SIZE_MAX;
-    bool isWaitInstr = false;
-    if (waitHandler.hasNext(waitPos))
+    // add delayed operation to entry of its queue (one entry per instruction)
+    auto addDelayedOp = [&](cxbyte delOpType, cxbyte rwFlags, bool secondOp)
     {
-        isWaitInstr = waitHandler.nextInstr(waitPos, delayedOp, waitInstr);
-        instrOffset = (isWaitInstr ? waitInstr.offset : delayedOp.offset);
-    }
-    
-    uint16_t curQueueSizes[ASM_WAIT_MAX_TYPES_NUM];
-    uint16_t curWaits[ASM_WAIT_MAX_TYPES_NUM];
-    std::fill(curWaits, curWaits + waitConfig.waitQueuesNum, uint16_t(0));
-    // we assume that current queue size at start is not limited
-    std::fill(curQueueSizes, curQueueSizes + waitConfig.waitQueuesNum, UINT16_MAX);
+        const AsmDelayedOp& delOp = reader.delayedOp;
+        const AsmDelayedOpTypeEntry& delOpEntry = waitConfig.delayOpTypes[delOpType];
+        WaitQueueEntry& entry = newEntries[delOpEntry.waitType];
+        if (entry.type == ASMDELOP_NONE)
+        {
+            entry.type = delOpType;
+            entry.random = false;
+        }
+        // second operation (in other queue) is not ordered with its queue
+        entry.random = entry.random || !delOpEntry.ordered || secondOp ||
+                entry.type != delOpType;
+        for (uint16_t rindex = delOp.rstart; rindex < delOp.rend; rindex++)
+        {
+            AsmSingleVReg svreg{ delOp.regVar, rindex };
+            size_t ssaIdIdx = 0;
+            if (delOp.regVar != nullptr)
+            {
+                auto ssit = ssaIdIdxMap.find(svreg);
+                if (ssit != ssaIdIdxMap.end())
+                    ssaIdIdx = ssit->second;
+            }
+            const cxuint rreg = getRRegFromSVReg(svreg, ssaIdIdx, delOp.offset, cblock,
+                        vregIndexMaps, graphColorMaps, splitRanges, regVarRegs,
+                        regTypesNum, regRanges);
+            if ((rwFlags & ASMRVU_READ) != 0 && delOpEntry.finishOnRegReadOut)
+                entry.regs.push_back(qregVal(rreg, false));
+            if ((rwFlags & ASMRVU_WRITE) != 0)
+                entry.regs.push_back(qregVal(rreg, true));
+        }
+    };
     
-    cxuint flushedQueues = 0;
-    while (usageHandler.hasNext(usagePos))
+    while (true)
     {
-        const AsmRegVarUsage rvu = usageHandler.nextUsage(usagePos);
-        if (rvu.offset >= cblock.end && instrOffset >= cblock.end)
+        const size_t offset = std::min(reader.usageOffset, reader.instrOffset);
+        if (offset >= cblock.end)
             break;
+        WaitBlockInstr binstr{ offset, 0, 0, false, { } };
         
-        bool genWaitCnt = false;
-        // gwaitI - current wait instruction
-        AsmWaitInstr gwaitI { rvu.offset, { } };
-        for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-            gwaitI.waits[q] = waitConfig.waitQueueSizes[q]-1;
-        
-        std::vector<std::pair<uint16_t, RRegInfo> > curRegs;
-        
-        if (rvu.offset < cblock.end && rvu.offset <= instrOffset)
+        // register accesses of instruction
+        for (; reader.usageOffset == offset; reader.nextUsage())
         {
-            // process RegVar usage
+            const AsmRegVarUsage& rvu = reader.rvu;
             for (uint16_t rindex = rvu.rstart; rindex < rvu.rend; rindex++)
             {
                 AsmSingleVReg svreg{ rvu.regVar, rindex };
-                
                 size_t outSSAIdIdx = 0;
                 if (rvu.regVar != nullptr)
                 {
-                    // if regvar, get vidx and get from vidx register index
                     if (checkWriteWithSSA(rvu))
                     {
                         size_t& ssaIdIdx = ssaIdIdxMap[svreg];
-                        if (svreg.regVar != nullptr)
-                            ssaIdIdx++;
-                        outSSAIdIdx = ssaIdIdx;
+                        outSSAIdIdx = ++ssaIdIdx;
                         svregWriteOffsets.insert({ svreg, rvu.offset });
                     }
-                    else // insert zero
+                    else
                     {
-                        outSSAIdIdx = 0;
                         auto svrres = ssaIdIdxMap.insert({ svreg, 0 });
                         outSSAIdIdx = svrres.first->second;
                         auto swit = svregWriteOffsets.find(svreg);
@@ -573,510 +544,450 @@ static void processQueueBlock(const CodeBlock& cblock, WaitCodeBlock& wblock,
                             outSSAIdIdx--; // before this write
                     }
                 }
-                const cxuint rreg = getRRegFromSVReg(svreg, outSSAIdIdx, cblock,
-                            vregIndexMaps, graphColorMaps, regTypesNum, regRanges);
-                
-                // put to readRegs and writeRegs
-                if ((rvu.rwFlags & ASMRVU_READ) != 0)
-                    curRegs.push_back({ qregVal(rreg, false), { rvu.offset } });
-                if ((rvu.rwFlags & ASMRVU_WRITE) != 0)
-                    curRegs.push_back({ qregVal(rreg, true), { rvu.offset } });
-                
-                // rreg
+                const cxuint rreg = getRRegFromSVReg(svreg, outSSAIdIdx, offset,
+                            cblock, vregIndexMaps, graphColorMaps, splitRanges,
+                            regVarRegs, regTypesNum, regRanges);
                 if ((rvu.rwFlags & ASMRVU_READ) != 0)
-                    for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-                    {
-                        uint16_t waitCnt = wblock.queues[q]
-                            .findMinQueueSizeForReg(qregVal(rreg, false));
-                        if (waitCnt != UINT16_MAX)
-                        {
-                            if (!onlyWarnings)
-                            {
-                                gwaitI.waits[q] = std::min(gwaitI.waits[q], waitCnt);
-                                genWaitCnt = true;
-                            }
-                        }
-                    }
+                    wblock.accesses.push_back(qregVal(rreg, false));
                 if ((rvu.rwFlags & ASMRVU_WRITE) != 0)
-                    for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-                    {
-                        uint16_t waitCnt = wblock.queues[q]
-                            .findMinQueueSizeForReg(qregVal(rreg, true));
-                        if (waitCnt != UINT16_MAX)
-                        {
-                            if (!onlyWarnings)
-                            {
-                                gwaitI.waits[q] = std::min(gwaitI.waits[q], waitCnt);
-                                genWaitCnt = true;
-                            }
-                        }
-                    }
-            }
-            
-            if (genWaitCnt && rvu.offset != instrOffset)
-            {
-                // generate wait instr
-                wblock.waitInstrs.push_back(gwaitI);
-                for (cxuint w = 0; w < waitConfig.waitQueuesNum; w++)
-                    wblock.queues[w].flushTo(gwaitI.waits[w]);
+                    wblock.accesses.push_back(qregVal(rreg, true));
             }
         }
         
-        if (instrOffset < cblock.end && rvu.offset >= instrOffset && isWaitInstr)
+        // delayed operations (enqueued after instruction) and wait instruction
+        for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
         {
-            // process wait instr
-            if (genWaitCnt)
-            {
-                // if user waitinstr and generate wait instr
-                // then choose min queue sizes in wait instr and generate new
-                // wait instr.
-                for (cxuint w = 0; w < waitConfig.waitQueuesNum; w++)
-                    gwaitI.waits[w] = std::min(gwaitI.waits[w], waitInstr.waits[w]);
-                wblock.waitInstrs.push_back(gwaitI);
-                for (cxuint w = 0; w < waitConfig.waitQueuesNum; w++)
-                    wblock.queues[w].flushTo(gwaitI.waits[w]);
-            }
-            else
-            {
-                wblock.waitInstrs.push_back(waitInstr);
-                for (cxuint w = 0; w < waitConfig.waitQueuesNum; w++)
-                {
-                    wblock.queues[w].flushTo(waitInstr.waits[w]);
-                    gwaitI.waits[w] = waitInstr.waits[w];
-                    genWaitCnt = true;
-                }
-            }
+            newEntries[q].type = ASMDELOP_NONE;
+            newEntries[q].regs.clear();
         }
-        
-        // update curQueue sizes from curent waitcnt
-        if (genWaitCnt && flushedQueues < waitConfig.waitQueuesNum)
-            for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-            {
-                if (!wblock.queues[q].reallyFlushed)
-                {
-                    // update wait after flush
-                    curQueueSizes[q] = wblock.queues[q].requestedQueueSize;
-                    curWaits[q] = std::min(curWaits[q],
-                                uint16_t(wblock.queues[q].ordered.size()));
-                }
-                else
-                {
-                    // increment flushQueues when queue has been flushed now
-                    if (curWaits[q] != UINT16_MAX)
-                        flushedQueues++;
-                    curWaits[q] = UINT16_MAX;
-                }
-            }
-        
-        if (instrOffset < cblock.end && rvu.offset >= instrOffset)
+        for (; reader.instrOffset == offset; reader.nextInstr())
         {
-            if (!isWaitInstr)
+            if (reader.isWaitInstr)
             {
-                // delayed op
-                const AsmDelayedOpTypeEntry& delOpEntry = waitConfig.delayOpTypes[
-                                delayedOp.delayedOpType];
-                const cxuint queue1Idx = delOpEntry.waitType;
-                const cxuint queue2Idx = delayedOp.delayedOpType!=ASMDELOP_NONE ?
-                        waitConfig.delayOpTypes[delayedOp.delayedOpType].waitType :
-                        UINT_MAX;
-                // next entry
-                wblock.queues[queue1Idx].nextEntry();
-                if (queue2Idx != UINT_MAX)
-                    wblock.queues[queue2Idx].nextEntry();
-                cxuint rcount = 0, rcount2 = 0;
-                
-                for (uint16_t rindex = delayedOp.rstart;
-                                    rindex < delayedOp.rend; rindex++)
-                {
-                    AsmSingleVReg svreg{ delayedOp.regVar, rindex };
-                    const size_t ssaIdIdx = ssaIdIdxMap.find(svreg)->second;
-                    const cxuint rreg = getRRegFromSVReg(svreg, ssaIdIdx, cblock,
-                            vregIndexMaps, graphColorMaps, regTypesNum, regRanges);
-                    
-                    if ((delayedOp.rwFlags & ASMRVU_READ) != 0 &&
-                                delOpEntry.finishOnRegReadOut)
-                    {
-                        const uint16_t qreg = qregVal(rreg, false);
-                        if (delOpEntry.ordered)
-                            wblock.queues[queue1Idx].pushOrdered(qreg);
-                        else
-                            wblock.queues[queue1Idx].pushRandom(qreg);
-                    }
-                    if ((delayedOp.rwFlags & ASMRVU_WRITE) != 0)
-                    {
-                        const uint16_t qreg = qregVal(rreg, true);
-                        if (delOpEntry.ordered)
-                            wblock.queues[queue1Idx].pushOrdered(qreg);
-                        else
-                            wblock.queues[queue1Idx].pushRandom(qreg);
-                    }
-                    // if queue2
-                    if (queue2Idx != UINT_MAX)
-                    {
-                        const AsmDelayedOpTypeEntry& delOpEntry2 =
-                                waitConfig.delayOpTypes[delayedOp.delayedOpType2];
-                        if ((delayedOp.rwFlags2 & ASMRVU_READ) != 0 &&
-                                delOpEntry2.finishOnRegReadOut)
-                        {
-                            const uint16_t qreg = qregVal(rreg, false);
-                            if (delOpEntry2.ordered)
-                                wblock.queues[queue2Idx].pushOrdered(qreg);
-                            else
-                                wblock.queues[queue2Idx].pushRandom(qreg);
-                        }
-                        if ((delayedOp.rwFlags2 & ASMRVU_WRITE) != 0)
-                        {
-                            const uint16_t qreg = qregVal(rreg, true);
-                            if (delOpEntry2.ordered)
-                                wblock.queues[queue2Idx].pushOrdered(qreg);
-                            else
-                                wblock.queues[queue2Idx].pushRandom(qreg);
-                        }
-                        // do next queue entry if registered per element
-                        rcount2 += 4;
-                        if (delOpEntry2.counting!=255 && delOpEntry2.counting <= rcount)
-                        {
-                            // new entry
-                            wblock.queues[queue2Idx].nextEntry();
-                            rcount2 = 0;
-                        }
-                    }
-                    
-                    // do next queue entry if registered per element
-                    rcount += 4;
-                    if (delOpEntry.counting!=255 && delOpEntry.counting <= rcount)
-                    {
-                        // new entry
-                        wblock.queues[queue1Idx].nextEntry();
-                        rcount = 0;
-                    }
-                }
-                
-                // update current queue sizes from last delayed ops
-                if (flushedQueues < waitConfig.waitQueuesNum)
-                {
-                    curQueueSizes[queue1Idx] = wblock.queues[queue1Idx].requestedQueueSize;
-                    // increment curWait for queue1
-                    curWaits[queue1Idx] = std::min(uint16_t(curWaits[queue1Idx]+1),
-                                    waitConfig.waitQueueSizes[queue1Idx]);
-                    if (queue2Idx != UINT_MAX)
-                    {
-                        curQueueSizes[queue2Idx] =
-                                wblock.queues[queue2Idx].requestedQueueSize;
-                        // increment curWait for queue2
-                        curWaits[queue2Idx] = std::min(uint16_t(curWaits[queue2Idx]+1),
-                                    waitConfig.waitQueueSizes[queue2Idx]);
-                    }
-                }
-            }
-            
-            // only if any not flushed queue
-            if (flushedQueues < waitConfig.waitQueuesNum)
-            {
-                // update current queue sizes
-                for (auto& re: curRegs)
-                {
-                    std::copy(curQueueSizes, curQueueSizes + waitConfig.waitQueuesNum,
-                                re.second.qsizes);
-                    std::copy(curWaits, curWaits + waitConfig.waitQueuesNum,
-                                re.second.waits);
-                }
-                // put current regs to firstRegs
-                firstRegs.insert(curRegs.begin(), curRegs.end());
-            }
-            // get next instr
-            if (!waitHandler.hasNext(waitPos))
-                instrOffset = SIZE_MAX;
-            else
-            {
-                isWaitInstr = waitHandler.nextInstr(waitPos, delayedOp, waitInstr);
-                instrOffset = (isWaitInstr ? waitInstr.offset : delayedOp.offset);
+                binstr.isWaitInstr = true;
+                std::copy(reader.waitInstr.waits,
+                        reader.waitInstr.waits + ASM_WAIT_MAX_TYPES_NUM, binstr.waits);
+                continue;
             }
+            addDelayedOp(reader.delayedOp.delayedOpType, reader.delayedOp.rwFlags, false);
+            if (reader.delayedOp.delayedOpType2 != ASMDELOP_NONE)
+                addDelayedOp(reader.delayedOp.delayedOpType2,
+                            reader.delayedOp.rwFlags2, true);
         }
-        
-        // copy to wblock as array
-        wblock.firstRegs.resize(firstRegs.size());
-        std::copy(firstRegs.begin(), firstRegs.end(), wblock.firstRegs.begin());
-        mapSort(wblock.firstRegs.begin(), wblock.firstRegs.end());
-    }
-}
-
-static void optimizeWaitInstrs(const AsmWaitConfig& waitConfig,
-                std::vector<WaitInstrXInfo>& waitInstrs)
-{
-    uint16_t extraQSizes[ASM_WAIT_MAX_TYPES_NUM];
-    std::fill(extraQSizes, extraQSizes + waitConfig.waitQueuesNum, uint16_t(UINT16_MAX));
-    for (WaitInstrXInfo& wi: waitInstrs)
-    {
-        cxuint toRemove = 0;
         for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-        {
-            if (wi.waits[q] - wi.qsizes[q] >= extraQSizes[q])
+            if (newEntries[q].type != ASMDELOP_NONE)
             {
-                // mark to remove
-                wi.waits[q] = UINT16_MAX;
-                toRemove++;
+                std::vector<uint16_t>& regs = newEntries[q].regs;
+                std::sort(regs.begin(), regs.end());
+                regs.resize(std::unique(regs.begin(), regs.end()) - regs.begin());
+                wblock.enqueues.push_back(std::make_pair(q, newEntries[q]));
             }
-            else
-                // update new extraQSize for this queue
-                extraQSizes[q] = wi.waits[q] - wi.qsizes[q];
-        }
-        
-        if (toRemove == waitConfig.waitQueuesNum)
-            wi.offset = SIZE_MAX; // to remove
-        else
-            // correct waits
-            for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-                if (wi.waits[q] == UINT16_MAX)
-                    wi.waits[q] = waitConfig.waitQueueSizes[q] - 1;
+        binstr.accessesEnd = wblock.accesses.size();
+        binstr.enqueuesEnd = wblock.enqueues.size();
+        wblock.instrs.push_back(binstr);
     }
-    
-    const size_t newSize = std::remove_if(waitInstrs.begin(), waitInstrs.end(),
-                [](const WaitInstrXInfo& wi)
-                { return wi.offset == SIZE_MAX; }) - waitInstrs.begin();
-    waitInstrs.resize(newSize);
 }
 
-static void generateWaitInstrsWhileJoining(const AsmWaitConfig& waitConfig,
-        QueueState1* queues, const std::vector<std::pair<uint16_t, RRegInfo> >& firstRegs,
-        std::vector<WaitInstrXInfo>& waitInstrs, uint16_t* extraMinQueueSizes,
-        bool onlyWarnings)
+/* simulate wait queues in code block (queue states from start to end of block).
+ * if waitInstrs is not null, put wait instructions needed before instructions.
+ * if waitAllAtStart, then all operations are waited for at start of block: wait is
+ * put before first instruction that is not wait instruction, and only for
+ * queues not emptied by wait instructions at start of block (hence no second
+ * wait instruction at same offset) */
+static void simulateWaitBlock(const AsmWaitConfig& waitConfig, const WaitCodeBlock& wblock,
+        WaitQueueStates& qstates, std::vector<AsmWaitInstr>* waitInstrs,
+        bool waitAllAtStart = false)
 {
-    std::fill(extraMinQueueSizes,
-              extraMinQueueSizes + waitConfig.waitQueuesNum, UINT16_MAX);
-    for (const auto& entry: firstRegs)
+    bool flushQueues[ASM_WAIT_MAX_TYPES_NUM];
+    std::fill(flushQueues, flushQueues + ASM_WAIT_MAX_TYPES_NUM, waitAllAtStart);
+    size_t accessPos = 0, enqueuePos = 0;
+    for (size_t i = 0; i < wblock.instrs.size(); i++)
     {
-        bool genWaitCnt = false;
-        WaitInstrXInfo gwaitI { entry.second.offset, { } };
-        for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-        {
-            gwaitI.waits[q] = waitConfig.waitQueueSizes[q]-1;
-            gwaitI.qsizes[q] = entry.second.qsizes[q];
-        }
+        const WaitBlockInstr& binstr = wblock.instrs[i];
+        if (binstr.isWaitInstr)
+            for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
+            {
+                qstates.queues[q].flushTo(binstr.waits[q]);
+                if (binstr.waits[q] == 0)
+                    flushQueues[q] = false;
+            }
         
+        // find greatest wait counters that satisfy register accesses
+        AsmWaitInstr waitInstr{ binstr.offset, { } };
+        bool needWait = false;
         for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
-        {
-            uint16_t waitCnt = queues[q].findMinQueueSizeForReg(entry.first);
-            if (waitCnt != UINT16_MAX)
+            waitInstr.waits[q] = waitConfig.waitQueueSizes[q]-1;
+        // block with wait instructions only: wait before last of them
+        if (!binstr.isWaitInstr || i+1 == wblock.instrs.size())
+            for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
+                if (flushQueues[q])
+                {
+                    waitInstr.waits[q] = 0;
+                    flushQueues[q] = false;
+                    needWait = true;
+                }
+        for (; accessPos < binstr.accessesEnd; accessPos++)
+            for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
             {
-                waitCnt = std::min(gwaitI.waits[q], waitCnt);
-                if (!onlyWarnings && waitCnt < entry.second.qsizes[q])
+                const uint16_t waitCount = qstates.queues[q].findWaitCount(
+                            wblock.accesses[accessPos]);
+                if (waitCount < waitInstr.waits[q])
                 {
-                    gwaitI.waits[q] = waitCnt;
-                    genWaitCnt = true;
+                    waitInstr.waits[q] = waitCount;
+                    needWait = true;
                 }
-                extraMinQueueSizes[q] = std::min(
-                            uint16_t(entry.second.qsizes[q] - entry.second.waits[q]),
-                            extraMinQueueSizes[q]);
             }
+        if (needWait)
+        {
+            for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
+                qstates.queues[q].flushTo(waitInstr.waits[q]);
+            if (waitInstrs != nullptr)
+                waitInstrs->push_back(waitInstr);
+        }
+        
+        for (; enqueuePos < binstr.enqueuesEnd; enqueuePos++)
+        {
+            const auto& enqueue = wblock.enqueues[enqueuePos];
+            qstates.queues[enqueue.first].enqueue(enqueue.second,
+                        waitConfig.waitQueueSizes[enqueue.first]);
         }
-        if (genWaitCnt)
-            waitInstrs.push_back(gwaitI);
     }
-    
-    std::sort(waitInstrs.begin(), waitInstrs.end(),
-              [](const WaitInstrXInfo& a, const WaitInstrXInfo& b)
-              { return a.offset < b.offset; });
-    optimizeWaitInstrs(waitConfig, waitInstrs);
 }
 
+// default max number of visits of code block while scheduling
+static const cxuint maxWaitBlockVisits = 64;
+
 AsmWaitScheduler::AsmWaitScheduler(const AsmWaitConfig& _asmWaitConfig,
         Assembler& _assembler, const std::vector<CodeBlock>& _codeBlocks,
         const VarIndexMap* _vregIndexMaps, const Array<cxuint>* _graphColorMaps,
-        bool _onlyWarnings)
+        const std::vector<SplitRange>* _splitRanges)
         : waitConfig(_asmWaitConfig), assembler(_assembler), codeBlocks(_codeBlocks),
           vregIndexMaps(_vregIndexMaps), graphColorMaps(_graphColorMaps),
-          onlyWarnings(_onlyWarnings)
+          splitRanges(_splitRanges),
+          maxBlockVisits(maxWaitBlockVisits)
 { }
 
 void AsmWaitScheduler::schedule(ISAUsageHandler& usageHandler, ISAWaitHandler& waitHandler)
 {
+    neededWaitInstrs.clear();
     if (codeBlocks.empty())
         return;
     
     cxuint regRanges[MAX_REGTYPES_NUM*2];
     size_t regTypesNum;
-    std::vector<WaitCodeBlock> waitCodeBlocks(codeBlocks.size());
-    for(WaitCodeBlock& wblock: waitCodeBlocks)
-        wblock.setMaxQueueSizes(waitConfig);
-    
     assembler.isaAssembler->getRegisterRanges(regTypesNum, regRanges);
     
-    // fill queue states
-    ISAWaitHandler::ReadPos waitPos{ 0, 0 };
-    for (size_t i = 0; i < codeBlocks.size(); i++)
-        processQueueBlock(codeBlocks[i], waitCodeBlocks[i], waitHandler, waitPos,
-                usageHandler, waitConfig, vregIndexMaps, graphColorMaps, regTypesNum,
-                regRanges, onlyWarnings);
-    
-    // key - current res first key, value - previous first key and its flowStack pos
-    PrevWaysIndexMap prevWaysIndexMap;
-    // to track ways last block indices pair: block index, flowStackPos)
-    std::pair<size_t, size_t> lastCommonCacheWayPoint{ SIZE_MAX, SIZE_MAX };
-    ResSecondPointsToCache cblocksToCache(codeBlocks.size());
-    std::vector<bool> waysToCache(codeBlocks.size(), false);
-    // main loop variables
-    std::deque<CallStackEntry> callStack;
-    std::unordered_set<BlockIndex> callBlocks;
-    std::deque<WaitFlowStackEntry0> flowStack;
-    flowStack.push_back(WaitFlowStackEntry0(0, 0, waitConfig));
-    std::vector<bool> visited(codeBlocks.size(), false);
+    const size_t blocksNum = codeBlocks.size();
+    std::vector<WaitCodeBlock> waitCodeBlocks(blocksNum);
+    WaitCodeReader reader(usageHandler, waitHandler);
+    SVRegMap regVarRegs;
+    for (size_t i = 0; i < blocksNum; i++)
+        fillWaitCodeBlock(codeBlocks[i], waitCodeBlocks[i], reader, waitConfig,
+                vregIndexMaps, graphColorMaps, splitRanges, regVarRegs,
+                regTypesNum, regRanges);
+    
+    // blocks after calls (return places) get queue states from ends of routines
+    std::vector<size_t> returnBlocks;
+    for (size_t i = 0; i+1 < blocksNum; i++)
+        if (codeBlocks[i].haveCalls)
+            returnBlocks.push_back(i+1);
+    
+    /* dataflow over code blocks: queue state at start of block is join of
+     * queue states at end of the previous blocks. code blocks are processed by
+     * worklist until queue states do not change (fixed point). */
+    WaitQueueStatePool statePool(waitConfig);
+    const size_t emptyStateIndex = statePool.intern(WaitQueueStates());
+    // indices of queue states at start and at end of code blocks
+    std::vector<size_t> inStates(blocksNum, SIZE_MAX);
+    std::vector<size_t> outStates(blocksNum, SIZE_MAX);
+    std::vector<cxuint> visitsNums(blocksNum, 0);
+    // blocks with waiting for all operations at start (empty queue states)
+    std::vector<bool> flushedBlocks(blocksNum, false);
+    // key - indices of joined queue states, value - index of result
+    std::unordered_map<uint64_t, size_t> joinCache;
+    std::vector<bool> inWorklist(blocksNum, false);
+    std::deque<size_t> worklist;
+    inStates[0] = emptyStateIndex;
+    worklist.push_back(0);
+    inWorklist[0] = true;
+    std::vector<size_t> nextBlocks;
     
-    /*
-     * main loop to fill up ssaInfos
-     */
-    while (!flowStack.empty())
+    while (!worklist.empty())
     {
-        WaitFlowStackEntry0& entry = flowStack.back();
-        const CodeBlock& cblock = codeBlocks[entry.blockIndex];
-        WaitCodeBlock& wblock = waitCodeBlocks[entry.blockIndex];
+        const size_t blockIndex = worklist.front();
+        worklist.pop_front();
+        inWorklist[blockIndex] = false;
+        /* limit number of visits if joining of queue states is not monotone:
+         * after that, all operations are waited for at start of block */
+        if (visitsNums[blockIndex] >= maxBlockVisits && !flushedBlocks[blockIndex])
+        {
+            flushedBlocks[blockIndex] = true;
+            inStates[blockIndex] = emptyStateIndex;
+        }
+        visitsNums[blockIndex]++;
+        
+        WaitQueueStates qstates = statePool[inStates[blockIndex]];
+        simulateWaitBlock(waitConfig, waitCodeBlocks[blockIndex], qstates, nullptr);
+        const size_t outIndex = statePool.intern(qstates);
+        if (outIndex == outStates[blockIndex])
+            continue; // no change
+        outStates[blockIndex] = outIndex;
         
-        if (entry.nextIndex == 0)
+        // next blocks (calls are treated as jumps)
+        const CodeBlock& cblock = codeBlocks[blockIndex];
+        nextBlocks.clear();
+        for (const NextBlock& next: cblock.nexts)
+            nextBlocks.push_back(next.block);
+        if ((cblock.nexts.empty() || cblock.haveCalls) &&
+            !cblock.haveReturn && !cblock.haveEnd && blockIndex+1 < blocksNum)
+            nextBlocks.push_back(blockIndex+1);
+        // routine can be called from any call
+        if (cblock.haveReturn)
+            nextBlocks.insert(nextBlocks.end(), returnBlocks.begin(), returnBlocks.end());
+        
+        for (size_t nextBlock: nextBlocks)
         {
-            // process current block
-            if (!visited[entry.blockIndex])
+            if (flushedBlocks[nextBlock])
+                continue; // queue states are empty at start of this block
+            size_t newInIndex = outIndex;
+            if (inStates[nextBlock] != SIZE_MAX)
             {
-                uint16_t minExtraQueueSizes[ASM_WAIT_MAX_TYPES_NUM];
-                visited[entry.blockIndex] = true;
-                std::vector<WaitInstrXInfo> thisWaitInstrs;
-                generateWaitInstrsWhileJoining(waitConfig, entry.queues, wblock.firstRegs,
-                            thisWaitInstrs, minExtraQueueSizes, onlyWarnings);
-                // insert to firstWaitInstrs in wblock
-                wblock.firstWaitInstrs.insert(wblock.firstWaitInstrs.end(),
-                            thisWaitInstrs.begin(), thisWaitInstrs.end());
-                // code to join queue state in previous with current block
-                for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
+                // join ways: use cached result if this join has been done
+                const uint64_t joinKey = (uint64_t(inStates[nextBlock])<<32) |
+                            uint64_t(outIndex);
+                auto jit = joinCache.find(joinKey);
+                if (jit == joinCache.end())
                 {
-                    if (minExtraQueueSizes[q]!=UINT16_MAX &&
-                        !wblock.queues[q].reallyFlushed)
-                        entry.queues[q].requestedQueueSize = std::min(
-                            size_t(entry.queues[q].requestedQueueSize),
-                            minExtraQueueSizes[q] + wblock.queues[q].ordered.size());
-                    entry.queues[q].joinNext(wblock.queues[q]);
+                    WaitQueueStates joined = statePool[inStates[nextBlock]];
+                    const WaitQueueStates& outQStates = statePool[outIndex];
+                    for (cxuint q = 0; q < waitConfig.waitQueuesNum; q++)
+                        joined.queues[q].join(outQStates.queues[q]);
+                    jit = joinCache.insert(std::make_pair(joinKey,
+                                statePool.intern(joined))).first;
                 }
+                newInIndex = jit->second;
             }
-            else
+            if (newInIndex != inStates[nextBlock])
             {
-                cblocksToCache.increase(entry.blockIndex);
-                ARDOut << "jcblockToCache: " << entry.blockIndex << "=" <<
-                            cblocksToCache.count(entry.blockIndex) << "\n";
-                
-                // back, already visited
-                flowStack.pop_back();
-                
-                size_t curWayBIndex = flowStack.back().blockIndex;
-                if (lastCommonCacheWayPoint.first != SIZE_MAX)
+                inStates[nextBlock] = newInIndex;
+                if (!inWorklist[nextBlock])
                 {
-                    // mark point of way to cache (res first point)
-                    waysToCache[lastCommonCacheWayPoint.first] = true;
-                    ARDOut << "mark to pfcache " <<
-                            lastCommonCacheWayPoint.first << ", " <<
-                            curWayBIndex << "\n";
-                    prevWaysIndexMap[curWayBIndex] = lastCommonCacheWayPoint;
+                    worklist.push_back(nextBlock);
+                    inWorklist[nextBlock] = true;
                 }
-                lastCommonCacheWayPoint = { curWayBIndex, flowStack.size()-1 };
-                ARDOut << "lastCcwP: " << curWayBIndex << "\n";
-                continue;
             }
         }
-        
-        if (!callStack.empty() &&
-            entry.blockIndex == callStack.back().callBlock.index &&
-            entry.nextIndex-1 == callStack.back().callNextIndex)
-        {
-            const BlockIndex routineBlock = callStack.back().routineBlock;
-            callBlocks.erase(routineBlock);
-            callStack.pop_back(); // just return from call
-        }
-        
-        if (entry.nextIndex < cblock.nexts.size())
+    }
+    
+    // generate wait instructions from queue states at starts of code blocks
+    for (size_t i = 0; i < blocksNum; i++)
+    {
+        WaitQueueStates qstates = statePool[inStates[i] != SIZE_MAX ? inStates[i] :
+                    emptyStateIndex];
+        // flushed blocks wait for all operations at start
+        simulateWaitBlock(waitConfig, waitCodeBlocks[i], qstates, &neededWaitInstrs,
+                    flushedBlocks[i]);
+    }
+}
+
+/* inserting wait instructions */
+
+// update offsets of labels in section (in scope and its children)
+static void shiftSymbolsInScope(AsmScope& scope, AsmSectionId sectionId,
+            const AsmCodeShiftMap& shiftMap)
+{
+    for (AsmSymbolEntry& symEntry: scope.symbolMap)
+    {
+        AsmSymbol& symbol = symEntry.second;
+        if (symbol.sectionId == sectionId && symbol.hasValue && !symbol.regRange)
+            symbol.value = shiftMap.labelOffset(symbol.value);
+    }
+    for (const auto& scopeEntry: scope.scopeMap)
+        shiftSymbolsInScope(*scopeEntry.second, sectionId, shiftMap);
+}
+
+bool Assembler::insertWaitInstrs()
+{
+    if (isaAssembler == nullptr)
+        return good;
+    const AsmWaitConfig& waitConfig = isaAssembler->getWaitConfig();
+    for (AsmSectionId i = 0; i < sections.size(); i++)
+    {
+        AsmSection& section = sections[i];
+        if (section.type != AsmSectionType::CODE || section.usageHandler == nullptr ||
+            section.waitHandler == nullptr || section.getSize() == 0)
+            continue;
+        // only code structure is needed: registers are used as encoded in code
+        AsmRegAllocator regAlloc(*this);
+        regAlloc.createCodeStructure(section.codeFlow, section.content.size(),
+                    section.content.data());
+        AsmWaitScheduler waitScheduler(waitConfig, *this, regAlloc.getCodeBlocks(),
+                    nullptr, nullptr);
+        waitScheduler.schedule(*section.usageHandler, *section.waitHandler);
+        std::vector<AsmWaitInstr> waitInstrs = waitScheduler.getNeededWaitInstrs();
+        insertSectionWaitInstrs(i, waitInstrs);
+    }
+    codeOffsetsUses.clear();
+    return good;
+}
+
+void AsmRegAllocator::encodeSplitCopies(const ISAAssembler& isaAssembler,
+            cxuint regType, std::vector<SplitCopy>& copies, std::vector<cxbyte>& output)
+{
+    while (!copies.empty())
+    {
+        // find copy whose destination is not source of other copies
+        auto cit = std::find_if(copies.begin(), copies.end(),
+                [&copies](const SplitCopy& c)
+                {
+                    for (const SplitCopy& c2: copies)
+                        if (c2.srcColor == c.dstColor)
+                            return false;
+                    return true;
+                });
+        if (cit != copies.end())
         {
-            size_t nextBlock = cblock.nexts[entry.nextIndex].block;
-            //nextBlock.pass = entry.blockIndex.pass;
-            
-            flowStack.push_back(WaitFlowStackEntry0(nextBlock, 0, waitConfig));
-            entry.nextIndex++;
+            isaAssembler.encodeRegCopy(regType, cit->dstColor, cit->srcColor, false,
+                        output);
+            copies.erase(cit);
+            continue;
         }
-        
-        else if (((entry.nextIndex==0 && cblock.nexts.empty()) ||
-                // if have any call then go to next block
-                (cblock.haveCalls && entry.nextIndex==cblock.nexts.size())) &&
-                 !cblock.haveReturn && !cblock.haveEnd)
+        // only cycles: swap registers, source of copy holds old destination value
+        const SplitCopy copy = copies.front();
+        isaAssembler.encodeRegCopy(regType, copy.dstColor, copy.srcColor, true, output);
+        copies.erase(copies.begin());
+        for (SplitCopy& c: copies)
+            if (c.srcColor == copy.dstColor)
+                c.srcColor = copy.srcColor;
+        // copy which closed cycle is done by swap
+        copies.erase(std::remove_if(copies.begin(), copies.end(),
+                [](const SplitCopy& c)
+                { return c.srcColor == c.dstColor; }), copies.end());
+    }
+}
+
+void Assembler::insertSectionWaitInstrs(AsmSectionId sectionId,
+            std::vector<AsmWaitInstr>& waitInstrs)
+{
+    AsmSection& section = sections[sectionId];
+    if (waitInstrs.empty())
+        return;
+    // places of inserted wait instructions (instruction offsets)
+    std::vector<size_t> insertOffsets;
+    for (const AsmWaitInstr& waitInstr: waitInstrs)
+        insertOffsets.push_back(waitInstr.offset);
+    insertOffsets.resize(std::unique(insertOffsets.begin(), insertOffsets.end()) -
+                insertOffsets.begin());
+    
+    // build new content with inserted wait instructions
+    std::vector<cxbyte> newContent;
+    newContent.reserve(section.content.size() + insertOffsets.size()*8);
+    AsmCodeShiftMap shiftMap;
+    // new offsets of inserted code
+    std::vector<size_t> newInsertOffsets;
+    size_t waitIndex = 0;
+    size_t pos = 0;
+    for (size_t offset: insertOffsets)
+    {
+        newContent.insert(newContent.end(), section.content.begin() + pos,
+                    section.content.begin() + offset);
+        pos = offset;
+        const size_t insertOffset = newContent.size();
+        newInsertOffsets.push_back(insertOffset);
+        for (; waitIndex < waitInstrs.size() &&
+                waitInstrs[waitIndex].offset == offset; waitIndex++)
         {
-            if (entry.nextIndex!=0) // if back from calls (just return from calls)
-            {
-            }
-            flowStack.push_back(WaitFlowStackEntry0(entry.blockIndex+1, 0, waitConfig));
-            entry.nextIndex++;
+            AsmWaitInstr& waitInstr = waitInstrs[waitIndex];
+            waitInstr.offset = newContent.size();
+            isaAssembler->encodeWaitInstr(waitInstr, newContent);
         }
+        shiftMap.addInsertion(offset, newContent.size() - insertOffset);
+    }
+    newContent.insert(newContent.end(), section.content.begin() + pos,
+                section.content.end());
+    section.content.swap(newContent);
+    
+    // values of evaluated expressions can not be changed: report error if
+    // code has been inserted between used code offsets
+    for (const CodeOffsetsUse& use: codeOffsetsUses)
+        if (use.sectionId == sectionId &&
+            shiftMap.labelOffset(use.minOffset) - use.minOffset !=
+            shiftMap.labelOffset(use.maxOffset) - use.maxOffset)
+            printError(use.sourcePos, "Value of expression depends on "
+                    "code offsets changed by inserting wait instructions");
+    
+    if (section.usageHandler != nullptr)
+        section.usageHandler->shiftOffsets(shiftMap);
+    if (section.linearDepHandler != nullptr)
+        section.linearDepHandler->shiftOffsets(shiftMap);
+    if (section.waitHandler != nullptr)
+    {
+        section.waitHandler->shiftOffsets(shiftMap);
+        section.waitHandler->addWaitInstrs(waitInstrs);
+    }
+    
+    // source positions (inserted code gets position of next instruction)
+    AsmSourcePosHandler newSourcePosHandler;
+    AsmSourcePosHandler::ReadPos sposPos{ 0, 0 };
+    size_t insertIndex = 0;
+    while (section.sourcePosHandler.hasNext(sposPos))
+    {
+        const std::pair<size_t, AsmSourcePos> spos =
+                section.sourcePosHandler.nextSourcePos(sposPos);
+        for (; insertIndex < insertOffsets.size() &&
+                    insertOffsets[insertIndex] <= spos.first; insertIndex++)
+            newSourcePosHandler.pushSourcePos(newInsertOffsets[insertIndex],
+                        spos.second);
+        newSourcePosHandler.pushSourcePos(shiftMap.instrOffset(spos.first),
+                        spos.second);
+    }
+    section.sourcePosHandler = newSourcePosHandler;
+    
+    // code flow and jumps
+    for (AsmCodeFlowEntry& entry: section.codeFlow)
+    {
+        const size_t oldOffset = entry.offset;
+        const size_t oldTarget = entry.target;
+        // start and end of code are placed like labels
+        if (entry.type == AsmCodeFlowType::START || entry.type == AsmCodeFlowType::END)
+            entry.offset = shiftMap.labelOffset(entry.offset);
         else
+            entry.offset = shiftMap.instrOffset(entry.offset);
+        if (entry.type != AsmCodeFlowType::JUMP && entry.type != AsmCodeFlowType::CJUMP &&
+            entry.type != AsmCodeFlowType::CALL)
+            continue;
+        entry.target = shiftMap.labelOffset(entry.target);
+        if (!isaAssembler->relocateJump(section.content.data(), oldOffset, oldTarget,
+                    entry.offset, entry.target))
         {
-            // back
-            flowStack.pop_back();
-            
-            if (!flowStack.empty() && lastCommonCacheWayPoint.first != SIZE_MAX &&
-                    lastCommonCacheWayPoint.second >= flowStack.size())
+            if (section.kernelId != ASMKERN_GLOBAL)
             {
-                lastCommonCacheWayPoint =
-                        { flowStack.back().blockIndex, flowStack.size()-1 };
-                ARDOut << "POPlastCcwP: " << lastCommonCacheWayPoint.first << "\n";
+                // print position of kernel
+                kernels[section.kernelId].sourcePos.print(messageStream);
+                messageStream << ": ";
             }
+            messageStream << "Error: Insertion of wait instructions"
+                    " in section '" << section.name << "': Jump out of range\n";
+            good = false;
         }
     }
     
-    // after, that resolve joins (join with already visited code)
-    // next loop
-    flowStack.clear();
-    std::deque<FlowStackEntry2> flowStack2;
-    
-    std::fill(visited.begin(), visited.end(), false);
-    flowStack2.push_back({ 0, 0 });
-    SimpleCache<size_t, WaitFirstCacheEntry> resFirstPointsCache(codeBlocks.size()*256);
-    SimpleCache<size_t, WaitSecCacheEntry> resSecondPointsCache(codeBlocks.size()*128);
-    
-    while (!flowStack2.empty())
+    // labels, relocations and code regions of kernels
+    shiftSymbolsInScope(globalScope, sectionId, shiftMap);
+    for (AsmRelocation& reloc: relocations)
     {
-        FlowStackEntry2& entry = flowStack2.back();
-        const CodeBlock& cblock = codeBlocks[entry.blockIndex];
-        
-        if (entry.nextIndex == 0)
-        {
-            // process current block
-            if (!visited[entry.blockIndex])
-                visited[entry.blockIndex] = true;
-            else
+        if (reloc.sectionId == sectionId)
+            reloc.offset = shiftMap.instrOffset(reloc.offset);
+        if (reloc.relSectionId == sectionId)
+            reloc.addend = shiftMap.labelOffset(reloc.addend);
+    }
+    // code regions of kernels are in global code section
+    if (section.kernelId == ASMKERN_GLOBAL)
+        for (AsmKernel& kernel: kernels)
+            for (std::pair<size_t, size_t>& region: kernel.codeRegions)
             {
-                /*resolveSSAConflicts(flowStack2, routineMap, codeBlocks,
-                            prevWaysIndexMap, waysToCache, cblocksToCache,
-                            resFirstPointsCache, resSecondPointsCache, ssaReplacesMap);*/
-                
-                // back, already visited
-                flowStack2.pop_back();
-                continue;
+                region.first = shiftMap.labelOffset(region.first);
+                if (region.second != SIZE_MAX)
+                    region.second = shiftMap.labelOffset(region.second);
             }
-        }
-        
-        if (entry.nextIndex < cblock.nexts.size())
-        {
-            flowStack2.push_back({ cblock.nexts[entry.nextIndex].block, 0 });
-            entry.nextIndex++;
-        }
-        else if (((entry.nextIndex==0 && cblock.nexts.empty()) ||
-                // if have any call then go to next block
-                (cblock.haveCalls && entry.nextIndex==cblock.nexts.size())) &&
-                 !cblock.haveReturn && !cblock.haveEnd)
-        {
-            flowStack2.push_back({ entry.blockIndex+1, 0 });
-            entry.nextIndex++;
-        }
-        else // back
-        {
-            /*if (cblocksToCache.count(entry.blockIndex)==2 &&
-                !resSecondPointsCache.hasKey(entry.blockIndex))
-                // add to cache
-                addResSecCacheEntry(routineMap, codeBlocks, resSecondPointsCache,
-                            entry.blockIndex);*/
-            flowStack2.pop_back();
-        }
-    }
 }
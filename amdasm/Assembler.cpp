@@ -20,12 +20,15 @@
 #include <CLRX/Config.h>
 #include <string>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <vector>
 #include <stack>
 #include <deque>
+#include <memory>
 #include <utility>
 #include <algorithm>
+#include <unordered_map>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/utils/MemAccess.h>
 #include <CLRX/utils/GPUId.h>
@@ -70,6 +73,7 @@ AsmSection::AsmSection(const AsmSection& section)
     if (section.waitHandler!=nullptr)
         waitHandler.reset(section.waitHandler->copy());
     codeFlow = section.codeFlow;
+    sourcePosHandler = section.sourcePosHandler;
 }
 
 // copy assignment - includes usageHandler copying
@@ -92,6 +96,7 @@ AsmSection& AsmSection::operator=(const AsmSection& section)
     if (section.waitHandler!=nullptr)
         waitHandler.reset(section.waitHandler->copy());
     codeFlow = section.codeFlow;
+    sourcePosHandler = section.sourcePosHandler;
     return *this;
 }
 
@@ -624,6 +629,26 @@ ISAAssembler::ISAAssembler(Assembler& _assembler) : assembler(_assembler)
 ISAAssembler::~ISAAssembler()
 { }
 
+bool ISAAssembler::resolveMnemonic(const CString& mnemonic, size_t& instrId) const
+{
+    return false;
+}
+
+void ISAAssembler::assembleResolved(size_t instrId, const char* mnemPlace,
+              const char* linePtr, const char* lineEnd, std::vector<cxbyte>& output,
+              ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler)
+{
+    throw AsmException("Assembling resolved instructions is not supported");
+}
+
+void AsmSymbol::addOccurrenceInExpr(AsmExpression* expr, size_t argIndex,
+               size_t opIndex)
+{
+    // occurrences are allocated from expression's memory pool
+    occurrencesInExprs.setPool(expr->getMemoryPool());
+    occurrencesInExprs.push_back({expr, argIndex, opIndex});
+}
+
 void AsmSymbol::removeOccurrenceInExpr(AsmExpression* expr, size_t argIndex,
                size_t opIndex)
 {
@@ -664,6 +689,176 @@ void AsmSymbol::undefine()
     *this = AsmSymbol();
 }
 
+AsmSymbolMap::AsmSymbolMap(const AsmSymbolMap& map)
+        : slots(nullptr), slotsNum(0), entriesNum(0), first(nullptr), last(nullptr)
+{
+    if (map.entriesNum == 0)
+        return;
+    rehash(map.slotsNum);
+    for (const Node* node = map.first; node != nullptr; node = node->next)
+    {
+        // slot is always found, because all names in map are different
+        size_t slot = node->hash & (slotsNum-1);
+        while (slots[slot] != nullptr)
+            slot = (slot+1) & (slotsNum-1);
+        insertNode(slot, new Node(node->hash, node->entry));
+    }
+}
+
+AsmSymbolMap::AsmSymbolMap(AsmSymbolMap&& map) noexcept
+        : slots(map.slots), slotsNum(map.slotsNum), entriesNum(map.entriesNum),
+          first(map.first), last(map.last)
+{
+    map.slots = nullptr;
+    map.slotsNum = map.entriesNum = 0;
+    map.first = map.last = nullptr;
+}
+
+AsmSymbolMap::~AsmSymbolMap()
+{
+    clear();
+    delete[] slots;
+}
+
+AsmSymbolMap& AsmSymbolMap::operator=(const AsmSymbolMap& map)
+{
+    if (this == &map)
+        return *this;
+    AsmSymbolMap newMap(map);
+    return *this = std::move(newMap);
+}
+
+AsmSymbolMap& AsmSymbolMap::operator=(AsmSymbolMap&& map) noexcept
+{
+    std::swap(slots, map.slots);
+    std::swap(slotsNum, map.slotsNum);
+    std::swap(entriesNum, map.entriesNum);
+    std::swap(first, map.first);
+    std::swap(last, map.last);
+    return *this;
+}
+
+// returns slot with entry of this name or first free slot
+size_t AsmSymbolMap::findSlot(const AsmSymbolName& name) const
+{
+    if (slotsNum == 0)
+        return 0;
+    size_t slot = name.hash & (slotsNum-1);
+    for (; slots[slot] != nullptr; slot = (slot+1) & (slotsNum-1))
+    {
+        const Node* node = slots[slot];
+        // compare hashes before names
+        if (node->hash == name.hash && node->entry.first.size() == name.length &&
+            ::memcmp(node->entry.first.c_str(), name.name, name.length) == 0)
+            break;
+    }
+    return slot;
+}
+
+void AsmSymbolMap::rehash(size_t newSlotsNum)
+{
+    std::unique_ptr<Node*[]> newSlots(new Node*[newSlotsNum]);
+    std::fill(newSlots.get(), newSlots.get()+newSlotsNum, nullptr);
+    // use hashes held in entries
+    for (Node* node = first; node != nullptr; node = node->next)
+    {
+        size_t slot = node->hash & (newSlotsNum-1);
+        while (newSlots[slot] != nullptr)
+            slot = (slot+1) & (newSlotsNum-1);
+        newSlots[slot] = node;
+    }
+    delete[] slots;
+    slots = newSlots.release();
+    slotsNum = newSlotsNum;
+}
+
+std::pair<AsmSymbolMap::iterator, bool> AsmSymbolMap::insertNode(size_t slot, Node* node)
+{
+    slots[slot] = node;
+    // append to list (insertion order)
+    node->prev = last;
+    if (last != nullptr)
+        last->next = node;
+    else
+        first = node;
+    last = node;
+    entriesNum++;
+    return std::make_pair(iterator(node), true);
+}
+
+std::pair<AsmSymbolMap::iterator, bool> AsmSymbolMap::insert(const value_type& entry)
+{
+    const AsmSymbolName name(entry.first);
+    if ((entriesNum+1)<<1 > slotsNum) // keep load factor below 0.5
+        rehash(slotsNum != 0 ? slotsNum<<1 : 16);
+    const size_t slot = findSlot(name);
+    if (slots[slot] != nullptr)
+        return std::make_pair(iterator(slots[slot]), false);
+    return insertNode(slot, new Node(name.hash, entry));
+}
+
+std::pair<AsmSymbolMap::iterator, bool> AsmSymbolMap::insert(const AsmSymbolName& name,
+                const AsmSymbol& symbol)
+{
+    if ((entriesNum+1)<<1 > slotsNum) // keep load factor below 0.5
+        rehash(slotsNum != 0 ? slotsNum<<1 : 16);
+    const size_t slot = findSlot(name);
+    if (slots[slot] != nullptr)
+        return std::make_pair(iterator(slots[slot]), false);
+    return insertNode(slot, new Node(name.hash, name, symbol));
+}
+
+AsmSymbolMap::iterator AsmSymbolMap::erase(iterator it)
+{
+    Node* node = it.node;
+    size_t slot = node->hash & (slotsNum-1);
+    while (slots[slot] != node)
+        slot = (slot+1) & (slotsNum-1);
+    // backward shift deletion: move next entries from probe sequence to free slot
+    size_t next = slot;
+    while (true)
+    {
+        next = (next+1) & (slotsNum-1);
+        if (slots[next] == nullptr)
+            break;
+        const size_t ideal = slots[next]->hash & (slotsNum-1);
+        // move if ideal slot of entry is not in cyclic range (slot, next]
+        if (((next - ideal) & (slotsNum-1)) >= ((next - slot) & (slotsNum-1)))
+        {
+            slots[slot] = slots[next];
+            slot = next;
+        }
+    }
+    slots[slot] = nullptr;
+    // unlink from list
+    Node* nextNode = node->next;
+    if (node->prev != nullptr)
+        node->prev->next = nextNode;
+    else
+        first = nextNode;
+    if (nextNode != nullptr)
+        nextNode->prev = node->prev;
+    else
+        last = node->prev;
+    delete node;
+    entriesNum--;
+    return iterator(nextNode);
+}
+
+void AsmSymbolMap::clear()
+{
+    for (Node* node = first; node != nullptr;)
+    {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+    first = last = nullptr;
+    entriesNum = 0;
+    if (slots != nullptr)
+        std::fill(slots, slots+slotsNum, nullptr);
+}
+
 void Assembler::undefineSymbol(AsmSymbolEntry& symEntry)
 {
     cloneSymEntryIfNeeded(symEntry);
@@ -749,6 +944,110 @@ void AsmScope::stopUsingScope(AsmScope* scope)
     }
 }
 
+// return true if symbol still waits for value of its expression
+static inline bool hasPendingExpression(const AsmSymbol& symbol)
+{
+    return !symbol.hasValue && !symbol.regRange && !symbol.base &&
+            symbol.expression != nullptr;
+}
+
+namespace CLRX
+{
+
+/* dependency graph of symbols: edge from symbol to other symbol whose pending
+ * expression uses it. successors are stored in one array (successors of node are
+ * between succStarts[node] and succStarts[node+1]). graph is kept by assembler
+ * and reused (with its allocated memory) by next resolving */
+struct CLRX_INTERNAL AsmSymbolDepGraph
+{
+    std::vector<AsmSymbolEntry*> nodes;
+    std::unordered_map<const AsmSymbolEntry*, size_t> nodeIndices;
+    std::vector<std::pair<size_t, size_t> > edges;
+    std::vector<size_t> succStarts;
+    std::vector<size_t> succPos;
+    std::vector<size_t> successors;
+    std::vector<size_t> inDegrees;
+    std::vector<size_t> queue;
+    
+    void clear()
+    { nodes.clear(); }
+    
+    void addNode(AsmSymbolEntry* entry)
+    { nodes.push_back(entry); }
+    
+    // add edges from symbols in pending expressions of nodes
+    void build();
+    
+    // resolve nodes in topological order (Kahn's algorithm),
+    // nodes in cycles (or depending on cycles) are resolved at end
+    template<typename ResolveNode>
+    void resolve(ResolveNode resolveNode);
+};
+
+};
+
+void AsmSymbolDepGraph::build()
+{
+    nodeIndices.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+        nodeIndices.insert(std::make_pair(nodes[i], i));
+    edges.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const AsmSymbol& symbol = nodes[i]->second;
+        if (!hasPendingExpression(symbol))
+            continue;
+        const AsmExpression* expr = symbol.expression;
+        const AsmExprOp* ops = expr->getOps();
+        const AsmExprArg* args = expr->getArgs();
+        size_t argIndex = 0;
+        for (size_t opIndex = 0; opIndex < expr->getOpsNum(); opIndex++)
+            if (ops[opIndex] == AsmExprOp::ARG_SYMBOL)
+            {
+                auto it = nodeIndices.find(args[argIndex++].symbol);
+                if (it != nodeIndices.end())
+                    edges.push_back(std::make_pair(it->second, i));
+            }
+            else if (ops[opIndex] == AsmExprOp::ARG_VALUE)
+                argIndex++;
+    }
+    // put successors in order of source nodes (counting sort)
+    succStarts.assign(nodes.size()+1, 0);
+    inDegrees.assign(nodes.size(), 0);
+    for (const auto& edge: edges)
+    {
+        succStarts[edge.first+1]++;
+        inDegrees[edge.second]++;
+    }
+    for (size_t i = 0; i < nodes.size(); i++)
+        succStarts[i+1] += succStarts[i];
+    successors.resize(edges.size());
+    succPos.assign(succStarts.begin(), succStarts.end()-1);
+    for (const auto& edge: edges)
+        successors[succPos[edge.first]++] = edge.second;
+}
+
+template<typename ResolveNode>
+void AsmSymbolDepGraph::resolve(ResolveNode resolveNode)
+{
+    queue.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+        if (inDegrees[i] == 0)
+            queue.push_back(i);
+    for (size_t qi = 0; qi < queue.size(); qi++)
+    {
+        const size_t node = queue[qi];
+        resolveNode(*nodes[node]);
+        for (size_t si = succStarts[node]; si < succStarts[node+1]; si++)
+            if (--inDegrees[successors[si]] == 0)
+                queue.push_back(successors[si]);
+    }
+    if (queue.size() != nodes.size())
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (inDegrees[i] != 0)
+                resolveNode(*nodes[i]);
+}
+
 /*
  * Assembler
  */
@@ -761,7 +1060,7 @@ Assembler::Assembler(const CString& filename, std::istream& input, Flags _flags,
           driverVersion(0), llvmVersion(0),
           _64bit(false), newROCmBinFormat(false),
           llvm10BinFormat(false), rocmMetadataV3(false),
-          policyVersion(ASM_POLICY_DEFAULT),
+          policyVersion(ASM_POLICY_DEFAULT), occupancyTarget(0),
           isaAssembler(nullptr),
           // initialize global scope: adds '.' to symbols
           globalScope({nullptr,{std::make_pair(".", AsmSymbol(0, uint64_t(0)))}}),
@@ -776,6 +1075,9 @@ Assembler::Assembler(const CString& filename, std::istream& input, Flags _flags,
           currentOutPos(globalScope.symbolMap.begin()->second.value)
 {
     filenameIndex = 0;
+    settingsSaved = false;
+    includeCache = nullptr;
+    trackFileDeps = false;
     alternateMacro = (flags & ASM_ALTMACRO)!=0;
     buggyFPLit = (flags & ASM_BUGGYFPLIT)!=0;
     macroCase = (flags & ASM_MACRONOCASE)==0;
@@ -788,6 +1090,9 @@ Assembler::Assembler(const CString& filename, std::istream& input, Flags _flags,
     resolvingRelocs = false;
     collectSourcePoses = false;
     formatHandler = nullptr;
+    savedFormatHandler = nullptr;
+    savedIsaAssembler = nullptr;
+    symbolDepGraph = nullptr;
     input.exceptions(std::ios::badbit);
     std::unique_ptr<AsmInputFilter> thatInputFilter(
                     new AsmStreamInputFilter(input, filename));
@@ -795,6 +1100,53 @@ Assembler::Assembler(const CString& filename, std::istream& input, Flags _flags,
     currentInputFilter = thatInputFilter.release();
 }
 
+Assembler::Assembler(const CString& filename, size_t sourceSize, const char* source,
+        Flags _flags, BinaryFormat _format, GPUDeviceType _deviceType,
+        std::ostream& msgStream, std::ostream& _printStream)
+        : format(_format),
+          deviceType(_deviceType),
+          driverVersion(0), llvmVersion(0),
+          _64bit(false), newROCmBinFormat(false),
+          llvm10BinFormat(false), rocmMetadataV3(false),
+          policyVersion(ASM_POLICY_DEFAULT), occupancyTarget(0),
+          isaAssembler(nullptr),
+          // initialize global scope: adds '.' to symbols
+          globalScope({nullptr,{std::make_pair(".", AsmSymbol(0, uint64_t(0)))}}),
+          currentScope(&globalScope),
+          flags(_flags),
+          lineSize(0), line(nullptr),
+          endOfAssembly(false),
+          messageStream(msgStream),
+          printStream(_printStream),
+          // value reference and section reference from first symbol: '.'
+          currentSection(globalScope.symbolMap.begin()->second.sectionId),
+          currentOutPos(globalScope.symbolMap.begin()->second.value)
+{
+    filenameIndex = 0;
+    settingsSaved = false;
+    includeCache = nullptr;
+    trackFileDeps = false;
+    alternateMacro = (flags & ASM_ALTMACRO)!=0;
+    buggyFPLit = (flags & ASM_BUGGYFPLIT)!=0;
+    macroCase = (flags & ASM_MACRONOCASE)==0;
+    oldModParam = (flags & ASM_OLDMODPARAM)!=0;
+    codeFlags = ((flags & ASM_WAVE32)!=0)?ASM_CODE_WAVE32:0;
+    localCount = macroCount = inclusionLevel = 0;
+    macroSubstLevel = repetitionLevel = 0;
+    lineAlreadyRead = false;
+    good = true;
+    resolvingRelocs = false;
+    collectSourcePoses = false;
+    formatHandler = nullptr;
+    savedFormatHandler = nullptr;
+    savedIsaAssembler = nullptr;
+    symbolDepGraph = nullptr;
+    std::unique_ptr<AsmInputFilter> thatInputFilter(
+                    new AsmStreamInputFilter(sourceSize, source, filename));
+    asmInputFilters.push(thatInputFilter.get());
+    currentInputFilter = thatInputFilter.release();
+}
+
 Assembler::Assembler(const Array<CString>& _filenames, Flags _flags,
         BinaryFormat _format, GPUDeviceType _deviceType, std::ostream& msgStream,
         std::ostream& _printStream)
@@ -803,7 +1155,7 @@ Assembler::Assembler(const Array<CString>& _filenames, Flags _flags,
           driverVersion(0), llvmVersion(0),
           _64bit(false), newROCmBinFormat(false),
           llvm10BinFormat(false), rocmMetadataV3(false),
-          policyVersion(ASM_POLICY_DEFAULT),
+          policyVersion(ASM_POLICY_DEFAULT), occupancyTarget(0),
           isaAssembler(nullptr),
           // initialize global scope: adds '.' to symbols
           globalScope({nullptr,{std::make_pair(".", AsmSymbol(0, uint64_t(0)))}}),
@@ -818,6 +1170,9 @@ Assembler::Assembler(const Array<CString>& _filenames, Flags _flags,
           currentOutPos(globalScope.symbolMap.begin()->second.value)
 {
     filenameIndex = 0;
+    settingsSaved = false;
+    includeCache = nullptr;
+    trackFileDeps = false;
     filenames = _filenames;
     alternateMacro = (flags & ASM_ALTMACRO)!=0;
     buggyFPLit = (flags & ASM_BUGGYFPLIT)!=0;
@@ -831,6 +1186,9 @@ Assembler::Assembler(const Array<CString>& _filenames, Flags _flags,
     resolvingRelocs = false;
     collectSourcePoses = false;
     formatHandler = nullptr;
+    savedFormatHandler = nullptr;
+    savedIsaAssembler = nullptr;
+    symbolDepGraph = nullptr;
     if (filenames.empty())
         throw AsmException("Filename list is empty");
     for (cxuint i = 0; i < filenames.size(); i++)
@@ -845,15 +1203,27 @@ Assembler::Assembler(const Array<CString>& _filenames, Flags _flags,
 }
 
 Assembler::~Assembler()
+{
+    clearState();
+    delete savedFormatHandler;
+    delete savedIsaAssembler;
+    delete symbolDepGraph;
+}
+
+// delete all objects created while assembling (except global scope)
+void Assembler::clearState()
 {
     delete formatHandler;
+    formatHandler = nullptr;
     if (isaAssembler != nullptr)
         delete isaAssembler;
+    isaAssembler = nullptr;
     while (!asmInputFilters.empty())
     {
         delete asmInputFilters.top();
         asmInputFilters.pop();
     }
+    includeSnapshots.clear();
     
     /// remove expressions before symbol map deletion
     for (auto& entry: globalScope.symbolMap)
@@ -862,6 +1232,7 @@ Assembler::~Assembler()
         delete entry.second;
     for (AsmScope* entry: abandonedScopes)
         delete entry;
+    abandonedScopes.clear();
     globalScope.scopeMap.clear();
     /// remove expressions before symbol snapshots
     for (auto& entry: symbolSnapshots)
@@ -869,6 +1240,7 @@ Assembler::~Assembler()
     
     for (auto& entry: symbolSnapshots)
         delete entry;
+    symbolSnapshots.clear();
     
     /// remove expressions before symbol clones
     for (auto& entry: symbolClones)
@@ -876,9 +1248,87 @@ Assembler::~Assembler()
     
     for (auto& entry: symbolClones)
         delete entry;
+    symbolClones.clear();
     
     for (auto& expr: unevalExpressions)
         delete expr;
+    unevalExpressions.clear();
+    codeOffsetsUses.clear();
+}
+
+void Assembler::reset(const CString& filename, size_t sourceSize, const char* source)
+{
+    if (formatHandler != nullptr)
+    {
+        // keep format handler and ISA assembler to reuse them
+        delete savedFormatHandler;
+        delete savedIsaAssembler;
+        savedFormatHandler = formatHandler;
+        savedHandlerFormat = format;
+        savedIsaAssembler = isaAssembler;
+        formatHandler = nullptr;
+        isaAssembler = nullptr;
+    }
+    clearState();
+    if (settingsSaved)
+    {
+        // restore settings changed by pseudo-ops
+        format = initialSettings.format;
+        deviceType = initialSettings.deviceType;
+        driverVersion = initialSettings.driverVersion;
+        llvmVersion = initialSettings.llvmVersion;
+        _64bit = initialSettings._64bit;
+        newROCmBinFormat = initialSettings.newROCmBinFormat;
+        llvm10BinFormat = initialSettings.llvm10BinFormat;
+        rocmMetadataV3 = initialSettings.rocmMetadataV3;
+        policyVersion = initialSettings.policyVersion;
+        occupancyTarget = initialSettings.occupancyTarget;
+    }
+    // remove all symbols except '.' (current section and output position refer to it)
+    for (auto it = globalScope.symbolMap.begin(); it != globalScope.symbolMap.end();)
+        if (it->first != ".")
+            it = globalScope.symbolMap.erase(it);
+        else
+            ++it;
+    globalScope.symbolMap.find(".")->second = AsmSymbol(0, uint64_t(0));
+    globalScope.regVarMap.clear();
+    globalScope.stopUsingScopes();
+    globalScope.enumCount = 0;
+    
+    filenames.clear();
+    filenameIndex = 0;
+    fileDependencies.clear();
+    sections.clear();
+    regAllocResults.clear();
+    relSpacesSections.clear();
+    relocations.clear();
+    regVarLinearsMap.clear();
+    macroMap.clear();
+    scopeStack = std::stack<AsmScope*>();
+    currentScope = &globalScope;
+    kernelMap.clear();
+    kernels.clear();
+    clauses = std::stack<AsmClause>();
+    
+    alternateMacro = (flags & ASM_ALTMACRO)!=0;
+    buggyFPLit = (flags & ASM_BUGGYFPLIT)!=0;
+    macroCase = (flags & ASM_MACRONOCASE)==0;
+    oldModParam = (flags & ASM_OLDMODPARAM)!=0;
+    codeFlags = ((flags & ASM_WAVE32)!=0)?ASM_CODE_WAVE32:0;
+    localCount = macroCount = inclusionLevel = 0;
+    macroSubstLevel = repetitionLevel = 0;
+    lineAlreadyRead = false;
+    lineSize = 0;
+    line = nullptr;
+    endOfAssembly = false;
+    good = true;
+    resolvingRelocs = false;
+    collectSourcePoses = false;
+    
+    std::unique_ptr<AsmInputFilter> thatInputFilter(
+                    new AsmStreamInputFilter(sourceSize, source, filename));
+    asmInputFilters.push(thatInputFilter.get());
+    currentInputFilter = thatInputFilter.release();
 }
 
 // routine to parse string in assembly syntax
@@ -1258,6 +1708,7 @@ Assembler::ParseState Assembler::parseSymbol(const char*& linePtr,
     if (symName == ".") // any usage of '.' causes format initialization
     {
         // special case ('.' - always global)
+        taintIncludeSnapshots(); // depends on output position
         initializeOutputFormat();
         entry = &*globalScope.symbolMap.find(".");
         return Assembler::ParseState::PARSED;
@@ -1271,7 +1722,7 @@ Assembler::ParseState Assembler::parseSymbol(const char*& linePtr,
         AsmScope* outScope;
         CString sameSymName;
         entry = findSymbolInScope(symName, outScope, sameSymName);
-        if (sameSymName == ".")
+        if ((entry != nullptr ? entry->first : sameSymName) == ".")
         {
             // illegal name of symbol (must be in global)
             printError(startPlace, "Symbol '.' can be only in global scope");
@@ -1283,6 +1734,8 @@ Assembler::ParseState Assembler::parseSymbol(const char*& linePtr,
             std::pair<AsmSymbolMap::iterator, bool> res =
                     outScope->symbolMap.insert(std::make_pair(sameSymName, AsmSymbol()));
             entry = &*res.first;
+            if (res.second)
+                addIncludeSymbol(entry);
             symHasValue = res.first->second.hasValue;
         }
         else // only find symbol and set isDefined and entry
@@ -1291,11 +1744,12 @@ Assembler::ParseState Assembler::parseSymbol(const char*& linePtr,
     else
     {
         // local labels is in global scope
+        taintIncludeSnapshots(); // local labels are not cacheable
         if (!dontCreateSymbol)
         {
             // create symbol if not found
             std::pair<AsmSymbolMap::iterator, bool> res =
-                    globalScope.symbolMap.insert(std::make_pair(symName, AsmSymbol()));
+                    globalScope.symbolMap.insert(AsmSymbolName(symName), AsmSymbol());
             entry = &*res.first;
             symHasValue = res.first->second.hasValue;
         }
@@ -1910,6 +2364,7 @@ void Assembler::printWarning(const AsmSourcePos& pos, const char* message)
 {
     if ((flags & ASM_WARNINGS) == 0)
         return; // do nothing
+    taintIncludeSnapshots();
     pos.print(messageStream);
     messageStream.write(": Warning: ", 11);
     messageStream.write(message, ::strlen(message));
@@ -1919,6 +2374,7 @@ void Assembler::printWarning(const AsmSourcePos& pos, const char* message)
 void Assembler::printError(const AsmSourcePos& pos, const char* message)
 {
     good = false;
+    taintIncludeSnapshots();
     pos.print(messageStream);
     messageStream.write(": Error: ", 9);
     messageStream.write(message, ::strlen(message));
@@ -2068,9 +2524,11 @@ Assembler::ParseState Assembler::makeMacroSubstitution(const char* linePtr)
         return ParseState::MISSING;
     if (macroCase)
         toLowerString(macroName);
+    useIncludeMacro(macroName);
     AsmMacroMap::const_iterator it = macroMap.find(macroName);
     if (it == macroMap.end())
         return ParseState::MISSING; // macro not found
+    useIncludeMacroCount();
     
     /* parse arguments */
     RefPtr<const AsmMacro> macro = it->second;
@@ -2256,8 +2714,17 @@ AsmScope* Assembler::getRecurScope(const CString& scopePlace, bool ignoreLast,
 
 // internal routine to find symbol in scope (only traversing by '.using's)
 AsmSymbolEntry* Assembler::findSymbolInScopeInt(AsmScope* scope,
-                    const CString& symName, std::unordered_set<AsmScope*>& scopeSet)
+                const AsmSymbolName& symName, std::unordered_set<AsmScope*>& scopeSet)
 {
+    if (scope->usedScopes.empty())
+    {
+        /* fast path: scope without usings. do not remember this scope in set,
+         * because second visit just repeats lookup without result */
+        if (scopeSet.find(scope) != scopeSet.end())
+            return nullptr;
+        AsmSymbolMap::iterator it = scope->symbolMap.find(symName);
+        return (it != scope->symbolMap.end()) ? &*it : nullptr;
+    }
     if (!scopeSet.insert(scope).second)
         return nullptr;
     std::stack<ScopeUsingStackElem> usingStack;
@@ -2294,10 +2761,22 @@ AsmSymbolEntry* Assembler::findSymbolInScope(const CString& symName, AsmScope*&
     const char* lastStep = nullptr;
     scope = getRecurScope(symName, true, &lastStep);
     std::unordered_set<AsmScope*> scopeSet;
-    AsmSymbolEntry* foundSym = findSymbolInScopeInt(scope, lastStep, scopeSet);
-    sameSymName = lastStep;
+    // name hashed once for all visited scopes
+    const AsmSymbolName lastStepName(lastStep,
+                symName.size() - (lastStep - symName.c_str()));
+    AsmSymbolEntry* foundSym = findSymbolInScopeInt(scope, lastStepName, scopeSet);
+    if (!includeSnapshots.empty())
+    {
+        // include cache holds only uses of global symbols
+        if (currentScope != &globalScope || scope != &globalScope ||
+            lastStep != symName.c_str() || !globalScope.usedScopes.empty())
+            taintIncludeSnapshots();
+        else
+            useIncludeSymbol(lastStepName, foundSym);
+    }
     if (foundSym != nullptr)
         return foundSym;
+    sameSymName = lastStep;
     if (lastStep != symName)
         return nullptr;
     // otherwise is symName is not normal symName
@@ -2307,7 +2786,7 @@ AsmSymbolEntry* Assembler::findSymbolInScope(const CString& symName, AsmScope*&
     
     for (AsmScope* scope2 = scope; scope2 != nullptr; scope2 = scope2->parent)
     {  // find this scope
-        foundSym = findSymbolInScopeInt(scope2, lastStep, scopeSet);
+        foundSym = findSymbolInScopeInt(scope2, lastStepName, scopeSet);
         if (foundSym != nullptr)
             return foundSym;
     }
@@ -2323,6 +2802,8 @@ std::pair<AsmSymbolEntry*, bool> Assembler::insertSymbolInScope(const CString& s
     if (symEntry==nullptr)
     {
         auto res = outScope->symbolMap.insert({ sameSymName, symbol });
+        if (res.second)
+            addIncludeSymbol(&*res.first);
         return std::make_pair(&*res.first, res.second);
     }
     return std::make_pair(symEntry, false);
@@ -2457,14 +2938,47 @@ bool Assembler::includeFile(const char* pseudoOpPlace, const std::string& filena
 {
     if (inclusionLevel == 500)
         THIS_FAIL_BY_ERROR(pseudoOpPlace, "Inclusion level is greater than 500")
+    uint64_t contentHash = 0, settingsHash = 0;
+    bool regular = true;
+    if (includeCache != nullptr || trackFileDeps)
+    {
+        // throws exception if file can not be read (likes input filter)
+        contentHash = hashIncludeFile(filename, &regular);
+        if (trackFileDeps)
+            fileDependencies.push_back({ filename, regular, contentHash, false });
+    }
+    /* content of pipe or device can change, hence it is not cached.
+     * cache holds only global symbols, hence file included in scope is not cached */
+    const bool useIncludeCache = includeCache != nullptr && regular &&
+                currentScope == &globalScope;
+    if (!regular || currentScope != &globalScope)
+        taintIncludeSnapshots();
+    if (useIncludeCache)
+    {
+        settingsHash = hashIncludeSettings();
+        if (restoreIncludeFromCache(filename, contentHash, settingsHash))
+            return true;
+    }
     std::unique_ptr<AsmInputFilter> newInputFilter(new AsmStreamInputFilter(
                 getSourcePos(pseudoOpPlace), filename));
+    if (useIncludeCache)
+        beginIncludeSnapshot(filename, contentHash, settingsHash, newInputFilter.get());
     asmInputFilters.push(newInputFilter.release());
     currentInputFilter = asmInputFilters.top();
     inclusionLevel++;
     return true;
 }
 
+void Assembler::addMissingIncludePath(const std::string& path)
+{
+    // file created at this path would be found by next include search
+    const AsmFileDependency dep = { path, true, 0, true };
+    for (IncludeSnapshot& snapshot: includeSnapshots)
+        snapshot.dependencies.push_back(dep);
+    if (trackFileDeps)
+        fileDependencies.push_back(dep);
+}
+
 bool Assembler::readLine()
 {
     line = currentInputFilter->readLine(*this, lineSize);
@@ -2477,7 +2991,12 @@ bool Assembler::readLine()
             if (currentInputFilter->getType() == AsmInputFilterType::MACROSUBST)
                 macroSubstLevel--;
             else if (currentInputFilter->getType() == AsmInputFilterType::STREAM)
+            {
                 inclusionLevel--;
+                if (!includeSnapshots.empty() &&
+                    includeSnapshots.back().filter == currentInputFilter)
+                    endIncludeSnapshot();
+            }
             else if (currentInputFilter->getType() == AsmInputFilterType::REPEAT)
                 repetitionLevel--;
             delete asmInputFilters.top();
@@ -2693,25 +3212,44 @@ void Assembler::initializeOutputFormat()
 {
     if (formatHandler!=nullptr)
         return;
-    switch(format)
+    if (savedFormatHandler != nullptr && savedHandlerFormat == format)
     {
-        case BinaryFormat::AMD:
-            formatHandler = new AsmAmdHandler(*this);
-            break;
-        case BinaryFormat::AMDCL2:
-            formatHandler = new AsmAmdCL2Handler(*this);
-            break;
-        case BinaryFormat::GALLIUM:
-            formatHandler = new AsmGalliumHandler(*this);
-            break;
-        case BinaryFormat::ROCM:
-            formatHandler = new AsmROCmHandler(*this);
-            break;
-        default:
-            formatHandler = new AsmRawCodeHandler(*this);
-            break;
+        // reuse format handler from previous assembling
+        formatHandler = savedFormatHandler;
+        savedFormatHandler = nullptr;
+        formatHandler->reset();
+    }
+    else
+    {
+        delete savedFormatHandler;
+        savedFormatHandler = nullptr;
+        switch(format)
+        {
+            case BinaryFormat::AMD:
+                formatHandler = new AsmAmdHandler(*this);
+                break;
+            case BinaryFormat::AMDCL2:
+                formatHandler = new AsmAmdCL2Handler(*this);
+                break;
+            case BinaryFormat::GALLIUM:
+                formatHandler = new AsmGalliumHandler(*this);
+                break;
+            case BinaryFormat::ROCM:
+                formatHandler = new AsmROCmHandler(*this);
+                break;
+            default:
+                formatHandler = new AsmRawCodeHandler(*this);
+                break;
+        }
+    }
+    if (savedIsaAssembler != nullptr)
+    {
+        isaAssembler = savedIsaAssembler;
+        savedIsaAssembler = nullptr;
+        isaAssembler->reset();
     }
-    isaAssembler = new GCNAssembler(*this);
+    else
+        isaAssembler = new GCNAssembler(*this);
     // add first section
     auto info = formatHandler->getSectionInfo(currentSection);
     sections.push_back({ info.name, currentKernel, info.type, info.flags, 0,
@@ -2785,21 +3323,31 @@ void Assembler::tryToResolveSymbol(AsmSymbolEntry& symEntry)
 
 // try to resolve symbols in scope (after closing temporary scope or
 // ending assembly for global scope)
+/* symbols are resolved in order of their dependency graph. setSymbol substitutes
+ * value only to dependent expressions, hence every dependency is visited once */
 void Assembler::tryToResolveSymbols(AsmScope* thisScope)
 {
     std::deque<ScopeStackElem> scopeStack;
     std::pair<CString, AsmScope*> globalScopeEntry = { "", thisScope };
     scopeStack.push_back({ globalScopeEntry, thisScope->scopeMap.begin() });
+    if (symbolDepGraph == nullptr)
+        symbolDepGraph = new AsmSymbolDepGraph;
+    AsmSymbolDepGraph& depGraph = *symbolDepGraph;
+    depGraph.clear();
+    bool pendingSymbols = false;
     
     while (!scopeStack.empty())
     {
         ScopeStackElem& elem = scopeStack.back();
         if (elem.childIt == elem.scope.second->scopeMap.begin())
         {
-            // first we check symbol of current scope
+            // first we collect symbols of current scope
             AsmScope* curScope = elem.scope.second;
             for (AsmSymbolEntry& symEntry: curScope->symbolMap)
-                tryToResolveSymbol(symEntry);
+            {
+                depGraph.addNode(&symEntry);
+                pendingSymbols |= hasPendingExpression(symEntry.second);
+            }
         }
         // next, we travere on children
         if (elem.childIt != elem.scope.second->scopeMap.end())
@@ -2811,6 +3359,18 @@ void Assembler::tryToResolveSymbols(AsmScope* thisScope)
         else // if end, we pop from stack
             scopeStack.pop_back();
     }
+    if (!pendingSymbols)
+    {
+        // no dependencies between symbols, just resolve in collection order
+        for (AsmSymbolEntry* symEntry: depGraph.nodes)
+            tryToResolveSymbol(*symEntry);
+        depGraph.clear();
+        return;
+    }
+    depGraph.build();
+    depGraph.resolve([this](AsmSymbolEntry& symEntry)
+            { tryToResolveSymbol(symEntry); });
+    depGraph.clear();
 }
 
 // print unresolved symbols in global scope after assemblying
@@ -2823,6 +3383,8 @@ void Assembler::printUnresolvedSymbols(AsmScope* thisScope)
     std::deque<ScopeStackElem> scopeStack;
     std::pair<CString, AsmScope*> globalScopeEntry = { "", thisScope };
     scopeStack.push_back({ globalScopeEntry, thisScope->scopeMap.begin() });
+    // symbols with unresolved expressions (to find circular dependencies)
+    std::vector<AsmSymbolEntry*> pendingSymbols;
     
     while (!scopeStack.empty())
     {
@@ -2832,6 +3394,9 @@ void Assembler::printUnresolvedSymbols(AsmScope* thisScope)
             // first we check symbol of current scope
             AsmScope* curScope = elem.scope.second;
             for (AsmSymbolEntry& symEntry: curScope->symbolMap)
+            {
+                if (hasPendingExpression(symEntry.second))
+                    pendingSymbols.push_back(&symEntry);
                 if (!symEntry.second.occurrencesInExprs.empty())
                     for (AsmExprSymbolOccurrence occur:
                             symEntry.second.occurrencesInExprs)
@@ -2849,6 +3414,7 @@ void Assembler::printUnresolvedSymbols(AsmScope* thisScope)
                             "Unresolved symbol '")+scopePath+
                             symEntry.first.c_str()+"'").c_str());
                     }
+            }
         }
         // next, we travere on children
         if (elem.childIt != elem.scope.second->scopeMap.end())
@@ -2860,13 +3426,182 @@ void Assembler::printUnresolvedSymbols(AsmScope* thisScope)
         else // if end, we pop from stack
             scopeStack.pop_back();
     }
+    
+    printCircularDependencies(pendingSymbols);
+}
+
+/* find cycles in graph of symbols with unresolved expressions (edges from symbol
+ * to symbols in its expression) by depth-first search and print each cycle once */
+void Assembler::printCircularDependencies(const std::vector<AsmSymbolEntry*>& symbols)
+{
+    enum : cxbyte { VISITING = 1, VISITED };
+    std::unordered_map<const AsmSymbolEntry*, cxbyte> states;
+    struct StackEntry
+    {
+        AsmSymbolEntry* entry;
+        size_t opIndex;
+        size_t argIndex;
+    };
+    std::vector<StackEntry> stack;
+    
+    for (AsmSymbolEntry* startEntry: symbols)
+    {
+        if (!states.insert(std::make_pair(startEntry, VISITING)).second)
+            continue; // already visited
+        stack.push_back({ startEntry, 0, 0 });
+        while (!stack.empty())
+        {
+            StackEntry& se = stack.back();
+            const AsmExpression* expr = se.entry->second.expression;
+            const AsmExprOp* ops = expr->getOps();
+            AsmSymbolEntry* nextEntry = nullptr;
+            // find next symbol in expression
+            for (; se.opIndex < expr->getOpsNum() && nextEntry == nullptr; se.opIndex++)
+                if (ops[se.opIndex] == AsmExprOp::ARG_SYMBOL)
+                {
+                    AsmSymbolEntry* argEntry = expr->getArgs()[se.argIndex++].symbol;
+                    if (hasPendingExpression(argEntry->second))
+                        nextEntry = argEntry;
+                }
+                else if (ops[se.opIndex] == AsmExprOp::ARG_VALUE)
+                    se.argIndex++;
+            
+            if (nextEntry == nullptr)
+            {
+                // all dependencies visited
+                states[se.entry] = VISITED;
+                stack.pop_back();
+                continue;
+            }
+            auto res = states.insert(std::make_pair(nextEntry, VISITING));
+            if (res.second)
+                stack.push_back({ nextEntry, 0, 0 });
+            else if (res.first->second == VISITING)
+            {
+                // cycle found (from nextEntry to top of stack)
+                auto it = stack.begin();
+                while (it->entry != nextEntry)
+                    ++it;
+                std::string cycleStr;
+                for (; it != stack.end(); ++it)
+                {
+                    cycleStr += it->entry->first.c_str();
+                    cycleStr += " -> ";
+                }
+                cycleStr += nextEntry->first.c_str();
+                printError(nextEntry->second.expression->getSourcePos(),
+                        ("Circular dependency: "+cycleStr).c_str());
+            }
+        }
+    }
+}
+
+void Assembler::assembleStatement(const CString& firstName, const char* stmtPlace,
+            const char* linePtr, AsmCachedStmt* cachedStmt, bool stmtCached)
+{
+    const char* end = line+lineSize;
+    const AsmSectionId oldCurrentSection = currentSection;
+    const uint64_t oldCurrentOutPos = currentOutPos;
+    AsmSourcePos sourcePos{};
+    if (collectSourcePoses)
+        // source pos for sourcePosHandler
+        sourcePos = getSourcePos(stmtPlace);
+    
+    if (firstName.size() >= 2 && firstName[0] == '.') // check for pseudo-op
+    {
+        size_t pseudoOp;
+        if (stmtCached)
+            pseudoOp = cachedStmt->id;
+        else
+        {
+            pseudoOp = findPseudoOp(firstName);
+            if (cachedStmt != nullptr)
+                cachedStmt->set(AsmCachedStmt::PSEUDOOP, line, lineSize, stmtPlace,
+                            linePtr, firstName, pseudoOp);
+        }
+        parsePseudoOps(firstName, pseudoOp, stmtPlace, linePtr);
+    }
+    else if (firstName.size() >= 1 && isDigit(firstName[0]))
+        printError(stmtPlace, "Illegal number at statement begin");
+    else
+    {
+        // try to parse processor instruction or macro substitution
+        // (macro can be defined after caching instruction)
+        if ((stmtCached && macroMap.empty()) ||
+            makeMacroSubstitution(stmtPlace) == ParseState::MISSING)
+        {  
+            if (firstName.empty()) // if name is empty
+            {
+                if (linePtr!=end) // error
+                    printError(stmtPlace, "Garbages at statement place");
+                return;
+            }
+            initializeOutputFormat();
+            taintIncludeSnapshots(); // instructions are not cacheable
+            // try parse instruction
+            if (!isWriteableSection())
+            {
+                printError(stmtPlace,
+                   "Writing data into non-writeable section is illegal");
+                return;
+            }
+            
+            if (sections[currentSection].usageHandler == nullptr)
+                sections[currentSection].usageHandler.reset(
+                        isaAssembler->createUsageHandler());
+            
+            if (sections[currentSection].linearDepHandler == nullptr)
+                sections[currentSection].linearDepHandler.reset(
+                        new ISALinearDepHandler());
+            
+            if (sections[currentSection].waitHandler == nullptr)
+                sections[currentSection].waitHandler.reset(new ISAWaitHandler());
+            
+            size_t instrId = 0;
+            if (stmtCached)
+                instrId = cachedStmt->id;
+            else if (cachedStmt != nullptr &&
+                    isaAssembler->resolveMnemonic(firstName, instrId))
+            {
+                cachedStmt->set(AsmCachedStmt::INSTRUCTION, line, lineSize, stmtPlace,
+                            linePtr, firstName, instrId);
+                stmtCached = true;
+            }
+            
+            if (stmtCached)
+                isaAssembler->assembleResolved(instrId, stmtPlace, linePtr, end,
+                           sections[currentSection].content,
+                           sections[currentSection].usageHandler.get(),
+                           sections[currentSection].waitHandler.get());
+            else
+                isaAssembler->assemble(firstName, stmtPlace, linePtr, end,
+                           sections[currentSection].content,
+                           sections[currentSection].usageHandler.get(),
+                           sections[currentSection].waitHandler.get());
+            currentOutPos = sections[currentSection].getSize();
+        }
+    }
+    
+    // register offset-sourcePos (only if enabled)
+    if (collectSourcePoses && oldCurrentSection == currentSection &&
+        currentSection != ASMSECT_ABS && oldCurrentOutPos != currentOutPos)
+        sections[currentSection].sourcePosHandler.pushSourcePos(
+                        oldCurrentOutPos, sourcePos);
 }
 
 bool Assembler::assemble()
 {
+    // save settings to restore them by reset
+    initialSettings = { format, deviceType, driverVersion, llvmVersion, _64bit,
+            newROCmBinFormat, llvm10BinFormat, rocmMetadataV3, policyVersion,
+            occupancyTarget };
+    settingsSaved = true;
     resolvingRelocs = false;
     doNotRemoveFromSymbolClones = false;
     sectionDiffsPrepared = false;
+    // source positions of instructions are needed by register allocation and wait
+    // instructions insertion (to report errors)
+    collectSourcePoses = (flags & (ASM_REGALLOC|ASM_AUTOWAIT)) != 0;
     
     for (const DefSym& defSym: defSyms)
         if (defSym.first!=".")
@@ -2892,6 +3627,16 @@ bool Assembler::assemble()
                 break; // end of stream
         }
         
+        // statement of repetition line cached in previous iterations
+        AsmCachedStmt* cachedStmt = currentInputFilter->getCachedStmt();
+        if (cachedStmt != nullptr && cachedStmt->match(line, lineSize))
+        {
+            // skip lexing of cached statement
+            assembleStatement(cachedStmt->name, line + cachedStmt->stmtPos,
+                        line + cachedStmt->argsPos, cachedStmt, true);
+            continue;
+        }
+        
         const char* linePtr = line; // string points to place of line
         const char* end = line+lineSize;
         skipSpacesToEnd(linePtr, end);
@@ -2909,9 +3654,11 @@ bool Assembler::assemble()
                     (linePtr+1==end || linePtr[1]!=':'))
         {
             // labels
+            cachedStmt = nullptr; // lines with labels are not cached
             linePtr++;
             skipSpacesToEnd(linePtr, end);
             initializeOutputFormat();
+            taintIncludeSnapshots(); // labels are not cacheable
             if (firstName.front() >= '0' && firstName.front() <= '9')
             {
                 // handle local labels
@@ -2930,12 +3677,16 @@ bool Assembler::assemble()
                 }
                 /* prevLRes - iterator to previous instance of local label (with 'b)
                  * nextLRes - iterator to next instance of local label (with 'f) */
-                AsmSymbolEntry& prevLRes =
-                        *globalScope.symbolMap.insert(std::make_pair(
-                            std::string(firstName.c_str())+"b", AsmSymbol())).first;
-                AsmSymbolEntry& nextLRes =
-                        *globalScope.symbolMap.insert(std::make_pair(
-                            std::string(firstName.c_str())+"f", AsmSymbol())).first;
+                // name of local label with suffix (name is copied only at insertion)
+                std::string localName(firstName.c_str());
+                localName.push_back('b');
+                AsmSymbolEntry& prevLRes = *globalScope.symbolMap.insert(
+                        AsmSymbolName(localName.c_str(), localName.size()),
+                        AsmSymbol()).first;
+                localName.back() = 'f';
+                AsmSymbolEntry& nextLRes = *globalScope.symbolMap.insert(
+                        AsmSymbolName(localName.c_str(), localName.size()),
+                        AsmSymbol()).first;
                 /* resolve forward symbol of label now */
                 assert(setSymbol(nextLRes, currentOutPos, currentSection));
                 // move symbol value from next local label into previous local label
@@ -3018,63 +3769,10 @@ bool Assembler::assemble()
         }
         // make firstname as lowercase
         toLowerString(firstName);
-        
-        const AsmSectionId oldCurrentSection = currentSection;
-        const uint64_t oldCurrentOutPos = currentOutPos;
-        AsmSourcePos sourcePos{};
-        if (collectSourcePoses)
-            // source pos for sourcePosHandler
-            sourcePos = getSourcePos(stmtPlace);
-        
-        if (firstName.size() >= 2 && firstName[0] == '.') // check for pseudo-op
-            parsePseudoOps(firstName, stmtPlace, linePtr);
-        else if (firstName.size() >= 1 && isDigit(firstName[0]))
-            printError(stmtPlace, "Illegal number at statement begin");
-        else
-        {
-            // try to parse processor instruction or macro substitution
-            if (makeMacroSubstitution(stmtPlace) == ParseState::MISSING)
-            {  
-                if (firstName.empty()) // if name is empty
-                {
-                    if (linePtr!=end) // error
-                        printError(stmtPlace, "Garbages at statement place");
-                    continue;
-                }
-                initializeOutputFormat();
-                // try parse instruction
-                if (!isWriteableSection())
-                {
-                    printError(stmtPlace,
-                       "Writing data into non-writeable section is illegal");
-                    continue;
-                }
-                
-                if (sections[currentSection].usageHandler == nullptr)
-                    sections[currentSection].usageHandler.reset(
-                            isaAssembler->createUsageHandler());
-                
-                if (sections[currentSection].linearDepHandler == nullptr)
-                    sections[currentSection].linearDepHandler.reset(
-                            new ISALinearDepHandler());
-                
-                if (sections[currentSection].waitHandler == nullptr)
-                    sections[currentSection].waitHandler.reset(new ISAWaitHandler());
-                
-                isaAssembler->assemble(firstName, stmtPlace, linePtr, end,
-                           sections[currentSection].content,
-                           sections[currentSection].usageHandler.get(),
-                           sections[currentSection].waitHandler.get());
-                currentOutPos = sections[currentSection].getSize();
-            }
-        }
-        
-        // register offset-sourcePos (only if enabled)
-        if (collectSourcePoses && oldCurrentSection == currentSection &&
-            currentSection != ASMSECT_ABS && oldCurrentOutPos != currentOutPos)
-            sections[currentSection].sourcePosHandler.pushSourcePos(
-                            oldCurrentOutPos, sourcePos);
+        assembleStatement(firstName, stmtPlace, linePtr, cachedStmt, false);
     }
+    // includes not finished (after '.end' or '.abort') are not cached
+    includeSnapshots.clear();
     /* check clauses and print errors */
     while (!clauses.empty())
     {
@@ -3134,6 +3832,20 @@ bool Assembler::assemble()
     
     printUnresolvedSymbols(&globalScope);
     
+    /* insert wait instructions before closing code regions of kernels.
+     * it does not depend on register allocation (registers as encoded in code) */
+    if (good && (flags & ASM_AUTOWAIT) != 0)
+        good = insertWaitInstrs();
+    // allocate registers to achieve occupancy target (results are kept)
+    if (good && (flags & ASM_REGALLOC) != 0 && occupancyTarget != 0)
+    {
+        good = allocateRegisters();
+        /* copies between parts of split registers are only reported in results:
+         * they are not inserted, because regvar operands are not rewritten */
+        if (good)
+            applyRegAllocResults();
+    }
+    
     if (good && formatHandler!=nullptr)
     {
         // code opened regions for kernels
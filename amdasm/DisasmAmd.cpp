@@ -1513,7 +1513,8 @@ static void dumpAmdKernelConfig(std::ostream& output, const AmdKernelConfig& con
 }
 
 void CLRX::disassembleAmd(std::ostream& output, const AmdDisasmInput* amdInput,
-       ISADisassembler* isaDisassembler, size_t& sectionCount, Flags flags)
+       ISADisassembler* isaDisassembler, size_t& sectionCount, Flags flags,
+       cxuint threadsNum)
 {
     if (amdInput->is64BitMode)
         output.write(".64bit\n", 7);
@@ -1544,8 +1545,13 @@ void CLRX::disassembleAmd(std::ostream& output, const AmdDisasmInput* amdInput,
         printDisasmData(amdInput->globalDataSize, amdInput->globalData, output);
     }
     
-    for (const AmdDisasmKernelInput& kinput: amdInput->kernels)
+    auto kernelHasCode = [doDumpCode](const AmdDisasmKernelInput& kinput)
+    { return doDumpCode && kinput.code != nullptr && kinput.codeSize != 0; };
+    
+    auto disassembleKernel = [amdInput, flags, &kernelHasCode](std::ostream& output,
+                ISADisassembler* isaDisassembler, size_t kernelIndex)
     {
+        const AmdDisasmKernelInput& kinput = amdInput->kernels[kernelIndex];
         output.write(".kernel ", 8);
         output.write(kinput.kernelName.c_str(), kinput.kernelName.size());
         output.put('\n');
@@ -1560,14 +1566,36 @@ void CLRX::disassembleAmd(std::ostream& output, const AmdDisasmInput* amdInput,
             dumpAmdKernelConfig(output, config);
         }
         
-        if (doDumpCode && kinput.code != nullptr && kinput.codeSize != 0)
+        if (kernelHasCode(kinput))
         {
             // input kernel code (main disassembly)
             output.write("    .text\n", 10);
             isaDisassembler->setInput(kinput.codeSize, kinput.code);
             isaDisassembler->beforeDisassemble();
             isaDisassembler->disassemble();
-            sectionCount++;
         }
+    };
+    
+    const size_t kernelsNum = amdInput->kernels.size();
+    if ((flags & DISASM_PARALLEL) != 0)
+    {
+        // determine section counters before disassembling kernels
+        std::vector<size_t> kernelSectionCounts(kernelsNum);
+        for (size_t i = 0; i < kernelsNum; i++)
+        {
+            kernelSectionCounts[i] = sectionCount;
+            if (kernelHasCode(amdInput->kernels[i]))
+                sectionCount++;
+        }
+        DisasmParallelUtils::disassembleKernels(output, amdInput->deviceType, flags,
+                    threadsNum, kernelSectionCounts, disassembleKernel);
+        return;
+    }
+    
+    for (size_t i = 0; i < kernelsNum; i++)
+    {
+        disassembleKernel(output, isaDisassembler, i);
+        if (kernelHasCode(amdInput->kernels[i]))
+            sectionCount++;
     }
 }
@@ -898,7 +898,8 @@ static void dumpAmdCL2ArgsAndSamplers(std::ostream& output,
 }
 
 void CLRX::disassembleAmdCL2(std::ostream& output, const AmdCL2DisasmInput* amdCL2Input,
-       ISADisassembler* isaDisassembler, size_t& sectionCount, Flags flags)
+       ISADisassembler* isaDisassembler, size_t& sectionCount, Flags flags,
+       cxuint threadsNum)
 {
     const bool doMetadata = ((flags & DISASM_METADATA) != 0);
     const bool doDumpData = ((flags & DISASM_DUMPDATA) != 0);
@@ -1023,8 +1024,16 @@ void CLRX::disassembleAmdCL2(std::ostream& output, const AmdCL2DisasmInput* amdC
     const GPUArchitecture arch = getGPUArchitectureFromDeviceType(amdCL2Input->deviceType);
     const cxuint maxSgprsNum = getGPUMaxRegistersNum(arch, REGTYPE_SGPR, 0);
     
-    for (const AmdCL2DisasmKernelInput& kinput: amdCL2Input->kernels)
+    auto kernelHasCode = [doHSALayout, doDumpCode](const AmdCL2DisasmKernelInput& kinput)
     {
+        return !doHSALayout && doDumpCode && kinput.code != nullptr &&
+                kinput.codeSize != 0;
+    };
+    
+    auto disassembleKernel = [&](std::ostream& output, ISADisassembler* isaDisassembler,
+                size_t kernelIndex)
+    {
+        const AmdCL2DisasmKernelInput& kinput = amdCL2Input->kernels[kernelIndex];
         output.write(".kernel ", 8);
         output.write(kinput.kernelName.c_str(), kinput.kernelName.size());
         output.put('\n');
@@ -1090,7 +1099,7 @@ void CLRX::disassembleAmdCL2(std::ostream& output, const AmdCL2DisasmInput* amdC
             dumpAmdCL2ArgsAndSamplers(output, config);
         }
         
-        if (!doHSALayout && doDumpCode && kinput.code != nullptr && kinput.codeSize != 0)
+        if (kernelHasCode(kinput))
         {
             // input kernel code (main disassembly)
             isaDisassembler->clearRelocations();
@@ -1105,9 +1114,30 @@ void CLRX::disassembleAmdCL2(std::ostream& output, const AmdCL2DisasmInput* amdC
             isaDisassembler->setInput(kinput.codeSize, kinput.code);
             isaDisassembler->beforeDisassemble();
             isaDisassembler->disassemble();
-            sectionCount++;
         }
+    };
+    
+    const size_t kernelsNum = amdCL2Input->kernels.size();
+    if ((flags & DISASM_PARALLEL) != 0)
+    {
+        // determine section counters before disassembling kernels
+        std::vector<size_t> kernelSectionCounts(kernelsNum);
+        for (size_t i = 0; i < kernelsNum; i++)
+        {
+            kernelSectionCounts[i] = sectionCount;
+            if (kernelHasCode(amdCL2Input->kernels[i]))
+                sectionCount++;
+        }
+        DisasmParallelUtils::disassembleKernels(output, amdCL2Input->deviceType,
+                    flags, threadsNum, kernelSectionCounts, disassembleKernel);
     }
+    else
+        for (size_t i = 0; i < kernelsNum; i++)
+        {
+            disassembleKernel(output, isaDisassembler, i);
+            if (kernelHasCode(amdCL2Input->kernels[i]))
+                sectionCount++;
+        }
     
     if (doDumpCode && doHSALayout &&
         amdCL2Input->code != nullptr && amdCL2Input->codeSize != 0)
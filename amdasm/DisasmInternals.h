@@ -24,7 +24,9 @@
 #include <cstdint>
 #include <string>
 #include <ostream>
+#include <vector>
 #include <utility>
+#include <functional>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/amdbin/AmdBinaries.h>
 #include <CLRX/amdbin/AmdCL2Binaries.h>
@@ -47,15 +49,31 @@ extern CLRX_INTERNAL void printDisasmDataU32(size_t size, const uint32_t* data,
 extern CLRX_INTERNAL void printDisasmLongString(size_t size, const char* data,
             std::ostream& output, bool secondAlign = false);
 
+// routine that disassembles single kernel (by index) to output
+typedef std::function<void(std::ostream& output, ISADisassembler* isaDisassembler,
+            size_t kernelIndex)> DisasmKernelRoutine;
+
+struct CLRX_INTERNAL DisasmParallelUtils
+{
+    /* disassemble kernels concurrently. every kernel is disassembled to own buffer
+     * by own ISA disassembler. kernelSectionCounts holds section counter for every
+     * kernel (used by numbered labels). buffers are written to output
+     * in original kernels order */
+    static void disassembleKernels(std::ostream& output, GPUDeviceType deviceType,
+            Flags flags, cxuint threadsNum,
+            const std::vector<size_t>& kernelSectionCounts,
+            const DisasmKernelRoutine& kernelRoutine);
+};
+
 // disassemble Amd OpenCL 1.0 binary input
 extern CLRX_INTERNAL void disassembleAmd(std::ostream& output,
        const AmdDisasmInput* amdInput, ISADisassembler* isaDisassembler,
-       size_t& sectionCount, Flags flags);
+       size_t& sectionCount, Flags flags, cxuint threadsNum = 0);
 
 // disassemble Amd OpenCL 2.0 binary input
 extern CLRX_INTERNAL void disassembleAmdCL2(std::ostream& output,
         const AmdCL2DisasmInput* amdCL2Input, ISADisassembler* isaDisassembler,
-        size_t& sectionCount, Flags flags);
+        size_t& sectionCount, Flags flags, cxuint threadsNum = 0);
 
 // disassemble ROCm binary input
 extern CLRX_INTERNAL void disassembleROCm(std::ostream& output,
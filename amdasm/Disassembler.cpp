@@ -21,8 +21,12 @@
 #include <string>
 #include <cstring>
 #include <ostream>
+#include <sstream>
 #include <cstring>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <exception>
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -286,7 +290,8 @@ void ISADisassembler::beforeDisassemble()
 
 Disassembler::Disassembler(const AmdMainGPUBinary32& binary, std::ostream& _output,
             Flags _flags) : fromBinary(true), binaryFormat(BinaryFormat::AMD),
-            amdInput(nullptr), output(_output), flags(_flags), sectionCount(0)
+            amdInput(nullptr), output(_output), flags(_flags), sectionCount(0),
+            threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     amdInput = getAmdDisasmInputFromBinary32(binary, flags);
@@ -294,7 +299,8 @@ Disassembler::Disassembler(const AmdMainGPUBinary32& binary, std::ostream& _outp
 
 Disassembler::Disassembler(const AmdMainGPUBinary64& binary, std::ostream& _output,
             Flags _flags) : fromBinary(true), binaryFormat(BinaryFormat::AMD),
-            amdInput(nullptr), output(_output), flags(_flags), sectionCount(0)
+            amdInput(nullptr), output(_output), flags(_flags), sectionCount(0),
+            threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     amdInput = getAmdDisasmInputFromBinary64(binary, flags);
@@ -303,7 +309,7 @@ Disassembler::Disassembler(const AmdMainGPUBinary64& binary, std::ostream& _outp
 Disassembler::Disassembler(const AmdCL2MainGPUBinary32& binary, std::ostream& _output,
            Flags _flags, cxuint driverVersion) : fromBinary(true),
             binaryFormat(BinaryFormat::AMDCL2), amdCL2Input(nullptr), output(_output),
-            flags(_flags), sectionCount(0)
+            flags(_flags), sectionCount(0), threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     amdCL2Input = getAmdCL2DisasmInputFromBinary32(binary, driverVersion,
@@ -313,7 +319,7 @@ Disassembler::Disassembler(const AmdCL2MainGPUBinary32& binary, std::ostream& _o
 Disassembler::Disassembler(const AmdCL2MainGPUBinary64& binary, std::ostream& _output,
            Flags _flags, cxuint driverVersion) : fromBinary(true),
             binaryFormat(BinaryFormat::AMDCL2), amdCL2Input(nullptr), output(_output),
-            flags(_flags), sectionCount(0)
+            flags(_flags), sectionCount(0), threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     amdCL2Input = getAmdCL2DisasmInputFromBinary64(binary, driverVersion,
@@ -322,7 +328,8 @@ Disassembler::Disassembler(const AmdCL2MainGPUBinary64& binary, std::ostream& _o
 
 Disassembler::Disassembler(const ROCmBinary& binary, std::ostream& _output, Flags _flags)
          : fromBinary(true), binaryFormat(BinaryFormat::ROCM),
-           rocmInput(nullptr), output(_output), flags(_flags), sectionCount(0)
+           rocmInput(nullptr), output(_output), flags(_flags), sectionCount(0),
+           threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     rocmInput = getROCmDisasmInputFromBinary(binary);
@@ -331,7 +338,8 @@ Disassembler::Disassembler(const ROCmBinary& binary, std::ostream& _output, Flag
 Disassembler::Disassembler(const ROCmBinary& binary, std::ostream& _output,
                 bool hasGPUDeviceType, GPUDeviceType deviceType, Flags _flags)
          : fromBinary(true), binaryFormat(BinaryFormat::ROCM),
-           rocmInput(nullptr), output(_output), flags(_flags), sectionCount(0)
+           rocmInput(nullptr), output(_output), flags(_flags), sectionCount(0),
+           threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     ROCmDisasmInput* _rocmInput = getROCmDisasmInputFromBinary(binary);
@@ -346,21 +354,24 @@ Disassembler::Disassembler(const ROCmBinary& binary, std::ostream& _output,
 
 Disassembler::Disassembler(const AmdDisasmInput* disasmInput, std::ostream& _output,
             Flags _flags) : fromBinary(false), binaryFormat(BinaryFormat::AMD),
-            amdInput(disasmInput), output(_output), flags(_flags), sectionCount(0)
+            amdInput(disasmInput), output(_output), flags(_flags), sectionCount(0),
+            threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
 }
 
 Disassembler::Disassembler(const AmdCL2DisasmInput* disasmInput, std::ostream& _output,
             Flags _flags) : fromBinary(false), binaryFormat(BinaryFormat::AMDCL2),
-            amdCL2Input(disasmInput), output(_output), flags(_flags), sectionCount(0)
+            amdCL2Input(disasmInput), output(_output), flags(_flags), sectionCount(0),
+            threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
 }
 
 Disassembler::Disassembler(const ROCmDisasmInput* disasmInput, std::ostream& _output,
                  Flags _flags) : fromBinary(false), binaryFormat(BinaryFormat::ROCM),
-            rocmInput(disasmInput), output(_output), flags(_flags), sectionCount(0)
+            rocmInput(disasmInput), output(_output), flags(_flags), sectionCount(0),
+            threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
 }
@@ -368,7 +379,8 @@ Disassembler::Disassembler(const ROCmDisasmInput* disasmInput, std::ostream& _ou
 Disassembler::Disassembler(GPUDeviceType deviceType, const GalliumBinary& binary,
            std::ostream& _output, Flags _flags, cxuint llvmVersion) :
            fromBinary(true), binaryFormat(BinaryFormat::GALLIUM),
-           galliumInput(nullptr), output(_output), flags(_flags), sectionCount(0)
+           galliumInput(nullptr), output(_output), flags(_flags), sectionCount(0),
+           threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     galliumInput = getGalliumDisasmInputFromBinary(deviceType, binary, llvmVersion);
@@ -376,7 +388,8 @@ Disassembler::Disassembler(GPUDeviceType deviceType, const GalliumBinary& binary
 
 Disassembler::Disassembler(const GalliumDisasmInput* disasmInput, std::ostream& _output,
              Flags _flags) : fromBinary(false), binaryFormat(BinaryFormat::GALLIUM),
-            galliumInput(disasmInput), output(_output), flags(_flags), sectionCount(0)
+            galliumInput(disasmInput), output(_output), flags(_flags), sectionCount(0),
+            threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
 }
@@ -384,7 +397,7 @@ Disassembler::Disassembler(const GalliumDisasmInput* disasmInput, std::ostream&
 Disassembler::Disassembler(GPUDeviceType deviceType, size_t rawCodeSize,
            const cxbyte* rawCode, std::ostream& _output, Flags _flags)
        : fromBinary(true), binaryFormat(BinaryFormat::RAWCODE),
-         output(_output), flags(_flags), sectionCount(0)
+         output(_output), flags(_flags), sectionCount(0), threadsNum(0)
 {
     isaDisassembler.reset(new GCNDisassembler(*this));
     rawInput = new RawCodeInput{ deviceType, rawCodeSize, rawCode };
@@ -605,6 +618,55 @@ static void disassembleRawCode(std::ostream& output, const RawCodeInput* rawInpu
     }
 }
 
+void DisasmParallelUtils::disassembleKernels(std::ostream& output,
+            GPUDeviceType deviceType, Flags flags, cxuint threadsNum,
+            const std::vector<size_t>& kernelSectionCounts,
+            const DisasmKernelRoutine& kernelRoutine)
+{
+    const size_t kernelsNum = kernelSectionCounts.size();
+    if (kernelsNum == 0)
+        return;
+    std::unique_ptr<std::ostringstream[]> kernelOutputs(
+                new std::ostringstream[kernelsNum]);
+    std::unique_ptr<std::exception_ptr[]> kernelErrors(
+                new std::exception_ptr[kernelsNum]);
+    
+    if (threadsNum == 0)
+        threadsNum = std::max(std::thread::hardware_concurrency(), 1U);
+    threadsNum = std::min(size_t(threadsNum), kernelsNum);
+    std::atomic<size_t> nextKernel(0);
+    auto worker = [&]()
+    {
+        size_t i;
+        while ((i = nextKernel.fetch_add(1)) < kernelsNum)
+            try
+            {
+                // every kernel has own disassembler that writes to own buffer
+                Disassembler kernelDisasm(deviceType, 0, nullptr, kernelOutputs[i], flags);
+                kernelDisasm.sectionCount = kernelSectionCounts[i];
+                kernelRoutine(kernelOutputs[i], kernelDisasm.isaDisassembler.get(), i);
+            }
+            catch(...)
+            { kernelErrors[i] = std::current_exception(); }
+    };
+    std::vector<std::thread> threads;
+    for (cxuint i = 1; i < threadsNum; i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (std::thread& thread: threads)
+        thread.join();
+    
+    // write kernel outputs in original order, stop at first failed kernel
+    // (like in sequential disassembling)
+    for (size_t i = 0; i < kernelsNum; i++)
+    {
+        const std::string kernelText = kernelOutputs[i].str();
+        output.write(kernelText.c_str(), kernelText.size());
+        if (kernelErrors[i])
+            std::rethrow_exception(kernelErrors[i]);
+    }
+}
+
 void Disassembler::disassemble()
 {
     const std::ios::iostate oldExceptions = output.exceptions();
@@ -644,11 +706,12 @@ void Disassembler::disassemble()
     switch(binaryFormat)
     {
         case BinaryFormat::AMD:
-            disassembleAmd(output, amdInput, isaDisassembler.get(), sectionCount, flags);
+            disassembleAmd(output, amdInput, isaDisassembler.get(), sectionCount,
+                           flags, threadsNum);
             break;
         case BinaryFormat::AMDCL2:
             disassembleAmdCL2(output, amdCL2Input, isaDisassembler.get(),
-                              sectionCount, flags);
+                              sectionCount, flags, threadsNum);
             break;
         case BinaryFormat::ROCM:
             disassembleROCm(output, rocmInput, isaDisassembler.get(), flags);
@@ -469,6 +469,20 @@ bool GCNAsmUtils::parseSOPKEncoding(Assembler& asmr, const GCNAsmInstruction& gc
     if (!checkGCNEncodingSize(asmr, instrPlace, gcnEncSize, wordsNum))
         return false;
     
+    if (isGCN15 && gcnInsn.code1 >= 23 && gcnInsn.code1 <= 26 && imm16Expr==nullptr &&
+        !dstReg.isRegVar() && dstReg.bstart() == 125)
+    {
+        // S_WAITCNT_VSCNT, S_WAITCNT_VMCNT, S_WAITCNT_EXPCNT, S_WAITCNT_LGKMCNT
+        // with null register (only immediate value)
+        static const cxbyte waitTypes[4] = { GCNWAIT_VSCNT, GCNWAIT_VMCNT,
+                    GCNWAIT_EXPCNT, GCNWAIT_LGKMCNT };
+        gcnAsm->waitInstr = { output.size(), { 63, 63, 7, 63 } };
+        const cxbyte waitType = waitTypes[gcnInsn.code1-23];
+        gcnAsm->waitInstr.waits[waitType] = std::min(imm16,
+                    gcnAsm->waitInstr.waits[waitType]);
+        gcnAsm->hasWaitInstr = true;
+    }
+    
     // put data (instruction words)
     uint32_t words[2];
     SLEV(words[0], 0xb0000000U | imm16 | (uint32_t(dstReg.bstart())<<16) |
@@ -742,12 +756,15 @@ bool GCNAsmUtils::parseSOPPEncoding(Assembler& asmr, const GCNAsmInstruction& gc
             if (gcnInsn.code1==12)
             {
                 // S_WAICTNT
-                uint16_t lgkmCnt = (imm16>>8) & 15;
+                uint16_t lgkmCnt = (imm16>>8) & (isGCN15 ? 63 : 15);
                 if ((arch & ARCH_HD7X00) != 0)
                     lgkmCnt = std::min(uint16_t(7), lgkmCnt);
                 const uint16_t expCnt = (imm16>>4) & 7;
-                const uint16_t vmCnt = ((imm16) & 15) + (isGCN14 ? ((imm16>>10)&0x30) : 0);
-                gcnAsm->waitInstr = { output.size(), { vmCnt, lgkmCnt, expCnt } };
+                const uint16_t vmCnt = ((imm16) & 15) +
+                        ((isGCN14 || isGCN15) ? ((imm16>>10)&0x30) : 0);
+                // GCN 1.5: VSCNT is not waited by S_WAITCNT
+                gcnAsm->waitInstr = { output.size(), { vmCnt, lgkmCnt, expCnt,
+                            uint16_t(isGCN15 ? 63 : 0) } };
                 gcnAsm->hasWaitInstr = true;
             }
             break;
@@ -106,13 +106,16 @@ void GCNAsmUtils::prepareRVUAndWait(GCNAssembler* gcnAsm, GPUArchMask arch,
     
     // register delayed operations
     const bool needExpWrite = (vdataToRead && (arch & ARCH_HD7X00) != 0);
+    // GCN 1.5 counts stores by separate counter (VSCNT)
+    const cxbyte vmDelOpType = ((arch & ARCH_GCN_1_5) != 0 && !vdataToWrite) ?
+                GCNDELOP_VMSTOREOP : GCNDELOP_VMOP;
     if (gcnAsm->instrRVUs[0].regField != ASMFIELD_NONE)
     {
         if (!haveLds)
         {
             gcnAsm->delayedOps[0] = { output.size(), gcnAsm->instrRVUs[0].regVar,
                     gcnAsm->instrRVUs[0].rstart, gcnAsm->instrRVUs[0].rend, 1,
-                    GCNDELOP_VMOP, needExpWrite ? GCNDELOP_EXPVMWRITE : GCNDELOP_NONE,
+                    vmDelOpType, needExpWrite ? GCNDELOP_EXPVMWRITE : GCNDELOP_NONE,
                     gcnAsm->instrRVUs[0].rwFlags,
                     cxbyte(needExpWrite ? ASMRVU_READ : 0) };
             if (haveTfe)
@@ -1337,9 +1340,11 @@ bool GCNAsmUtils::parseFLATEncoding(Assembler& asmr, const GCNAsmInstruction& gc
                     GCNDELOP_VMOP, GCNDELOP_NONE, gcnAsm->instrRVUs[3].rwFlags };
     }
     if ((gcnInsn.mode & GCN_FLAT_NODATA) == 0)
+        // GCN 1.5 counts stores (without returned data) by separate counter (VSCNT)
         gcnAsm->delayedOps[2] = { output.size(), gcnAsm->instrRVUs[2].regVar,
                 gcnAsm->instrRVUs[2].rstart, gcnAsm->instrRVUs[2].rend,
-                1, GCNDELOP_VMOP, secondDelOpType, gcnAsm->instrRVUs[2].rwFlags,
+                1, (isGCN15 && gcnAsm->instrRVUs[0].regField == ASMFIELD_NONE) ?
+                GCNDELOP_VMSTOREOP : GCNDELOP_VMOP, secondDelOpType, gcnAsm->instrRVUs[2].rwFlags,
                 cxbyte(secondDelOpType!=GCNDELOP_NONE ?
                             gcnAsm->instrRVUs[2].rwFlags : 0) };
     
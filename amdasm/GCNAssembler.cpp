@@ -35,6 +35,76 @@ using namespace CLRX;
 static OnceFlag clrxGCNAssemblerOnceFlag;
 static Array<GCNAsmInstruction> gcnInstrSortedTable;
 
+static const size_t gcnArchsNum = size_t(GPUArchitecture::GPUARCH_MAX)+1;
+
+// entry of mnemonic hash table: index of first matched instruction for every arch
+struct CLRX_INTERNAL GCNMnemonicHashEntry
+{
+    const char* mnemonic;
+    uint16_t archIndices[gcnArchsNum]; // UINT16_MAX - no instruction for arch
+};
+
+// open-addressing hash table (load factor <= 1/4) for mnemonics
+static Array<GCNMnemonicHashEntry> gcnMnemonicHashTable;
+static size_t gcnMnemonicHashMask;
+
+// FNV-1a hash (CStringHash has weak lower bits)
+static inline uint32_t gcnMnemonicHash(const char* mnemonic)
+{
+    uint32_t hash = 2166136261U;
+    for (const char* p = mnemonic; *p != 0; p++)
+        hash = (hash ^ cxbyte(*p)) * 16777619U;
+    return hash;
+}
+
+static const GCNMnemonicHashEntry* findGCNMnemonic(const char* mnemonic)
+{
+    for (size_t i = gcnMnemonicHash(mnemonic) & gcnMnemonicHashMask;
+         gcnMnemonicHashTable[i].mnemonic != nullptr; i = (i+1) & gcnMnemonicHashMask)
+        if (::strcmp(gcnMnemonicHashTable[i].mnemonic, mnemonic)==0)
+            return gcnMnemonicHashTable.data() + i;
+    return nullptr;
+}
+
+static void initializeGCNMnemonicHashTable()
+{
+    // count mnemonics
+    size_t mnemonicsNum = 0;
+    for (size_t i = 0; i < gcnInstrSortedTable.size(); i++)
+        if (i == 0 || ::strcmp(gcnInstrSortedTable[i-1].mnemonic,
+                    gcnInstrSortedTable[i].mnemonic)!=0)
+            mnemonicsNum++;
+    size_t hashSize = 1;
+    while (hashSize < (mnemonicsNum<<2))
+        hashSize <<= 1;
+    gcnMnemonicHashTable.resize(hashSize);
+    gcnMnemonicHashMask = hashSize-1;
+    for (GCNMnemonicHashEntry& entry: gcnMnemonicHashTable)
+    {
+        entry.mnemonic = nullptr;
+        std::fill(entry.archIndices, entry.archIndices + gcnArchsNum, UINT16_MAX);
+    }
+    
+    GCNMnemonicHashEntry* entry = nullptr;
+    for (size_t i = 0; i < gcnInstrSortedTable.size(); i++)
+    {
+        const GCNAsmInstruction& insn = gcnInstrSortedTable[i];
+        if (entry == nullptr || ::strcmp(entry->mnemonic, insn.mnemonic)!=0)
+        {
+            // new mnemonic, find free place
+            size_t j = gcnMnemonicHash(insn.mnemonic) & gcnMnemonicHashMask;
+            while (gcnMnemonicHashTable[j].mnemonic != nullptr)
+                j = (j+1) & gcnMnemonicHashMask;
+            entry = gcnMnemonicHashTable.data() + j;
+            entry->mnemonic = insn.mnemonic;
+        }
+        // set first instruction for every architecture
+        for (cxuint arch = 0; arch < gcnArchsNum; arch++)
+            if ((insn.archMask & (1U<<arch)) != 0 && entry->archIndices[arch]==UINT16_MAX)
+                entry->archIndices[arch] = i;
+    }
+}
+
 static void initializeGCNAssembler()
 {
     size_t tableSize = 0;
@@ -117,6 +187,7 @@ static void initializeGCNAssembler()
         }
     }
     gcnInstrSortedTable.resize(j); // final size
+    initializeGCNMnemonicHashTable();
 }
 
 // GCN Usage handler
@@ -166,6 +237,14 @@ GCNAssembler::GCNAssembler(Assembler& assembler): ISAAssembler(assembler),
             AsmRegVarUsage{});
 }
 
+void GCNAssembler::reset()
+{
+    regs = { 0, 0, 0 };
+    curArchMask = 1U<<cxuint(getGPUArchitectureFromDeviceType(assembler.getDeviceType()));
+    std::fill(instrRVUs, instrRVUs + sizeof(instrRVUs)/sizeof(AsmRegVarUsage),
+            AsmRegVarUsage{});
+}
+
 GCNAssembler::~GCNAssembler()
 { }
 
@@ -199,9 +278,8 @@ Flags GCNAssembler::getImportantCodeFlags() const
     return (curArchMask & ARCH_GCN_1_5)!=0 ? ASM_CODE_WAVE32 : 0;
 }
 
-void GCNAssembler::assemble(const CString& inMnemonic, const char* mnemPlace,
-            const char* linePtr, const char* lineEnd, std::vector<cxbyte>& output,
-            ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler)
+// resolve mnemonic with encoding suffix to instruction index and encoding
+bool GCNAssembler::resolveMnemonic(const CString& inMnemonic, size_t& instrId) const
 {
     CString mnemonic;
     size_t inMnemLen = inMnemonic.size();
@@ -233,25 +311,39 @@ void GCNAssembler::assemble(const CString& inMnemonic, const char* mnemPlace,
     else
         mnemonic = inMnemonic;
     
-    // find instruction by mnemonic
-    auto it = binaryFind(gcnInstrSortedTable.begin(), gcnInstrSortedTable.end(),
-               GCNAsmInstruction{mnemonic.c_str()},
-               [](const GCNAsmInstruction& instr1, const GCNAsmInstruction& instr2)
-               { return ::strcmp(instr1.mnemonic, instr2.mnemonic)<0; });
-    
-    // find matched entry
-    if (it != gcnInstrSortedTable.end() && (it->archMask & curArchMask)==0)
-        // if not match current arch mask
-        for (++it ;it != gcnInstrSortedTable.end() &&
-               ::strcmp(it->mnemonic, mnemonic.c_str())==0 &&
-               (it->archMask & curArchMask)==0; ++it);
-
-    if (it == gcnInstrSortedTable.end() || ::strcmp(it->mnemonic, mnemonic.c_str())!=0)
+    // find instruction by mnemonic and current architecture
+    const GCNMnemonicHashEntry* entry = findGCNMnemonic(mnemonic.c_str());
+    const cxuint instrIndex = (entry != nullptr) ?
+                entry->archIndices[CTZ32(curArchMask)] : UINT16_MAX;
+    if (instrIndex == UINT16_MAX)
+        return false;
+    // instruction id: index in sorted table, encoding size and VOP encoding
+    instrId = instrIndex | (size_t(gcnEncSize)<<16) | (size_t(vopEnc)<<18);
+    return true;
+}
+
+void GCNAssembler::assemble(const CString& inMnemonic, const char* mnemPlace,
+            const char* linePtr, const char* lineEnd, std::vector<cxbyte>& output,
+            ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler)
+{
+    size_t instrId;
+    if (!resolveMnemonic(inMnemonic, instrId))
     {
         // unrecognized mnemonic
         printError(mnemPlace, "Unknown instruction");
         return;
     }
+    assembleResolved(instrId, mnemPlace, linePtr, lineEnd, output,
+                usageHandler, waitHandler);
+}
+
+void GCNAssembler::assembleResolved(size_t instrId, const char* mnemPlace,
+            const char* linePtr, const char* lineEnd, std::vector<cxbyte>& output,
+            ISAUsageHandler* usageHandler, ISAWaitHandler* waitHandler)
+{
+    const GCNAsmInstruction* it = gcnInstrSortedTable.data() + (instrId & 0xffff);
+    const GCNEncSize gcnEncSize = GCNEncSize((instrId>>16) & 3);
+    const GCNVOPEnc vopEnc = GCNVOPEnc((instrId>>18) & 3);
     
     resetInstrRVUs();
     resetWaitInstrs();
@@ -334,8 +426,8 @@ void GCNAssembler::assemble(const CString& inMnemonic, const char* mnemPlace,
         default:
             break;
     }
-    // register RegVarUsage in tests, do not apply normal usage
-    if (good && (assembler.getFlags() & ASM_TESTRUN) != 0)
+    // register RegVarUsage in tests or for register allocation
+    if (good && (assembler.getFlags() & (ASM_TESTRUN|ASM_REGALLOC|ASM_AUTOWAIT)) != 0)
     {
         flushInstrRVUs(usageHandler);
         flushWaitInstrs(waitHandler);
@@ -513,10 +605,7 @@ bool GCNAssembler::checkMnemonic(const CString& inMnemonic) const
     else
         mnemonic = inMnemonic;
     
-    return std::binary_search(gcnInstrSortedTable.begin(), gcnInstrSortedTable.end(),
-               GCNAsmInstruction{mnemonic.c_str()},
-               [](const GCNAsmInstruction& instr1, const GCNAsmInstruction& instr2)
-               { return ::strcmp(instr1.mnemonic, instr2.mnemonic)<0; });
+    return findGCNMnemonic(mnemonic.c_str()) != nullptr;
 }
 
 void GCNAssembler::setAllocatedRegisters(const cxuint* inRegs, Flags inRegFlags)
@@ -798,7 +887,7 @@ size_t GCNAssembler::getInstructionSize(size_t codeSize, const cxbyte* code) con
 static const AsmWaitConfig gcnWaitConfig10 =
 {
     cxuint(GCNDELOP_MAX+1),
-    cxuint(GCNWAIT_MAX+1),
+    cxuint(GCNWAIT_EXPCNT+1),
     {
         { GCNWAIT_VMCNT, true, false, 255 },  // GCNDELOP_VMOP
         { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_LDSOP
@@ -806,7 +895,8 @@ static const AsmWaitConfig gcnWaitConfig10 =
         { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_SENDMSG
         { GCNWAIT_LGKMCNT, false, false, 4 },  // GCNDELOP_SMOP
         { GCNWAIT_EXPCNT, true, true, 255 },  // GCNDELOP_EXPVMWRITE
-        { GCNWAIT_EXPCNT, false, false, 255 }  // GCNDELOP_EXPORT
+        { GCNWAIT_EXPCNT, false, false, 255 },  // GCNDELOP_EXPORT
+        { GCNWAIT_VMCNT, true, false, 255 }  // GCNDELOP_VMSTOREOP
     },
     { 16, 8, 8 }
 };
@@ -815,7 +905,7 @@ static const AsmWaitConfig gcnWaitConfig10 =
 static const AsmWaitConfig gcnWaitConfig =
 {
     cxuint(GCNDELOP_MAX+1),
-    cxuint(GCNWAIT_MAX+1),
+    cxuint(GCNWAIT_EXPCNT+1),
     {
         { GCNWAIT_VMCNT, true, false, 255 },  // GCNDELOP_VMOP
         { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_LDSOP
@@ -823,7 +913,8 @@ static const AsmWaitConfig gcnWaitConfig =
         { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_SENDMSG
         { GCNWAIT_LGKMCNT, false, false, 4 },  // GCNDELOP_SMOP
         { GCNWAIT_EXPCNT, true, true, 255 },  // GCNDELOP_EXPVMWRITE
-        { GCNWAIT_EXPCNT, false, true, 255 }  // GCNDELOP_EXPORT
+        { GCNWAIT_EXPCNT, false, true, 255 },  // GCNDELOP_EXPORT
+        { GCNWAIT_VMCNT, true, false, 255 }  // GCNDELOP_VMSTOREOP
     },
     { 16, 16, 8 }
 };
@@ -832,7 +923,7 @@ static const AsmWaitConfig gcnWaitConfig =
 static const AsmWaitConfig gcnWaitConfig14 =
 {
     cxuint(GCNDELOP_MAX+1),
-    cxuint(GCNWAIT_MAX+1),
+    cxuint(GCNWAIT_EXPCNT+1),
     {
         { GCNWAIT_VMCNT, true, false, 255 },  // GCNDELOP_VMOP
         { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_LDSOP
@@ -840,14 +931,127 @@ static const AsmWaitConfig gcnWaitConfig14 =
         { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_SENDMSG
         { GCNWAIT_LGKMCNT, false, false, 4 },  // GCNDELOP_SMOP
         { GCNWAIT_EXPCNT, true, true, 255 },  // GCNDELOP_EXPVMWRITE
-        { GCNWAIT_EXPCNT, false, true, 255 }  // GCNDELOP_EXPORT
+        { GCNWAIT_EXPCNT, false, true, 255 },  // GCNDELOP_EXPORT
+        { GCNWAIT_VMCNT, true, false, 255 }  // GCNDELOP_VMSTOREOP
     },
     { 64, 16, 8 }
 };
 
+// for Navi (stores are counted separately by VSCNT)
+static const AsmWaitConfig gcnWaitConfig15 =
+{
+    cxuint(GCNDELOP_MAX+1),
+    cxuint(GCNWAIT_MAX+1),
+    {
+        { GCNWAIT_VMCNT, true, false, 255 },  // GCNDELOP_VMOP
+        { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_LDSOP
+        { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_GDSOP
+        { GCNWAIT_LGKMCNT, true, false, 255 },  // GCNDELOP_SENDMSG
+        { GCNWAIT_LGKMCNT, false, false, 4 },  // GCNDELOP_SMOP
+        { GCNWAIT_EXPCNT, true, true, 255 },  // GCNDELOP_EXPVMWRITE
+        { GCNWAIT_EXPCNT, false, true, 255 },  // GCNDELOP_EXPORT
+        { GCNWAIT_VSCNT, true, false, 255 }  // GCNDELOP_VMSTOREOP
+    },
+    { 64, 64, 8, 64 }
+};
+
 const AsmWaitConfig& GCNAssembler::getWaitConfig() const
 {
     if ((curArchMask&ARCH_HD7X00)!=0)
         return gcnWaitConfig10;
+    if ((curArchMask&ARCH_GCN_1_5)!=0)
+        return gcnWaitConfig15;
     return (curArchMask&ARCH_GCN_1_4)!=0 ? gcnWaitConfig14 : gcnWaitConfig;
 }
+
+void GCNAssembler::encodeWaitInstr(const AsmWaitInstr& waitInstr,
+            std::vector<cxbyte>& output) const
+{
+    const bool isGCN14 = (curArchMask & ARCH_GCN_1_4)!=0;
+    const bool isGCN15 = (curArchMask & ARCH_GCN_1_5)!=0;
+    const AsmWaitConfig& waitConfig = getWaitConfig();
+    // wait is not needed if it is not less than queue size-1 (max value)
+    bool needWaitCnt = false;
+    for (cxuint q = GCNWAIT_VMCNT; q <= GCNWAIT_EXPCNT; q++)
+        needWaitCnt |= waitInstr.waits[q] < waitConfig.waitQueueSizes[q]-1;
+    const bool needVsCnt = (waitConfig.waitQueuesNum > GCNWAIT_VSCNT &&
+            waitInstr.waits[GCNWAIT_VSCNT] < waitConfig.waitQueueSizes[GCNWAIT_VSCNT]-1);
+    
+    uint32_t words[2];
+    cxuint wordsNum = 0;
+    if (needWaitCnt)
+    {
+        // S_WAITCNT
+        uint32_t imm16 = isGCN15 ? 0xff7f : (isGCN14 ? 0xcf7f : 0xf7f);
+        const uint32_t vmCnt = waitInstr.waits[GCNWAIT_VMCNT];
+        if (vmCnt < waitConfig.waitQueueSizes[GCNWAIT_VMCNT]-1U)
+            imm16 = (imm16 & ~0xc00fU) | (vmCnt & 15) | ((vmCnt & 0x30) << 10);
+        const uint32_t lgkmCnt = waitInstr.waits[GCNWAIT_LGKMCNT];
+        if (lgkmCnt < waitConfig.waitQueueSizes[GCNWAIT_LGKMCNT]-1U)
+            imm16 = (imm16 & ~0x3f00U) | (lgkmCnt << 8);
+        const uint32_t expCnt = waitInstr.waits[GCNWAIT_EXPCNT];
+        if (expCnt < waitConfig.waitQueueSizes[GCNWAIT_EXPCNT]-1U)
+            imm16 = (imm16 & ~0x70U) | (expCnt << 4);
+        SLEV(words[wordsNum++], 0xbf8c0000U | imm16);
+    }
+    if (needVsCnt)
+        // S_WAITCNT_VSCNT null, VSCNT
+        SLEV(words[wordsNum++], 0xbbfd0000U | waitInstr.waits[GCNWAIT_VSCNT]);
+    output.insert(output.end(), reinterpret_cast<cxbyte*>(words),
+            reinterpret_cast<cxbyte*>(words + wordsNum));
+}
+
+void GCNAssembler::encodeRegCopy(cxuint regType, cxuint dstReg, cxuint srcReg,
+            bool swap, std::vector<cxbyte>& output) const
+{
+    // GCN 1.2 and GCN 1.4 have other opcodes of SOP and VOP2 instructions
+    const bool isGCN12 = (curArchMask & ARCH_GCN_1_2_4)!=0;
+    uint32_t words[3];
+    cxuint wordsNum = 0;
+    if (!swap)
+    {
+        if (regType == REGTYPE_SGPR)
+            // S_MOV_B32 dst, src
+            SLEV(words[wordsNum++], 0xbe800000U | (dstReg<<16) |
+                    ((isGCN12 ? 0U : 3U)<<8) | srcReg);
+        else
+            // V_MOV_B32 dst, src
+            SLEV(words[wordsNum++], 0x7e000200U | (dstReg<<17) | (256+srcReg));
+    }
+    else
+    {
+        // swap by three XORs: dst^=src, src^=dst, dst^=src
+        const cxuint regs[3][2] = { { dstReg, srcReg }, { srcReg, dstReg },
+                    { dstReg, srcReg } };
+        for (const cxuint* r: regs)
+            if (regType == REGTYPE_SGPR)
+                // S_XOR_B32 r0, r0, r1
+                SLEV(words[wordsNum++], 0x80000000U | ((isGCN12 ? 16U : 18U)<<23) |
+                        (r[0]<<16) | (r[1]<<8) | r[0]);
+            else
+                // V_XOR_B32 r0, r1, r0
+                SLEV(words[wordsNum++], ((isGCN12 ? 21U : 29U)<<25) | (r[0]<<17) |
+                        (r[0]<<9) | (256+r[1]));
+    }
+    output.insert(output.end(), reinterpret_cast<cxbyte*>(words),
+            reinterpret_cast<cxbyte*>(words + wordsNum));
+}
+
+bool GCNAssembler::relocateJump(cxbyte* code, size_t oldOffset, size_t oldTarget,
+                size_t offset, size_t target) const
+{
+    const uint32_t insnCode = ULEV(*reinterpret_cast<const uint32_t*>(code + offset));
+    // only SOPP (0x17f) and SOPK (0x160-0x17c) instructions have relative jumps
+    const uint32_t encoding = insnCode >> 23;
+    if (encoding != 0x17f && (encoding < 0x160 || encoding > 0x17c))
+        return true;
+    const int64_t oldJump = (int64_t(oldTarget)-int64_t(oldOffset)-4) >> 2;
+    if (int16_t(insnCode & 0xffff) != oldJump)
+        return true; // jump target is not in immediate
+    const int64_t newJump = (int64_t(target)-int64_t(offset)-4) >> 2;
+    if (newJump > INT16_MAX || newJump < INT16_MIN)
+        return false;
+    SULEV(*reinterpret_cast<uint32_t*>(code + offset),
+            (insnCode & 0xffff0000U) | uint16_t(newJump));
+    return true;
+}
@@ -311,6 +311,96 @@ static const cxbyte gcnSize15Table[16] =
     GCNENCSCH_1DWORD // GCNENC_NONE   // 1111 - illegal
 };
 
+// classes of instruction length (used while analyzing code before disassemblying)
+enum : cxbyte
+{
+    GCNLENCL_1DWORD = 0,    // single dword
+    GCNLENCL_2DWORD,        // two dwords
+    GCNLENCL_SOP1,          // single dword + literal (if SSRC0 is literal)
+    GCNLENCL_SOP2,          // single dword + literal (if SSRC0 or SSRC1 is literal)
+    GCNLENCL_SOPP,          // single dword (jump if opcode is jump)
+    GCNLENCL_JUMP,          // single dword (jump)
+    GCNLENCL_VOP,           // single dword + literal (if SRC0 is literal, SDWA or DPP)
+    GCNLENCL_SMRD11,        // single dword + literal (if SOFFSET is literal)
+    GCNLENCL_MIMG15,        // two dwords + NSA dwords
+    GCNLENCL_VOP3_15        // two dwords + literal (if any source is literal)
+};
+
+// architecture variant for length classes
+struct CLRX_INTERNAL GCNLengthArch
+{
+    bool isGCN11;
+    bool isGCN12;
+    bool isGCN14;
+    bool isGCN15;
+};
+
+// get length class for bits 23-31 of first instruction word
+static cxbyte getGCNLengthClass(const GCNLengthArch& a, cxuint topBits)
+{
+    if ((topBits & 0x100) != 0)
+    {
+        if ((topBits & 0x80) == 0)
+        {
+            // SOP???
+            if ((topBits & 0x60) == 0x60)
+            {
+                // SOP1/SOPK/SOPC/SOPP
+                const cxuint encPart = topBits & 0x1f;
+                if (encPart == 0x1d)
+                    return GCNLENCL_SOP1;
+                if (encPart == 0x1e)
+                    return GCNLENCL_SOP2; // SOPC
+                if (encPart == 0x1f)
+                    return GCNLENCL_SOPP;
+                // SOPK
+                const cxuint opcode = encPart;
+                if ((!a.isGCN12 && opcode == 17) ||
+                    (a.isGCN12 && opcode == 16) || // if branch fork
+                    (a.isGCN14 && opcode == 21) || // if s_call_b64
+                    (a.isGCN15 && (opcode == 22 ||
+                        opcode == 27 || opcode == 28))) // if s_subvector_loop_*
+                    return GCNLENCL_JUMP;
+                if (((!a.isGCN12 || a.isGCN15) && opcode == 21) ||
+                    (a.isGCN12 && !a.isGCN15 && opcode == 20))
+                    return GCNLENCL_2DWORD; // additional literal
+                return GCNLENCL_1DWORD;
+            }
+            return GCNLENCL_SOP2;
+        }
+        // SMRD and others
+        const cxuint encPart = (topBits>>3) & 0xf;
+        if (a.isGCN15)
+        {
+            if (gcnSize15Table[encPart]==GCNENCSCH_MIMG_DWORDS)
+                return GCNLENCL_MIMG15;
+            if (encPart==3 || encPart==5)
+                return GCNLENCL_VOP3_15;
+            return gcnSize15Table[encPart] ? GCNLENCL_2DWORD : GCNLENCL_1DWORD;
+        }
+        if (a.isGCN11 && encPart==0)
+            return GCNLENCL_SMRD11;
+        if ((!a.isGCN12 && gcnSize11Table[encPart] && (encPart != 7 || a.isGCN11)) ||
+            (a.isGCN12 && gcnSize12Table[encPart]))
+            return GCNLENCL_2DWORD;
+        return GCNLENCL_1DWORD;
+    }
+    // some vector instructions
+    const cxuint vopEnc = (topBits>>2) & 0x3f;
+    if (vopEnc == 0x3e || vopEnc == 0x3f)
+        return GCNLENCL_VOP; // VOPC or VOP1
+    // VOP2
+    const cxuint opcode = vopEnc;
+    if ((!a.isGCN12 && (opcode == 32 || opcode == 33)) ||
+        (a.isGCN12 && !a.isGCN15 && (opcode == 23 || opcode == 24 ||
+        opcode == 36 || opcode == 37)) ||
+        (a.isGCN15 && (opcode == 32 || opcode == 33 || // V_MADMK and V_MADAK
+            opcode == 44 || opcode == 45 || // V_FMAMK_F32, V_FMAAK_F32
+            opcode == 55 || opcode == 56))) // V_FMAMK_F16, V_FMAAK_F16
+        return GCNLENCL_2DWORD;  // inline 32-bit constant
+    return GCNLENCL_VOP;
+}
+
 void GCNDisassembler::analyzeBeforeDisassemble()
 {
     const uint32_t* codeWords = reinterpret_cast<const uint32_t*>(input);
@@ -318,136 +408,79 @@ void GCNDisassembler::analyzeBeforeDisassemble()
 
     const GPUArchitecture arch = getGPUArchitectureFromDeviceType(
                 disassembler.getDeviceType());
-    const bool isGCN11 = (arch == GPUArchitecture::GCN1_1);
-    const bool isGCN12 = (arch >= GPUArchitecture::GCN1_2);
-    const bool isGCN14 = (arch == GPUArchitecture::GCN1_4 || arch == GPUArchitecture::GCN1_4_1);
-    const bool isGCN15 = (arch >= GPUArchitecture::GCN1_5 || arch == GPUArchitecture::GCN1_5_1);
+    const GCNLengthArch lenArch = { arch == GPUArchitecture::GCN1_1,
+        arch >= GPUArchitecture::GCN1_2,
+        arch == GPUArchitecture::GCN1_4 || arch == GPUArchitecture::GCN1_4_1,
+        arch >= GPUArchitecture::GCN1_5 };
+    
+    /* table driven length decoding: class of instruction is determined by
+     * top 9 bits of first word, and remaining checks are simple compares */
+    cxbyte lengthClasses[512];
+    for (cxuint i = 0; i < 512; i++)
+        lengthClasses[i] = getGCNLengthClass(lenArch, i);
+    // SRC0 values that requires extra dword (literal, SDWA, DPP)
+    const uint32_t vopExtra1 = lenArch.isGCN12 ? 0xf9 : 0xff;
+    const uint32_t vopExtra2 = lenArch.isGCN12 ? 0xfa : 0xff;
+    const uint32_t vopExtra3 = lenArch.isGCN15 ? 0xe9 : 0xff;
+    const uint32_t vopExtra4 = lenArch.isGCN15 ? 0xea : 0xff;
+    // SOPP jump opcodes mask (4-9 and 2, GCN1.1 and GCN1.2: 23-26)
+    const uint64_t soppJumpMask = (0x3f0ULL | 4ULL) |
+            ((lenArch.isGCN11 || lenArch.isGCN12) ? (0xfULL<<23) : 0ULL);
+    
     size_t pos;
     for (pos = 0; pos < codeWordsNum; pos++)
     {
         /* scan all instructions and get jump addresses */
         const uint32_t insnCode = ULEV(codeWords[pos]);
-        if ((insnCode & 0x80000000U) != 0)
+        switch (lengthClasses[insnCode>>23])
         {
-            if ((insnCode & 0x40000000U) == 0)
+            case GCNLENCL_2DWORD:
+                pos++;
+                break;
+            case GCNLENCL_SOP1:
+                pos += ((insnCode&0xff) == 0xff);
+                break;
+            case GCNLENCL_SOP2:
+                pos += ((insnCode&0xff) == 0xff || (insnCode&0xff00) == 0xff00);
+                break;
+            case GCNLENCL_SOPP:
             {
-                // SOP???
-                if  ((insnCode & 0x30000000U) == 0x30000000U)
-                {
-                    // SOP1/SOPK/SOPC/SOPP
-                    const uint32_t encPart = (insnCode & 0x0f800000U);
-                    if (encPart == 0x0e800000U)
-                    {
-                        // SOP1
-                        if ((insnCode&0xff) == 0xff) // literal
-                            pos++;
-                    }
-                    else if (encPart == 0x0f000000U)
-                    {
-                        // SOPC
-                        if ((insnCode&0xff) == 0xff ||
-                            (insnCode&0xff00) == 0xff00) // literal
-                            pos++;
-                    }
-                    else if (encPart == 0x0f800000U)
-                    {
-                        // SOPP
-                        const cxuint opcode = (insnCode>>16)&0x7f;
-                        if (opcode == 2 || (opcode >= 4 && opcode <= 9) ||
-                            // GCN1.1 and GCN1.2 opcodes
-                            ((isGCN11 || isGCN12) &&
-                                    (opcode >= 23 && opcode <= 26))) // if jump
-                            labels.push_back(startOffset +
-                                    ((pos+int16_t(insnCode&0xffff)+1)<<2));
-                    }
-                    else
-                    {
-                        // SOPK
-                        const cxuint opcode = (insnCode>>23)&0x1f;
-                        if ((!isGCN12 && opcode == 17) ||
-                            (isGCN12 && opcode == 16) || // if branch fork
-                            (isGCN14 && opcode == 21) || // if s_call_b64
-                            (isGCN15 && (opcode == 22 ||
-                                opcode == 27 || opcode == 28))) // if s_subvector_loop_*
-                            labels.push_back(startOffset +
-                                    ((pos+int16_t(insnCode&0xffff)+1)<<2));
-                        else if (((!isGCN12 || isGCN15) && opcode == 21) ||
-                            (isGCN12 && !isGCN15 && opcode == 20))
-                            pos++; // additional literal
-                    }
-                }
-                else
-                {
-                    // SOP2
-                    if ((insnCode&0xff) == 0xff || (insnCode&0xff00) == 0xff00)
-                        pos++;  // literal
-                }
-            }
-            else
-            {
-                // SMRD and others
-                const uint32_t encPart = (insnCode&0x3c000000U)>>26;
-                if (isGCN15)
-                {
-                    if (gcnSize15Table[encPart]==GCNENCSCH_MIMG_DWORDS)
-                        pos += ((insnCode>>1)&3) + 1;
-                    else if (gcnSize15Table[encPart])
-                        pos++;
-                }
-                else if (isGCN11 && encPart==0 && (insnCode&0x1ff)==0xff)
-                    pos++;
-                else if ((!isGCN12 && gcnSize11Table[encPart] && (encPart != 7 || isGCN11)) ||
-                    (isGCN12 && gcnSize12Table[encPart]))
-                    pos++;
-                if (isGCN15 && (encPart==3 || encPart==5))
-                {
-                    // include VOP3 literal
-                    const uint32_t insnCode2 = ULEV(codeWords[pos]);
-                    if ((insnCode2 & 0x1ff) == 0xff || ((insnCode2>>9) & 0x1ff) == 0xff ||
-                        ((insnCode2>>18) & 0x1ff) == 0xff)
-                        pos++;
-                }
-            }
-        }
-        else
-        {
-            uint32_t src0 = (insnCode&0x1ff);
-            // some vector instructions
-            if ((insnCode & 0x7e000000U) == 0x7c000000U)
-            {
-                // VOPC
-                if (src0 == 0xff || // literal
-                    // SDWA, DPP
-                    (isGCN12 && (src0 == 0xf9 || src0 == 0xfa)) ||
-                    (isGCN15 && (src0 == 0xe9 || src0 == 0xea)))
-                    pos++;
+                const cxuint opcode = (insnCode>>16)&0x7f;
+                if (opcode < 64 && ((soppJumpMask>>opcode) & 1) != 0)
+                    labels.push_back(startOffset +
+                            ((pos+int16_t(insnCode&0xffff)+1)<<2));
+                break;
             }
-            else if ((insnCode & 0x7e000000U) == 0x7e000000U)
+            case GCNLENCL_JUMP:
+                labels.push_back(startOffset +
+                        ((pos+int16_t(insnCode&0xffff)+1)<<2));
+                break;
+            case GCNLENCL_VOP:
             {
-                // VOP1
-                if (src0 == 0xff || // literal
-                    // SDWA, DPP
-                    (isGCN12 && (src0 == 0xf9 || src0 == 0xfa)) ||
-                    (isGCN15 && (src0 == 0xe9 || src0 == 0xea)))
-                    pos++;
+                const uint32_t src0 = (insnCode&0x1ff);
+                pos += (src0 == 0xff || src0 == vopExtra1 || src0 == vopExtra2 ||
+                        src0 == vopExtra3 || src0 == vopExtra4);
+                break;
             }
-            else
+            case GCNLENCL_SMRD11:
+                pos += ((insnCode&0x1ff)==0xff);
+                break;
+            case GCNLENCL_MIMG15:
+                pos += ((insnCode>>1)&3) + 1;
+                break;
+            case GCNLENCL_VOP3_15:
             {
-                // VOP2
-                const cxuint opcode = (insnCode >> 25)&0x3f;
-                if ((!isGCN12 && (opcode == 32 || opcode == 33)) ||
-                    (isGCN12 && !isGCN15 && (opcode == 23 || opcode == 24 ||
-                    opcode == 36 || opcode == 37)) ||
-                    (isGCN15 && (opcode == 32 || opcode == 33 || // V_MADMK and V_MADAK
-                        opcode == 44 || opcode == 45 || // V_FMAMK_F32, V_FMAAK_F32
-                        opcode == 55 || opcode == 56))) // V_FMAMK_F16, V_FMAAK_F16
-                    pos++;  // inline 32-bit constant
-                else if (src0 == 0xff || // literal
-                    // SDWA, DPP
-                    (isGCN12 && (src0 == 0xf9 || src0 == 0xfa)) ||
-                    (isGCN15 && (src0 == 0xe9 || src0 == 0xea)))
-                    pos++;  // literal
+                pos++;
+                if (pos >= codeWordsNum)
+                    break;
+                // include VOP3 literal
+                const uint32_t insnCode2 = ULEV(codeWords[pos]);
+                pos += ((insnCode2 & 0x1ff) == 0xff || ((insnCode2>>9) & 0x1ff) == 0xff ||
+                        ((insnCode2>>18) & 0x1ff) == 0xff);
+                break;
             }
+            default:
+                break;
         }
     }
     
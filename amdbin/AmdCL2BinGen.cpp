@@ -2882,43 +2882,47 @@ void AmdCL2GPUBinGenerator::generateInternal(std::ostream* osPtr, std::vector<ch
         binarySize > UINT32_MAX)
         throw BinGenException("Binary size is too big!");
     /****
-     * prepare for write binary to output
+     * write binary to output (directly to memory if output is array or vector)
      ****/
-    std::unique_ptr<std::ostream> outStreamHolder;
+    std::unique_ptr<FastOutputBuffer> fob;
     std::ostream* os = nullptr;
     if (aPtr != nullptr)
     {
         aPtr->resize(binarySize);
-        outStreamHolder.reset(
-            new ArrayOStream(binarySize, reinterpret_cast<char*>(aPtr->data())));
-        os = outStreamHolder.get();
+        fob.reset(new FastOutputBuffer(size_t(binarySize),
+                    reinterpret_cast<char*>(aPtr->data())));
     }
     else if (vPtr != nullptr)
     {
         vPtr->resize(binarySize);
-        outStreamHolder.reset(new VectorOStream(*vPtr));
-        os = outStreamHolder.get();
+        fob.reset(new FastOutputBuffer(size_t(binarySize), vPtr->data()));
     }
     else // from argument
+    {
         os = osPtr;
+        fob.reset(new FastOutputBuffer(BINGEN_OUTBUFFER_SIZE, *os));
+    }
     
-    const std::ios::iostate oldExceptions = os->exceptions();
-    FastOutputBuffer fob(256, *os);
+    const std::ios::iostate oldExceptions = (os != nullptr) ?
+                os->exceptions() : std::ios::goodbit;
     try
     {
-        os->exceptions(std::ios::failbit | std::ios::badbit);
+        if (os != nullptr)
+            os->exceptions(std::ios::failbit | std::ios::badbit);
         if (input->is64Bit)
-            elfBinGen64->generate(fob);
+            elfBinGen64->generate(*fob);
         else
-            elfBinGen32->generate(fob);
+            elfBinGen32->generate(*fob);
     }
     catch(...)
     {
-        os->exceptions(oldExceptions);
+        if (os != nullptr)
+            os->exceptions(oldExceptions);
         throw;
     }
-    os->exceptions(oldExceptions);
-    assert(fob.getWritten() == binarySize);
+    if (os != nullptr)
+        os->exceptions(oldExceptions);
+    assert(fob->getWritten() == binarySize);
 }
 
 void AmdCL2GPUBinGenerator::generate(Array<cxbyte>& array) const
@@ -25,6 +25,8 @@
 #include <climits>
 #include <utility>
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include <cassert>
 #include <CLRX/amdbin/Elf.h>
 #include <CLRX/utils/Utilities.h>
@@ -72,10 +74,199 @@ const cxbyte CLRX::Elf64Types::ELFCLASS = ELFCLASS64;
 const cxuint CLRX::Elf64Types::bitness = 64;
 const char* CLRX::Elf64Types::bitName = "64";
 
+/* ELF hash index */
+
+// SysV ELF hash of name (as in SHT_HASH section)
+static uint32_t elfNameHash(const cxbyte* name)
+{
+    uint32_t h = 0, g;
+    while(*name!=0)
+    {
+        h = (h<<4) + *name++;
+        g = h & 0xf0000000U;
+        if (g) h ^= g>>24;
+        h &= ~g;
+    }
+    return h;
+}
+
+// GNU hash of name (as in SHT_GNU_HASH section)
+static uint32_t gnuNameHash(const cxbyte* name)
+{
+    uint32_t h = 5381;
+    while(*name!=0)
+        h = h*33 + *name++;
+    return h;
+}
+
+typedef std::unordered_map<const char*, size_t, CStringHash, CStringEqual> ElfNameHashMap;
+
+/// hash index of symbol table
+struct ElfSymHashIndex
+{
+    const cxbyte* hashTable;    // content of hash section of this symbol table
+    bool gnuHash;       // true if hash section is SHT_GNU_HASH
+    ElfNameHashMap nameMap; // own name map if no usable hash section
+    
+    ElfSymHashIndex() : hashTable(nullptr), gnuHash(false)
+    { }
+};
+
+struct CLRX::ElfHashIndex
+{
+    OnceFlag onceFlag;  // index is built once at first lookup
+    ElfNameHashMap sectionMap;
+    ElfSymHashIndex symbols;
+    ElfSymHashIndex dynSymbols;
+};
+
+/* use content of hash section for symbol table if it matches to symbol table.
+ * all hash chains are checked here, hence lookups do not check them */
+template<typename Types>
+static void setUpSymHashTable(ElfSymHashIndex& index, const cxbyte* table, size_t size,
+            bool gnuHash, size_t symsNum)
+{
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(table);
+    // every symbol can be only in one chain
+    std::vector<bool> visited(symsNum, false);
+    if (!gnuHash)
+    {
+        if (size < 8)
+            return;
+        const uint64_t bucketsNum = ULEV(words[0]);
+        const uint64_t chainsNum = ULEV(words[1]);
+        if (bucketsNum == 0 || chainsNum != symsNum ||
+            ((bucketsNum + chainsNum + 2)<<2) > size)
+            return;
+        const uint32_t* buckets = words + 2;
+        const uint32_t* chains = buckets + bucketsNum;
+        for (size_t b = 0; b < bucketsNum; b++)
+            for (size_t i = ULEV(buckets[b]); i != STN_UNDEF; i = ULEV(chains[i]))
+            {
+                if (i >= symsNum || visited[i])
+                    return;
+                visited[i] = true;
+            }
+    }
+    else
+    {
+        if (size < 16)
+            return;
+        const uint64_t bucketsNum = ULEV(words[0]);
+        const uint64_t symOffset = ULEV(words[1]);
+        const uint64_t bloomSize = ULEV(words[2]);
+        if (bucketsNum == 0 || symOffset > symsNum ||
+            16 + bloomSize*sizeof(typename Types::Word) +
+                ((bucketsNum + symsNum - symOffset)<<2) > size)
+            return;
+        const uint32_t* buckets = words + 4 +
+                    size_t(bloomSize)*(sizeof(typename Types::Word)>>2);
+        const uint32_t* chains = buckets + bucketsNum;
+        for (size_t b = 0; b < bucketsNum; b++)
+        {
+            size_t i = ULEV(buckets[b]);
+            if (i == 0)
+                continue; // empty bucket
+            if (i < symOffset)
+                return;
+            // chain must be finished before end of symbol table
+            for (; ; i++)
+            {
+                if (i >= symsNum || visited[i])
+                    return;
+                visited[i] = true;
+                if ((ULEV(chains[i-symOffset])&1) != 0)
+                    break; // end of chain
+            }
+        }
+    }
+    index.hashTable = table;
+    index.gnuHash = gnuHash;
+}
+
+template<typename Types>
+static inline const char* getSymNameFromTable(const cxbyte* symTable, size_t entSize,
+            const cxbyte* strTable, size_t i)
+{
+    const typename Types::Sym& sym = *reinterpret_cast<const typename Types::Sym*>(
+                symTable + i*entSize);
+    return reinterpret_cast<const char*>(strTable + ULEV(sym.st_name));
+}
+
+/* build own name map of symbol table if no usable hash section
+ * (symbol names must be already verified) */
+template<typename Types>
+static void buildSymNameMap(ElfSymHashIndex& index, const cxbyte* symTable,
+            size_t entSize, size_t symsNum, const cxbyte* strTable)
+{
+    if (index.hashTable != nullptr)
+        return;
+    index.nameMap.reserve(symsNum);
+    // first symbol with that name wins
+    for (size_t i = 0; i < symsNum; i++)
+        index.nameMap.insert(std::make_pair(getSymNameFromTable<Types>(
+                    symTable, entSize, strTable, i), i));
+}
+
+/* find symbol by name in symbol hash index, returns SIZE_MAX if not found */
+template<typename Types>
+static size_t findSymbolByHash(const ElfSymHashIndex& index, const cxbyte* symTable,
+            size_t entSize, size_t symsNum, const cxbyte* strTable, const char* name)
+{
+    if (index.hashTable == nullptr)
+    {
+        auto it = index.nameMap.find(name);
+        return (it != index.nameMap.end()) ? it->second : SIZE_MAX;
+    }
+    auto getSymName = [symTable, entSize, strTable](size_t i)
+    { return getSymNameFromTable<Types>(symTable, entSize, strTable, i); };
+    
+    const cxbyte* uname = reinterpret_cast<const cxbyte*>(name);
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(index.hashTable);
+    const uint32_t bucketsNum = ULEV(words[0]);
+    if (!index.gnuHash)
+    {
+        const uint32_t* buckets = words + 2;
+        const uint32_t* chains = buckets + bucketsNum;
+        for (size_t i = ULEV(buckets[elfNameHash(uname) % bucketsNum]);
+                    i != STN_UNDEF; i = ULEV(chains[i]))
+            if (::strcmp(getSymName(i), name) == 0)
+                return i;
+        // first (null) symbol is not in SysV hash table
+        if (symsNum != 0 && ::strcmp(getSymName(0), name) == 0)
+            return 0;
+    }
+    else
+    {
+        const uint32_t symOffset = ULEV(words[1]);
+        const uint32_t bloomSize = ULEV(words[2]);
+        const uint32_t* buckets = words + 4 +
+                size_t(bloomSize)*(sizeof(typename Types::Word)>>2);
+        const uint32_t* chains = buckets + bucketsNum;
+        const uint32_t hash = gnuNameHash(uname);
+        size_t i = ULEV(buckets[hash % bucketsNum]);
+        if (i != 0)
+            for (; ; i++)
+            {
+                const uint32_t chainHash = ULEV(chains[i-symOffset]);
+                if ((chainHash|1) == (hash|1) && ::strcmp(getSymName(i), name) == 0)
+                    return i;
+                if ((chainHash&1) != 0)
+                    break; // end of chain
+            }
+        // symbols before symOffset are not in GNU hash table
+        for (i = 0; i < symOffset; i++)
+            if (::strcmp(getSymName(i), name) == 0)
+                return i;
+    }
+    return SIZE_MAX;
+}
+
 /* ElfBinaryTemplate */
 
 template<typename Types>
-ElfBinaryTemplate<Types>::ElfBinaryTemplate() : binaryCodeSize(0), binaryCode(nullptr),
+ElfBinaryTemplate<Types>::ElfBinaryTemplate() : creationFlags(0),
+        binaryCodeSize(0), binaryCode(nullptr),
         sectionStringTable(nullptr), symbolStringTable(nullptr),
         symbolTable(nullptr), dynSymStringTable(nullptr), dynSymTable(nullptr),
         noteTable(nullptr), symbolsNum(0), dynSymbolsNum(0),
@@ -87,6 +278,52 @@ template<typename Types>
 ElfBinaryTemplate<Types>::~ElfBinaryTemplate()
 { }
 
+template<typename Types>
+ElfBinaryTemplate<Types>::ElfBinaryTemplate(const ElfBinaryTemplate& b)
+        : creationFlags(b.creationFlags), binaryCodeSize(b.binaryCodeSize),
+        binaryCode(b.binaryCode), sectionStringTable(b.sectionStringTable),
+        symbolStringTable(b.symbolStringTable), symbolTable(b.symbolTable),
+        dynSymStringTable(b.dynSymStringTable), dynSymTable(b.dynSymTable),
+        noteTable(b.noteTable), dynamicTable(b.dynamicTable),
+        sectionIndexMap(b.sectionIndexMap), symbolIndexMap(b.symbolIndexMap),
+        dynSymIndexMap(b.dynSymIndexMap),
+        hashIndex(b.hashIndex ? new ElfHashIndex : nullptr),
+        symbolsNum(b.symbolsNum), dynSymbolsNum(b.dynSymbolsNum),
+        noteTableSize(b.noteTableSize), dynamicsNum(b.dynamicsNum),
+        symbolEntSize(b.symbolEntSize), dynSymEntSize(b.dynSymEntSize),
+        dynamicEntSize(b.dynamicEntSize)
+{ }
+
+template<typename Types>
+ElfBinaryTemplate<Types>& ElfBinaryTemplate<Types>::operator=(const ElfBinaryTemplate& b)
+{
+    if (this == &b)
+        return *this;
+    creationFlags = b.creationFlags;
+    binaryCodeSize = b.binaryCodeSize;
+    binaryCode = b.binaryCode;
+    sectionStringTable = b.sectionStringTable;
+    symbolStringTable = b.symbolStringTable;
+    symbolTable = b.symbolTable;
+    dynSymStringTable = b.dynSymStringTable;
+    dynSymTable = b.dynSymTable;
+    noteTable = b.noteTable;
+    dynamicTable = b.dynamicTable;
+    sectionIndexMap = b.sectionIndexMap;
+    symbolIndexMap = b.symbolIndexMap;
+    dynSymIndexMap = b.dynSymIndexMap;
+    // own hash index (built at first lookup)
+    hashIndex.reset(b.hashIndex ? new ElfHashIndex : nullptr);
+    symbolsNum = b.symbolsNum;
+    dynSymbolsNum = b.dynSymbolsNum;
+    noteTableSize = b.noteTableSize;
+    dynamicsNum = b.dynamicsNum;
+    symbolEntSize = b.symbolEntSize;
+    dynSymEntSize = b.dynSymEntSize;
+    dynamicEntSize = b.dynamicEntSize;
+    return *this;
+}
+
 template<typename Types>
 ElfBinaryTemplate<Types>::ElfBinaryTemplate(size_t _binaryCodeSize, cxbyte* _binaryCode,
              Flags _creationFlags) : creationFlags(_creationFlags),
@@ -111,6 +348,9 @@ ElfBinaryTemplate<Types>::ElfBinaryTemplate(size_t _binaryCodeSize, cxbyte* _bin
     if (ehdr->e_ident[EI_DATA] != ELFDATA2LSB)
         throw BinException("Other than little-endian binaries are not supported!");
     
+    if ((creationFlags & ELF_CREATE_HASHINDEX) != 0)
+        hashIndex.reset(new ElfHashIndex);
+    
     if ((ULEV(ehdr->e_phoff) == 0 && ULEV(ehdr->e_phnum) != 0))
         throw BinException("Elf invalid phoff and phnum combination");
     if (ULEV(ehdr->e_phoff) != 0)
@@ -304,10 +544,53 @@ ElfBinaryTemplate<Types>::ElfBinaryTemplate(size_t _binaryCodeSize, cxbyte* _bin
     }
 }
 
+template<typename Types>
+void ElfBinaryTemplate<Types>::buildHashIndex() const
+{
+    // section headers are verified only if section string table is set
+    const cxuint shnum = (sectionStringTable != nullptr) ? getSectionHeadersNum() : 0;
+    // use hash sections of symbol tables (GNU hash sections are preferred)
+    for (cxuint i = 0; i < shnum; i++)
+    {
+        const typename Types::Shdr& shdr = getSectionHeader(i);
+        const uint32_t type = ULEV(shdr.sh_type);
+        if (type != SHT_HASH && type != SHT_GNU_HASH)
+            continue;
+        const typename Types::Shdr& linkHdr = getSectionHeader(ULEV(shdr.sh_link));
+        const cxbyte* linkTable = binaryCode + ULEV(linkHdr.sh_offset);
+        const bool isSymTab = (ULEV(linkHdr.sh_type) == SHT_SYMTAB &&
+                    linkTable == symbolTable);
+        if (!isSymTab && (ULEV(linkHdr.sh_type) != SHT_DYNSYM || linkTable != dynSymTable))
+            continue;
+        ElfSymHashIndex& symIndex = isSymTab ? hashIndex->symbols : hashIndex->dynSymbols;
+        if (symIndex.hashTable == nullptr || (!symIndex.gnuHash && type == SHT_GNU_HASH))
+            setUpSymHashTable<Types>(symIndex, binaryCode + ULEV(shdr.sh_offset),
+                    ULEV(shdr.sh_size), type == SHT_GNU_HASH,
+                    isSymTab ? symbolsNum : dynSymbolsNum);
+    }
+    hashIndex->sectionMap.reserve(shnum);
+    // first section with that name wins
+    for (cxuint i = 0; i < shnum; i++)
+        hashIndex->sectionMap.insert(std::make_pair(getSectionName(i), i));
+    buildSymNameMap<Types>(hashIndex->symbols, symbolTable, symbolEntSize,
+                symbolsNum, symbolStringTable);
+    buildSymNameMap<Types>(hashIndex->dynSymbols, dynSymTable, dynSymEntSize,
+                dynSymbolsNum, dynSymStringTable);
+}
+
 template<typename Types>
 uint16_t ElfBinaryTemplate<Types>::getSectionIndex(const char* name) const
 {
-    if (hasSectionMap())
+    if (hashIndex)
+    {
+        callOnce(hashIndex->onceFlag, [this]() { buildHashIndex(); });
+        // find in section hash map
+        auto it = hashIndex->sectionMap.find(name);
+        if (it == hashIndex->sectionMap.end())
+            throw BinException(std::string("Can't find Elf")+Types::bitName+" Section");
+        return it->second;
+    }
+    else if (hasSectionMap())
     {
         // find in section map (sorted array)
         SectionIndexMap::const_iterator it = binaryMapFind(
@@ -331,6 +614,15 @@ uint16_t ElfBinaryTemplate<Types>::getSectionIndex(const char* name) const
 template<typename Types>
 typename Types::Size ElfBinaryTemplate<Types>::getSymbolIndex(const char* name) const
 {
+    if (hashIndex)
+    {
+        callOnce(hashIndex->onceFlag, [this]() { buildHashIndex(); });
+        const size_t index = findSymbolByHash<Types>(hashIndex->symbols, symbolTable,
+                symbolEntSize, symbolsNum, symbolStringTable, name);
+        if (index == SIZE_MAX)
+            throw BinException(std::string("Can't find Elf")+Types::bitName+" Symbol");
+        return index;
+    }
     SymbolIndexMap::const_iterator it = binaryMapFind(
                     symbolIndexMap.begin(), symbolIndexMap.end(), name, CStringLess());
     if (it == symbolIndexMap.end())
@@ -341,6 +633,15 @@ typename Types::Size ElfBinaryTemplate<Types>::getSymbolIndex(const char* name)
 template<typename Types>
 typename Types::Size ElfBinaryTemplate<Types>::getDynSymbolIndex(const char* name) const
 {
+    if (hashIndex)
+    {
+        callOnce(hashIndex->onceFlag, [this]() { buildHashIndex(); });
+        const size_t index = findSymbolByHash<Types>(hashIndex->dynSymbols, dynSymTable,
+                dynSymEntSize, dynSymbolsNum, dynSymStringTable, name);
+        if (index == SIZE_MAX)
+            throw BinException(std::string("Can't find Elf")+Types::bitName+" DynSymbol");
+        return index;
+    }
     SymbolIndexMap::const_iterator it = binaryMapFind(
                     dynSymIndexMap.begin(), dynSymIndexMap.end(), name, CStringLess());
     if (it == dynSymIndexMap.end())
@@ -407,19 +708,8 @@ static std::unique_ptr<uint32_t[]> calculateHashValuesForSymbols(bool addNullSym
     if (addNullSymbol)
         hashCodes[0] = 0;
     for (size_t i = 0; i < symbols.size(); i++)
-    {
-        // main routine of hash
-        uint32_t h = 0, g;
-        const cxbyte* name = reinterpret_cast<const cxbyte*>(symbols[i].name);
-        while(*name!=0)
-        {
-            h = (h<<4) + *name++;
-            g = h & 0xf0000000U;
-            if (g) h ^= g>>24;
-            h &= ~g;
-        }
-        hashCodes[i+addNullSymbol] = h;
-    }
+        hashCodes[i+addNullSymbol] = elfNameHash(
+                    reinterpret_cast<const cxbyte*>(symbols[i].name));
     return hashCodes;
 }
 
@@ -1241,7 +1531,8 @@ void ElfBinaryGenTemplate<Types>::generate(FastOutputBuffer& fob)
         }
     }
     fob.flush();
-    fob.getOStream().flush();
+    if (!fob.isOutputToMemory())
+        fob.getOStream().flush();
     assert(size == fob.getWritten()-startOffset);
 }
 
@@ -168,7 +168,7 @@ GalliumElfBinary32::~GalliumElfBinary32()
 
 GalliumElfBinary32::GalliumElfBinary32(size_t binaryCodeSize, cxbyte* binaryCode,
            Flags creationFlags, size_t kernelsNum) :
-           ElfBinary32(binaryCodeSize, binaryCode, creationFlags|ELF_CREATE_SYMBOLMAP),
+           ElfBinary32(binaryCodeSize, binaryCode, creationFlags|ELF_CREATE_HASHINDEX),
            textRelsNum(0), textRelEntrySize(0), textRel(nullptr)
 {
     loadFromElf(static_cast<const ElfBinary32&>(*this), kernelsNum);
@@ -198,7 +198,7 @@ GalliumElfBinary64::~GalliumElfBinary64()
 
 GalliumElfBinary64::GalliumElfBinary64(size_t binaryCodeSize, cxbyte* binaryCode,
            Flags creationFlags, size_t kernelsNum) :
-           ElfBinary64(binaryCodeSize, binaryCode, creationFlags|ELF_CREATE_SYMBOLMAP),
+           ElfBinary64(binaryCodeSize, binaryCode, creationFlags|ELF_CREATE_HASHINDEX),
            textRelsNum(0), textRelEntrySize(0), textRel(nullptr)
 {
     loadFromElf(static_cast<const ElfBinary64&>(*this), kernelsNum);
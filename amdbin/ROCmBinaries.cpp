@@ -926,54 +926,45 @@ void ROCmBinGenerator::generateInternal(std::ostream* osPtr, std::vector<char>*
     if (elfBinGen64 == nullptr)
         prepareBinaryGen();
     /****
-     * prepare for write binary to output
+     * write binary to output (directly to memory if output is array or vector)
      ****/
-    std::unique_ptr<std::ostream> outStreamHolder;
+    std::unique_ptr<FastOutputBuffer> bos;
     std::ostream* os = nullptr;
     if (aPtr != nullptr)
     {
         aPtr->resize(binarySize);
-        outStreamHolder.reset(
-                new ArrayOStream(binarySize, reinterpret_cast<char*>(aPtr->data())));
-        os = outStreamHolder.get();
+        bos.reset(new FastOutputBuffer(size_t(binarySize),
+                    reinterpret_cast<char*>(aPtr->data())));
     }
     else if (vPtr != nullptr)
     {
         vPtr->resize(binarySize);
-        outStreamHolder.reset(new VectorOStream(*vPtr));
-        os = outStreamHolder.get();
+        bos.reset(new FastOutputBuffer(size_t(binarySize), vPtr->data()));
     }
     else // from argument
+    {
         os = osPtr;
+        bos.reset(new FastOutputBuffer(BINGEN_OUTBUFFER_SIZE, *os));
+    }
     
-    const std::ios::iostate oldExceptions = os->exceptions();
+    const std::ios::iostate oldExceptions = (os != nullptr) ?
+                os->exceptions() : std::ios::goodbit;
     try
     {
-    os->exceptions(std::ios::failbit | std::ios::badbit);
-    /****
-     * write binary to output
-     ****/
-    FastOutputBuffer bos(256, *os);
-    elfBinGen64->generate(bos);
-    assert(bos.getWritten() == binarySize);
-    
-    if (rocmGotGen != nullptr)
-    {
-        delete (ROCmGotGen*)rocmGotGen;
-        rocmGotGen = nullptr;
-    }
-    if (rocmRelaDynGen != nullptr)
-    {
-        delete (ROCmGotGen*)rocmRelaDynGen;
-        rocmRelaDynGen = nullptr;
-    }
+        if (os != nullptr)
+            os->exceptions(std::ios::failbit | std::ios::badbit);
+        // content generators are freed by destructor (binary can be generated again)
+        elfBinGen64->generate(*bos);
     }
     catch(...)
     {
-        os->exceptions(oldExceptions);
+        if (os != nullptr)
+            os->exceptions(oldExceptions);
         throw;
     }
-    os->exceptions(oldExceptions);
+    if (os != nullptr)
+        os->exceptions(oldExceptions);
+    assert(bos->getWritten() == binarySize);
 }
 
 void ROCmBinGenerator::generate(Array<cxbyte>& array)
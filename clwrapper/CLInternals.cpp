@@ -1649,7 +1649,7 @@ try
                     return CL_INVALID_BUILD_OPTIONS;
                 }
             }
-            else if (word == "-policy=")
+            else if (word.compare(0, 8, "-policy=")==0)
             {
                 const CString policyVersionStr = word.substr(8, word.size()-8);
                 const char* str = policyVersionStr.c_str();
@@ -1684,6 +1684,18 @@ try
         return CL_INVALID_BUILD_OPTIONS;
     }
     
+    // persistent cache of assembled binaries (directory given in envvar)
+    std::unique_ptr<AsmBinaryCache> binaryCache;
+    {
+        const std::string cacheDir = parseEnvVariable<std::string>(
+                    "CLRX_ASMCACHE_DIR", "");
+        if (!cacheDir.empty())
+            try
+            { binaryCache.reset(new AsmBinaryCache(cacheDir.c_str())); }
+            catch(const Exception& ex)
+            { /* ignore if cache directory is not available */ }
+    }
+    
     /* compiling programs */
     struct OutDevEntry {
         cl_device_id first, second;
@@ -1759,17 +1771,12 @@ try
             continue; // skip if this same architecture
         }
         prevDeviceType = devType;
-        // assemble it
-        ArrayIStream astream(sourceCodeSize-1, sourceCode.get());
-        std::string msgString;
-        StringOStream msgStream(msgString);
         /// determine whether use useCL20StdByDev
         bool useCL20StdByDev = (useCL20Std || (useCL2StdForGCN11 &&
                 getGPUArchitectureFromDeviceType(GPUDeviceType(devType))
                         >=GPUArchitecture::GCN1_1));
-        Assembler assembler("", astream, asmFlags,
-                    (useCL20StdByDev) ? BinaryFormat::AMDCL2 : BinaryFormat::AMD,
-                    GPUDeviceType(devType), msgStream);
+        const BinaryFormat binFormat = (useCL20StdByDev) ?
+                    BinaryFormat::AMDCL2 : BinaryFormat::AMD;
         
         // get address bit - for bitness
         cl_uint addressBits;
@@ -1777,7 +1784,37 @@ try
                     CL_DEVICE_ADDRESS_BITS, sizeof(cl_uint), &addressBits, nullptr);
         if (error != CL_SUCCESS)
             clrxAbort("Fatal error at clCompilerCall (clGetDeviceInfo)");
+        
+        AsmBinaryCache::Key cacheKey;
+        if (binaryCache)
+        {
+            // try to get binary from cache (without assembling)
+            cacheKey = AsmBinaryCache::computeKey(sourceCodeSize-1, sourceCode.get(),
+                    binFormat, GPUDeviceType(devType), addressBits==64, asmFlags,
+                    (havePolicy) ? policyVersion : cxuint(ASM_POLICY_DEFAULT), 0, 0,
+                    includePaths, defSyms);
+            Array<cxbyte> cachedBinary;
+            std::string cachedLog;
+            if (binaryCache->load(cacheKey, cachedBinary, cachedLog))
+            {
+                progDevEntry.log = RefPtr<CLProgLogEntry>(
+                            new CLProgLogEntry(std::move(cachedLog)));
+                progDevEntry.status = CL_BUILD_SUCCESS;
+                compiledProgBins[i] = RefPtr<CLProgBinEntry>(
+                            new CLProgBinEntry(std::move(cachedBinary)));
+                continue;
+            }
+        }
+        
+        // assemble it
+        ArrayIStream astream(sourceCodeSize-1, sourceCode.get());
+        std::string msgString;
+        StringOStream msgStream(msgString);
+        Assembler assembler("", astream, asmFlags, binFormat,
+                    GPUDeviceType(devType), msgStream);
         assembler.set64Bit(addressBits==64);
+        // collect included files for cache entry
+        assembler.setFileDepsTracking(binaryCache != nullptr);
         
         for (const CString& incPath: includePaths)
             assembler.addIncludeDir(incPath);
@@ -1810,6 +1847,14 @@ try
                 progDevEntry.status = CL_BUILD_SUCCESS;
                 Array<cxbyte> output;
                 assembler.writeBinary(output);
+                if (binaryCache)
+                    try
+                    {
+                        binaryCache->store(cacheKey, assembler.getFileDependencies(),
+                                output, progDevEntry.log->log);
+                    }
+                    catch(const Exception& ex)
+                    { /* ignore if entry can not be written */ }
                 compiledProgBins[i] = RefPtr<CLProgBinEntry>(
                             new CLProgBinEntry(std::move(output)));
             }
@@ -19,9 +19,14 @@
 
 #include <CLRX/Config.h>
 #include <iostream>
+#include <sstream>
 #include <memory>
 #include <fstream>
 #include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/utils/CLIParser.h>
 #include <CLRX/amdbin/AmdBinaries.h>
@@ -66,6 +71,16 @@ static const CLIOption programOptions[] =
     { "policy", 0, CLIArgType::UINT, false, false,
         "set policy version", "VERSION" },
     { "noWarnings", 'w', CLIArgType::NONE, false, false, "disable warnings", nullptr },
+    { "batch", 'B', CLIArgType::NONE, false, false,
+        "assemble every input file to separate output", nullptr },
+    { "threads", 'j', CLIArgType::UINT, false, false,
+        "set threads number for batch mode", "THREADS" },
+    { "includeCache", 0, CLIArgType::NONE, false, false,
+        "reuse results of unchanged include files between batch jobs", nullptr },
+    { "occupancy", 0, CLIArgType::UINT, false, false,
+        "allocate registers for target waves per SIMD and print occupancy", "WAVES" },
+    { "autoWait", 0, CLIArgType::NONE, false, false,
+        "insert wait instructions automatically", nullptr },
     CLRX_CLI_AUTOHELP
     { nullptr, 0 }
 };
@@ -81,6 +96,183 @@ static bool verifySymbolName(const CString& symbolName)
     return *c==0;
 }
 
+// common assembler setup
+struct AsmSetup
+{
+    bool is64Bit;
+    BinaryFormat binFormat;
+    GPUDeviceType deviceType;
+    uint32_t driverVersion;
+    uint32_t llvmVersion;
+    Flags flags;
+    bool newROCmBinFormat;
+    bool havePolicy;
+    cxuint policyVersion;
+    std::vector<std::pair<CString, uint64_t> > defSyms;
+    size_t includePathsNum;
+    const char* const* includePaths;
+    bool allocateRegs;
+    cxuint occupancyTarget;
+    
+    void apply(Assembler& assembler) const
+    {
+        assembler.set64Bit(is64Bit);
+        assembler.setDriverVersion(driverVersion);
+        assembler.setLLVMVersion(llvmVersion);
+        assembler.setNewROCmBinFormat(newROCmBinFormat);
+        if (havePolicy)
+            assembler.setPolicyVersion(policyVersion);
+        if (allocateRegs)
+            assembler.setOccupancyTarget(occupancyTarget);
+        for (size_t i = 0; i < includePathsNum; i++)
+            assembler.addIncludeDir(includePaths[i]);
+        for (const auto& defSym: defSyms)
+            assembler.addInitialDefSym(defSym.first, defSym.second);
+    }
+};
+
+// allocate registers and print achieved occupancy of the code sections
+static bool allocateRegisters(Assembler& assembler, cxuint threadsNum,
+            std::ostream& printStream)
+{
+    // registers are allocated while assembling if occupancy target is set
+    if (assembler.getRegAllocResults().empty() &&
+        !assembler.allocateRegisters(threadsNum))
+        return false;
+    for (const AsmRegAllocResult& result: assembler.getRegAllocResults())
+    {
+        const AsmSection& section = assembler.getSections()[result.sectionId];
+        if (section.kernelId != ASMKERN_GLOBAL)
+            printStream << "Kernel '" <<
+                    assembler.getKernels()[section.kernelId].name << "'";
+        else
+            printStream << "Section '" <<
+                    (section.name != nullptr ? section.name : "") << "'";
+        printStream << ": " << result.wavesPerSIMD << " waves per SIMD (SGPRs: " <<
+                result.regsNum[REGTYPE_SGPR] << ", VGPRs: " <<
+                result.regsNum[REGTYPE_VGPR] << ")\n";
+    }
+    return true;
+}
+
+// result of assembling single file in batch mode
+struct BatchJob
+{
+    CString inputName;
+    CString outputName;
+    std::ostringstream msgStream;   // messages (warnings and errors)
+    std::ostringstream printStream; // output of '.print'
+    bool good;
+};
+
+// create output filename for batch mode: replace extension by '.clo'
+static CString getBatchOutputName(const CString& inputName, const char* outDir)
+{
+    const char* filename = inputName.c_str();
+    const char* baseName = filename;
+    for (const char* p = filename; *p != 0; p++)
+        if (*p == '/' || *p == CLRX_NATIVE_DIR_SEP)
+            baseName = p+1;
+    const char* extPlace = ::strrchr(baseName, '.');
+    if (extPlace == nullptr || extPlace == baseName)
+        extPlace = baseName + ::strlen(baseName);
+    std::string outName;
+    if (outDir != nullptr)
+    {
+        // place output in output directory
+        outName = outDir;
+        if (!outName.empty() && outName.back() != '/' &&
+                outName.back() != CLRX_NATIVE_DIR_SEP)
+            outName.push_back(CLRX_NATIVE_DIR_SEP);
+        outName.append(baseName, extPlace);
+    }
+    else
+        outName.assign(filename, extPlace);
+    outName += ".clo";
+    return CString(outName.c_str());
+}
+
+static void assembleBatchJob(const AsmSetup& setup, AsmIncludeCache* includeCache,
+            BatchJob& job)
+{
+    job.good = false;
+    try
+    {
+        Array<CString> filenames(1);
+        filenames[0] = job.inputName;
+        Assembler assembler(filenames, setup.flags, setup.binFormat, setup.deviceType,
+                    job.msgStream, job.printStream);
+        setup.apply(assembler);
+        assembler.setIncludeCache(includeCache);
+        if (assembler.assemble() && (!setup.allocateRegs ||
+                allocateRegisters(assembler, 1, job.printStream)))
+        {
+            assembler.writeBinary(job.outputName.c_str());
+            job.good = true;
+        }
+    }
+    catch(const Exception& ex)
+    { job.msgStream << ex.what() << std::endl; }
+    catch(const std::bad_alloc& ex)
+    { job.msgStream << "Out of memory" << std::endl; }
+    catch(const std::exception& ex)
+    { job.msgStream << "System exception: " << ex.what() << std::endl; }
+}
+
+/* batch mode: assemble every input to separate output in thread pool.
+ * messages are printed in input files order after assembling */
+static int assembleBatch(const AsmSetup& setup, const Array<CString>& filenames,
+            const char* outDir, cxuint threadsNum, bool useIncludeCache)
+{
+    const size_t jobsNum = filenames.size();
+    std::unique_ptr<BatchJob[]> jobs(new BatchJob[jobsNum]);
+    for (size_t i = 0; i < jobsNum; i++)
+    {
+        jobs[i].inputName = filenames[i];
+        jobs[i].outputName = getBatchOutputName(filenames[i], outDir);
+    }
+    // inputs with same basename (in different directories) give same output
+    std::unordered_map<CString, size_t> outputJobs;
+    for (size_t i = 0; i < jobsNum; i++)
+    {
+        auto res = outputJobs.insert(std::make_pair(jobs[i].outputName, i));
+        if (!res.second)
+            throw Exception(std::string("Output file '")+jobs[i].outputName.c_str()+
+                    "' for input '"+jobs[i].inputName.c_str()+"' is same as for input '"+
+                    jobs[res.first->second].inputName.c_str()+"'");
+    }
+    
+    if (threadsNum == 0)
+        threadsNum = std::max(std::thread::hardware_concurrency(), 1U);
+    threadsNum = std::min(size_t(threadsNum), jobsNum);
+    std::atomic<size_t> nextJob(0);
+    auto worker = [&setup, &jobs, &nextJob, jobsNum, useIncludeCache]()
+    {
+        // include cache is not thread-safe, hence every thread has own cache
+        AsmIncludeCache includeCache;
+        size_t i;
+        while ((i = nextJob.fetch_add(1)) < jobsNum)
+            assembleBatchJob(setup, useIncludeCache ? &includeCache : nullptr, jobs[i]);
+    };
+    std::vector<std::thread> threads;
+    for (cxuint i = 1; i < threadsNum; i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (std::thread& thread: threads)
+        thread.join();
+    
+    int ret = 0;
+    for (size_t i = 0; i < jobsNum; i++)
+    {
+        std::cout << jobs[i].printStream.str();
+        std::cerr << jobs[i].msgStream.str();
+        if (!jobs[i].good)
+            ret = 1;
+    }
+    std::cout.flush();
+    return ret;
+}
+
 int main(int argc, const char** argv)
 try
 {
@@ -90,93 +282,82 @@ try
         return 0;
     
     int ret = 0;
-    bool is64Bit = false;
-    BinaryFormat binFormat = BinaryFormat::AMD;
-    GPUDeviceType deviceType = GPUDeviceType::CAPE_VERDE;
-    uint32_t driverVersion = 0;
-    uint32_t llvmVersion = 0;
-    Flags flags = 0;
-    bool newROCmBinFormat = false;
-    bool havePolicy = false;
-    cxuint policyVersion = 0;
+    AsmSetup setup{ false, BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, 0, 0, 0,
+            false, false, 0, {}, 0, nullptr, false, 0 };
     if (cli.hasShortOption('b'))
     {
         const char* binFmtName = cli.getShortOptArg<const char*>('b');
         // choosing binary format from name
         if (::strcasecmp(binFmtName, "raw")==0 || ::strcasecmp(binFmtName, "rawcode")==0)
-            binFormat = BinaryFormat::RAWCODE;
+            setup.binFormat = BinaryFormat::RAWCODE;
         else if (::strcasecmp(binFmtName, "gallium")==0)
-            binFormat = BinaryFormat::GALLIUM;
+            setup.binFormat = BinaryFormat::GALLIUM;
         else if (::strcasecmp(binFmtName, "amdcl2")==0)
-            binFormat = BinaryFormat::AMDCL2;
+            setup.binFormat = BinaryFormat::AMDCL2;
         else if (::strcasecmp(binFmtName, "rocm")==0)
-            binFormat = BinaryFormat::ROCM;
+            setup.binFormat = BinaryFormat::ROCM;
         else if (::strcasecmp(binFmtName, "amd")!=0 &&
                  ::strcasecmp(binFmtName, "catalyst")!=0)
             throw Exception("Unknown binary format");
     }
     if (cli.hasShortOption('6'))
-        is64Bit = true;
+        setup.is64Bit = true;
     if (cli.hasShortOption('g'))
-        deviceType = getGPUDeviceTypeFromName(cli.getShortOptArg<const char*>('g'));
+        setup.deviceType = getGPUDeviceTypeFromName(cli.getShortOptArg<const char*>('g'));
     else if (cli.hasShortOption('A'))
         // in this case, we choose lowest GPU device for choosen GPU architecture
-        deviceType = getLowestGPUDeviceTypeFromArchitecture(getGPUArchitectureFromName(
-                    cli.getShortOptArg<const char*>('A')));
+        setup.deviceType = getLowestGPUDeviceTypeFromArchitecture(
+                getGPUArchitectureFromName(cli.getShortOptArg<const char*>('A')));
     if (cli.hasShortOption('t'))
-        driverVersion = cli.getShortOptArg<cxuint>('t');
+        setup.driverVersion = cli.getShortOptArg<cxuint>('t');
     if (cli.hasLongOption("llvmVersion"))
-        llvmVersion = cli.getLongOptArg<cxuint>("llvmVersion");
+        setup.llvmVersion = cli.getLongOptArg<cxuint>("llvmVersion");
     if (cli.hasShortOption('S'))
-        flags |= ASM_FORCE_ADD_SYMBOLS;
+        setup.flags |= ASM_FORCE_ADD_SYMBOLS;
     if (!cli.hasShortOption('w'))
-        flags |= ASM_WARNINGS;
+        setup.flags |= ASM_WARNINGS;
     if (cli.hasShortOption('a'))
-        flags |= ASM_ALTMACRO;
+        setup.flags |= ASM_ALTMACRO;
     if (cli.hasLongOption("buggyFPLit"))
-        flags |= ASM_BUGGYFPLIT;
+        setup.flags |= ASM_BUGGYFPLIT;
     if (cli.hasShortOption('m'))
-        flags |= ASM_MACRONOCASE;
+        setup.flags |= ASM_MACRONOCASE;
     if (cli.hasLongOption("oldModParam"))
-        flags |= ASM_OLDMODPARAM;
+        setup.flags |= ASM_OLDMODPARAM;
     if (cli.hasShortOption('3'))
-        flags |= ASM_WAVE32;
+        setup.flags |= ASM_WAVE32;
     if (cli.hasLongOption("newROCmBinFormat"))
-        newROCmBinFormat = true;
+        setup.newROCmBinFormat = true;
     if (cli.hasLongOption("policy"))
     {
-        policyVersion = cli.getLongOptArg<cxuint>("policy");
-        havePolicy = true;
+        setup.policyVersion = cli.getLongOptArg<cxuint>("policy");
+        setup.havePolicy = true;
     }
+    if (cli.hasLongOption("occupancy"))
+    {
+        // register usage must be collected for register allocation
+        setup.occupancyTarget = cli.getLongOptArg<cxuint>("occupancy");
+        if (setup.occupancyTarget == 0)
+            throw Exception("Occupancy target must be nonzero");
+        setup.allocateRegs = true;
+        setup.flags |= ASM_REGALLOC;
+    }
+    if (cli.hasLongOption("autoWait"))
+        setup.flags |= ASM_AUTOWAIT;
     
     cxuint argsNum = cli.getArgsNum();
     Array<CString> filenames(argsNum);
     for (cxuint i = 0; i < argsNum; i++)
         filenames[i] = cli.getArgs()[i];
     
-    std::unique_ptr<Assembler> assembler;
-    if (!filenames.empty())
-        assembler.reset(new Assembler(filenames, flags, binFormat, deviceType));
-    else // if from stdin
-        assembler.reset(new Assembler(nullptr, std::cin, flags, binFormat, deviceType));
-    assembler->set64Bit(is64Bit);
-    assembler->setDriverVersion(driverVersion);
-    assembler->setLLVMVersion(llvmVersion);
-    assembler->setNewROCmBinFormat(newROCmBinFormat);
-    if (havePolicy)
-        assembler->setPolicyVersion(policyVersion);
-    
     size_t defSymsNum = 0;
     const char* const* defSyms = nullptr;
-    size_t includePathsNum = 0;
-    const char* const* includePaths = nullptr;
     if (cli.hasShortOption('D'))
         defSyms = cli.getShortOptArgArray<const char*>('D', defSymsNum);
     if (cli.hasShortOption('I'))
-        includePaths = cli.getShortOptArgArray<const char*>('I', includePathsNum);
+        setup.includePaths = cli.getShortOptArgArray<const char*>('I',
+                        setup.includePathsNum);
     
-    for (size_t i = 0; i < includePathsNum; i++)
-        assembler->addIncludeDir(includePaths[i]);
     for (size_t i = 0; i < defSymsNum; i++)
     {
         const char* eqPlace = ::strchr(defSyms[i], '=');
@@ -214,7 +395,7 @@ try
         else
             symName = defSyms[i];
         if (verifySymbolName(symName))
-            assembler->addInitialDefSym(symName, value);
+            setup.defSyms.push_back(std::make_pair(symName, value));
         else
         {
             std::cerr << "Invalid symbol name '" << symName << "'" << std::endl;
@@ -224,9 +405,35 @@ try
     // exit if errors occurred
     if (ret!=0)
         return ret;
+    
+    if (cli.hasShortOption('B'))
+    {
+        // batch mode
+        if (filenames.empty())
+            throw Exception("No input files for batch mode");
+        const char* outDir = nullptr;
+        if (cli.hasShortOption('o'))
+            outDir = cli.getShortOptArg<const char*>('o');
+        cxuint threadsNum = 0;
+        if (cli.hasShortOption('j'))
+            threadsNum = cli.getShortOptArg<cxuint>('j');
+        return assembleBatch(setup, filenames, outDir, threadsNum,
+                    cli.hasLongOption("includeCache"));
+    }
+    
+    std::unique_ptr<Assembler> assembler;
+    if (!filenames.empty())
+        assembler.reset(new Assembler(filenames, setup.flags, setup.binFormat,
+                    setup.deviceType));
+    else // if from stdin
+        assembler.reset(new Assembler(nullptr, std::cin, setup.flags, setup.binFormat,
+                    setup.deviceType));
+    setup.apply(*assembler);
     /// run assembling
     if (!assembler->assemble())
         return 1;
+    if (setup.allocateRegs && !allocateRegisters(*assembler, 0, std::cout))
+        return 1;
     /// write output to file
     const char* outputName = "a.out";
     if (cli.hasShortOption('o'))
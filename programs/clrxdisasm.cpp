@@ -61,6 +61,8 @@ static const CLIOption programOptions[] =
         "set LLVM version (for Gallium)", "VERSION" },
     { "buggyFPLit", 0, CLIArgType::NONE, false, false,
         "use old and buggy fplit rules", nullptr },
+    { "threads", 'j', CLIArgType::UINT, false, false,
+        "disassemble kernels in parallel using THREADS threads", "THREADS" },
     CLRX_CLI_AUTOHELP
     { nullptr, 0 }
 };
@@ -94,7 +96,11 @@ try
              (cli.hasLongOption("buggyFPLit")?DISASM_BUGGYFPLIT:0) |
              (cli.hasShortOption('H')?DISASM_HSACONFIG:0) |
              (cli.hasShortOption('L')?DISASM_HSALAYOUT:0) |
-             (cli.hasShortOption('3')?DISASM_WAVE32:0);
+             (cli.hasShortOption('3')?DISASM_WAVE32:0) |
+             (cli.hasShortOption('j')?DISASM_PARALLEL:0);
+    cxuint threadsNum = 0;
+    if (cli.hasShortOption('j'))
+        threadsNum = cli.getShortOptArg<cxuint>('j');
     
     bool hasGPUDeviceType = false;
     GPUDeviceType gpuDeviceType = GPUDeviceType::CAPE_VERDE;
@@ -122,11 +128,12 @@ try
     for (const char* const* args = cli.getArgs();*args != nullptr; args++)
     {
         std::cout << "/* Disassembling '" << *args << "\' */" << std::endl;
-        Array<cxbyte> binaryData;
+        // map binary file to memory (without copying)
+        MappedFile binaryData;
         std::unique_ptr<AmdMainBinaryBase> base = nullptr;
         try
         {
-            binaryData = loadDataFromFile(*args);
+            binaryData.mapOrLoad(*args);
             
             if (!fromRawCode)
             {
@@ -141,16 +148,17 @@ try
                 if ((disasmFlags & (DISASM_METADATA|DISASM_CONFIG)) != 0)
                     binFlags |= AMDBIN_CREATE_INFOSTRINGS;
                 
-                if (isAmdBinary(binaryData.size(), binaryData.data()))
+                if (isAmdBinary(binaryData.getSize(), binaryData.getContent()))
                 {
                     // if amd binary
-                    base.reset(createAmdBinaryFromCode(binaryData.size(),
-                            binaryData.data(), binFlags));
+                    base.reset(createAmdBinaryFromCode(binaryData.getSize(),
+                            binaryData.getContent(), binFlags));
                     if (base->getType() == AmdMainType::GPU_BINARY)
                     {
                         AmdMainGPUBinary32* amdGpuBin =
                                 static_cast<AmdMainGPUBinary32*>(base.get());
                         Disassembler disasm(*amdGpuBin, std::cout, disasmFlags);
+                        disasm.setThreadsNum(threadsNum);
                         disasm.disassemble();
                     }
                     else if (base->getType() == AmdMainType::GPU_64_BINARY)
@@ -158,25 +166,27 @@ try
                         AmdMainGPUBinary64* amdGpuBin =
                                 static_cast<AmdMainGPUBinary64*>(base.get());
                         Disassembler disasm(*amdGpuBin, std::cout, disasmFlags);
+                        disasm.setThreadsNum(threadsNum);
                         disasm.disassemble();
                     }
                     else
                         throw Exception("This is not AMDGPU binary file!");
                 }
-                else if (isAmdCL2Binary(binaryData.size(), binaryData.data()))
+                else if (isAmdCL2Binary(binaryData.getSize(), binaryData.getContent()))
                 {   // AMD OpenCL 2.0 binary
                     // extra (extra data) flags for OpenCL 2.0 disassembler
                     binFlags |= AMDCL2BIN_INNER_CREATE_KERNELDATA |
                                 AMDCL2BIN_INNER_CREATE_KERNELDATAMAP |
                                 AMDCL2BIN_INNER_CREATE_KERNELSTUBS;
-                    base.reset(createAmdCL2BinaryFromCode(binaryData.size(),
-                                           binaryData.data(), binFlags));
+                    base.reset(createAmdCL2BinaryFromCode(binaryData.getSize(),
+                                           binaryData.getContent(), binFlags));
                     if (base->getType() == AmdMainType::GPU_CL2_BINARY)
                     {
                         AmdCL2MainGPUBinary32* amdGpuBin =
                                 static_cast<AmdCL2MainGPUBinary32*>(base.get());
                         Disassembler disasm(*amdGpuBin, std::cout, disasmFlags,
                                             driverVersion);
+                        disasm.setThreadsNum(threadsNum);
                         disasm.disassemble();
                     }
                     else if (base->getType() == AmdMainType::GPU_CL2_64_BINARY)
@@ -185,33 +195,38 @@ try
                                 static_cast<AmdCL2MainGPUBinary64*>(base.get());
                         Disassembler disasm(*amdGpuBin, std::cout, disasmFlags,
                                             driverVersion);
+                        disasm.setThreadsNum(threadsNum);
                         disasm.disassemble();
                     }
                     else
                         throw Exception("This is not AMDGPU binary file!");
                 }
-                else if (isROCmBinary(binaryData.size(), binaryData.data()))
+                else if (isROCmBinary(binaryData.getSize(), binaryData.getContent()))
                 {
                     // ROCm binary
-                    ROCmBinary rocmBin(binaryData.size(), binaryData.data(), 0);
+                    ROCmBinary rocmBin(binaryData.getSize(), binaryData.getContent(), 0);
                     Disassembler disasm(rocmBin, std::cout, hasGPUDeviceType, gpuDeviceType,
                                         disasmFlags);
+                    disasm.setThreadsNum(threadsNum);
                     disasm.disassemble();
                 }
                 else
                 {
                     // if gallium binary
-                    GalliumBinary galliumBin(binaryData.size(),binaryData.data(), 0);
+                    GalliumBinary galliumBin(binaryData.getSize(),
+                                binaryData.getContent(), 0);
                     Disassembler disasm(gpuDeviceType, galliumBin, std::cout,
                             disasmFlags, llvmVersion);
+                    disasm.setThreadsNum(threadsNum);
                     disasm.disassemble();
                 }
             }
             else
             {
                 /* raw binaries */
-                Disassembler disasm(gpuDeviceType, binaryData.size(), binaryData.data(),
-                        std::cout, disasmFlags);
+                Disassembler disasm(gpuDeviceType, binaryData.getSize(),
+                        binaryData.getContent(), std::cout, disasmFlags);
+                disasm.setThreadsNum(threadsNum);
                 disasm.disassemble();
             }
         }
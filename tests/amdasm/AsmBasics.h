@@ -68,5 +68,6 @@ struct AsmTestCase
 
 extern const AsmTestCase asmTestCases1Tbl[];
 extern const AsmTestCase asmTestCases2Tbl[];
+extern const AsmTestCase asmTestCasesResolveTbl[];
 
 #endif
@@ -2499,5 +2499,199 @@ aa2=6
         { }, { }, { { ".", 0, 0, 0, true, false, false, 0, 0 } }, true,
         "", "isNotGCN1.4.1\n",
     },
+    /* 92 - include test (filtering of mapped source file) */
+    {   R"ffDXD(            .include "inc4.s"
+            .byte 9)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 1, 2, 3, 4, 5, 6, 7, 8, 9 } } },
+        { { ".", 9U, 0, 0U, true, false, false, 0, 0 } },
+        true, "In file included from test.s:1:13:\n"
+        CLRX_SOURCE_DIR "/tests/amdasm/incdir1/inc4.s:8:1: Warning: x\n", "a;#\"b\n",
+        { CLRX_SOURCE_DIR "/tests/amdasm/incdir1" }
+    },
+    /* 93 - include test (declarations only, nested include) */
+    {   R"ffDXD(            .include "incdefs.s"
+            putdef defB, 1
+            .byte defD, defE)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 36, 0, 0, 0, 7, 12 } } },
+        {
+            { ".", 6U, 0, 0U, true, false, false, 0, 0 },
+            { "defA", 16U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "defB", 35U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "defC", 3U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "defD", 7U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "defE", 12U, ASMSECT_ABS, 0U, true, false, false, 0, 0 }
+        }, true, "", "",
+        { CLRX_SOURCE_DIR "/tests/amdasm/incdir1" }
+    },
+    /* 94 - macro substitutions (repeated arguments, line continuations) */
+    {   R"ffDXD(            .macro splice x, yy, z
+            .byte \x, \yy+\x, \
+   \z, \yy\()0, \@
+            .byte \x+\yy+300
+            .endm
+            splice 1, 20, 3
+            splice 4, 5)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 1, 21, 3, 200, 0, 65, 4, 9, 0, 50, 1, 53 } } },
+        { { ".", 12U, 0, 0U, true, false, false, 0, 0 } },
+        true, "In macro substituted from test.s:6:13:\n"
+        "test.s:4:19: Warning: Value 0x141 truncated to 0x41\n"
+        "In macro substituted from test.s:7:13:\n"
+        "test.s:3:4: Warning: No expression, zero has been put\n"
+        "In macro substituted from test.s:7:13:\n"
+        "test.s:4:19: Warning: Value 0x135 truncated to 0x35\n", ""
+    },
+    /* 95 - cached statements of repetitions */
+    {   R"ffDXD(            .rawcode
+            .rept 2
+            s_nop 1
+            .ifndef snopDefined
+            snopDefined = 1
+            .macro s_nop x
+            .byte 7
+            .endm
+            .endif
+            .endr
+            .irp op, byte, hword, byte
+            .\op 1
+            .endr
+            .irp x, 3, 4
+            .byte \x
+            .endr
+            .for i = 0, i < 4, i + 1
+            .if i & 1
+            .byte 5
+            .else
+            .hword 6
+            .endif
+            .endr
+            .rept 2
+            s_movk_i32 s1, 0x12345
+            .endr)ffDXD",
+        BinaryFormat::RAWCODE, GPUDeviceType::CAPE_VERDE, false, { },
+        { { ".text", ASMKERN_GLOBAL, AsmSectionType::CODE,
+            {
+                0x01, 0x00, 0x80, 0xbf, 0x07, 0x01, 0x01, 0x00,
+                0x01, 0x03, 0x04, 0x06, 0x00, 0x05, 0x06, 0x00,
+                0x05, 0x45, 0x23, 0x01, 0xb0, 0x45, 0x23, 0x01,
+                0xb0
+            } } },
+        {
+            { ".", 25U, 0, 0U, true, false, false, 0, 0 },
+            { "i", 4U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "snopDefined", 1U, ASMSECT_ABS, 0U, true, false, false, 0, 0 }
+        },
+        true, "In repetition 1/2:\n"
+        "test.s:25:28: Warning: Value 0x12345 truncated to 0x2345\n"
+        "In repetition 2/2:\n"
+        "test.s:25:28: Warning: Value 0x12345 truncated to 0x2345\n", ""
+    },
+    /* 96 - compiled expressions (folded constants with later resolved symbols) */
+    {   R"ffDXD(            .int (3*4+x)*(10-2)+((1<<4)|y)
+            .int z ? 5+6 : (7-x)
+            .eqv e0, x*2+(100/4)
+            .eqv e1, e0+e0*(y-1)
+            .int e1+(2>>70)
+            .int (x<<(y+61))+(1<<64)
+            x = 5
+            y = 3
+            z = 0)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 0x9b, 0, 0, 0, 2, 0, 0, 0, 0x69, 0, 0, 0, 0, 0, 0, 0 } } },
+        {
+            { ".", 16U, 0, 0U, true, false, false, 0, 0 },
+            { "e0", 0U, ASMSECT_ABS, 0U, false, true, true, 0, 0 },
+            { "e1", 0U, ASMSECT_ABS, 0U, false, true, true, 0, 0 },
+            { "x", 5U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "y", 3U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "z", 0U, ASMSECT_ABS, 0U, true, false, false, 0, 0 }
+        },
+        true, "test.s:5:23: Warning: Shift count out of range (between 0 and 63)\n"
+        "test.s:6:20: Warning: Shift count out of range (between 0 and 63)\n"
+        "test.s:6:32: Warning: Shift count out of range (between 0 and 63)\n", ""
+    },
+    /* 97 - include test (declarations included inside scope) */
+    {   R"ffDXD(            .scope sc
+            .include "incdefs.s"
+            .ends
+            putdef sc::defB, 1
+            .byte sc::defD, sc::defE)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 36, 0, 0, 0, 7, 12 } } },
+        {
+            { ".", 6U, 0, 0U, true, false, false, 0, 0 },
+            { "sc::defA", 16U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "sc::defB", 35U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "sc::defC", 3U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "sc::defD", 7U, ASMSECT_ABS, 0U, true, false, false, 0, 0 },
+            { "sc::defE", 12U, ASMSECT_ABS, 0U, true, false, false, 0, 0 }
+        }, true, "", "",
+        { CLRX_SOURCE_DIR "/tests/amdasm/incdir1" }
+    },
+    { nullptr }
+};
+
+/* testcases assembled with resolving symbols at end (ASM_TESTRESOLVE) */
+const AsmTestCase asmTestCasesResolveTbl[] =
+{
+    /* 0 - circular dependencies between symbols */
+    {   R"ffDXD(            a = b+1
+            b = c*2
+            c = a-3
+            .int a
+            d = d+1
+            g = 1
+            .int g)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 0, 0, 0, 0, 1, 0, 0, 0 } } },
+        {
+            { ".", 8U, 0, 0U, true, false, false, 0, 0 },
+            { "a", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "b", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "c", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "d", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "g", 1U, ASMSECT_ABS, 0U, true, false, false, 0, 0 }
+        },
+        false, "test.s:1:17: Error: Unresolved symbol 'b'\n"
+        "test.s:3:17: Error: Unresolved symbol 'a'\n"
+        "test.s:4:18: Error: Unresolved symbol 'a'\n"
+        "test.s:2:17: Error: Unresolved symbol 'c'\n"
+        "test.s:5:17: Error: Unresolved symbol 'd'\n"
+        "test.s:2:17: Error: Circular dependency: b -> c -> a -> b\n"
+        "test.s:5:17: Error: Circular dependency: d -> d\n", ""
+    },
+    /* 1 - symbols depending on cycle are not reported as cycle */
+    {   R"ffDXD(            x = y+1
+            y = a*2
+            a = b+1
+            b = a
+            z = 3
+            .int x, z)ffDXD",
+        BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, false, { },
+        { { nullptr, ASMKERN_GLOBAL, AsmSectionType::DATA,
+            { 0, 0, 0, 0, 3, 0, 0, 0 } } },
+        {
+            { ".", 8U, 0, 0U, true, false, false, 0, 0 },
+            { "a", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "b", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "x", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "y", 0U, ASMSECT_ABS, 0U, false, false, false, 0, 0 },
+            { "z", 3U, ASMSECT_ABS, 0U, true, false, false, 0, 0 }
+        },
+        false, "test.s:1:17: Error: Unresolved symbol 'y'\n"
+        "test.s:6:18: Error: Unresolved symbol 'x'\n"
+        "test.s:2:17: Error: Unresolved symbol 'a'\n"
+        "test.s:4:17: Error: Unresolved symbol 'a'\n"
+        "test.s:3:17: Error: Unresolved symbol 'b'\n"
+        "test.s:3:17: Error: Circular dependency: a -> b -> a\n", ""
+    },
     { nullptr }
 };
@@ -0,0 +1,299 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#ifdef HAVE_WINDOWS
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+// directory of cache and files used by tests (created in working directory)
+static const char* cacheDir = "AsmBinaryCacheTest";
+
+static const char* cacheTestSource =
+        ".include \"incbc.s\"\n"
+        ".incbin \"binbc.bin\"\n"
+        ".byte 300\n";
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream ofs(path.c_str(), std::ios::binary);
+    ofs.write(content.data(), content.size());
+    if (!ofs)
+        throw Exception("Can't write test file");
+}
+
+static AsmBinaryCache::Key computeTestKey(const char* source,
+            GPUDeviceType deviceType = GPUDeviceType::CAPE_VERDE, bool is64Bit = false,
+            Flags flags = ASM_WARNINGS, cxuint policyVersion = ASM_POLICY_DEFAULT,
+            const std::vector<CString>& includeDirs = { cacheDir },
+            const std::vector<std::pair<CString, uint64_t> >& defSyms = { })
+{
+    return AsmBinaryCache::computeKey(::strlen(source), source, BinaryFormat::RAWCODE,
+            deviceType, is64Bit, flags, policyVersion, 0, 0, includeDirs, defSyms);
+}
+
+static void testComputeKey()
+{
+    const AsmBinaryCache::Key key = computeTestKey(cacheTestSource);
+    assertTrue("computeKey", "same", key == computeTestKey(cacheTestSource));
+    assertTrue("computeKey", "source", key != computeTestKey(".byte 300\n"));
+    assertTrue("computeKey", "deviceType",
+            key != computeTestKey(cacheTestSource, GPUDeviceType::BONAIRE));
+    assertTrue("computeKey", "64bit",
+            key != computeTestKey(cacheTestSource, GPUDeviceType::CAPE_VERDE, true));
+    assertTrue("computeKey", "flags", key != computeTestKey(cacheTestSource,
+            GPUDeviceType::CAPE_VERDE, false, 0));
+    assertTrue("computeKey", "policy", key != computeTestKey(cacheTestSource,
+            GPUDeviceType::CAPE_VERDE, false, ASM_WARNINGS, 100));
+    assertTrue("computeKey", "includeDirs", key != computeTestKey(cacheTestSource,
+            GPUDeviceType::CAPE_VERDE, false, ASM_WARNINGS, ASM_POLICY_DEFAULT,
+            { cacheDir, "otherDir" }));
+    assertTrue("computeKey", "defSyms", key != computeTestKey(cacheTestSource,
+            GPUDeviceType::CAPE_VERDE, false, ASM_WARNINGS, ASM_POLICY_DEFAULT,
+            { cacheDir }, { { "x", 1 } }));
+    // strings are separated by its sizes
+    assertTrue("computeKey", "includeDirsSplit", computeTestKey(cacheTestSource,
+            GPUDeviceType::CAPE_VERDE, false, ASM_WARNINGS, ASM_POLICY_DEFAULT,
+            { "ab", "c" }) != computeTestKey(cacheTestSource, GPUDeviceType::CAPE_VERDE,
+            false, ASM_WARNINGS, ASM_POLICY_DEFAULT, { "a", "bc" }));
+}
+
+// assemble test source with tracking of file dependencies
+static Array<cxbyte> assembleTestSource(std::vector<AsmFileDependency>& fileDeps,
+            std::string& messages)
+{
+    std::ostringstream msgStream;
+    Assembler assembler("", ::strlen(cacheTestSource), cacheTestSource, ASM_WARNINGS,
+            BinaryFormat::RAWCODE, GPUDeviceType::CAPE_VERDE, msgStream);
+    assembler.addIncludeDir(cacheDir);
+    assembler.setFileDepsTracking(true);
+    if (!assembler.assemble())
+        throw Exception("Assembling failed");
+    Array<cxbyte> binary;
+    assembler.writeBinary(binary);
+    fileDeps = assembler.getFileDependencies();
+    messages = msgStream.str();
+    return binary;
+}
+
+static void testStoreAndLoad()
+{
+    AsmBinaryCache cache(cacheDir);
+    assertTrue("binCache", "dirCreated", isDirectory(cacheDir));
+    const std::string incPath = joinPaths(cacheDir, "incbc.s");
+    const std::string binPath = joinPaths(cacheDir, "binbc.bin");
+    writeFile(incPath, ".byte 1, 2\n");
+    writeFile(binPath, "abc");
+    
+    const AsmBinaryCache::Key key = computeTestKey(cacheTestSource);
+    std::remove(cache.getEntryPath(key).c_str());
+    Array<cxbyte> binary;
+    std::string messages;
+    assertTrue("binCache", "emptyMiss", !cache.load(key, binary, messages));
+    
+    std::vector<AsmFileDependency> fileDeps;
+    std::string asmMessages;
+    const Array<cxbyte> asmBinary = assembleTestSource(fileDeps, asmMessages);
+    assertValue("binCache", "binarySize", size_t(6), asmBinary.size());
+    // files are searched in working directory before include directory
+    assertValue("binCache", "fileDepsNum", size_t(4), fileDeps.size());
+    assertString("binCache", "fileDep0", "incbc.s", fileDeps[0].path);
+    assertTrue("binCache", "fileDep0Missing", fileDeps[0].missing);
+    assertString("binCache", "fileDep1", incPath.c_str(), fileDeps[1].path);
+    assertTrue("binCache", "fileDep1Regular", fileDeps[1].regular);
+    assertTrue("binCache", "fileDep1NotMissing", !fileDeps[1].missing);
+    assertString("binCache", "fileDep2", "binbc.bin", fileDeps[2].path);
+    assertTrue("binCache", "fileDep2Missing", fileDeps[2].missing);
+    assertString("binCache", "fileDep3", binPath.c_str(), fileDeps[3].path);
+    assertTrue("binCache", "fileDep3Regular", fileDeps[3].regular);
+    assertTrue("binCache", "fileDep3NotMissing", !fileDeps[3].missing);
+    assertTrue("binCache", "store", cache.store(key, fileDeps, asmBinary, asmMessages));
+    
+    assertTrue("binCache", "hit", cache.load(key, binary, messages));
+    assertArray("binCache", "binary", asmBinary, binary);
+    assertString("binCache", "messages",
+            "<stdin>:3:7: Warning: Value 0x12c truncated to 0x2c\n", messages);
+    // rewritten files with same content
+    writeFile(incPath, ".byte 1, 2\n");
+    assertTrue("binCache", "hitSameContent", cache.load(key, binary, messages));
+    
+    // changed included file and binary file
+    writeFile(incPath, ".byte 1, 3\n");
+    assertTrue("binCache", "missChangedInclude", !cache.load(key, binary, messages));
+    writeFile(incPath, ".byte 1, 2\n");
+    assertTrue("binCache", "hitRestoredInclude", cache.load(key, binary, messages));
+    writeFile(binPath, "abd");
+    assertTrue("binCache", "missChangedBinFile", !cache.load(key, binary, messages));
+    writeFile(binPath, "abc");
+    std::remove(incPath.c_str());
+    assertTrue("binCache", "missRemovedInclude", !cache.load(key, binary, messages));
+    writeFile(incPath, ".byte 1, 2\n");
+    // new files in working directory shadow files in include directory
+    writeFile("incbc.s", ".byte 1, 2\n");
+    assertTrue("binCache", "missShadowedInclude", !cache.load(key, binary, messages));
+    std::remove("incbc.s");
+    writeFile("binbc.bin", "abc");
+    assertTrue("binCache", "missShadowedBinFile", !cache.load(key, binary, messages));
+    std::remove("binbc.bin");
+    assertTrue("binCache", "hitNotShadowed", cache.load(key, binary, messages));
+    
+    // other key
+    assertTrue("binCache", "missOtherKey", !cache.load(computeTestKey(cacheTestSource,
+                GPUDeviceType::BONAIRE), binary, messages));
+    
+    // corrupted (truncated) entry
+    {
+        Array<cxbyte> content = loadDataFromFile(cache.getEntryPath(key).c_str());
+        writeFile(cache.getEntryPath(key), std::string((const char*)content.data(),
+                content.size()-5));
+    }
+    assertTrue("binCache", "missCorrupted", !cache.load(key, binary, messages));
+    assertTrue("binCache", "storeAgain",
+            cache.store(key, fileDeps, asmBinary, asmMessages));
+    assertTrue("binCache", "hitAgain", cache.load(key, binary, messages));
+    
+    // entries with non-regular dependencies are not stored
+    std::vector<AsmFileDependency> pipeDeps = fileDeps;
+    pipeDeps.push_back({ "somepipe", false, 0, false });
+    const AsmBinaryCache::Key pipeKey = computeTestKey(".byte 1\n");
+    std::remove(cache.getEntryPath(pipeKey).c_str());
+    assertTrue("binCache", "notStoredPipe",
+            !cache.store(pipeKey, pipeDeps, asmBinary, asmMessages));
+    assertTrue("binCache", "missPipe", !cache.load(pipeKey, binary, messages));
+}
+
+static void changeDir(const char* path)
+{
+#ifdef HAVE_WINDOWS
+    if (_chdir(path) != 0)
+#else
+    if (::chdir(path) != 0)
+#endif
+        throw Exception("Can't change working directory");
+}
+
+// entry stored in one working directory and checked in other working directory
+static void testOtherWorkingDir()
+{
+    const std::string absCacheDir = getAbsolutePath(cacheDir);
+    AsmBinaryCache cache(absCacheDir.c_str());
+    const std::string incPath = joinPaths(absCacheDir, "incbc.s");
+    writeFile(incPath, ".byte 1, 2\n");
+    writeFile(joinPaths(absCacheDir, "binbc.bin"), "abc");
+    
+    const AsmBinaryCache::Key key = computeTestKey(cacheTestSource);
+    std::vector<AsmFileDependency> fileDeps;
+    std::string asmMessages;
+    const Array<cxbyte> asmBinary = assembleTestSource(fileDeps, asmMessages);
+    // paths of dependencies are relative to working directory
+    assertTrue("binCacheWorkDir", "relativeDep", fileDeps[1].path[0] != '/');
+    assertTrue("binCacheWorkDir", "store",
+            cache.store(key, fileDeps, asmBinary, asmMessages));
+    
+    changeDir(cacheDir);
+    Array<cxbyte> binary;
+    std::string messages;
+    try
+    {
+        // relative include paths point to other files
+        assertTrue("binCacheWorkDir", "otherKey",
+                    key != computeTestKey(cacheTestSource));
+        // stored dependencies are absolute paths
+        assertTrue("binCacheWorkDir", "hit", cache.load(key, binary, messages));
+        assertArray("binCacheWorkDir", "binary", asmBinary, binary);
+        writeFile(incPath, ".byte 1, 3\n");
+        assertTrue("binCacheWorkDir", "missChangedInclude",
+                    !cache.load(key, binary, messages));
+        writeFile(incPath, ".byte 1, 2\n");
+    }
+    catch(...)
+    {
+        changeDir("..");
+        throw;
+    }
+    changeDir("..");
+    assertTrue("binCacheWorkDir", "sameKey", key == computeTestKey(cacheTestSource));
+}
+
+// many threads store and load this same entry (temporary files must be unique)
+static void testConcurrentStores()
+{
+    AsmBinaryCache cache(cacheDir);
+    const AsmBinaryCache::Key key = computeTestKey(".byte 7\n");
+    std::remove(cache.getEntryPath(key).c_str());
+    const std::vector<AsmFileDependency> fileDeps;
+    Array<cxbyte> storedBinary(4096);
+    for (size_t i = 0; i < storedBinary.size(); i++)
+        storedBinary[i] = i*7;
+    const std::string storedMessages = "message\n";
+    
+    bool failed[4] = { };
+    std::vector<std::thread> threads;
+    for (cxuint t = 0; t < 4; t++)
+        threads.push_back(std::thread([&cache, &key, &fileDeps, &storedBinary,
+                    &storedMessages, &failed, t]()
+        {
+            try
+            {
+                for (cxuint i = 0; i < 20; i++)
+                {
+                    cache.store(key, fileDeps, storedBinary, storedMessages);
+                    Array<cxbyte> binary;
+                    std::string messages;
+                    if (!cache.load(key, binary, messages) ||
+                        binary.size() != storedBinary.size() ||
+                        !std::equal(binary.begin(), binary.end(), storedBinary.begin()) ||
+                        messages != storedMessages)
+                        failed[t] = true;
+                }
+            }
+            catch(const std::exception& ex)
+            { failed[t] = true; }
+        }));
+    for (std::thread& thread: threads)
+        thread.join();
+    for (cxuint t = 0; t < 4; t++)
+        assertTrue("binCacheConcurrent", "thread", !failed[t]);
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    retVal |= callTest(testComputeKey);
+    retVal |= callTest(testStoreAndLoad);
+    retVal |= callTest(testOtherWorkingDir);
+    retVal |= callTest(testConcurrentStores);
+    return retVal;
+}
@@ -22,11 +22,19 @@
 #include <string>
 #include <cstring>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <vector>
 #include <CLRX/amdasm/Assembler.h>
 #include "../TestUtils.h"
 
 using namespace CLRX;
 
+// number of heap allocations (counted for benchmark, defined in AsmHeapCount.cpp)
+size_t getHeapAllocsNum();
+
 struct AsmExprParseCase
 {
     const char* expression;
@@ -483,8 +491,9 @@ static std::string rpnExpression(const AsmExpression* expr)
     std::ostringstream oss;
     const AsmExprArg* args = expr->getArgs();
     bool first = true;
-    for (AsmExprOp op: expr->getOps())
+    for (size_t i = 0; i < expr->getOpsNum(); i++)
     {
+        const AsmExprOp op = expr->getOps()[i];
         if (!first)
             oss << ' ';
         first = false;
@@ -675,9 +684,102 @@ static void testFastExprEval(cxuint i, const FastExprEvalCase& testCase)
     assertString(testName, "extra", testCase.extra, resExtra);
 }
 
+// copy of symbol must not refer to memory pool of assembler (it can outlive assembler)
+static void testSymbolCopy()
+{
+    const char* source = ".int a+b*a\n.int a-1\n";
+    std::ostringstream errorStream;
+    std::unique_ptr<Assembler> assembler(new Assembler("test.s", ::strlen(source),
+                source, ASM_WARNINGS, BinaryFormat::RAWCODE, GPUDeviceType::CAPE_VERDE,
+                errorStream));
+    assembler->assemble();
+    AsmSymbolMap::const_iterator symIt = assembler->getSymbolMap().find("a");
+    assertTrue("SymbolCopy", "symbolFound", symIt != assembler->getSymbolMap().end());
+    const AsmSymbol& symbol = symIt->second;
+    assertValue("SymbolCopy", "occurrencesNum", size_t(3),
+                symbol.occurrencesInExprs.size());
+    assertTrue("SymbolCopy", "origPool", symbol.occurrencesInExprs.getPool() != nullptr);
+    const std::vector<AsmExprSymbolOccurrence> expected(
+            symbol.occurrencesInExprs.begin(), symbol.occurrencesInExprs.end());
+    AsmSymbol symCopy(symbol);
+    AsmSymbol symCopy2;
+    symCopy2 = symbol;
+    assertTrue("SymbolCopy", "copyPool", symCopy.occurrencesInExprs.getPool() == nullptr);
+    assertTrue("SymbolCopy", "copy2Pool",
+               symCopy2.occurrencesInExprs.getPool() == nullptr);
+    assertTrue("SymbolCopy", "copyStorage",
+               symCopy.occurrencesInExprs.begin() != symbol.occurrencesInExprs.begin());
+    // copies must hold own elements after destroying assembler and its pool
+    assembler.reset();
+    // fill freed memory by new allocations
+    std::vector<std::unique_ptr<char[]> > fillers;
+    for (cxuint i = 0; i < 64; i++)
+    {
+        fillers.push_back(std::unique_ptr<char[]>(new char[64]));
+        std::fill(fillers.back().get(), fillers.back().get()+64, char(0xaa));
+    }
+    assertValue("SymbolCopy", "copyOccurrencesNum", expected.size(),
+                symCopy.occurrencesInExprs.size());
+    assertValue("SymbolCopy", "copy2OccurrencesNum", expected.size(),
+                symCopy2.occurrencesInExprs.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        assertTrue("SymbolCopy", "copyOccurrence",
+                   symCopy.occurrencesInExprs[i] == expected[i]);
+        assertTrue("SymbolCopy", "copy2Occurrence",
+                   symCopy2.occurrencesInExprs[i] == expected[i]);
+    }
+    // expressions have been freed with assembler
+    symCopy.occurrencesInExprs.clear();
+    symCopy2.occurrencesInExprs.clear();
+}
+
+/* benchmark: assemble forward-referencing expressions and symbol assignments
+ * (scale*10000 expressions), print time and number of heap allocations */
+static void benchmarkExprAssembling(cxuint scale)
+{
+    const size_t exprsNum = size_t(scale)*10000;
+    std::string source;
+    for (size_t i = 0; i < exprsNum; i++)
+        source += ".int x" + std::to_string(i) + "+y" + std::to_string(i) + "*3-" +
+                std::to_string(i) + "\n";
+    for (size_t i = 0; i < exprsNum; i++)
+        source += "x" + std::to_string(i) + "=y" + std::to_string(i) + "+" +
+                std::to_string(i&255) + "\ny" + std::to_string(i) + "=" +
+                std::to_string(i) + "\n";
+    double bestTime = 1e30;
+    size_t allocsNum = 0;
+    for (cxuint k = 0; k < 5; k++)
+    {
+        std::ostringstream errorStream;
+        const size_t startAllocsNum = getHeapAllocsNum();
+        auto startTime = std::chrono::steady_clock::now();
+        {
+            Assembler assembler("test.s", source.size(), source.c_str(), ASM_WARNINGS,
+                    BinaryFormat::RAWCODE, GPUDeviceType::CAPE_VERDE, errorStream);
+            assembler.assemble();
+        }
+        bestTime = std::min(bestTime, std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - startTime).count());
+        allocsNum = getHeapAllocsNum() - startAllocsNum;
+    }
+    std::cout << "Expressions (scale " << scale << "): " << bestTime*1000.0 <<
+            " ms, heap allocations: " << allocsNum << std::endl;
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    if (scale > 1)
+    {
+        benchmarkExprAssembling(scale);
+        return 0;
+    }
+    
     for (cxuint i = 0; i < sizeof(asmExprParseCases)/sizeof(AsmExprParseCase); i++)
     {
         try
@@ -705,5 +807,12 @@ int main(int argc, const char** argv)
             retVal = 1;
         }
     
+    try
+    { testSymbolCopy(); }
+    catch(const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        retVal = 1;
+    }
     return retVal;
 }
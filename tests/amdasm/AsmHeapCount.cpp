@@ -0,0 +1,80 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/* replaced allocation and deallocation functions that count heap allocations
+ * (for benchmarks). all replaceable functions (also array, nothrow and sized)
+ * are replaced, hence every deallocation matches its allocation. they are defined
+ * in separate source, because inlined deallocation by 'free' is reported by
+ * compiler as mismatched with 'operator new' */
+
+static size_t heapAllocsNum = 0;
+
+size_t getHeapAllocsNum()
+{ return heapAllocsNum; }
+
+static inline void* countedAlloc(size_t size) noexcept
+{
+    heapAllocsNum++;
+    return ::malloc(size != 0 ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = countedAlloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    void* ptr = countedAlloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{ return countedAlloc(size); }
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{ return countedAlloc(size); }
+
+void operator delete(void* ptr) noexcept
+{ ::free(ptr); }
+
+void operator delete[](void* ptr) noexcept
+{ ::free(ptr); }
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{ ::free(ptr); }
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{ ::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept
+{ ::free(ptr); }
+
+void operator delete[](void* ptr, size_t) noexcept
+{ ::free(ptr); }
@@ -0,0 +1,246 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include <CLRX/utils/Containers.h>
+#include "../TestUtils.h"
+#include "AsmRegAlloc.h"
+
+using namespace CLRX;
+
+typedef AsmRegAllocator::OutLiveness OutLiveness;
+typedef AsmRegAllocator::InterGraph InterGraph;
+
+// check graph with and without bit-matrix (for random edges)
+static void testInterGraphRandom(size_t nodesNum, size_t edgesNum)
+{
+    std::ostringstream oss;
+    oss << "InterGraphRandom(" << nodesNum << "," << edgesNum << ")";
+    const std::string testName = oss.str();
+    
+    std::mt19937 rng(nodesNum);
+    std::vector<std::pair<size_t, size_t> > edges;
+    AsmInterGraph graph;
+    graph.reset(nodesNum);
+    assertValue(testName, "hasBitMatrix",
+                nodesNum <= AsmInterGraph::maxBitMatrixNodes, graph.hasBitMatrix());
+    for (size_t i = 0; i < edgesNum; i++)
+    {
+        size_t a = rng() % nodesNum;
+        size_t b = rng() % (nodesNum-1);
+        if (b >= a)
+            b++;
+        graph.addEdge(a, b);
+        // add duplicate (reversed)
+        graph.addEdge(b, a);
+        edges.push_back(std::make_pair(std::max(a, b), std::min(a, b)));
+    }
+    graph.finish();
+    std::sort(edges.begin(), edges.end());
+    edges.resize(std::unique(edges.begin(), edges.end()) - edges.begin());
+    
+    assertValue(testName, "edgesNum", edges.size(), graph.getEdgesNum());
+    std::vector<size_t> degrees(nodesNum);
+    for (const auto& edge: edges)
+    {
+        assertTrue(testName, "isEdge", graph.isEdge(edge.first, edge.second));
+        assertTrue(testName, "isEdge2", graph.isEdge(edge.second, edge.first));
+        degrees[edge.first]++;
+        degrees[edge.second]++;
+    }
+    for (size_t i = 0; i < nodesNum; i++)
+    {
+        const AsmInterGraph::Neighbors nbs = graph[i];
+        assertValue(testName, "degree", degrees[i], nbs.size());
+        for (size_t nb: nbs)
+            assertTrue(testName, "isEdgeNb", graph.isEdge(i, nb));
+    }
+    // check some non-edges
+    for (size_t i = 0; i < edgesNum; i++)
+    {
+        const size_t a = rng() % nodesNum;
+        const size_t b = rng() % nodesNum;
+        const bool expected = a!=b && std::binary_search(edges.begin(), edges.end(),
+                    std::make_pair(std::max(a, b), std::min(a, b)));
+        assertValue(testName, "isEdgeRandom", expected, graph.isEdge(a, b));
+    }
+}
+
+static bool isLiveOverlap(const OutLiveness& lv1, const OutLiveness& lv2)
+{
+    for (const auto& b1: lv1)
+        for (const auto& b2: lv2)
+            if (b1.first != b1.second && b2.first != b2.second &&
+                b1.first < b2.second && b2.first < b1.second)
+                return true;
+    return false;
+}
+
+/* create interference graphs for register allocator testcases.
+ * if scale is 1, then check graphs (compare with overlapping of livenesses),
+ * otherwise livenesses are repeated 'scale' times (every copy overlaps with half of
+ * previous copy) and time of creating and coloring interference graph is measured */
+static void testInterGraphCase(const char* suiteName, cxuint i,
+            const char* inputStr, cxuint scale, double& totalTime,
+            double& totalColorTime)
+{
+    std::istringstream input(inputStr);
+    std::ostringstream errorStream;
+    
+    Assembler assembler("test.s", input,
+                    (ASM_ALL&~ASM_ALTMACRO) | ASM_TESTRUN | ASM_TESTRESOLVE,
+                    BinaryFormat::RAWCODE, GPUDeviceType::CAPE_VERDE, errorStream);
+    if (!assembler.assemble() || assembler.getSections().size()<1)
+        return; // skip failed testcases
+    const AsmSection& section = assembler.getSections()[0];
+    if (section.getSize() == 0)
+        return; // skip empty code
+    
+    AsmRegAllocator regAlloc(assembler);
+    regAlloc.createCodeStructure(section.codeFlow, section.getSize(),
+                            section.content.data());
+    regAlloc.createSSAData(*section.usageHandler, *section.linearDepHandler);
+    regAlloc.applySSAReplaces();
+    regAlloc.createLivenesses(*section.usageHandler, *section.linearDepHandler);
+    
+    Array<OutLiveness> livenesses[MAX_REGTYPES_NUM];
+    const size_t shift = std::max(section.getSize()>>1, size_t(1));
+    for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+    {
+        const Array<OutLiveness>& lvs = regAlloc.getOutLivenesses()[r];
+        livenesses[r].resize(lvs.size()*scale);
+        for (size_t k = 0; k < scale; k++)
+            for (size_t li = 0; li < lvs.size(); li++)
+            {
+                OutLiveness& lv = livenesses[r][k*lvs.size() + li];
+                lv = lvs[li];
+                for (auto& blk: lv)
+                {
+                    blk.first += k*shift;
+                    blk.second += k*shift;
+                }
+            }
+    }
+    
+    // create interference graph from repeated livenesses
+    AsmRegAllocator regAlloc2(assembler, livenesses);
+    auto startTime = std::chrono::steady_clock::now();
+    regAlloc2.createInterferenceGraph();
+    auto graphTime = std::chrono::steady_clock::now();
+    regAlloc2.colorInterferenceGraph();
+    totalTime += std::chrono::duration<double>(graphTime - startTime).count();
+    totalColorTime += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - graphTime).count();
+    
+    const InterGraph* interGraphs = regAlloc2.getInterGraphs();
+    const Array<cxuint>* graphColorMaps = regAlloc2.getGraphColorMaps();
+    std::ostringstream oss;
+    oss << suiteName << "#" << i;
+    const std::string testName = oss.str();
+    // check coloring: neighbors have different colors
+    for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+    {
+        const InterGraph& interGraph = interGraphs[r];
+        const Array<cxuint>& gcMap = graphColorMaps[r];
+        assertValue(testName, "gcMap.size", interGraph.size(), gcMap.size());
+        for (size_t a = 0; a < interGraph.size(); a++)
+        {
+            // DSatur does not use more colors than degree+1
+            assertTrue(testName, "colorLimit", gcMap[a] <= interGraph[a].size());
+            for (size_t b: interGraph[a])
+                assertTrue(testName, "color", gcMap[a] != gcMap[b]);
+        }
+    }
+    if (scale > 1)
+        return;
+    
+    for (size_t r = 0; r < MAX_REGTYPES_NUM; r++)
+    {
+        const InterGraph& interGraph = interGraphs[r];
+        const Array<OutLiveness>& lvs = livenesses[r];
+        assertValue(testName, "nodesNum", lvs.size(), interGraph.size());
+        for (size_t a = 0; a < lvs.size(); a++)
+        {
+            size_t degree = 0;
+            for (size_t b = 0; b < lvs.size(); b++)
+            {
+                const bool expected = a!=b && isLiveOverlap(lvs[a], lvs[b]);
+                assertValue(testName, "isEdge", expected, interGraph.isEdge(a, b));
+                if (expected)
+                    degree++;
+            }
+            assertValue(testName, "degree", degree, interGraph[a].size());
+        }
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    
+    if (scale == 1)
+    {
+        const std::pair<size_t, size_t> randomCases[] = {
+            { 2, 1 }, { 70, 300 }, { 1000, 20000 },
+            { AsmInterGraph::maxBitMatrixNodes+100, 50000 } };
+        for (const auto& rcase: randomCases)
+            try
+            { testInterGraphRandom(rcase.first, rcase.second); }
+            catch(const std::exception& ex)
+            {
+                std::cerr << ex.what() << std::endl;
+                retVal = 1;
+            }
+    }
+    
+    double totalTime = 0.0;
+    double totalColorTime = 0.0;
+    const std::pair<const char*, const AsmSSADataCase*> suites[] = {
+        { "ssaData1", ssaDataTestCases1Tbl }, { "ssaData2", ssaDataTestCases2Tbl },
+        { "ssaData3", ssaDataTestCases3Tbl } };
+    for (const auto& suite: suites)
+        for (size_t i = 0; suite.second[i].input!=nullptr; i++)
+            try
+            { testInterGraphCase(suite.first, i, suite.second[i].input,
+                        scale, totalTime, totalColorTime); }
+            catch(const std::exception& ex)
+            {
+                std::cerr << ex.what() << std::endl;
+                retVal = 1;
+            }
+    if (scale > 1)
+        std::cout << "Interference graphs (scale " << scale << "): " <<
+                totalTime*1000.0 << " ms, coloring: " <<
+                totalColorTime*1000.0 << " ms" << std::endl;
+    return retVal;
+}
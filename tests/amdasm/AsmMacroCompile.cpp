@@ -0,0 +1,206 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include <CLRX/utils/Containers.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+static const char* macroArgNames[4] = { "a", "bb", "c_d", "x1" };
+
+// pieces of macro body: arguments, separators, counters, unknown names,
+// comments and line joins (that give column translations)
+static const char* bodyPieces[] =
+{
+    "\\a", "\\bb", "\\c_d", "\\x1", "\\x12", "\\()", "\\@", "\\zz", "\\\\", "\\",
+    "s_mov_b32 ", "v0", ", ", "  ", "lbl:", ";", "\"str \\a\"", "/* c */",
+    "/* c\n d */", "\\\n", "\n", "\n\n"
+};
+
+/* build two macros from this same body: first is compiled,
+ * second is not compiled (expanded by scanning its content) */
+static void buildMacros(Assembler& assembler, const std::string& body,
+            RefPtr<const AsmMacro>& compiled, RefPtr<const AsmMacro>& scanned)
+{
+    Array<AsmMacroArg> args(4);
+    for (cxuint i = 0; i < 4; i++)
+        args[i] = { macroArgNames[i], "", false, false };
+    compiled = RefPtr<const AsmMacro>(new AsmMacro(AsmSourcePos(), args));
+    scanned = RefPtr<const AsmMacro>(new AsmMacro(AsmSourcePos(), args));
+    AsmStreamInputFilter filter(body.size(), body.c_str(), "body.s");
+    size_t lineSize = 0;
+    const char* line;
+    while ((line = filter.readLine(assembler, lineSize)) != nullptr)
+    {
+        compiled.constCast<AsmMacro>()->addLine(filter.getMacroSubst(),
+                    filter.getSource(), filter.getColTranslations(), lineSize, line);
+        scanned.constCast<AsmMacro>()->addLine(filter.getMacroSubst(),
+                    filter.getSource(), filter.getColTranslations(), lineSize, line);
+    }
+    compiled.constCast<AsmMacro>()->compile();
+}
+
+static AsmMacroInputFilter::MacroArgMap makeArgMap(const std::string* values)
+{
+    AsmMacroInputFilter::MacroArgMap argMap(4);
+    for (cxuint i = 0; i < 4; i++)
+        argMap[i] = std::make_pair(CString(macroArgNames[i]), CString(values[i]));
+    mapSort(argMap.begin(), argMap.end());
+    return argMap;
+}
+
+// compare lines, column translations, line numbers and sources of both expansions
+static void testMacroExpansion(Assembler& assembler, cxuint testId,
+            const std::string& body, const std::string* values, uint64_t macroCount)
+{
+    std::ostringstream oss;
+    oss << "macroCompile#" << testId;
+    const std::string testName = oss.str();
+
+    RefPtr<const AsmMacro> compiled, scanned;
+    buildMacros(assembler, body, compiled, scanned);
+    AsmMacroInputFilter compFilter(compiled, AsmSourcePos(), makeArgMap(values),
+                macroCount, false);
+    AsmMacroInputFilter scanFilter(scanned, AsmSourcePos(), makeArgMap(values),
+                macroCount, false);
+    for (cxuint l = 0; ; l++)
+    {
+        std::ostringstream lineOss;
+        lineOss << "line#" << l;
+        const std::string lineName = lineOss.str();
+        size_t compSize = 0, scanSize = 0;
+        const char* compLine = compFilter.readLine(assembler, compSize);
+        const char* scanLine = scanFilter.readLine(assembler, scanSize);
+        assertValue(testName, lineName+".end", scanLine==nullptr, compLine==nullptr);
+        if (scanLine == nullptr)
+            break;
+        assertString(testName, lineName, std::string(scanLine, scanSize).c_str(),
+                    std::string(compLine, compSize));
+        assertValue(testName, lineName+".lineNo", scanFilter.getLineNo(),
+                    compFilter.getLineNo());
+        const std::vector<LineTrans> compTrans = compFilter.getColTranslations();
+        const std::vector<LineTrans> scanTrans = scanFilter.getColTranslations();
+        assertValue(testName, lineName+".colTransSize", scanTrans.size(),
+                    compTrans.size());
+        for (size_t i = 0; i < scanTrans.size(); i++)
+        {
+            std::ostringstream transOss;
+            transOss << lineName << ".colTrans#" << i;
+            assertValue(testName, transOss.str()+".pos", scanTrans[i].position,
+                        compTrans[i].position);
+            assertValue(testName, transOss.str()+".lineNo", scanTrans[i].lineNo,
+                        compTrans[i].lineNo);
+        }
+        // sources are macro sources of different macros with this same source
+        RefPtr<const AsmSource> compSource = compFilter.getSource();
+        RefPtr<const AsmSource> scanSource = scanFilter.getSource();
+        assertTrue(testName, lineName+".source", compSource->type == scanSource->type);
+        if (scanSource->type == AsmSourceType::MACRO)
+            assertTrue(testName, lineName+".source",
+                    compSource.staticCast<const AsmMacroSource>()->source ==
+                    scanSource.staticCast<const AsmMacroSource>()->source);
+    }
+}
+
+static void testMacroCompileRandom(Assembler& assembler, cxuint casesNum)
+{
+    std::mt19937 rng(casesNum);
+    const cxuint piecesNum = sizeof(bodyPieces)/sizeof(const char*);
+    const char* valuePieces[] = { "", "v1", "s[2:3]", "x y", "\\a", "0x10" };
+    for (cxuint testId = 0; testId < casesNum; testId++)
+    {
+        std::string body;
+        const cxuint bodyPiecesNum = rng()%40;
+        for (cxuint i = 0; i < bodyPiecesNum; i++)
+            body += bodyPieces[rng()%piecesNum];
+        body += '\n';
+        std::string values[4];
+        for (cxuint i = 0; i < 4; i++)
+            values[i] = valuePieces[rng()%(sizeof(valuePieces)/sizeof(const char*))];
+        testMacroExpansion(assembler, testId, body, values, rng()%100000);
+    }
+}
+
+// expand this same macro many times by compiled and by scanning expansion
+static void benchmarkMacroExpansion(Assembler& assembler, size_t expansionsNum)
+{
+    RefPtr<const AsmMacro> compiled, scanned;
+    buildMacros(assembler, "    v_add_f32 \\a, \\bb, \\c_d   # first line\n"
+            "    s_mov_b32 s\\x1, \\a\\()_\\@\n", compiled, scanned);
+    const std::string values[4] = { "v1", "v2", "v3", "10" };
+    const AsmMacroInputFilter::MacroArgMap argMap = makeArgMap(values);
+    const RefPtr<const AsmMacro> macros[2] = { scanned, compiled };
+    double times[2];
+    size_t totalSizes[2] = { 0, 0 };
+    for (cxuint m = 0; m < 2; m++)
+    {
+        const std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+        for (size_t i = 0; i < expansionsNum; i++)
+        {
+            AsmMacroInputFilter filter(macros[m], AsmSourcePos(), argMap, i, false);
+            size_t lineSize = 0;
+            while (filter.readLine(assembler, lineSize) != nullptr)
+                totalSizes[m] += lineSize;
+        }
+        times[m] = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+    assertValue("macroBench", "totalSize", totalSizes[0], totalSizes[1]);
+    std::cout << "Macro expansions (" << expansionsNum << "): scanning " <<
+            times[0]*1000.0 << " ms, compiled " << times[1]*1000.0 << " ms" << std::endl;
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+
+    std::istringstream input("");
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, ASM_ALL&~ASM_ALTMACRO,
+                    BinaryFormat::RAWCODE, GPUDeviceType::BONAIRE, errorStream);
+    try
+    {
+        if (scale == 1)
+            testMacroCompileRandom(assembler, 3000);
+        else
+            // scale 10 gives 1M expansions
+            benchmarkMacroExpansion(assembler, size_t(100000)*scale);
+    }
+    catch(const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        retVal = 1;
+    }
+    return retVal;
+}
@@ -23,6 +23,7 @@
 #include <CLRX/Config.h>
 #include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <cstring>
 #include <CLRX/utils/Utilities.h>
@@ -94,6 +95,42 @@ struct AsmSSADataCase
     const char* errorMessages;
 };
 
+/* generate kernel with 'fillNum' registers (SGPRs or VGPRs by regType) live in
+ * whole code and three registers (a, b, c) which interfere in pairs in three code
+ * blocks (triangle). at most two registers are live at same time besides
+ * filling registers. occupancyOp is put before kernel */
+static inline std::string generateSplitKernel(cxuint fillNum, char regType = 's',
+            const char* occupancyOp = "")
+{
+    const bool vector = (regType == 'v');
+    const char* movInstr = vector ? "v_mov_b32 " : "s_mov_b32 ";
+    const char* cmpInstr = vector ? "v_cmp_eq_u32 vcc, " : "s_cmp_eq_u32 ";
+    std::ostringstream oss;
+    oss << ".amdcl2\n.gpu Bonaire\n" << occupancyOp <<
+        ".kernel k0\n.config\n.dims x\n.text\n"
+        ".regvar f:" << regType << ":" << fillNum << ", a:" << regType <<
+        ", b:" << regType << ", c:" << regType << "\n";
+    for (cxuint i = 0; i < fillNum; i++)
+        oss << movInstr << "f[" << i << "], " << i << "\n";
+    oss << movInstr << "a, 1\n" << movInstr << "b, 2\n" <<
+        (vector ? "s_cmp_eq_u32 s0, s1\n" : "s_cmp_eq_u32 f[0], f[1]\n") <<
+        "s_cbranch_scc1 lc\n" <<
+        // b and c are live
+        movInstr << "c, 5\n" << cmpInstr << "b, c\n"
+        "s_branch ld\n"
+        "lc:\n" <<
+        // a and c are live
+        movInstr << "c, 3\n" << cmpInstr << "a, c\n"
+        "ld:\n";
+    for (cxuint i = 0; i < fillNum; i++)
+        if (vector)
+            oss << "v_add_u32 f[" << i << "], vcc, f[" << i << "], c\n";
+        else
+            oss << "s_add_u32 f[" << i << "], f[" << i << "], c\n";
+    oss << "s_endpgm\n";
+    return oss.str();
+}
+
 extern const AsmCodeStructCase codeStructTestCases1Tbl[];
 extern const AsmSSADataCase ssaDataTestCases1Tbl[];
 extern const AsmSSADataCase ssaDataTestCases2Tbl[];
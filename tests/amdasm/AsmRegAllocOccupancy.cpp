@@ -0,0 +1,160 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../TestUtils.h"
+#include "AsmRegAlloc.h"
+
+using namespace CLRX;
+
+struct AsmRegAllocOccupancyCase
+{
+    cxuint fillNum;   // number of registers live in whole code
+    char regType;     // type of registers of kernel ('s' or 'v')
+    const char* occupancyOp; // occupancy pseudo-op
+    cxuint occupancyTarget; // occupancy target set by assembler's method
+    bool good;
+    const char* errorMessages;
+    cxuint regsNum;     // number of allocated registers of kernel type
+    cxuint wavesPerSIMD;
+    bool split;    // live ranges are split
+    cxuint configSGPRsNum; // number of used SGPRs in kernel configuration
+    cxuint configVGPRsNum; // number of used VGPRs in kernel configuration
+};
+
+static const AsmRegAllocOccupancyCase regAllocOccupancyTestCases[] =
+{
+    /* 0 - no occupancy target: triangle needs three SGPRs
+     * (kernel configuration is not updated) */
+    { 44, 's', "", 0, true, "", 47, 9, false, 5, 1 },
+    /* 1 - occupancy target: live ranges are split (46 SGPRs + VCC) */
+    { 44, 's', ".occupancy 10\n", 0, true, "", 46, 10, true, 46, 1 },
+    /* 2 - occupancy target set by method */
+    { 44, 's', "", 10, true, "", 46, 10, true, 46, 1 },
+    /* 3 - lower occupancy target */
+    { 44, 's', ".occupancy 9\n", 0, true, "", 47, 9, false, 47, 1 },
+    /* 4 - occupancy target is not possible to achieve */
+    { 45, 's', ".occupancy 10\n", 0, true, "", 48, 9, false, 48, 1 },
+    /* 5 - zero disables occupancy target (kernel configuration is not updated) */
+    { 44, 's', ".occupancy 0\n", 10, true, "", 47, 9, false, 5, 1 },
+    /* 6 - wrong occupancy target */
+    { 44, 's', ".occupancy 11\n", 0, false,
+        "test.s:3:12: Error: Occupancy target out of range\n", 0, 0, false, 0, 0 },
+    /* 7 - VGPRs: occupancy target (minimal number of SGPRs in configuration) */
+    { 22, 'v', ".occupancy 10\n", 0, true, "", 24, 10, true, 5, 24 },
+    /* 8 - VGPRs: lower occupancy target */
+    { 22, 'v', ".occupancy 9\n", 0, true, "", 25, 9, false, 5, 25 }
+};
+
+static void testRegAllocOccupancy(cxuint i, const AsmRegAllocOccupancyCase& testCase)
+{
+    std::ostringstream nameOss;
+    nameOss << "RegAllocOccupancy#" << i;
+    const std::string testName = nameOss.str();
+    
+    std::istringstream input(generateSplitKernel(testCase.fillNum, testCase.regType,
+                    testCase.occupancyOp));
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, errorStream);
+    assembler.setOccupancyTarget(testCase.occupancyTarget);
+    bool good = assembler.assemble();
+    // registers are allocated while assembling if occupancy target is set
+    if (good && assembler.getRegAllocResults().empty())
+        good = assembler.allocateRegisters(1);
+    assertValue(testName, "good", testCase.good, good);
+    assertString(testName, "errorMessages", testCase.errorMessages,
+                errorStream.str().c_str());
+    if (!good)
+        return;
+    
+    assertValue(testName, "resultsNum", size_t(1), assembler.getRegAllocResults().size());
+    const AsmRegAllocResult& result = assembler.getRegAllocResults()[0];
+    const cxuint regType = (testCase.regType == 'v') ? REGTYPE_VGPR : REGTYPE_SGPR;
+    assertValue(testName, "regsNum", testCase.regsNum, result.regsNum[regType]);
+    assertValue(testName, "wavesPerSIMD", testCase.wavesPerSIMD, result.wavesPerSIMD);
+    assertValue(testName, "split", testCase.split, !result.splitCopies[regType].empty());
+    // allocated registers must be set in kernel configuration
+    const AmdCL2Input* output = static_cast<const AsmAmdCL2Handler*>(
+                assembler.getFormatHandler())->getOutput();
+    const AmdCL2KernelConfig& config = output->kernels[0].config;
+    assertValue(testName, "configSGPRsNum", testCase.configSGPRsNum,
+                config.usedSGPRsNum);
+    assertValue(testName, "configVGPRsNum", testCase.configVGPRsNum,
+                config.usedVGPRsNum);
+    if (assembler.getOccupancyTarget() == 0)
+        return;
+    // emitted configuration gives achieved occupancy (VCC is counted)
+    assertValue(testName, "configWaves", result.wavesPerSIMD,
+                getGPUWavesPerSIMD(GPUArchitecture::GCN1_1, config.usedSGPRsNum +
+                    getGPUExtraRegsNum(GPUArchitecture::GCN1_1, REGTYPE_SGPR, GCN_VCC),
+                    config.usedVGPRsNum));
+}
+
+/* registers used directly in code are counted, because operands are not rewritten
+ * to allocated registers: used registers in configuration can not be lower */
+static void testRegAllocOccupancyDirectRegs()
+{
+    const char* testName = "RegAllocOccupancyDirectRegs";
+    std::istringstream input(".amdcl2\n.gpu Bonaire\n.occupancy 10\n"
+        ".kernel k0\n.config\n.dims x\n.text\n"
+        ".regvar a:s, b:s, va:v\n"
+        "s_mov_b32 a, 1\n"
+        "s_mov_b32 b, 2\n"
+        "s_add_u32 s60, a, b\n"
+        "v_mov_b32 va, s60\n"
+        "v_mov_b32 v30, va\n"
+        "s_endpgm\n");
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, errorStream);
+    assertTrue(testName, "good", assembler.assemble());
+    assertString(testName, "errorMessages", "", errorStream.str().c_str());
+    assertValue(testName, "resultsNum", size_t(1), assembler.getRegAllocResults().size());
+    const AsmRegAllocResult& result = assembler.getRegAllocResults()[0];
+    assertValue(testName, "sgprsNum", 61U, result.regsNum[REGTYPE_SGPR]);
+    assertValue(testName, "vgprsNum", 31U, result.regsNum[REGTYPE_VGPR]);
+    assertValue(testName, "wavesPerSIMD", 8U, result.wavesPerSIMD);
+    const AmdCL2Input* output = static_cast<const AsmAmdCL2Handler*>(
+                assembler.getFormatHandler())->getOutput();
+    const AmdCL2KernelConfig& config = output->kernels[0].config;
+    assertValue(testName, "configSGPRsNum", 61U, config.usedSGPRsNum);
+    assertValue(testName, "configVGPRsNum", 31U, config.usedVGPRsNum);
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    for (cxuint i = 0; i < sizeof(regAllocOccupancyTestCases)/
+                sizeof(AsmRegAllocOccupancyCase); i++)
+        try
+        { testRegAllocOccupancy(i, regAllocOccupancyTestCases[i]); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    retVal |= callTest(testRegAllocOccupancyDirectRegs);
+    return retVal;
+}
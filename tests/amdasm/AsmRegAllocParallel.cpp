@@ -0,0 +1,198 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+// generate source with many kernels (kernel 'badKernel' needs too many SGPRs)
+static std::string generateKernels(cxuint kernelsNum, cxuint badKernel)
+{
+    std::ostringstream oss;
+    oss << ".amdcl2\n.gpu Bonaire\n";
+    for (cxuint k = 0; k < kernelsNum; k++)
+    {
+        oss << ".kernel k" << k << "\n.config\n.dims x\n.text\n"
+            ".regvar va" << k << ":v:12, sa" << k << ":s:128\n";
+        if (k == badKernel)
+        {
+            // all SGPRs are live at same time
+            for (cxuint i = 0; i < 128; i++)
+                oss << "s_mov_b32 sa" << k << "[" << i << "], " << i << "\n";
+            for (cxuint i = 0; i < 128; i += 2)
+                oss << "s_add_u32 s0, sa" << k << "[" << i << "], sa" << k <<
+                        "[" << (i+1) << "]\n";
+        }
+        else
+            for (cxuint i = 0; i < 20+k*3; i++)
+                oss << "s_load_dword sa" << k << "[" << (i&7) << "], s[4:5], " <<
+                        (i*4) << "\n"
+                    "v_add_f32 va" << k << "[" << (i%12) << "], sa" << k << "[" <<
+                        ((i+3)&7) << "], va" << k << "[" << ((i+1)%12) << "]\n"
+                    "s_add_u32 sa" << k << "[" << ((i+1)&7) << "], sa" << k << "[" <<
+                        (i&7) << "], s2\n";
+        oss << "s_endpgm\n";
+    }
+    return oss.str();
+}
+
+/* allocate registers with threadsNum threads, returns messages and results
+ * (in text form) */
+static bool allocateRegs(const std::string& source, cxuint threadsNum,
+            std::string& messages, std::string& results)
+{
+    std::istringstream input(source);
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, errorStream);
+    if (!assembler.assemble())
+        throw Exception("Assembling failed");
+    const bool good = assembler.allocateRegisters(threadsNum);
+    messages = errorStream.str();
+    std::ostringstream resOss;
+    for (const AsmRegAllocResult& result: assembler.getRegAllocResults())
+    {
+        resOss << "section " << result.sectionId << ":";
+        for (cxuint r = 0; r < MAX_REGTYPES_NUM; r++)
+        {
+            resOss << " [" << result.vregIndexMaps[r].size() << "]";
+            for (cxuint color: result.graphColorMaps[r])
+                resOss << " " << color;
+        }
+        resOss << " waits: " << result.waitInstrs.size() << "\n";
+    }
+    results = resOss.str();
+    return good;
+}
+
+static void testRegAllocParallel(cxuint kernelsNum, cxuint badKernel)
+{
+    std::ostringstream nameOss;
+    nameOss << "RegAllocParallel(" << kernelsNum << "," << badKernel << ")";
+    const std::string testName = nameOss.str();
+    const std::string source = generateKernels(kernelsNum, badKernel);
+    
+    std::string messages1, results1;
+    const bool good1 = allocateRegs(source, 1, messages1, results1);
+    assertValue(testName, "good", badKernel >= kernelsNum, good1);
+    if (badKernel < kernelsNum)
+    {
+        // error at kernel position
+        std::ostringstream kernelOss;
+        kernelOss << ".kernel k" << badKernel << "\n";
+        const size_t kernelPos = source.find(kernelOss.str());
+        const size_t kernelLine = std::count(source.begin(),
+                source.begin()+kernelPos, '\n')+1;
+        std::ostringstream expOss;
+        expOss << "test.s:" << kernelLine << ":1: Error: Register allocation "
+                "in section '.text': Too many register is needed\n"
+                // register pressure at first instruction
+                "test.s:" << (kernelLine+5) << ":1: Note: Max live registers in block "
+                "0x0-0x400: SGPRs: 128, VGPRs: 0; live SGPRs: sa" << badKernel <<
+                "[0:127]\n";
+        assertString(testName, "messages", expOss.str().c_str(), messages1.c_str());
+    }
+    // results must be same regardless number of threads
+    for (cxuint threadsNum: { 2, 3, 8 })
+    {
+        std::string messages, results;
+        const bool good = allocateRegs(source, threadsNum, messages, results);
+        assertValue(testName, "goodN", good1, good);
+        assertString(testName, "messagesN", messages1.c_str(), messages.c_str());
+        assertString(testName, "resultsN", results1.c_str(), results.c_str());
+    }
+}
+
+// generate source with many kernels (odd kernels have wrong linear dependencies)
+static std::string generateKernelsWithLinearDeps(cxuint kernelsNum)
+{
+    std::ostringstream oss;
+    oss << ".amdcl2\n.gpu Bonaire\n";
+    for (cxuint k = 0; k < kernelsNum; k++)
+    {
+        oss << ".kernel k" << k << "\n.config\n.dims x\n.text\n"
+            ".regvar sa" << k << ":s:8, sb" << k << ":s:4\n";
+        if ((k&1) != 0)
+            // linear dependencies of register variable unused by instruction
+            oss << ".rvlin_once sb" << k << "[0:3]\n";
+        oss << "s_mov_b32 sa" << k << "[0], s4\n"
+            "s_add_u32 sa" << k << "[1], sa" << k << "[0], s2\n"
+            "s_endpgm\n";
+    }
+    return oss.str();
+}
+
+// errors from linear dependencies are printed in sections order with source position
+static void testRegAllocParallelLinearDeps(cxuint kernelsNum)
+{
+    std::ostringstream nameOss;
+    nameOss << "RegAllocParallelLinearDeps(" << kernelsNum << ")";
+    const std::string testName = nameOss.str();
+    const std::string source = generateKernelsWithLinearDeps(kernelsNum);
+    
+    std::ostringstream expOss;
+    for (cxuint k = 1; k < kernelsNum; k += 2)
+    {
+        // position of instruction after '.rvlin_once'
+        std::ostringstream instrOss;
+        instrOss << "s_mov_b32 sa" << k << "[0]";
+        const size_t instrPos = source.find(instrOss.str());
+        expOss << "test.s:" << (std::count(source.begin(), source.begin()+instrPos,
+                '\n')+1) << ":1: Error: Linear deps failed\n";
+    }
+    for (cxuint threadsNum: { 1, 2, 3, 8 })
+    {
+        std::string messages, results;
+        const bool good = allocateRegs(source, threadsNum, messages, results);
+        assertValue(testName, "good", kernelsNum < 2, good);
+        assertString(testName, "messages", expOss.str().c_str(), messages.c_str());
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    const std::pair<cxuint, cxuint> testCases[] = {
+        { 1, 1 }, { 7, 7 }, { 16, 16 }, { 5, 3 } };
+    for (const auto& testCase: testCases)
+        try
+        { testRegAllocParallel(testCase.first, testCase.second); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    for (cxuint kernelsNum: { 1, 2, 9 })
+        try
+        { testRegAllocParallelLinearDeps(kernelsNum); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    return retVal;
+}
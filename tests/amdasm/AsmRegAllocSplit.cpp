@@ -0,0 +1,288 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../TestUtils.h"
+#include "AsmRegAlloc.h"
+
+using namespace CLRX;
+
+static void testRegAllocSplit(cxuint fillNum, bool expectedGood)
+{
+    std::ostringstream nameOss;
+    nameOss << "RegAllocSplit(" << fillNum << ")";
+    const std::string testName = nameOss.str();
+    
+    std::istringstream input(generateSplitKernel(fillNum));
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, errorStream);
+    if (!assembler.assemble())
+        throw Exception("Assembling failed");
+    const bool good = assembler.allocateRegisters(1);
+    assertValue(testName, "good", expectedGood, good);
+    assertValue(testName, "resultsNum", size_t(1), assembler.getRegAllocResults().size());
+    const AsmRegAllocResult& result = assembler.getRegAllocResults()[0];
+    const cxuint maxSGPRs = getGPUMaxRegistersNum(GPUArchitecture::GCN1_1, REGTYPE_SGPR);
+    
+    if (!good)
+    {
+        assertString(testName, "messages", "test.s:3:1: Error: Register allocation "
+                "in section '.text': Too many register is needed\n"
+                // blocks with max live registers and live regvars
+                "test.s:8:1: Note: Max live registers in block 0x0-0x244: "
+                "SGPRs: 105, VGPRs: 0; live SGPRs: a, b, f[0:102]\n"
+                "test.s:115:1: Note: Max live registers in block 0x244-0x250: "
+                "SGPRs: 105, VGPRs: 0; live SGPRs: b, c, f[0:102]\n"
+                "test.s:119:1: Note: Max live registers in block 0x250-0x258: "
+                "SGPRs: 105, VGPRs: 0; live SGPRs: a, c, f[0:102]\n",
+                errorStream.str().c_str());
+        // register pressure must be reported
+        assertTrue(testName, "regPressures", !result.regPressures.empty());
+        cxuint maxLive = 0;
+        for (const AsmRegPressure& pressure: result.regPressures)
+        {
+            assertTrue(testName, "pressureRange", pressure.start <= pressure.end);
+            assertValue(testName, "liveSVRegsNum",
+                    size_t(pressure.maxLive[REGTYPE_SGPR]),
+                    pressure.liveSVRegs[REGTYPE_SGPR].size());
+            maxLive = std::max(maxLive, pressure.maxLive[REGTYPE_SGPR]);
+        }
+        assertTrue(testName, "maxLive", maxLive > maxSGPRs);
+        return;
+    }
+    
+    assertString(testName, "messages", "", errorStream.str().c_str());
+    assertTrue(testName, "noRegPressures", result.regPressures.empty());
+    // coloring without splitting is not possible (triangle of a, b and c)
+    assertTrue(testName, "splitRanges", !result.splitRanges[REGTYPE_SGPR].empty());
+    assertTrue(testName, "splitCopies", !result.splitCopies[REGTYPE_SGPR].empty());
+    const Array<cxuint>& gcMap = result.graphColorMaps[REGTYPE_SGPR];
+    for (const AsmRegAllocator::SplitRange& range: result.splitRanges[REGTYPE_SGPR])
+    {
+        assertTrue(testName, "rangeVIdx", range.vidx < gcMap.size());
+        assertTrue(testName, "rangeColor", range.color < maxSGPRs);
+        assertTrue(testName, "range", range.start < range.end);
+    }
+    for (const AsmRegAllocator::SplitCopy& copy: result.splitCopies[REGTYPE_SGPR])
+    {
+        assertTrue(testName, "copySrc", copy.srcColor < maxSGPRs);
+        assertTrue(testName, "copyDst", copy.dstColor < maxSGPRs);
+        assertTrue(testName, "copyColors", copy.srcColor != copy.dstColor);
+    }
+    for (cxuint color: gcMap)
+        assertTrue(testName, "color", color < maxSGPRs);
+}
+
+/* copies of split registers are only reported (regvar operands are not rewritten
+ * to allocated registers), hence code must be same as code assembled without
+ * occupancy target */
+static void testRegAllocSplitCode(cxuint fillNum, char regType)
+{
+    std::ostringstream nameOss;
+    nameOss << "RegAllocSplitCode(" << fillNum << "," << regType << ")";
+    const std::string testName = nameOss.str();
+    
+    // reference code (without register allocation)
+    std::istringstream refInput(generateSplitKernel(fillNum, regType));
+    std::ostringstream refErrorStream;
+    Assembler refAssembler("test.s", refInput, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, refErrorStream);
+    if (!refAssembler.assemble())
+        throw Exception("Assembling failed");
+    
+    std::istringstream input(generateSplitKernel(fillNum, regType));
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, errorStream);
+    // registers are allocated while assembling if occupancy target is set
+    assembler.setOccupancyTarget(10);
+    const bool good = assembler.assemble();
+    assertValue(testName, "good", true, good);
+    assertString(testName, "messages", "", errorStream.str().c_str());
+    assertValue(testName, "resultsNum", size_t(1), assembler.getRegAllocResults().size());
+    const AsmRegAllocResult& result = assembler.getRegAllocResults()[0];
+    const cxuint rtype = (regType == 'v') ? REGTYPE_VGPR : REGTYPE_SGPR;
+    const std::vector<AsmRegAllocator::SplitCopy>& splitCopies =
+                result.splitCopies[rtype];
+    assertTrue(testName, "splitCopies", !splitCopies.empty());
+    assertTrue(testName, "otherSplitCopies",
+                result.splitCopies[rtype == REGTYPE_SGPR ? REGTYPE_VGPR :
+                        REGTYPE_SGPR].empty());
+    
+    const AsmSection& refSection = refAssembler.getSections()[result.sectionId];
+    const AsmSection& section = assembler.getSections()[result.sectionId];
+    // copies are reported at starts of code blocks (jump targets)
+    for (size_t j = 0; j < splitCopies.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "copy#" << j;
+        const size_t offset = splitCopies[j].offset;
+        assertTrue(testName, caseOss.str() + ".offset",
+                    offset < section.content.size() && (offset & 3) == 0);
+        assertTrue(testName, caseOss.str() + ".blockStart",
+                std::any_of(section.codeFlow.begin(), section.codeFlow.end(),
+                    [offset](const AsmCodeFlowEntry& entry)
+                    { return entry.target == offset ||
+                        entry.offset + 4 == offset; }));
+    }
+    
+    // code, labels and code flow are not changed
+    assertValue(testName, "codeSize", refSection.content.size(),
+                section.content.size());
+    const uint32_t* refCode = reinterpret_cast<const uint32_t*>(
+                refSection.content.data());
+    const uint32_t* code = reinterpret_cast<const uint32_t*>(section.content.data());
+    for (size_t j = 0; j < section.content.size()>>2; j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "code#" << j;
+        assertValue(testName, caseOss.str(), ULEV(refCode[j]), ULEV(code[j]));
+    }
+    for (const char* label: { "lc", "ld" })
+    {
+        auto refIt = refAssembler.getSymbolMap().find(label);
+        auto it = assembler.getSymbolMap().find(label);
+        assertTrue(testName, std::string("label ") + label,
+                    it != assembler.getSymbolMap().end() && it->second.hasValue);
+        assertValue(testName, std::string("labelValue ") + label,
+                    refIt->second.value, it->second.value);
+    }
+    assertValue(testName, "codeFlowSize", refSection.codeFlow.size(),
+                section.codeFlow.size());
+    for (size_t j = 0; j < section.codeFlow.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "codeFlow#" << j;
+        assertValue(testName, caseOss.str() + ".offset", refSection.codeFlow[j].offset,
+                    section.codeFlow[j].offset);
+        assertValue(testName, caseOss.str() + ".target", refSection.codeFlow[j].target,
+                    section.codeFlow[j].target);
+    }
+}
+
+struct RegAllocSplitCopiesCase
+{
+    GPUDeviceType deviceType;
+    cxuint regType;
+    std::vector<AsmRegAllocator::SplitCopy> copies; // parallel copies
+    std::vector<uint32_t> code;
+};
+
+static const RegAllocSplitCopiesCase regAllocSplitCopiesTestCases[] =
+{
+    {   /* 0 - independent copies */
+        GPUDeviceType::BONAIRE, REGTYPE_SGPR, { { 0, 1, 2 }, { 0, 3, 4 } },
+        { 0xbe820301U, 0xbe840303U }
+    },
+    {   /* 1 - chain of copies: destination read by other copy is written later */
+        GPUDeviceType::BONAIRE, REGTYPE_SGPR, { { 0, 1, 2 }, { 0, 2, 3 } },
+        { 0xbe830302U, 0xbe820301U }
+    },
+    {   /* 2 - cycle: swap by three XORs */
+        GPUDeviceType::BONAIRE, REGTYPE_SGPR, { { 0, 1, 2 }, { 0, 2, 1 } },
+        { 0x89020102U, 0x89010201U, 0x89020102U }
+    },
+    {   /* 3 - cycle of three registers: two swaps */
+        GPUDeviceType::BONAIRE, REGTYPE_SGPR, { { 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 1 } },
+        { 0x89020102U, 0x89010201U, 0x89020102U,
+          0x89030103U, 0x89010301U, 0x89030103U }
+    },
+    {   /* 4 - cycle and copy from register of cycle */
+        GPUDeviceType::BONAIRE, REGTYPE_SGPR, { { 0, 1, 2 }, { 0, 2, 1 }, { 0, 1, 3 } },
+        { 0xbe830301U, 0x89020102U, 0x89010201U, 0x89020102U }
+    },
+    {   /* 5 - cycle of VGPRs */
+        GPUDeviceType::BONAIRE, REGTYPE_VGPR, { { 0, 1, 2 }, { 0, 2, 1 } },
+        { 0x3a040501U, 0x3a020302U, 0x3a040501U }
+    },
+    {   /* 6 - GCN 1.2: copy and cycle of SGPRs */
+        GPUDeviceType::FIJI, REGTYPE_SGPR, { { 0, 5, 6 }, { 0, 1, 2 }, { 0, 2, 1 } },
+        { 0xbe860005U, 0x88020102U, 0x88010201U, 0x88020102U }
+    },
+    {   /* 7 - GCN 1.2: copy and cycle of VGPRs */
+        GPUDeviceType::FIJI, REGTYPE_VGPR, { { 0, 5, 6 }, { 0, 1, 2 }, { 0, 2, 1 } },
+        { 0x7e0c0305U, 0x2a040501U, 0x2a020302U, 0x2a040501U }
+    }
+};
+
+static void testRegAllocSplitCopies(cxuint i, const RegAllocSplitCopiesCase& testCase)
+{
+    std::ostringstream nameOss;
+    nameOss << "RegAllocSplitCopies#" << i;
+    const std::string testName = nameOss.str();
+    
+    std::istringstream input("");
+    Assembler assembler("test.s", input, ASM_ALL&~ASM_ALTMACRO,
+                    BinaryFormat::RAWCODE, testCase.deviceType);
+    GCNAssembler gcnAssembler(assembler);
+    std::vector<AsmRegAllocator::SplitCopy> copies = testCase.copies;
+    std::vector<cxbyte> output;
+    AsmRegAllocator::encodeSplitCopies(gcnAssembler, testCase.regType, copies, output);
+    assertTrue(testName, "copiesConsumed", copies.empty());
+    assertValue(testName, "codeSize", testCase.code.size()*4, output.size());
+    const uint32_t* code = reinterpret_cast<const uint32_t*>(output.data());
+    for (size_t j = 0; j < testCase.code.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "code#" << j;
+        assertValue(testName, caseOss.str(), testCase.code[j], ULEV(code[j]));
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    const std::pair<cxuint, bool> testCases[] = {
+        { 102, true }, { 103, false } };
+    for (const auto& testCase: testCases)
+        try
+        { testRegAllocSplit(testCase.first, testCase.second); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    const std::pair<cxuint, char> codeTestCases[] = { { 44, 's' }, { 22, 'v' } };
+    for (const auto& testCase: codeTestCases)
+        try
+        { testRegAllocSplitCode(testCase.first, testCase.second); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    for (cxuint i = 0; i < sizeof(regAllocSplitCopiesTestCases)/
+                sizeof(RegAllocSplitCopiesCase); i++)
+        try
+        { testRegAllocSplitCopies(i, regAllocSplitCopiesTestCases[i]); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    return retVal;
+}
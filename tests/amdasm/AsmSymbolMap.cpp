@@ -0,0 +1,113 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <CLRX/utils/Containers.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+static std::string symName(const char* prefix, size_t i, const char* suffix)
+{
+    std::ostringstream oss;
+    oss << prefix << i << suffix;
+    return oss.str();
+}
+
+// insert, find, erase and iteration order
+static void testSymbolMapBasic()
+{
+    AsmSymbolMap map;
+    const size_t namesNum = 1000;
+    for (size_t i = 0; i < namesNum; i++)
+    {
+        const std::string name = symName("sym", i, "");
+        auto res = map.insert(std::make_pair(CString(name.c_str()),
+                    AsmSymbol(ASMSECT_ABS, i)));
+        assertTrue("symbolMapBasic", "inserted", res.second);
+    }
+    assertValue("symbolMapBasic", "size", namesNum, map.size());
+    // duplicate must not be inserted
+    auto dupRes = map.insert(AsmSymbolName("sym7"), AsmSymbol(ASMSECT_ABS, 77));
+    assertTrue("symbolMapBasic", "notInserted", !dupRes.second);
+    assertValue("symbolMapBasic", "dupValue", uint64_t(7), dupRes.first->second.value);
+    
+    for (size_t i = 0; i < namesNum; i++)
+    {
+        const std::string name = symName("sym", i, "");
+        auto it = map.find(name.c_str());
+        assertTrue("symbolMapBasic", "found", it != map.end());
+        assertValue("symbolMapBasic", "value", uint64_t(i), it->second.value);
+    }
+    assertTrue("symbolMapBasic", "notFound", map.find("sym1000") == map.end());
+    
+    // erase odd entries, even entries must be still found (backward-shift deletion)
+    for (size_t i = 1; i < namesNum; i += 2)
+        map.erase(map.find(symName("sym", i, "").c_str()));
+    assertValue("symbolMapBasic", "sizeAfterErase", namesNum>>1, map.size());
+    for (size_t i = 0; i < namesNum; i++)
+    {
+        const std::string name = symName("sym", i, "");
+        assertTrue("symbolMapBasic", "foundAfterErase",
+                   (map.find(name.c_str()) != map.end()) == ((i&1) == 0));
+    }
+    // iteration in insertion order
+    size_t i = 0;
+    for (const auto& entry: map)
+    {
+        assertString("symbolMapBasic", "order", symName("sym", i, "").c_str(),
+                     entry.first);
+        i += 2;
+    }
+}
+
+/* names with common suffix (for example 'l123_end', 'x1_loop') must be spread over
+ * low bits of hash (slot index in symbol map) */
+static void testSymbolNameHashSpread(const char* prefix, const char* suffix)
+{
+    const std::string testName = std::string("symbolNameHashSpread:") + prefix +
+                "*" + suffix;
+    const size_t namesNum = 4096;
+    const size_t lowMask = 0xfff;
+    std::unordered_set<size_t> lowHashes;
+    for (size_t i = 0; i < namesNum; i++)
+    {
+        const std::string name = symName(prefix, i, suffix);
+        lowHashes.insert(AsmSymbolName(name.c_str()).hash & lowMask);
+    }
+    /* for random hashes expected number of distinct low parts
+     * is about namesNum*(1-1/e) ~ 2589 */
+    assertTrue(testName, "distinctLowHashes", lowHashes.size() > namesNum/2);
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    retVal |= callTest(testSymbolMapBasic);
+    retVal |= callTest(testSymbolNameHashSpread, "l", "");
+    retVal |= callTest(testSymbolNameHashSpread, "l", "_end");
+    retVal |= callTest(testSymbolNameHashSpread, "loop", "_inner_cond");
+    retVal |= callTest(testSymbolNameHashSpread, "", "b");
+    return retVal;
+}
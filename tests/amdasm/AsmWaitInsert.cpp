@@ -0,0 +1,290 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include <CLRX/amdasm/AsmFormats.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+struct AsmWaitInsertCase
+{
+    const char* input;
+    GPUDeviceType deviceType;
+    std::vector<uint32_t> code; // code after inserting wait instructions
+    // expected label values
+    std::vector<std::pair<const char*, uint64_t> > labels;
+    // offsets of code flow entries
+    std::vector<std::pair<size_t, size_t> > codeFlow;
+    // source positions (code offset and line number)
+    std::vector<std::pair<size_t, LineNo> > sourcePoses;
+    bool good;
+    const char* errorMessages;
+};
+
+static const AsmWaitInsertCase waitInsertTestCases[] =
+{
+    {   /* 0 - wait before first use of loaded register (after label) */
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l1\n"
+        "s_nop 0\n"
+        "l1:\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_branch l1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE,
+        { 0xc0000300U, 0xbf840001U, 0xbf800000U, 0xbf8c007fU, 0x80018100U,
+          0xbf82fffdU, 0xbf810000U },
+        { { "l1", 12 } },
+        { { 4, 12 }, { 20, 12 }, { 28, 0 } },
+        { { 0, 1 }, { 4, 2 }, { 8, 3 }, { 12, 5 }, { 16, 5 }, { 20, 6 }, { 24, 7 } },
+        true, ""
+    },
+    {   /* 1 - relaxed vmcnt (only first load must be finished) */
+        "buffer_load_dword v1, v0, s[4:7], 0 offen\n"
+        "buffer_load_dword v2, v0, s[4:7], 0 offen\n"
+        "v_add_f32 v3, v1, v0\n"
+        "v_add_f32 v4, v2, v3\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE,
+        { 0xe0301000U, 0x80010100U, 0xe0301000U, 0x80010200U, 0xbf8c0f71U,
+          0x06060101U, 0xbf8c0f70U, 0x06080702U, 0xbf810000U },
+        { }, { { 36, 0 } },
+        { { 0, 1 }, { 8, 2 }, { 16, 3 }, { 20, 3 }, { 24, 4 }, { 28, 4 }, { 32, 5 } },
+        true, ""
+    },
+    {   /* 2 - wait instruction in code is respected */
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_waitcnt lgkmcnt(0)\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE,
+        { 0xc0000300U, 0xbf8c007fU, 0x80018100U, 0xbf810000U },
+        { }, { { 16, 0 } },
+        { { 0, 1 }, { 4, 2 }, { 8, 3 }, { 12, 4 } },
+        true, ""
+    },
+    {   /* 3 - wait at start of loop (queue state from loop end) */
+        "l0:\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l0\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE,
+        { 0xbf8c007fU, 0x80018100U, 0xc0000300U, 0xbf84fffcU, 0xbf810000U },
+        { { "l0", 0 } },
+        { { 12, 0 }, { 20, 0 } },
+        { { 0, 2 }, { 4, 2 }, { 8, 3 }, { 12, 4 }, { 16, 5 } },
+        true, ""
+    },
+    {   /* 4 - GFX10 (stores are not counted by vmcnt) */
+        "buffer_store_dword v1, v0, s[4:7], 0 offen\n"
+        "buffer_load_dword v2, v0, s[4:7], 0 offen\n"
+        "v_mov_b32 v1, 0\n"
+        "v_add_f32 v4, v2, v1\n"
+        "s_endpgm\n",
+        GPUDeviceType::GFX1010,
+        { 0xe0701000U, 0x80010100U, 0xe0301000U, 0x80010200U, 0x7e020280U,
+          0xbf8c3f70U, 0x06080302U, 0xbf810000U },
+        { }, { { 32, 0 } },
+        { { 0, 1 }, { 8, 2 }, { 16, 3 }, { 20, 4 }, { 24, 4 }, { 28, 5 } },
+        true, ""
+    },
+    {   /* 5 - label differences without inserted code between labels */
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_add_u32 s1, s0, 1\n"
+        "l0:\n"
+        "s_mov_b32 s2, l1-l0\n"
+        "s_mov_b32 s3, l0-.\n"
+        "l1:\n"
+        "s_endpgm\n"
+        "l2:\n"
+        ".int l2-l1\n",
+        GPUDeviceType::BONAIRE,
+        { 0xc0000300U, 0xbf8c007fU, 0x80018100U, 0xbe8203ffU, 0x0000000cU,
+          0xbe8303c8U, 0xbf810000U, 0x00000004U },
+        { { "l0", 12 }, { "l1", 24 }, { "l2", 28 } },
+        { { 28, 0 } },
+        { { 0, 1 }, { 4, 2 }, { 8, 2 }, { 12, 4 }, { 20, 5 }, { 24, 7 }, { 28, 9 } },
+        true, ""
+    },
+    {   /* 6 - label differences with inserted code between labels */
+        "l0:\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_add_u32 s1, s0, 1\n"
+        "l1:\n"
+        "s_mov_b32 s2, l1-l0\n"
+        "s_endpgm\n"
+        ".int l1-l0\n"
+        "x = l1 - l0\n",
+        GPUDeviceType::BONAIRE, { }, { }, { }, { }, false,
+        "test.s:5:15: Error: Value of expression depends on code offsets changed "
+        "by inserting wait instructions\n"
+        "test.s:7:6: Error: Value of expression depends on code offsets changed "
+        "by inserting wait instructions\n"
+        "test.s:8:5: Error: Value of expression depends on code offsets changed "
+        "by inserting wait instructions\n"
+    },
+    {   /* 7 - regvars (not allocated): own registers, not encoded placeholders */
+        ".regvar rx:s, ry:s, rv:v:2\n"
+        "s_load_dword rx, s[2:3], 0\n"
+        "buffer_load_dword rv[1], v0, s[4:7], 0 offen\n"
+        "s_add_u32 s0, ry, 1\n"
+        "v_add_f32 rv[0], rv[0], v1\n"
+        "s_add_u32 s1, rx, 1\n"
+        "v_add_f32 v2, rv[1], v1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE,
+        { 0xc0000300U, 0xe0301000U, 0x80010000U, 0x80008100U, 0x06000200U,
+          0xbf8c007fU, 0x80018100U, 0xbf8c0f70U, 0x06040200U, 0xbf810000U },
+        { }, { { 40, 0 } },
+        { { 0, 2 }, { 4, 3 }, { 12, 4 }, { 16, 5 }, { 20, 6 }, { 24, 6 },
+          { 28, 7 }, { 32, 7 }, { 36, 8 } },
+        true, ""
+    }
+};
+
+static void testWaitInsert(cxuint i, const AsmWaitInsertCase& testCase)
+{
+    std::ostringstream nameOss;
+    nameOss << "WaitInsert#" << i;
+    const std::string testName = nameOss.str();
+    
+    std::istringstream input(testCase.input);
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_AUTOWAIT,
+                    BinaryFormat::RAWCODE, testCase.deviceType, errorStream);
+    const bool good = assembler.assemble();
+    assertValue(testName, "good", int(testCase.good), int(good));
+    assertString(testName, "messages", testCase.errorMessages,
+                errorStream.str().c_str());
+    if (!good)
+        return;
+    
+    const AsmSection& section = assembler.getSections()[0];
+    assertValue(testName, "codeSize", testCase.code.size()*4, section.content.size());
+    for (size_t j = 0; j < testCase.code.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "code#" << j;
+        assertValue(testName, caseOss.str(), testCase.code[j],
+                    ULEV(reinterpret_cast<const uint32_t*>(section.content.data())[j]));
+    }
+    for (const auto& label: testCase.labels)
+    {
+        auto it = assembler.getSymbolMap().find(label.first);
+        assertTrue(testName, std::string("label ") + label.first,
+                    it != assembler.getSymbolMap().end() && it->second.hasValue);
+        assertValue(testName, std::string("labelValue ") + label.first,
+                    label.second, it->second.value);
+    }
+    assertValue(testName, "codeFlowSize", testCase.codeFlow.size(),
+                section.codeFlow.size());
+    for (size_t j = 0; j < testCase.codeFlow.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "codeFlow#" << j;
+        assertValue(testName, caseOss.str() + ".offset", testCase.codeFlow[j].first,
+                    section.codeFlow[j].offset);
+        assertValue(testName, caseOss.str() + ".target", testCase.codeFlow[j].second,
+                    section.codeFlow[j].target);
+    }
+    // source positions of wait instructions are taken from next instruction
+    std::vector<std::pair<size_t, LineNo> > resSourcePoses;
+    AsmSourcePosHandler::ReadPos sposPos{ 0, 0 };
+    while (section.sourcePosHandler.hasNext(sposPos))
+    {
+        const std::pair<size_t, AsmSourcePos> spos =
+                section.sourcePosHandler.nextSourcePos(sposPos);
+        resSourcePoses.push_back(std::make_pair(spos.first, spos.second.lineNo));
+    }
+    assertValue(testName, "sourcePosesNum", testCase.sourcePoses.size(),
+                resSourcePoses.size());
+    for (size_t j = 0; j < resSourcePoses.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "sourcePos#" << j;
+        assertValue(testName, caseOss.str() + ".offset", testCase.sourcePoses[j].first,
+                    resSourcePoses[j].first);
+        assertValue(testName, caseOss.str() + ".lineNo", testCase.sourcePoses[j].second,
+                    resSourcePoses[j].second);
+    }
+    // wait instructions are not needed after inserting
+    assertTrue(testName, "regAllocResults", assembler.getRegAllocResults().empty());
+}
+
+// relocations in code are moved with instructions
+static void testWaitInsertRelocs()
+{
+    const char* testName = "WaitInsertRelocs";
+    std::istringstream input(
+        ".amdcl2\n"
+        ".gpu Bonaire\n"
+        ".driver_version 191205\n"
+        ".globaldata\n"
+        "dat0: .int 1, 2, 3, 4\n"
+        ".kernel k0\n"
+        "    .config\n"
+        "        .dims x\n"
+        ".text\n"
+        "k0:\n"
+        "    s_load_dword s0, s[2:3], 0\n"
+        "    s_add_u32 s1, s0, 1\n"
+        "    s_mov_b32 s2, dat0&0xffffffff\n"
+        "    s_mov_b32 s3, (dat0+8)>>32\n"
+        "    s_endpgm\n");
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_AUTOWAIT,
+                    BinaryFormat::AMDCL2, GPUDeviceType::BONAIRE, errorStream);
+    const bool good = assembler.assemble();
+    assertTrue(testName, "good", good);
+    assertString(testName, "messages", "", errorStream.str().c_str());
+    
+    const AmdCL2Input* output = static_cast<const AsmAmdCL2Handler*>(
+                assembler.getFormatHandler())->getOutput();
+    const std::vector<AmdCL2RelInput>& relocs = output->kernels[0].relocations;
+    assertValue(testName, "relocsNum", size_t(2), relocs.size());
+    assertValue(testName, "reloc#0.offset", size_t(16), relocs[0].offset);
+    assertValue(testName, "reloc#0.type", int(RELTYPE_LOW_32BIT), int(relocs[0].type));
+    assertValue(testName, "reloc#0.addend", size_t(0), relocs[0].addend);
+    assertValue(testName, "reloc#1.offset", size_t(24), relocs[1].offset);
+    assertValue(testName, "reloc#1.type", int(RELTYPE_HIGH_32BIT), int(relocs[1].type));
+    assertValue(testName, "reloc#1.addend", size_t(8), relocs[1].addend);
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    for (cxuint i = 0; i < sizeof(waitInsertTestCases)/sizeof(AsmWaitInsertCase); i++)
+        try
+        { testWaitInsert(i, waitInsertTestCases[i]); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    retVal |= callTest(testWaitInsertRelocs);
+    return retVal;
+}
@@ -0,0 +1,209 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+struct WaitInstrEntry
+{
+    size_t offset;
+    uint16_t waits[ASM_WAIT_MAX_TYPES_NUM];  // vmcnt, lgkmcnt, expcnt, vscnt
+};
+
+struct AsmWaitScheduleCase
+{
+    const char* input;
+    GPUDeviceType deviceType;
+    cxuint maxBlockVisits;  // 0 - default
+    std::vector<WaitInstrEntry> waitInstrs; // needed wait instructions
+};
+
+static const AsmWaitScheduleCase waitScheduleTestCases[] =
+{
+    {   /* 0 - wait before use of loaded register */
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0,
+        { { 4, { 15, 0, 7, 0 } } }
+    },
+    {   /* 1 - no wait if loaded register is not used */
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_add_u32 s1, s2, 1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0, { }
+    },
+    {   /* 2 - wait instruction in code is respected */
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_waitcnt lgkmcnt(0)\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0, { }
+    },
+    {   /* 3 - relaxed vmcnt (ordered loads) */
+        "buffer_load_dword v1, v0, s[4:7], 0 offen\n"
+        "buffer_load_dword v2, v0, s[4:7], 0 offen\n"
+        "v_add_f32 v3, v1, v0\n"
+        "v_add_f32 v4, v2, v3\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0,
+        { { 16, { 1, 15, 7, 0 } }, { 20, { 0, 15, 7, 0 } } }
+    },
+    {   /* 4 - join of ways: load only in one way */
+        "s_cbranch_scc0 l1\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "l1:\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0,
+        { { 8, { 15, 0, 7, 0 } } }
+    },
+    {   /* 5 - loop: queue state at start of loop from end of loop */
+        "l0:\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l0\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0,
+        { { 0, { 15, 0, 7, 0 } } }
+    },
+    {   /* 6 - queue state after call from end of routine */
+        ".cf_call r\n"
+        "s_swappc_b64 s[6:7], s[4:5]\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_endpgm\n"
+        "r:\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        ".cf_ret\n"
+        "s_setpc_b64 s[6:7]\n",
+        GPUDeviceType::BONAIRE, 0,
+        { { 4, { 15, 0, 7, 0 } } }
+    },
+    {   /* 7 - nested loops */
+        "l0:\n"
+        "l1:\n"
+        "s_add_u32 s1, s0, 1\n"
+        "buffer_load_dword v1, v0, s[4:7], 0 offen\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l1\n"
+        "v_add_f32 v2, v1, v0\n"
+        "s_cbranch_scc1 l0\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 0,
+        { { 0, { 15, 0, 7, 0 } }, { 4, { 0, 15, 7, 0 } }, { 20, { 0, 15, 7, 0 } } }
+    },
+    {   /* 8 - limit of visits: wait for all operations at start of loop */
+        "buffer_load_dword v1, v0, s[4:7], 0 offen\n"
+        "l0:\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l0\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 1,
+        { { 8, { 0, 0, 0, 0 } } }
+    },
+    {   /* 9 - limit of visits: wait instruction at start of loop is not doubled */
+        "buffer_load_dword v1, v0, s[4:7], 0 offen\n"
+        "l0:\n"
+        "s_waitcnt vmcnt(0)\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l0\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 1,
+        { { 12, { 15, 0, 0, 0 } } }
+    },
+    {   /* 10 - limit of visits: wait instruction at start of loop waits for all */
+        "buffer_load_dword v1, v0, s[4:7], 0 offen\n"
+        "l0:\n"
+        "s_waitcnt vmcnt(0) & lgkmcnt(0) & expcnt(0)\n"
+        "s_add_u32 s1, s0, 1\n"
+        "s_load_dword s0, s[2:3], 0\n"
+        "s_cbranch_scc0 l0\n"
+        "s_endpgm\n",
+        GPUDeviceType::BONAIRE, 1, { }
+    }
+};
+
+static void testWaitSchedule(cxuint i, const AsmWaitScheduleCase& testCase)
+{
+    std::ostringstream nameOss;
+    nameOss << "WaitSchedule#" << i;
+    const std::string testName = nameOss.str();
+    
+    std::istringstream input(testCase.input);
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, (ASM_ALL&~ASM_ALTMACRO) | ASM_REGALLOC,
+                    BinaryFormat::RAWCODE, testCase.deviceType, errorStream);
+    const bool good = assembler.assemble();
+    assertTrue(testName, "good", good);
+    assertString(testName, "messages", "", errorStream.str().c_str());
+    
+    AsmRegAllocator regAlloc(assembler);
+    regAlloc.allocateRegisters(0);
+    const AsmSection& section = assembler.getSections()[0];
+    AsmWaitScheduler waitScheduler(assembler.getISAAssembler()->getWaitConfig(),
+                assembler, regAlloc.getCodeBlocks(), regAlloc.getVregIndexMaps(),
+                regAlloc.getGraphColorMaps());
+    if (testCase.maxBlockVisits != 0)
+        waitScheduler.setMaxBlockVisits(testCase.maxBlockVisits);
+    waitScheduler.schedule(*section.usageHandler, *section.waitHandler);
+    
+    const std::vector<AsmWaitInstr>& waitInstrs = waitScheduler.getNeededWaitInstrs();
+    assertValue(testName, "waitInstrsNum", testCase.waitInstrs.size(),
+                waitInstrs.size());
+    for (size_t j = 0; j < waitInstrs.size(); j++)
+    {
+        std::ostringstream caseOss;
+        caseOss << "waitInstr#" << j;
+        const std::string caseName = caseOss.str();
+        assertValue(testName, caseName + ".offset", testCase.waitInstrs[j].offset,
+                    waitInstrs[j].offset);
+        for (cxuint q = 0; q < ASM_WAIT_MAX_TYPES_NUM; q++)
+        {
+            std::ostringstream waitOss;
+            waitOss << caseName << ".waits[" << q << "]";
+            assertValue(testName, waitOss.str(), testCase.waitInstrs[j].waits[q],
+                        waitInstrs[j].waits[q]);
+        }
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    for (cxuint i = 0; i < sizeof(waitScheduleTestCases)/sizeof(AsmWaitScheduleCase);
+                i++)
+        try
+        { testWaitSchedule(i, waitScheduleTestCases[i]); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    return retVal;
+}
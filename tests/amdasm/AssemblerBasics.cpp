@@ -20,8 +20,14 @@
 #include <CLRX/Config.h>
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 #include <sstream>
+#include <fstream>
+#include <string>
+#include <utility>
 #include <memory>
+#include <algorithm>
+#include <chrono>
 #include <CLRX/utils/Containers.h>
 #include <CLRX/amdasm/Assembler.h>
 #include "../TestUtils.h"
@@ -49,25 +55,10 @@ static void pushSymbolsFromScopes(const AsmScope& scope,
     }
 }
 
-static void testAssembler(cxuint testSuiteId, cxuint testId, const AsmTestCase& testCase)
+static void checkAssemblerResult(const char* testName, const Assembler& assembler,
+            bool good, const AsmTestCase& testCase, std::ostringstream& errorStream,
+            std::ostringstream& printStream)
 {
-    std::istringstream input(testCase.input);
-    std::ostringstream errorStream;
-    std::ostringstream printStream;
-    
-    // create assembler with testcase input
-    // enable ASM_TESTRUN (needed while testing)
-    Assembler assembler("test.s", input, (ASM_ALL|ASM_TESTRUN)&~ASM_ALTMACRO,
-            BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, errorStream, printStream);
-    // include include dirs from testcase
-    for (const char* incDir: testCase.includeDirs)
-        assembler.addIncludeDir(incDir);
-    // just assemble
-    bool good = assembler.assemble();
-    /* compare results */
-    char testName[30];
-    snprintf(testName, 30, "Test%u #%u", testSuiteId, testId);
-    
     // check whether good, format, device, bitness is match
     assertValue(testName, "good", int(testCase.good), int(good));
     assertValue(testName, "format", int(testCase.format),
@@ -154,24 +145,339 @@ static void testAssembler(cxuint testSuiteId, cxuint testId, const AsmTestCase&
     assertString(testName, "printMessages", testCase.printMessages, printMsgs);
 }
 
+static void testAssembler(cxuint testSuiteId, cxuint testId, const AsmTestCase& testCase,
+            AsmIncludeCache* includeCache = nullptr, const char* testPrefix = "Test",
+            Flags extraFlags = 0)
+{
+    std::istringstream input(testCase.input);
+    std::ostringstream errorStream;
+    std::ostringstream printStream;
+    
+    // create assembler with testcase input
+    // enable ASM_TESTRUN (needed while testing)
+    Assembler assembler("test.s", input,
+            ((ASM_ALL|ASM_TESTRUN)&~ASM_ALTMACRO) | extraFlags,
+            BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, errorStream, printStream);
+    // include include dirs from testcase
+    for (const char* incDir: testCase.includeDirs)
+        assembler.addIncludeDir(incDir);
+    assembler.setIncludeCache(includeCache);
+    // just assemble
+    bool good = assembler.assemble();
+    /* compare results */
+    char testName[40];
+    snprintf(testName, 40, "%s%u #%u", testPrefix, testSuiteId, testId);
+    checkAssemblerResult(testName, assembler, good, testCase, errorStream, printStream);
+}
+
+// assemble testcase twice with include cache (second time with cached includes)
+static void testAssemblerIncludeCache(cxuint testSuiteId, cxuint testId,
+            const AsmTestCase& testCase)
+{
+    AsmIncludeCache includeCache;
+    testAssembler(testSuiteId, testId, testCase, &includeCache, "TestIncCache");
+    const size_t cachedNum = includeCache.size();
+    testAssembler(testSuiteId, testId, testCase, &includeCache, "TestIncCacheHit");
+    char testName[40];
+    snprintf(testName, 40, "TestIncCacheHit%u #%u", testSuiteId, testId);
+    if (cachedNum != 0)
+        assertTrue(testName, "cacheHits", includeCache.getHitsNum() != 0);
+}
+
+// assemble testcase by assembler reused after previous testcases
+static void testAssemblerReuse(cxuint testSuiteId, cxuint testId,
+            const AsmTestCase& testCase, Assembler& assembler,
+            std::ostringstream& errorStream, std::ostringstream& printStream)
+{
+    errorStream.str("");
+    printStream.str("");
+    assembler.reset("test.s", ::strlen(testCase.input), testCase.input);
+    bool good = assembler.assemble();
+    /* compare results */
+    char testName[40];
+    snprintf(testName, 40, "TestReuse%u #%u", testSuiteId, testId);
+    checkAssemblerResult(testName, assembler, good, testCase, errorStream, printStream);
+}
+
+static int testAssemblerSuite(cxuint testSuiteId, const AsmTestCase* testCases)
+{
+    int retVal = 0;
+    for (size_t i = 0; testCases[i].input != nullptr; i++)
+        try
+        { testAssembler(testSuiteId, i, testCases[i]); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    
+    // assemble testcases with include dirs with include cache
+    for (size_t i = 0; testCases[i].input != nullptr; i++)
+        if (!testCases[i].includeDirs.empty())
+            try
+            { testAssemblerIncludeCache(testSuiteId, i, testCases[i]); }
+            catch(const std::exception& ex)
+            {
+                std::cerr << ex.what() << std::endl;
+                retVal = 1;
+            }
+    
+    // assemble same testcases (without include dirs) by one assembler
+    std::ostringstream errorStream;
+    std::ostringstream printStream;
+    Assembler assembler("test.s", 0, "", (ASM_ALL|ASM_TESTRUN)&~ASM_ALTMACRO,
+            BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, errorStream, printStream);
+    for (size_t i = 0; testCases[i].input != nullptr; i++)
+        if (testCases[i].includeDirs.empty())
+            try
+            { testAssemblerReuse(testSuiteId, i, testCases[i], assembler,
+                        errorStream, printStream); }
+            catch(const std::exception& ex)
+            {
+                std::cerr << ex.what() << std::endl;
+                retVal = 1;
+            }
+    return retVal;
+}
+
+static const std::pair<BinaryFormat, const char*> reuseFormatSources[] =
+{
+    { BinaryFormat::AMD, ".kernel a\n    .config\n    .dims x\n"
+        ".text\n    s_mov_b32 s1, s2\n    s_endpgm\n" },
+    { BinaryFormat::AMDCL2, ".kernel a\n    .config\n    .dims x\n"
+        ".text\n    s_mov_b32 s1, s2\n    s_endpgm\n" },
+    { BinaryFormat::GALLIUM, ".kernel a\n    .args\n    .arg scalar, 4\n"
+        "    .config\n    .dims x\n.text\na:\n    .skip 256\n    s_mov_b32 s1, s2\n"
+        "    s_endpgm\n" },
+    { BinaryFormat::ROCM, ".kernel a\n    .config\n    .dims x\n"
+        ".text\na:\n    .skip 256\n    s_mov_b32 s1, s2\n    s_endpgm\n" },
+    { BinaryFormat::RAWCODE, "    s_mov_b32 s1, s2\n    s_endpgm\n" }
+};
+
+/* assemble sources of binary formats by reused assembler (format handler and
+ * ISA assembler must be reused) and compare binaries with new assembler */
+static void testAssemblerReuseFormat(cxuint testId,
+            const std::pair<BinaryFormat, const char*>& testCase)
+{
+    char testName[40];
+    snprintf(testName, 40, "TestReuseFormat #%u", testId);
+    std::ostringstream errorStream;
+    std::ostringstream printStream;
+    const size_t sourceSize = ::strlen(testCase.second);
+    Array<cxbyte> expectedBinary;
+    {
+        Assembler assembler("test.s", sourceSize, testCase.second, ASM_WARNINGS,
+                testCase.first, GPUDeviceType::FIJI, errorStream, printStream);
+        assertTrue(testName, "good", assembler.assemble());
+        assembler.writeBinary(expectedBinary);
+    }
+    Assembler assembler("test.s", sourceSize, testCase.second, ASM_WARNINGS,
+                testCase.first, GPUDeviceType::FIJI, errorStream, printStream);
+    assertTrue(testName, "good0", assembler.assemble());
+    const AsmFormatHandler* formatHandler = assembler.getFormatHandler();
+    const ISAAssembler* isaAssembler = assembler.getISAAssembler();
+    for (cxuint i = 1; i <= 2; i++)
+    {
+        std::string caseName = "#" + std::to_string(i);
+        assembler.reset("test.s", sourceSize, testCase.second);
+        assertTrue(testName, "good"+caseName, assembler.assemble());
+        assertTrue(testName, "formatHandlerReused"+caseName,
+                   formatHandler == assembler.getFormatHandler());
+        assertTrue(testName, "isaAssemblerReused"+caseName,
+                   isaAssembler == assembler.getISAAssembler());
+        Array<cxbyte> binary;
+        assembler.writeBinary(binary);
+        assertArray(testName, "binary"+caseName, expectedBinary, binary);
+    }
+    assertString(testName, "errors", "", errorStream.str());
+}
+
+struct IncludeCacheDepsCase
+{
+    const char* input;
+    uint64_t depZValue;
+    bool cacheHit;
+};
+
+/* include cache entry depends only on symbols and macros used by included file
+ * (other symbols and macros can be changed) */
+static const IncludeCacheDepsCase includeCacheDepsCases[] =
+{
+    { ".set other, 1\ndepX = 2\n.macro putdep name, value\n.set \\name, \\value\n.endm\n"
+        ".include \"incdeps.s\"\n", 7, false },
+    // unused symbol and macro changed
+    { ".set other, 5\n.macro other2\n.endm\ndepX = 2\n"
+        ".macro putdep name, value\n.set \\name, \\value\n.endm\n"
+        ".include \"incdeps.s\"\n", 7, true },
+    // used symbol changed
+    { "depX = 4\n.macro putdep name, value\n.set \\name, \\value\n.endm\n"
+        ".include \"incdeps.s\"\n", 13, false },
+    // used macro changed
+    { "depX = 4\n.macro putdep name, value\n.set \\name, \\value*2\n.endm\n"
+        ".include \"incdeps.s\"\n", 14, false },
+    // both previous states are cached
+    { "depX = 2\n.macro putdep name, value\n.set \\name, \\value\n.endm\n"
+        ".include \"incdeps.s\"\n", 7, true },
+    { "depX = 4\n.macro putdep name, value\n.set \\name, \\value*2\n.endm\n"
+        ".include \"incdeps.s\"\n", 14, true }
+};
+
+static void testIncludeCacheDeps(cxuint testId, const IncludeCacheDepsCase& testCase,
+            AsmIncludeCache& includeCache)
+{
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", ::strlen(testCase.input), testCase.input, ASM_ALL,
+            BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, errorStream);
+    assembler.addIncludeDir(CLRX_SOURCE_DIR "/tests/amdasm/incdir1");
+    assembler.setIncludeCache(&includeCache);
+    const size_t oldHitsNum = includeCache.getHitsNum();
+    char testName[40];
+    snprintf(testName, 40, "TestIncCacheDeps #%u", testId);
+    assertTrue(testName, "good", assembler.assemble());
+    assertString(testName, "errorMessages", "", errorStream.str());
+    assertValue(testName, "cacheHit", int(testCase.cacheHit),
+                int(includeCache.getHitsNum() != oldHitsNum));
+    const AsmSymbolMap& symbolMap = assembler.getSymbolMap();
+    AsmSymbolMap::const_iterator it = symbolMap.find("depZ");
+    assertTrue(testName, "depZ", it != symbolMap.end() && it->second.hasValue);
+    assertValue(testName, "depZValue", testCase.depZValue, it->second.value);
+}
+
+/* nested included file found in include directory can be shadowed by new file
+ * in working directory (searched before include directories) */
+static void testIncludeCacheShadowing()
+{
+    AsmIncludeCache includeCache;
+    const char* source = ".include \"incdefs.s\"\n";
+    const cxuint expHits[4] = { 0, 1, 0, 1 };
+    const uint64_t expDefBValues[4] = { 35, 35, 37, 35 };
+    for (cxuint i = 0; i < 4; i++)
+    {
+        char testName[40];
+        snprintf(testName, 40, "TestIncCacheShadow #%u", i);
+        if (i == 2)
+        {
+            std::ofstream ofs("incdefs2.s");
+            ofs << "defC = 5\ndefE = 10\n";
+        }
+        std::ostringstream errorStream;
+        Assembler assembler("test.s", ::strlen(source), source, ASM_ALL,
+                BinaryFormat::AMD, GPUDeviceType::CAPE_VERDE, errorStream);
+        assembler.addIncludeDir(CLRX_SOURCE_DIR "/tests/amdasm/incdir1");
+        assembler.setIncludeCache(&includeCache);
+        const size_t oldHitsNum = includeCache.getHitsNum();
+        const bool good = assembler.assemble();
+        if (i == 2)
+            std::remove("incdefs2.s");
+        assertTrue(testName, "good", good);
+        assertValue(testName, "cacheHits", size_t(expHits[i]),
+                    includeCache.getHitsNum() - oldHitsNum);
+        const AsmSymbolMap& symbolMap = assembler.getSymbolMap();
+        AsmSymbolMap::const_iterator it = symbolMap.find("defB");
+        assertTrue(testName, "defB", it != symbolMap.end() && it->second.hasValue);
+        assertValue(testName, "defBValue", expDefBValues[i], it->second.value);
+    }
+}
+
+/* assemble many times sources of binary formats (with changing defsym)
+ * by new assembler and by reused assembler (reset) */
+static void benchmarkAssemblerReuse(cxuint scale)
+{
+    const size_t buildsNum = size_t(10000)*scale;
+    std::ostringstream errorStream;
+    std::ostringstream printStream;
+    static const char* formatNames[] = { "AMD", "AMDCL2", "Gallium", "ROCm", "rawcode" };
+    for (cxuint f = 0; f < sizeof(reuseFormatSources)/sizeof(reuseFormatSources[0]); f++)
+    {
+        const std::pair<BinaryFormat, const char*>& testCase = reuseFormatSources[f];
+        const size_t sourceSize = ::strlen(testCase.second);
+        double times[2];
+        size_t binarySizes[2] = { 0, 0 };
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < buildsNum; i++)
+        {
+            Assembler assembler("test.s", sourceSize, testCase.second, ASM_WARNINGS,
+                    testCase.first, GPUDeviceType::FIJI, errorStream, printStream);
+            assembler.addInitialDefSym("xdef", i);
+            assertTrue("reuseBench", "good", assembler.assemble());
+            Array<cxbyte> binary;
+            assembler.writeBinary(binary);
+            binarySizes[0] += binary.size();
+        }
+        times[0] = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        {
+            Assembler assembler("test.s", sourceSize, testCase.second, ASM_WARNINGS,
+                    testCase.first, GPUDeviceType::FIJI, errorStream, printStream);
+            for (size_t i = 0; i < buildsNum; i++)
+            {
+                assembler.reset("test.s", sourceSize, testCase.second);
+                assembler.clearInitialDefSyms();
+                assembler.addInitialDefSym("xdef", i);
+                assertTrue("reuseBench", "good", assembler.assemble());
+                Array<cxbyte> binary;
+                assembler.writeBinary(binary);
+                binarySizes[1] += binary.size();
+            }
+        }
+        times[1] = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        assertValue("reuseBench", "binarySize", binarySizes[0], binarySizes[1]);
+        std::cout << "Assembling " << formatNames[f] << " (" <<
+                buildsNum << " times): new assembler " << times[0]*1000.0 <<
+                " ms, reset " << times[1]*1000.0 << " ms" << std::endl;
+    }
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
-    for (size_t i = 0; asmTestCases1Tbl[i].input != nullptr; i++)
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    if (scale != 1)
+    {
+        try
+        { benchmarkAssemblerReuse(scale); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+        return retVal;
+    }
+    retVal |= testAssemblerSuite(0, asmTestCases1Tbl);
+    retVal |= testAssemblerSuite(1, asmTestCases2Tbl);
+    // testcases with resolving symbols at end of assembly
+    for (size_t i = 0; asmTestCasesResolveTbl[i].input != nullptr; i++)
+        try
+        { testAssembler(2, i, asmTestCasesResolveTbl[i], nullptr, "TestResolve",
+                    ASM_TESTRESOLVE); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+    for (cxuint i = 0; i < sizeof(reuseFormatSources)/sizeof(reuseFormatSources[0]); i++)
         try
-        { testAssembler(0, i, asmTestCases1Tbl[i]); }
+        { testAssemblerReuseFormat(i, reuseFormatSources[i]); }
         catch(const std::exception& ex)
         {
             std::cerr << ex.what() << std::endl;
             retVal = 1;
         }
-    for (size_t i = 0; asmTestCases2Tbl[i].input != nullptr; i++)
+    AsmIncludeCache includeCache;
+    for (cxuint i = 0; i < sizeof(includeCacheDepsCases)/
+                sizeof(includeCacheDepsCases[0]); i++)
         try
-        { testAssembler(1, i, asmTestCases2Tbl[i]); }
+        { testIncludeCacheDeps(i, includeCacheDepsCases[i], includeCache); }
         catch(const std::exception& ex)
         {
             std::cerr << ex.what() << std::endl;
             retVal = 1;
         }
+    retVal |= callTest(testIncludeCacheShadowing);
     return retVal;
 }
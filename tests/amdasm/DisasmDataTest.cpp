@@ -2206,7 +2206,8 @@ sample_kernel2:
 )ffDXD", true, false }
 };
 
-static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
+static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase,
+            bool parallel)
 {
     std::ostringstream disasmOss;
     std::string resultStr;
@@ -2215,6 +2216,9 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
         disasmFlags |= DISASM_CONFIG;
     if (testCase.hsaConfig)
         disasmFlags |= DISASM_HSACONFIG;
+    // parallel disassembling must give same output
+    if (parallel)
+        disasmFlags |= DISASM_PARALLEL;
     
     bool haveException = false;
     std::string resExceptionStr;
@@ -2226,12 +2230,14 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
         if (testCase.amdInput != nullptr)
         {
             Disassembler disasm(testCase.amdInput, disasmOss, disasmFlags);
+            disasm.setThreadsNum(3);
             disasm.disassemble();
             resultStr = disasmOss.str();
         }
         else if (testCase.galliumInput != nullptr)
         {
             Disassembler disasm(testCase.galliumInput, disasmOss, disasmFlags);
+            disasm.setThreadsNum(3);
             disasm.disassemble();
             resultStr = disasmOss.str();
         }
@@ -2251,6 +2257,7 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
                     AMDBIN_CREATE_INFOSTRINGS));
             AmdMainGPUBinary32* amdGpuBin = static_cast<AmdMainGPUBinary32*>(base.get());
             Disassembler disasm(*amdGpuBin, disasmOss, disasmFlags);
+            disasm.setThreadsNum(3);
             disasm.disassemble();
             resultStr = disasmOss.str();
         }
@@ -2264,6 +2271,7 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
                 AMDBIN_CREATE_INFOSTRINGS | AMDCL2BIN_INNER_CREATE_KERNELDATA |
                 AMDCL2BIN_INNER_CREATE_KERNELDATAMAP | AMDCL2BIN_INNER_CREATE_KERNELSTUBS);
             Disassembler disasm(amdBin, disasmOss, disasmFlags);
+            disasm.setThreadsNum(3);
             disasm.disassemble();
             resultStr = disasmOss.str();
         }
@@ -2272,6 +2280,7 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
             // if ROCm (HSACO) binary
             ROCmBinary rocmBin(binaryData.size(), binaryData.data(), 0);
             Disassembler disasm(rocmBin, disasmOss, disasmFlags);
+            disasm.setThreadsNum(3);
             disasm.disassemble();
             resultStr = disasmOss.str();
         }
@@ -2280,6 +2289,7 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
             GalliumBinary galliumBin(binaryData.size(),binaryData.data(), 0);
             Disassembler disasm(GPUDeviceType::CAPE_VERDE, galliumBin,
                             disasmOss, disasmFlags, testCase.llvmVersion);
+            disasm.setThreadsNum(3);
             disasm.disassemble();
             resultStr = disasmOss.str();
         }
@@ -2294,7 +2304,7 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
     std::string caseName;
     {
         std::ostringstream oss;
-        oss << "DisasmCase#" << testId;
+        oss << "DisasmCase#" << testId << (parallel ? "P" : "");
         oss.flush();
         caseName = oss.str();
     }
@@ -2313,7 +2323,7 @@ static void testDisasmData(cxuint testId, const DisasmAmdTestCase& testCase)
     {
         // print error
         std::ostringstream oss;
-        oss << "Failed for #" << testId << std::endl;
+        oss << "Failed for #" << testId << (parallel ? " (parallel)" : "") << std::endl;
         oss << resultStr << std::endl;
         oss.flush();
         throw Exception(oss.str());
@@ -2324,12 +2334,13 @@ int main(int argc, const char** argv)
 {
     int retVal = 0;
     for (cxuint i = 0; i < sizeof(disasmDataTestCases)/sizeof(DisasmAmdTestCase); i++)
-        try
-        { testDisasmData(i, disasmDataTestCases[i]); }
-        catch(const std::exception& ex)
-        {
-            std::cerr << ex.what() << std::endl;
-            retVal = 1;
-        }
+        for (bool parallel: { false, true })
+            try
+            { testDisasmData(i, disasmDataTestCases[i], parallel); }
+            catch(const std::exception& ex)
+            {
+                std::cerr << ex.what() << std::endl;
+                retVal = 1;
+            }
     return retVal;
 }
@@ -17,9 +17,16 @@
  */
 
 #include <CLRX/Config.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstring>
 #include <CLRX/utils/Utilities.h>
+#include <CLRX/utils/Containers.h>
 #include <CLRX/amdasm/Assembler.h>
 #include <CLRX/utils/MemAccess.h>
 #include "GCNAsmOpc.h"
@@ -166,9 +173,135 @@ static void testEncGCNOpcodes2(cxuint i, const GCNAsmOpcodeCase2& testCase,
 }
 
 
+// FNV-1a hash (this same as in hash table of mnemonics in GCN assembler)
+static inline uint32_t mnemonicHash(const char* mnemonic)
+{
+    uint32_t hash = 2166136261U;
+    for (const char* p = mnemonic; *p != 0; p++)
+        hash = (hash ^ cxbyte(*p)) * 16777619U;
+    return hash;
+}
+
+/* compare lookup of mnemonics in sorted table (binary search, old way)
+ * with lookup in open-addressing hash table (used by GCN assembler) and
+ * measure assembling of all good GCN1.2 instructions */
+static void benchmarkGCNMnemonicLookup(cxuint scale)
+{
+    // collect mnemonics from testcases
+    std::vector<std::string> mnemonicStrs;
+    std::string source;
+    for (cxuint i = 0; encGCN12OpcodeCases[i].input!=nullptr; i++)
+    {
+        const GCNAsmOpcodeCase& testCase = encGCN12OpcodeCases[i];
+        if (!testCase.good)
+            continue;
+        // temporary scope for symbols defined in testcase
+        source += ".scope\n";
+        source += testCase.input;
+        source += "\n.ends\n";
+        const char* start = testCase.input;
+        while (*start == ' ' || *start == '\t') start++;
+        const char* end = start;
+        while (*end != 0 && *end != ' ' && *end != '\t') end++;
+        mnemonicStrs.push_back(std::string(start, end));
+    }
+    std::sort(mnemonicStrs.begin(), mnemonicStrs.end());
+    mnemonicStrs.resize(std::unique(mnemonicStrs.begin(), mnemonicStrs.end()) -
+                mnemonicStrs.begin());
+    
+    // sorted table
+    std::vector<const char*> sortedTable;
+    for (const std::string& mnemonic: mnemonicStrs)
+        sortedTable.push_back(mnemonic.c_str());
+    // hash table (load factor <= 1/4)
+    size_t hashSize = 1;
+    while (hashSize < (sortedTable.size()<<2))
+        hashSize <<= 1;
+    const size_t hashMask = hashSize-1;
+    std::vector<const char*> hashTable(hashSize, nullptr);
+    for (const char* mnemonic: sortedTable)
+    {
+        size_t j = mnemonicHash(mnemonic) & hashMask;
+        while (hashTable[j] != nullptr)
+            j = (j+1) & hashMask;
+        hashTable[j] = mnemonic;
+    }
+    
+    // mnemonics to find (copies to avoid comparing pointers only)
+    std::mt19937 rng(scale);
+    std::vector<std::string> queries(4096);
+    for (std::string& query: queries)
+        query = mnemonicStrs[rng() % mnemonicStrs.size()];
+    const size_t lookupsNum = size_t(1000000)*scale;
+    
+    size_t foundNums[2] = { 0, 0 };
+    double times[2];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookupsNum; i++)
+    {
+        const char* mnemonic = queries[i & 4095].c_str();
+        auto it = binaryFind(sortedTable.begin(), sortedTable.end(), mnemonic,
+                [](const char* m1, const char* m2)
+                { return ::strcmp(m1, m2)<0; });
+        if (it != sortedTable.end())
+            foundNums[0]++;
+    }
+    times[0] = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookupsNum; i++)
+    {
+        const char* mnemonic = queries[i & 4095].c_str();
+        for (size_t j = mnemonicHash(mnemonic) & hashMask; hashTable[j] != nullptr;
+                    j = (j+1) & hashMask)
+            if (::strcmp(hashTable[j], mnemonic)==0)
+            {
+                foundNums[1]++;
+                break;
+            }
+    }
+    times[1] = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    assertValue("mnemonicBench", "foundNum", foundNums[0], foundNums[1]);
+    std::cout << "Mnemonic lookups (" << lookupsNum << ", " << sortedTable.size() <<
+            " mnemonics): sorted table " << times[0]*1000.0 << " ms, hash table " <<
+            times[1]*1000.0 << " ms" << std::endl;
+    
+    // assemble all good instructions
+    std::string bigSource;
+    for (cxuint i = 0; i < scale; i++)
+        bigSource += source;
+    std::istringstream input(bigSource);
+    std::ostringstream errorStream;
+    Assembler assembler("test.s", input, ASM_ALL&~(ASM_ALTMACRO|ASM_WAVE32),
+                    BinaryFormat::RAWCODE, GPUDeviceType::TONGA, errorStream);
+    start = std::chrono::steady_clock::now();
+    const bool good = assembler.assemble();
+    const double asmTime = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    assertTrue("mnemonicBench", "good", good);
+    std::cout << "Assembling " << bigSource.size() << " bytes: " <<
+            asmTime*1000.0 << " ms" << std::endl;
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    if (scale != 1)
+    {
+        try
+        { benchmarkGCNMnemonicLookup(scale); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+        return retVal;
+    }
     for (cxuint i = 0; encGCNOpcodeCases[i].input!=nullptr; i++)
         try
         { testEncGCNOpcodes(i, encGCNOpcodeCases[i], GPUDeviceType::PITCAIRN, 0); }
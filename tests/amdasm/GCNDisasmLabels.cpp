@@ -21,6 +21,8 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <vector>
+#include <chrono>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/utils/Containers.h>
 #include <CLRX/amdasm/Disassembler.h>
@@ -468,9 +470,62 @@ static void testDecGCNRelocations()
         throw Exception("FAILED relocationTest: result: "+disOss.str());
 }
 
+// disassemble big code with many labels (built from GCN1.2 testcases)
+static void benchmarkGCNDisasmLabels(cxuint scale)
+{
+    std::vector<uint32_t> code;
+    const size_t repeatsNum = size_t(2000)*scale;
+    const size_t casesNum = sizeof(decGCN12LabelCases)/sizeof(GCNDisasmLabelCase);
+    for (size_t r = 0; r < repeatsNum; r++)
+        for (size_t i = 0; i < casesNum; i++)
+            for (uint32_t word: decGCN12LabelCases[i].words)
+                code.push_back(LEV(word));
+    
+    std::ostringstream disOss;
+    AmdDisasmInput input;
+    input.deviceType = GPUDeviceType::TONGA;
+    input.is64BitMode = false;
+    Disassembler disasm(&input, disOss, DISASM_FLOATLITS);
+    GCNDisassembler gcnDisasm(disasm);
+    gcnDisasm.setInput(code.size()<<2, reinterpret_cast<const cxbyte*>(code.data()));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    gcnDisasm.beforeDisassemble();
+    const double analyzeTime = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    gcnDisasm.disassemble();
+    const double disasmTime = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    // every testcase has branch and label
+    const std::string outStr = disOss.str();
+    size_t labelsNum = 0;
+    for (size_t pos = 0; (pos = outStr.find("\n.L", pos)) != std::string::npos; pos++)
+        labelsNum++;
+    if (labelsNum < repeatsNum*casesNum)
+        throw Exception("FAILED benchmarkGCNDisasmLabels: too few labels");
+    std::cout << "Disassembling " << code.size() << " words (" << labelsNum <<
+            " labels): analyze " << analyzeTime*1000.0 << " ms, disassemble " <<
+            disasmTime*1000.0 << " ms" << std::endl;
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    if (scale != 1)
+    {
+        try
+        { benchmarkGCNDisasmLabels(scale); }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
+        return retVal;
+    }
     for (cxuint i = 0; i < sizeof(decGCNLabelCases)/sizeof(GCNDisasmLabelCase); i++)
         try
         { testDecGCNLabels(i, decGCNLabelCases[i], GPUDeviceType::PITCAIRN); }
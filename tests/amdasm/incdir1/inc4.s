@@ -0,0 +1,9 @@
+        .byte 1, 2 # comment
+	.byte 3 /* long
+comment */ .byte 4 ; .byte 5
+.byte \
+6
+.print "a;#\"b"
+        .byte 7
+.warning "x"
+.byte 8
\ No newline at end of file
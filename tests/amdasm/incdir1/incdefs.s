@@ -0,0 +1,12 @@
+            # only declarations (results can be stored in include cache)
+            .include "incdefs2.s"
+            .set defA, 0x10
+            defB = defA*2 + defC
+.ifdef defA
+            defD = 7
+.else
+            defD = 8
+.endif
+            .macro putdef name, value
+                .int \name+\value
+            .endm
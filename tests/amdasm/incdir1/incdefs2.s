@@ -0,0 +1,5 @@
+            defC = 3
+            defE = 10
+            .rept 2
+            .set defE, defE+1
+            .endr
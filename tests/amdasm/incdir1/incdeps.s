@@ -0,0 +1,3 @@
+            # uses symbol and macro defined before inclusion
+            depY = depX*3
+            putdep depZ, depY+1
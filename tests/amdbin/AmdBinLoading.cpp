@@ -18,6 +18,7 @@
  */
 
 #include <CLRX/Config.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <CLRX/utils/Containers.h>
@@ -491,6 +492,24 @@ static void testKernelArgs(const char* filename, const char* kernelName,
     }
 }
 
+// testing loading binaries through MappedFile
+static void testKernelArgsMapped(const char* filename, const char* kernelName,
+               size_t expKernelArgsNum)
+{
+    const std::string testName = std::string("testKernelArgsMapped:") + filename;
+    
+    MappedFile data(filename);
+    std::unique_ptr<AmdMainBinaryBase> base;
+    if (isAmdCL2Binary(data.getSize(), data.getContent()))
+        base.reset(new AmdCL2MainGPUBinary64(data.getSize(), data.getContent()));
+    else // old Amd CL1.1/1.2 binary
+        base.reset(createAmdBinaryFromCode(data.getSize(), data.getContent()));
+    
+    const KernelInfo& kernelInfo = base->getKernelInfo(size_t(0));
+    assertValue(testName, "KernelName", CString(kernelName), kernelInfo.kernelName);
+    assertValue(testName, "argInfosNum", expKernelArgsNum, kernelInfo.argInfos.size());
+}
+
 static const cxbyte defaultHeader[32] = { };
 
 static AmdMainGPUBinaryBase* genAmdBinWithMetadata(const std::string& metadata)
@@ -608,6 +627,53 @@ static void testBinLoadingFailCase(cxuint testCaseId, const BinLoadingFailCase&
     }
 }
 
+// checking failures on binary loaded through MappedFile, changes of mapped content
+// must not be written to file
+static void testBinLoadingFailCaseMapped(cxuint testCaseId,
+            const BinLoadingFailCase& testCase)
+{
+    const Array<cxbyte> origData = loadDataFromFile(testCase.filename);
+    {
+        MappedFile data(testCase.filename);
+        for (size_t i = 0; i < testCase.change.size(); i++)
+            data.getContent()[testCase.changeOffset+i] = testCase.change[i];
+        bool failed = false;
+        try
+        {
+            std::unique_ptr<AmdMainBinaryBase> base(createAmdBinaryFromCode(
+                    data.getSize(), data.getContent(), 0));
+        }
+        catch(const Exception& ex)
+        {
+            if (::strcmp(testCase.exception, ex.what())!=0)
+            {
+                std::ostringstream oss;
+                oss << "Exception not match for mapped #" << testCaseId <<
+                        " file=" << testCase.filename <<
+                        ": expectedException=" << testCase.exception  <<
+                        ", resultException=" << ex.what();
+                throw Exception(oss.str());
+            }
+            failed = true;
+        }
+        if (!failed)
+        {
+            std::ostringstream oss;
+            oss << "Not failed for mapped #" << testCaseId <<
+                    " file=" << testCase.filename;
+            throw Exception(oss.str());
+        }
+    }
+    const Array<cxbyte> afterData = loadDataFromFile(testCase.filename);
+    if (origData.size() != afterData.size() ||
+        !std::equal(origData.begin(), origData.end(), afterData.begin()))
+    {
+        std::ostringstream oss;
+        oss << "File changed by mapped #" << testCaseId << " file=" << testCase.filename;
+        throw Exception(oss.str());
+    }
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
@@ -656,6 +722,12 @@ int main(int argc, const char** argv)
     retVal |= callTest(testKernelArgs, CLRX_SOURCE_DIR
             "/tests/amdbin/amdbins/structkernel2_cpu64.clo", "myKernel1",
             sizeof(expectedCPUKernelArgs2)/sizeof(AmdKernelArg), expectedCPUKernelArgs2);
+    retVal |= callTest(testKernelArgsMapped, CLRX_SOURCE_DIR
+            "/tests/amdbin/amdbins/alltypes.clo",
+            "myKernel", sizeof(expectedKernelArgs1)/sizeof(AmdKernelArg));
+    retVal |= callTest(testKernelArgsMapped, CLRX_SOURCE_DIR
+            "/tests/amdbin/amdbins/alltypes-15_11.clo",
+            "myKernel", sizeof(expectedCL2NewKernelArgs1)/sizeof(AmdKernelArg));
     retVal |= callTest(testAmdGPUMetadataGen);
     
     for (cxuint i = 0; i < sizeof(binLoadingTestCases)/sizeof(BinLoadingFailCase); i++)
@@ -667,6 +739,13 @@ int main(int argc, const char** argv)
             std::cerr << ex.what() << std::endl;
             retVal = 1;
         }
+        try
+        { testBinLoadingFailCaseMapped(i, binLoadingTestCases[i]); }
+        catch(const Exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            retVal = 1;
+        }
     }
     
     return retVal;
@@ -18,6 +18,9 @@
  */
 
 #include <CLRX/Config.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <memory>
@@ -845,6 +848,25 @@ static void testOrigBinary(cxuint testCase, const char* origBinaryFilename, bool
     // generate output binary
     AmdCL2GPUBinGenerator binGen(&amdCL2Input);
     binGen.generate(output);
+    // binary generated to stream and vector must be same
+    std::ostringstream streamOutput;
+    binGen.generate(streamOutput);
+    std::vector<char> vectorOutput;
+    binGen.generate(vectorOutput);
+    const std::string streamContent = streamOutput.str();
+    if (streamContent.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), streamContent.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }) ||
+        vectorOutput.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), vectorOutput.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }))
+    {
+        std::ostringstream oss;
+        oss << "Failed for #" << testCase << (hsaLayout ? " HSALayout" : "") <<
+                " file=" << origBinaryFilename <<
+                ": outputs mismatch";
+        throw Exception(oss.str());
+    }
     
     // compare generated binary with input
     if (output.size() != inputData.size())
@@ -866,9 +888,107 @@ static void testOrigBinary(cxuint testCase, const char* origBinaryFilename, bool
         }
 }
 
+/* generate binary with many kernels (from configuration) to Array (memory mode of
+ * FastOutputBuffer), vector and stream. outputs must be same. if scale is greater
+ * than 1, then generating time is measured */
+static void testMultiKernelBinary(cxuint scale)
+{
+    const cxuint kernelsNum = 200*scale;
+    // s_nop's and s_endpgm
+    std::vector<uint32_t> code(64, LEV(0xbf800000U));
+    code.back() = LEV(0xbf810000U);
+    AmdCL2Input amdCL2Input{};
+    amdCL2Input.is64Bit = true;
+    amdCL2Input.deviceType = GPUDeviceType::BONAIRE;
+    amdCL2Input.archMinor = amdCL2Input.archStepping = UINT32_MAX;
+    amdCL2Input.driverVersion = 200406;
+    for (cxuint i = 0; i < kernelsNum; i++)
+    {
+        std::ostringstream nameOss;
+        nameOss << "kernel" << i;
+        amdCL2Input.addEmptyKernel(nameOss.str().c_str());
+        AmdCL2KernelInput& kernel = amdCL2Input.kernels.back();
+        kernel.useConfig = true;
+        kernel.config.dimMask = 1;
+        kernel.config.usedSGPRsNum = 16;
+        kernel.config.usedVGPRsNum = 8;
+        kernel.config.args.push_back(AmdKernelArgInput::gptr("out", "float*",
+                    KernelArgType::FLOAT));
+        kernel.codeSize = code.size()*4;
+        kernel.code = reinterpret_cast<const cxbyte*>(code.data());
+    }
+    
+    AmdCL2GPUBinGenerator binGen(&amdCL2Input);
+    const cxuint runsNum = (scale > 1) ? 4 : 1;
+    Array<cxbyte> output;
+    std::vector<char> vectorOutput;
+    std::string streamContent;
+    // first generating prepares layout of binary
+    auto prepStartTime = std::chrono::steady_clock::now();
+    binGen.generate(output);
+    const double prepTime = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - prepStartTime).count();
+    double arrayTime = 0.0, vectorTime = 0.0, streamTime = 0.0;
+    for (cxuint r = 0; r < runsNum; r++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        binGen.generate(output);
+        auto arrayEndTime = std::chrono::steady_clock::now();
+        vectorOutput.clear();
+        binGen.generate(vectorOutput);
+        auto vectorEndTime = std::chrono::steady_clock::now();
+        std::ostringstream streamOutput;
+        binGen.generate(streamOutput);
+        streamContent = streamOutput.str();
+        auto streamEndTime = std::chrono::steady_clock::now();
+        arrayTime += std::chrono::duration<double>(arrayEndTime - startTime).count();
+        vectorTime += std::chrono::duration<double>(
+                    vectorEndTime - arrayEndTime).count();
+        streamTime += std::chrono::duration<double>(
+                    streamEndTime - vectorEndTime).count();
+    }
+    
+    if (streamContent.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), streamContent.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }) ||
+        vectorOutput.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), vectorOutput.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }))
+        throw Exception("Failed for MultiKernel: outputs mismatch");
+    // all kernels must be in binary
+    std::unique_ptr<AmdCL2MainGPUBinaryBase> amdCL2GpuBin(
+            createAmdCL2BinaryFromCode(output.size(), output.data(),
+                AMDBIN_CREATE_KERNELINFO | AMDBIN_CREATE_KERNELINFOMAP |
+                AMDBIN_CREATE_INNERBINMAP));
+    if (amdCL2GpuBin->getKernelInfosNum() != kernelsNum)
+        throw Exception("Failed for MultiKernel: wrong kernels number");
+    
+    if (scale > 1)
+        std::cout << "AmdCL2 binary (" << kernelsNum << " kernels, " <<
+                output.size() << " bytes, " << runsNum << " runs): first: " <<
+                prepTime*1000.0 << " ms, array: " <<
+                arrayTime*1000.0 << " ms, vector: " << vectorTime*1000.0 <<
+                " ms, stream: " << streamTime*1000.0 << " ms" << std::endl;
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    
+    try
+    { testMultiKernelBinary(scale); }
+    catch(const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        retVal = 1;
+    }
+    if (scale > 1)
+        return retVal;
+    
     for (cxuint i = 0; i < sizeof(origBinaryFiles)/sizeof(const char*); i++)
     {
         std::string regenName = origBinaryFiles[i];
@@ -0,0 +1,232 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <CLRX/Config.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <CLRX/utils/Containers.h>
+#include <CLRX/amdbin/ElfBinaries.h>
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+static const char* origBinaryFiles[3] =
+{
+    CLRX_SOURCE_DIR "/tests/amdbin/rocmbins/consttest1-kaveri.hsaco.regen",
+    CLRX_SOURCE_DIR "/tests/amdbin/rocmbins/rijndael.hsaco.regen",
+    CLRX_SOURCE_DIR "/tests/amdbin/rocmbins/vectoradd-rocm.clo.regen"
+};
+
+/* compare lookups by hash index with lookups by sorted maps.
+ * returned index must point to first entry with that name */
+static void testHashIndexLookups(const std::string& testName, const ElfBinary64& mapBin,
+            const ElfBinary64& hashBin)
+{
+    for (cxuint i = 0; i < mapBin.getSectionHeadersNum(); i++)
+    {
+        const char* name = mapBin.getSectionName(i);
+        const uint16_t index = hashBin.getSectionIndex(name);
+        assertString(testName, std::string("section ")+name, name,
+                    hashBin.getSectionName(index));
+        assertTrue(testName, std::string("section first ")+name, index <= i);
+        assertString(testName, std::string("section map ")+name, name,
+                    mapBin.getSectionName(mapBin.getSectionIndex(name)));
+    }
+    for (size_t i = 0; i < mapBin.getSymbolsNum(); i++)
+    {
+        const char* name = mapBin.getSymbolName(i);
+        const size_t index = hashBin.getSymbolIndex(name);
+        assertString(testName, std::string("symbol ")+name, name,
+                    hashBin.getSymbolName(index));
+        assertTrue(testName, std::string("symbol first ")+name, index <= i);
+    }
+    for (size_t i = 0; i < mapBin.getDynSymbolsNum(); i++)
+    {
+        const char* name = mapBin.getDynSymbolName(i);
+        const size_t index = hashBin.getDynSymbolIndex(name);
+        assertString(testName, std::string("dynsymbol ")+name, name,
+                    hashBin.getDynSymbolName(index));
+        assertTrue(testName, std::string("dynsymbol first ")+name, index <= i);
+    }
+    assertCLRXException(testName, "missing section", "Can't find Elf64 Section",
+                [&hashBin]() { hashBin.getSectionIndex(".missing"); });
+    assertCLRXException(testName, "missing symbol", "Can't find Elf64 Symbol",
+                [&hashBin]() { hashBin.getSymbolIndex("missingSymbol"); });
+    assertCLRXException(testName, "missing dynsymbol", "Can't find Elf64 DynSymbol",
+                [&hashBin]() { hashBin.getDynSymbolIndex("missingSymbol"); });
+}
+
+static void testOrigBinary(cxuint testCase, const char* origBinaryFilename)
+{
+    std::string origBinFilenameStr(origBinaryFilename);
+    filesystemPath(origBinFilenameStr); // convert to system path (native separators)
+    Array<cxbyte> inputData = loadDataFromFile(origBinFilenameStr.c_str());
+    
+    ElfBinary64 mapBin(inputData.size(), inputData.data(),
+                ELF_CREATE_SECTIONMAP|ELF_CREATE_SYMBOLMAP|ELF_CREATE_DYNSYMMAP);
+    ElfBinary64 hashBin(inputData.size(), inputData.data(), ELF_CREATE_HASHINDEX);
+    std::ostringstream oss;
+    oss << "origBinary#" << testCase;
+    testHashIndexLookups(oss.str(), mapBin, hashBin);
+}
+
+static uint32_t gnuHash(const char* name)
+{
+    uint32_t h = 5381;
+    for (const cxbyte* p = reinterpret_cast<const cxbyte*>(name); *p != 0; p++)
+        h = h*33 + *p;
+    return h;
+}
+
+/* generate binary with dynamic symbols hashed in .gnu.hash and
+ * symbols hashed in .hash and check lookups through these sections */
+static void testGnuHashBinary()
+{
+    const uint32_t bucketsNum = 7;
+    std::vector<std::string> names;
+    for (cxuint i = 0; i < 50; i++)
+        names.push_back("kernel" + std::to_string(i));
+    // GNU hash requires symbols grouped by bucket
+    std::stable_sort(names.begin(), names.end(),
+            [bucketsNum](const std::string& a, const std::string& b)
+            { return gnuHash(a.c_str())%bucketsNum < gnuHash(b.c_str())%bucketsNum; });
+    
+    // header, 64-bit bloom filter, buckets and chains
+    std::vector<uint32_t> gnuHashTable = { bucketsNum, 1, 1, 6, UINT32_MAX, UINT32_MAX };
+    std::vector<uint32_t> buckets(bucketsNum, 0);
+    std::vector<uint32_t> chains;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        const uint32_t hash = gnuHash(names[i].c_str());
+        if (buckets[hash%bucketsNum] == 0)
+            buckets[hash%bucketsNum] = i+1;
+        const bool last = (i+1 == names.size() ||
+                gnuHash(names[i+1].c_str())%bucketsNum != hash%bucketsNum);
+        chains.push_back((hash&~1U) | uint32_t(last));
+    }
+    gnuHashTable.insert(gnuHashTable.end(), buckets.begin(), buckets.end());
+    gnuHashTable.insert(gnuHashTable.end(), chains.begin(), chains.end());
+    for (uint32_t& v: gnuHashTable)
+        SLEV(v, v);
+    
+    ElfBinaryGen64 elfBinGen({ 0U, 0U, 0, 0, ET_DYN, 0xe0, EV_CURRENT, UINT_MAX, 0, 0 });
+    elfBinGen.addRegion(ElfRegion64::dynsymSection());
+    elfBinGen.addRegion(ElfRegion64(gnuHashTable.size()*4,
+                (const cxbyte*)gnuHashTable.data(), 8, ".gnu.hash", SHT_GNU_HASH,
+                SHF_ALLOC, 1));
+    elfBinGen.addRegion(ElfRegion64::dynstrSection());
+    elfBinGen.addRegion(ElfRegion64::symtabSection());
+    elfBinGen.addRegion(ElfRegion64::strtabSection());
+    elfBinGen.addRegion(ElfRegion64::hashSection(4));
+    elfBinGen.addRegion(ElfRegion64::shstrtabSection());
+    elfBinGen.addRegion(ElfRegion64::sectionHeaderTable());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        elfBinGen.addDynSymbol(ElfSymbol64(names[i].c_str(), 0,
+                    ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT), 0, false, i, 0));
+        elfBinGen.addSymbol(ElfSymbol64(names[names.size()-1-i].c_str(), 0,
+                    ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT), 0, false, i, 0));
+    }
+    Array<cxbyte> output(elfBinGen.countSize());
+    FastOutputBuffer fob(output.size(), (char*)output.data());
+    elfBinGen.generate(fob);
+    
+    ElfBinary64 mapBin(output.size(), output.data(), ELF_CREATE_ALL);
+    assertTrue("gnuHashBinary", "noHashIndexInAll", !mapBin.hasHashIndex());
+    ElfBinary64 hashBin(output.size(), output.data(), ELF_CREATE_HASHINDEX);
+    assertValue("gnuHashBinary", "gnuHashIndex", uint16_t(2),
+                hashBin.getSectionIndex(".gnu.hash"));
+    assertValue("gnuHashBinary", "hashIndex", uint16_t(6),
+                hashBin.getSectionIndex(".hash"));
+    testHashIndexLookups("gnuHashBinary", mapBin, hashBin);
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        assertValue("gnuHashBinary", "dynsym " + names[i], i+1,
+                    hashBin.getDynSymbolIndex(names[i].c_str()));
+        assertValue("gnuHashBinary", "sym " + names[i], names.size()-i,
+                    hashBin.getSymbolIndex(names[i].c_str()));
+    }
+    
+    // copy has own hash index
+    {
+        ElfBinary64 copyBin(hashBin);
+        testHashIndexLookups("gnuHashBinaryCopy", mapBin, copyBin);
+        ElfBinary64 assignedBin;
+        assignedBin = copyBin;
+        testHashIndexLookups("gnuHashBinaryAssigned", mapBin, assignedBin);
+    }
+    testHashIndexLookups("gnuHashBinaryAfterCopy", mapBin, hashBin);
+    
+    // many threads do first lookups at this same time (index is built once)
+    {
+        ElfBinary64 sharedBin(output.size(), output.data(), ELF_CREATE_HASHINDEX);
+        const cxuint threadsNum = 8;
+        std::vector<std::thread> threads;
+        bool failed[threadsNum] = { };
+        for (cxuint t = 0; t < threadsNum; t++)
+            threads.push_back(std::thread([&sharedBin, &names, &failed, t]()
+            {
+                for (size_t i = 0; i < names.size(); i++)
+                    if (sharedBin.getDynSymbolIndex(names[i].c_str()) != i+1 ||
+                        sharedBin.getSymbolIndex(names[i].c_str()) != names.size()-i)
+                        failed[t] = true;
+            }));
+        for (std::thread& thread: threads)
+            thread.join();
+        for (cxuint t = 0; t < threadsNum; t++)
+            assertTrue("gnuHashBinaryConcurrent", "thread", !failed[t]);
+    }
+    
+    // symbol names are verified while loading regardless of flags
+    {
+        Array<cxbyte> badOutput(output);
+        const size_t symOffset = reinterpret_cast<const cxbyte*>(
+                    &hashBin.getSymbol(3)) - hashBin.getBinaryCode();
+        SLEV(reinterpret_cast<Elf64_Sym*>(badOutput.data() + symOffset)->st_name,
+                    0xffffffU);
+        assertCLRXException("gnuHashBinary", "badSymbolName",
+                    "Symbol name index out of range!", [&badOutput]()
+                    { ElfBinary64(badOutput.size(), badOutput.data(),
+                                ELF_CREATE_HASHINDEX); });
+    }
+    
+    // break ends of GNU hash chains, lookups should use own name map
+    const size_t chainsOffset = ULEV(hashBin.getSectionHeader(2).sh_offset) +
+                (6 + bucketsNum)*4;
+    for (size_t i = 0; i < names.size(); i++)
+        output[chainsOffset + i*4] &= 0xfe;
+    ElfBinary64 brokenBin(output.size(), output.data(), ELF_CREATE_HASHINDEX);
+    testHashIndexLookups("brokenGnuHashBinary", mapBin, brokenBin);
+    for (size_t i = 0; i < names.size(); i++)
+        assertValue("brokenGnuHashBinary", "dynsym " + names[i], i+1,
+                    brokenBin.getDynSymbolIndex(names[i].c_str()));
+}
+
+int main(int argc, const char** argv)
+{
+    int retVal = 0;
+    for (cxuint i = 0; i < sizeof(origBinaryFiles)/sizeof(const char*); i++)
+        retVal |= callTest(testOrigBinary, i, origBinaryFiles[i]);
+    retVal |= callTest(testGnuHashBinary);
+    return retVal;
+}
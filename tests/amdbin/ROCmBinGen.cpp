@@ -18,6 +18,9 @@
  */
 
 #include <CLRX/Config.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <memory>
@@ -128,6 +131,24 @@ static void testOrigBinary(cxuint testCase, const char* origBinaryFilename)
     ROCmInput rocmInput = genROCmInput(rocmBin);
     ROCmBinGenerator binGen(&rocmInput);
     binGen.generate(output);
+    // binary generated to stream and vector must be same
+    std::ostringstream streamOutput;
+    binGen.generate(streamOutput);
+    std::vector<char> vectorOutput;
+    binGen.generate(vectorOutput);
+    const std::string streamContent = streamOutput.str();
+    if (streamContent.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), streamContent.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }) ||
+        vectorOutput.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), vectorOutput.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }))
+    {
+        std::ostringstream oss;
+        oss << "Failed for #" << testCase << " file=" << origBinaryFilename <<
+                ": outputs mismatch";
+        throw Exception(oss.str());
+    }
     
     // compare generated output with input
     if (output.size() != inputData.size())
@@ -148,9 +169,100 @@ static void testOrigBinary(cxuint testCase, const char* origBinaryFilename)
         }
 }
 
+/* generate binary with many kernels to Array (memory mode of FastOutputBuffer),
+ * vector and stream. outputs must be same. if scale is greater than 1,
+ * then generating time is measured */
+static void testMultiKernelBinary(cxuint scale)
+{
+    const cxuint kernelsNum = 200*scale;
+    // every kernel: zeroed kernel descriptor, s_nop's and s_endpgm
+    const size_t kernelSize = 256 + 64*4;
+    std::vector<uint32_t> code(kernelsNum*(kernelSize>>2), 0);
+    ROCmInput rocmInput{};
+    rocmInput.deviceType = GPUDeviceType::FIJI;
+    rocmInput.archMinor = 0;
+    rocmInput.archStepping = 3;
+    for (cxuint i = 0; i < kernelsNum; i++)
+    {
+        uint32_t* kcode = code.data() + i*(kernelSize>>2) + (256>>2);
+        std::fill(kcode, kcode + 63, LEV(0xbf800000U));
+        kcode[63] = LEV(0xbf810000U);
+        std::ostringstream nameOss;
+        nameOss << "kernel" << i;
+        rocmInput.symbols.push_back({ nameOss.str().c_str(), i*kernelSize, kernelSize,
+                    ROCmRegionType::KERNEL });
+    }
+    rocmInput.codeSize = code.size()*4;
+    rocmInput.code = reinterpret_cast<const cxbyte*>(code.data());
+    
+    ROCmBinGenerator binGen(&rocmInput);
+    const cxuint runsNum = (scale > 1) ? 4 : 1;
+    Array<cxbyte> output;
+    std::vector<char> vectorOutput;
+    std::string streamContent;
+    // first generating prepares layout of binary
+    auto prepStartTime = std::chrono::steady_clock::now();
+    binGen.generate(output);
+    const double prepTime = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - prepStartTime).count();
+    double arrayTime = 0.0, vectorTime = 0.0, streamTime = 0.0;
+    for (cxuint r = 0; r < runsNum; r++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        binGen.generate(output);
+        auto arrayEndTime = std::chrono::steady_clock::now();
+        vectorOutput.clear();
+        binGen.generate(vectorOutput);
+        auto vectorEndTime = std::chrono::steady_clock::now();
+        std::ostringstream streamOutput;
+        binGen.generate(streamOutput);
+        streamContent = streamOutput.str();
+        auto streamEndTime = std::chrono::steady_clock::now();
+        arrayTime += std::chrono::duration<double>(arrayEndTime - startTime).count();
+        vectorTime += std::chrono::duration<double>(
+                    vectorEndTime - arrayEndTime).count();
+        streamTime += std::chrono::duration<double>(
+                    streamEndTime - vectorEndTime).count();
+    }
+    
+    if (streamContent.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), streamContent.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }) ||
+        vectorOutput.size() != output.size() ||
+        !std::equal(output.begin(), output.end(), vectorOutput.begin(),
+                [](cxbyte a, char b) { return a == cxbyte(b); }))
+        throw Exception("Failed for MultiKernel: outputs mismatch");
+    // all kernels must be in binary
+    ROCmBinary rocmBin(output.size(), output.data(), ROCMBIN_CREATE_REGIONMAP);
+    if (rocmBin.getRegionsNum() != kernelsNum)
+        throw Exception("Failed for MultiKernel: wrong kernels number");
+    
+    if (scale > 1)
+        std::cout << "ROCm binary (" << kernelsNum << " kernels, " <<
+                output.size() << " bytes, " << runsNum << " runs): first: " <<
+                prepTime*1000.0 << " ms, array: " <<
+                arrayTime*1000.0 << " ms, vector: " << vectorTime*1000.0 <<
+                " ms, stream: " << streamTime*1000.0 << " ms" << std::endl;
+}
+
 int main(int argc, const char** argv)
 {
     int retVal = 0;
+    // scale for benchmarking (default: 1 - only testing)
+    cxuint scale = 1;
+    if (argc >= 2)
+        scale = std::max(::atoi(argv[1]), 1);
+    
+    try
+    { testMultiKernelBinary(scale); }
+    catch(const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        retVal = 1;
+    }
+    if (scale > 1)
+        return retVal;
+    
     for (cxuint i = 0; i < sizeof(origBinaryFiles)/sizeof(const char*); i++)
         try
         { testOrigBinary(i, origBinaryFiles[i]); }
@@ -0,0 +1,196 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* test of binary cache in CLRXWrapper. CLRXWrapper uses mock of AMD OpenCL
+ * (MockAmdOcl library) which records binaries passed to clCreateProgramWithBinary */
+
+#include <CLRX/Config.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <CLRX/utils/Utilities.h>
+#include <CLRX/amdasm/Assembler.h>
+#include "../../clwrapper/DispatchStruct.h"
+#include "../TestUtils.h"
+
+using namespace CLRX;
+
+typedef cl_int (CL_API_CALL *IcdGetPlatformIDsFunc)(cl_uint, cl_platform_id*, cl_uint*);
+typedef cl_uint (*MockGetLastBinaryFunc)(size_t, unsigned char*, size_t*);
+
+// directory of cache and included files (created in working directory)
+static const char* cacheDir = "CLWrapperAsmCacheTest";
+
+static const char* wrapperTestSource =
+        ".kernel cachetest\n"
+        "    .config\n"
+        "        .dims x\n"
+        "    .text\n"
+        "        .include \"wrappercache.s\"\n"
+        "        s_endpgm\n";
+
+static const char* wrapperBuildOptions = "-xasm -I CLWrapperAsmCacheTest";
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream ofs(path.c_str(), std::ios::binary);
+    ofs.write(content.data(), content.size());
+    if (!ofs)
+        throw Exception("Can't write test file");
+}
+
+struct WrapperTestContext
+{
+    CLRXIcdDispatch* dispatch;
+    cl_device_id device;
+    cl_context context;
+    MockGetLastBinaryFunc getLastBinary;
+};
+
+// build program by CLRXWrapper, returns binary passed to AMD OpenCL and build log
+static cl_int buildProgram(const WrapperTestContext& ctx, std::vector<cxbyte>& binary,
+            std::string& buildLog)
+{
+    cl_int error;
+    cl_program program = ctx.dispatch->clCreateProgramWithSource(ctx.context, 1,
+                &wrapperTestSource, nullptr, &error);
+    if (program == nullptr)
+        throw Exception("Can't create program");
+    const cl_uint oldBinariesNum = ctx.getLastBinary(0, nullptr, nullptr);
+    error = ctx.dispatch->clBuildProgram(program, 1, &ctx.device, wrapperBuildOptions,
+                nullptr, nullptr);
+    size_t binarySize;
+    if (ctx.getLastBinary(0, nullptr, &binarySize) != oldBinariesNum+1)
+        binarySize = 0; // no binary passed to AMD OpenCL
+    binary.resize(binarySize);
+    ctx.getLastBinary(binarySize, binary.data(), nullptr);
+    
+    size_t logSize;
+    if (ctx.dispatch->clGetProgramBuildInfo(program, ctx.device, CL_PROGRAM_BUILD_LOG,
+                0, nullptr, &logSize) != CL_SUCCESS)
+        throw Exception("Can't get build log size");
+    std::unique_ptr<char[]> logBuffer(new char[logSize]);
+    if (ctx.dispatch->clGetProgramBuildInfo(program, ctx.device, CL_PROGRAM_BUILD_LOG,
+                logSize, logBuffer.get(), nullptr) != CL_SUCCESS)
+        throw Exception("Can't get build log");
+    buildLog = logBuffer.get();
+    ctx.dispatch->clReleaseProgram(program);
+    return error;
+}
+
+static void testWrapperCache(const WrapperTestContext& ctx)
+{
+    AsmBinaryCache cache(cacheDir);
+    const std::string incPath = joinPaths(cacheDir, "wrappercache.s");
+    writeFile(incPath, "s_mov_b32 s1, s2\n");
+    // this same key as computed by CLRXWrapper for mock device
+    const AsmBinaryCache::Key key = AsmBinaryCache::computeKey(
+            ::strlen(wrapperTestSource), wrapperTestSource, BinaryFormat::AMD,
+            GPUDeviceType::PITCAIRN, false, ASM_WARNINGS, ASM_POLICY_DEFAULT, 0, 0,
+            { cacheDir }, { });
+    std::remove(cache.getEntryPath(key).c_str());
+    
+    // first build: assembling and storing binary in cache
+    std::vector<cxbyte> binary;
+    std::string buildLog;
+    assertValue("wrapperCache", "build", CL_SUCCESS,
+            buildProgram(ctx, binary, buildLog));
+    assertTrue("wrapperCache", "binaryPassed", !binary.empty());
+    Array<cxbyte> cachedBinary;
+    std::string cachedLog;
+    assertTrue("wrapperCache", "stored", cache.load(key, cachedBinary, cachedLog));
+    assertTrue("wrapperCache", "storedBinary", cachedBinary.size() == binary.size() &&
+            std::equal(binary.begin(), binary.end(), cachedBinary.begin()));
+    
+    // replace entry by fake binary - it must be passed without assembling
+    const cxbyte fakeBinaryData[] = { 'C', 'A', 'C', 'H', 'E', 'D' };
+    const Array<cxbyte> fakeBinary(fakeBinaryData, fakeBinaryData + 6);
+    cache.store(key, { }, fakeBinary, "fake log\n");
+    assertValue("wrapperCache", "buildHit", CL_SUCCESS,
+            buildProgram(ctx, binary, buildLog));
+    assertTrue("wrapperCache", "hitBinary", binary.size() == 6 &&
+            std::equal(binary.begin(), binary.end(), fakeBinaryData));
+    assertString("wrapperCache", "hitLog", "fake log\n", buildLog);
+    
+    // changed included file - assemble again
+    std::remove(cache.getEntryPath(key).c_str());
+    assertValue("wrapperCache", "buildMiss", CL_SUCCESS,
+            buildProgram(ctx, binary, buildLog));
+    const std::vector<cxbyte> firstBinary = binary;
+    assertValue("wrapperCache", "buildHit2", CL_SUCCESS,
+            buildProgram(ctx, binary, buildLog));
+    assertTrue("wrapperCache", "hit2Binary", binary == firstBinary);
+    writeFile(incPath, "s_mov_b32 s1, s3\n");
+    assertValue("wrapperCache", "buildChangedInclude", CL_SUCCESS,
+            buildProgram(ctx, binary, buildLog));
+    assertTrue("wrapperCache", "changedIncludeBinary", !binary.empty() &&
+            binary != firstBinary);
+}
+
+int main(int argc, const char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: CLWrapperAsmCache WRAPPERLIB MOCKAMDOCLLIB" << std::endl;
+        return 1;
+    }
+    // CLRXWrapper must use mock instead real AMD OpenCL
+    ::setenv("CLRX_AMDOCL_PATH", argv[2], 1);
+    ::setenv("CLRX_ASMCACHE_DIR", cacheDir, 1);
+    
+    int retVal = 0;
+    try
+    {
+        DynLibrary wrapperLib(argv[1], DYNLIB_NOW);
+        DynLibrary mockLib(argv[2], DYNLIB_NOW);
+        IcdGetPlatformIDsFunc getPlatformIDs = (IcdGetPlatformIDsFunc)
+                wrapperLib.getSymbol("clIcdGetPlatformIDsKHR");
+        WrapperTestContext ctx;
+        ctx.getLastBinary = (MockGetLastBinaryFunc)
+                mockLib.getSymbol("mockAmdOclGetLastBinary");
+    
+        cl_platform_id platform;
+        if (getPlatformIDs(1, &platform, nullptr) != CL_SUCCESS)
+            throw Exception("Can't get platform");
+        ctx.dispatch = platform->dispatch;
+        if (ctx.dispatch->clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1,
+                    &ctx.device, nullptr) != CL_SUCCESS)
+            throw Exception("Can't get device");
+        cl_int error;
+        ctx.context = ctx.dispatch->clCreateContext(nullptr, 1, &ctx.device,
+                    nullptr, nullptr, &error);
+        if (ctx.context == nullptr)
+            throw Exception("Can't create context");
+    
+        retVal |= callTest(testWrapperCache, ctx);
+        ctx.dispatch->clReleaseContext(ctx.context);
+    }
+    catch(const std::exception& ex)
+    {
+        std::cerr << "Failed to initialize test: " << ex.what() << std::endl;
+        retVal = 1;
+    }
+    return retVal;
+}
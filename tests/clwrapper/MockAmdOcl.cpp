@@ -0,0 +1,387 @@
+/*
+ *  CLRadeonExtender - Unofficial OpenCL Radeon Extensions Library
+ *  Copyright (C) 2014-2018 Mateusz Szpakowski
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* mock of AMD OpenCL implementation (one platform with one Pitcairn device)
+ * for testing CLRXWrapper without real GPU. Programs are not compiled. */
+
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../../clwrapper/DispatchStruct.h"
+
+struct MockProgram: _cl_program
+{
+    std::atomic<cl_uint> refCount;
+    std::string source;
+};
+
+static CLRXIcdDispatch mockDispatch;
+static _cl_platform_id mockPlatform = { &mockDispatch };
+static _cl_device_id mockDevice = { &mockDispatch };
+static _cl_context mockContext = { &mockDispatch };
+
+// binaries passed to clCreateProgramWithBinary (checked by tests)
+static std::mutex mockBinaryMutex;
+static std::vector<unsigned char> mockLastBinary;
+static cl_uint mockBinariesNum = 0;
+
+static cl_int mockGetString(const char* str, size_t paramValueSize, void* paramValue,
+            size_t* paramValueSizeRet)
+{
+    const size_t size = ::strlen(str)+1;
+    if (paramValue != nullptr)
+    {
+        if (paramValueSize < size)
+            return CL_INVALID_VALUE;
+        ::memcpy(paramValue, str, size);
+    }
+    if (paramValueSizeRet != nullptr)
+        *paramValueSizeRet = size;
+    return CL_SUCCESS;
+}
+
+template<typename T>
+static cl_int mockGetValue(const T& value, size_t paramValueSize, void* paramValue,
+            size_t* paramValueSizeRet)
+{
+    if (paramValue != nullptr)
+    {
+        if (paramValueSize < sizeof(T))
+            return CL_INVALID_VALUE;
+        ::memcpy(paramValue, &value, sizeof(T));
+    }
+    if (paramValueSizeRet != nullptr)
+        *paramValueSizeRet = sizeof(T);
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL mockclGetPlatformIDs(cl_uint numEntries,
+            cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+    if (platforms != nullptr)
+    {
+        if (numEntries == 0)
+            return CL_INVALID_VALUE;
+        platforms[0] = &mockPlatform;
+    }
+    if (numPlatforms != nullptr)
+        *numPlatforms = 1;
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL mockclGetPlatformInfo(cl_platform_id platform,
+            cl_platform_info paramName, size_t paramValueSize, void* paramValue,
+            size_t* paramValueSizeRet)
+{
+    if (platform != &mockPlatform)
+        return CL_INVALID_PLATFORM;
+    switch(paramName)
+    {
+        case CL_PLATFORM_PROFILE:
+            return mockGetString("FULL_PROFILE", paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_PLATFORM_VERSION:
+            return mockGetString("OpenCL 1.1 MockAmdOcl", paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_PLATFORM_NAME:
+            return mockGetString("AMD Accelerated Parallel Processing", paramValueSize,
+                        paramValue, paramValueSizeRet);
+        case CL_PLATFORM_VENDOR:
+            return mockGetString("Advanced Micro Devices, Inc.", paramValueSize,
+                        paramValue, paramValueSizeRet);
+        case CL_PLATFORM_EXTENSIONS:
+            return mockGetString("cl_khr_icd", paramValueSize, paramValue,
+                        paramValueSizeRet);
+        default:
+            return CL_INVALID_VALUE;
+    }
+}
+
+static cl_int CL_API_CALL mockclGetDeviceIDs(cl_platform_id platform,
+            cl_device_type deviceType, cl_uint numEntries, cl_device_id* devices,
+            cl_uint* numDevices)
+{
+    if (platform != &mockPlatform)
+        return CL_INVALID_PLATFORM;
+    if ((deviceType & (CL_DEVICE_TYPE_GPU|CL_DEVICE_TYPE_DEFAULT)) == 0)
+        return CL_DEVICE_NOT_FOUND;
+    if (devices != nullptr)
+    {
+        if (numEntries == 0)
+            return CL_INVALID_VALUE;
+        devices[0] = &mockDevice;
+    }
+    if (numDevices != nullptr)
+        *numDevices = 1;
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL mockclGetDeviceInfo(cl_device_id device,
+            cl_device_info paramName, size_t paramValueSize, void* paramValue,
+            size_t* paramValueSizeRet)
+{
+    if (device != &mockDevice)
+        return CL_INVALID_DEVICE;
+    switch(paramName)
+    {
+        case CL_DEVICE_TYPE:
+            return mockGetValue(cl_device_type(CL_DEVICE_TYPE_GPU), paramValueSize,
+                        paramValue, paramValueSizeRet);
+        case CL_DEVICE_ADDRESS_BITS:
+            return mockGetValue(cl_uint(32), paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_DEVICE_NAME:
+            return mockGetString("Pitcairn", paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_DEVICE_VERSION:
+            return mockGetString("OpenCL 1.1 MockAmdOcl", paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_DEVICE_EXTENSIONS:
+            return mockGetString("cl_khr_icd", paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_DEVICE_PLATFORM:
+            return mockGetValue(cl_platform_id(&mockPlatform), paramValueSize,
+                        paramValue, paramValueSizeRet);
+        default:
+            return CL_INVALID_VALUE;
+    }
+}
+
+static cl_context CL_API_CALL mockclCreateContext(
+            const cl_context_properties* properties, cl_uint numDevices,
+            const cl_device_id* devices,
+            void (CL_CALLBACK* pfnNotify)(const char*, const void*, size_t, void*),
+            void* userData, cl_int* errcodeRet)
+{
+    if (numDevices != 1 || devices == nullptr || devices[0] != &mockDevice)
+    {
+        if (errcodeRet != nullptr)
+            *errcodeRet = CL_INVALID_DEVICE;
+        return nullptr;
+    }
+    if (errcodeRet != nullptr)
+        *errcodeRet = CL_SUCCESS;
+    return &mockContext;
+}
+
+static cl_int CL_API_CALL mockclRetainContext(cl_context context)
+{ return (context == &mockContext) ? CL_SUCCESS : CL_INVALID_CONTEXT; }
+
+static cl_int CL_API_CALL mockclReleaseContext(cl_context context)
+{ return (context == &mockContext) ? CL_SUCCESS : CL_INVALID_CONTEXT; }
+
+static cl_int CL_API_CALL mockclGetContextInfo(cl_context context,
+            cl_context_info paramName, size_t paramValueSize, void* paramValue,
+            size_t* paramValueSizeRet)
+{
+    if (context != &mockContext)
+        return CL_INVALID_CONTEXT;
+    switch(paramName)
+    {
+        case CL_CONTEXT_NUM_DEVICES:
+            return mockGetValue(cl_uint(1), paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_CONTEXT_DEVICES:
+            return mockGetValue(cl_device_id(&mockDevice), paramValueSize,
+                        paramValue, paramValueSizeRet);
+        default:
+            return CL_INVALID_VALUE;
+    }
+}
+
+static MockProgram* mockCreateProgram(cl_int* errcodeRet)
+{
+    MockProgram* program = new MockProgram;
+    program->dispatch = &mockDispatch;
+    program->refCount = 1;
+    if (errcodeRet != nullptr)
+        *errcodeRet = CL_SUCCESS;
+    return program;
+}
+
+static cl_program CL_API_CALL mockclCreateProgramWithSource(
+            cl_context context, cl_uint count, const char** strings,
+            const size_t* lengths, cl_int* errcodeRet)
+{
+    if (context != &mockContext)
+    {
+        if (errcodeRet != nullptr)
+            *errcodeRet = CL_INVALID_CONTEXT;
+        return nullptr;
+    }
+    MockProgram* program = mockCreateProgram(errcodeRet);
+    for (cl_uint i = 0; i < count; i++)
+        if (lengths == nullptr || lengths[i] == 0)
+            program->source.append(strings[i]);
+        else
+            program->source.append(strings[i], lengths[i]);
+    return program;
+}
+
+static cl_program CL_API_CALL mockclCreateProgramWithBinary(
+            cl_context context, cl_uint numDevices, const cl_device_id* devices,
+            const size_t* lengths, const unsigned char** binaries,
+            cl_int* binaryStatus, cl_int* errcodeRet)
+{
+    if (context != &mockContext || numDevices != 1 || devices[0] != &mockDevice)
+    {
+        if (errcodeRet != nullptr)
+            *errcodeRet = CL_INVALID_VALUE;
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mockBinaryMutex);
+        mockLastBinary.assign(binaries[0], binaries[0] + lengths[0]);
+        mockBinariesNum++;
+    }
+    if (binaryStatus != nullptr)
+        binaryStatus[0] = CL_SUCCESS;
+    return mockCreateProgram(errcodeRet);
+}
+
+static cl_int CL_API_CALL mockclRetainProgram(cl_program program)
+{
+    static_cast<MockProgram*>(program)->refCount.fetch_add(1);
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL mockclReleaseProgram(cl_program program)
+{
+    MockProgram* p = static_cast<MockProgram*>(program);
+    if (p->refCount.fetch_sub(1) == 1)
+        delete p;
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL mockclBuildProgram(cl_program program,
+            cl_uint numDevices, const cl_device_id* devices, const char* options,
+            void (CL_CALLBACK* pfnNotify)(cl_program, void*), void* userData)
+{
+    if (pfnNotify != nullptr)
+        pfnNotify(program, userData);
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL mockclGetProgramInfo(cl_program program,
+            cl_program_info paramName, size_t paramValueSize, void* paramValue,
+            size_t* paramValueSizeRet)
+{
+    const MockProgram* p = static_cast<const MockProgram*>(program);
+    switch(paramName)
+    {
+        case CL_PROGRAM_NUM_DEVICES:
+            return mockGetValue(cl_uint(1), paramValueSize, paramValue,
+                        paramValueSizeRet);
+        case CL_PROGRAM_DEVICES:
+            return mockGetValue(cl_device_id(&mockDevice), paramValueSize,
+                        paramValue, paramValueSizeRet);
+        case CL_PROGRAM_SOURCE:
+            return mockGetString(p->source.c_str(), paramValueSize, paramValue,
+                        paramValueSizeRet);
+        default:
+            return CL_INVALID_VALUE;
+    }
+}
+
+static cl_int CL_API_CALL mockclGetProgramBuildInfo(cl_program program,
+            cl_device_id device, cl_program_build_info paramName, size_t paramValueSize,
+            void* paramValue, size_t* paramValueSizeRet)
+{
+    if (device != &mockDevice)
+        return CL_INVALID_DEVICE;
+    switch(paramName)
+    {
+        case CL_PROGRAM_BUILD_STATUS:
+            return mockGetValue(cl_build_status(CL_BUILD_SUCCESS), paramValueSize,
+                        paramValue, paramValueSizeRet);
+        case CL_PROGRAM_BUILD_OPTIONS:
+        case CL_PROGRAM_BUILD_LOG:
+            return mockGetString("", paramValueSize, paramValue, paramValueSizeRet);
+        default:
+            return CL_INVALID_VALUE;
+    }
+}
+
+static void initializeMockDispatch()
+{
+    mockDispatch.clGetPlatformIDs = mockclGetPlatformIDs;
+    mockDispatch.clGetPlatformInfo = mockclGetPlatformInfo;
+    mockDispatch.clGetDeviceIDs = mockclGetDeviceIDs;
+    mockDispatch.clGetDeviceInfo = mockclGetDeviceInfo;
+    mockDispatch.clCreateContext = mockclCreateContext;
+    mockDispatch.clRetainContext = mockclRetainContext;
+    mockDispatch.clReleaseContext = mockclReleaseContext;
+    mockDispatch.clGetContextInfo = mockclGetContextInfo;
+    mockDispatch.clCreateProgramWithSource = mockclCreateProgramWithSource;
+    mockDispatch.clCreateProgramWithBinary = mockclCreateProgramWithBinary;
+    mockDispatch.clRetainProgram = mockclRetainProgram;
+    mockDispatch.clReleaseProgram = mockclReleaseProgram;
+    mockDispatch.clBuildProgram = mockclBuildProgram;
+    mockDispatch.clGetProgramInfo = mockclGetProgramInfo;
+    mockDispatch.clGetProgramBuildInfo = mockclGetProgramBuildInfo;
+}
+
+#ifdef _WIN32
+#  define MOCK_EXPORT __declspec(dllexport)
+#else
+#  define MOCK_EXPORT __attribute__((visibility("default")))
+#endif
+
+extern "C"
+{
+    
+MOCK_EXPORT cl_int CL_API_CALL clGetPlatformIDs(cl_uint numEntries,
+            cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+    initializeMockDispatch();
+    return mockclGetPlatformIDs(numEntries, platforms, numPlatforms);
+}
+    
+static cl_int CL_API_CALL mockclIcdGetPlatformIDsKHR(cl_uint numEntries,
+            cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+    initializeMockDispatch();
+    return mockclGetPlatformIDs(numEntries, platforms, numPlatforms);
+}
+    
+MOCK_EXPORT void* CL_API_CALL clGetExtensionFunctionAddress(const char* funcName)
+{
+    if (::strcmp(funcName, "clIcdGetPlatformIDsKHR") == 0)
+        return (void*)mockclIcdGetPlatformIDsKHR;
+    return nullptr;
+}
+    
+/// get number of binaries passed to clCreateProgramWithBinary and last binary
+MOCK_EXPORT cl_uint mockAmdOclGetLastBinary(size_t binarySize, unsigned char* binary,
+            size_t* binarySizeRet)
+{
+    std::lock_guard<std::mutex> lock(mockBinaryMutex);
+    if (binary != nullptr)
+        std::copy(mockLastBinary.begin(), mockLastBinary.begin() +
+                std::min(binarySize, mockLastBinary.size()), binary);
+    if (binarySizeRet != nullptr)
+        *binarySizeRet = mockLastBinary.size();
+    return mockBinariesNum;
+}
+    
+}
@@ -307,6 +307,85 @@ static void testGetGPUExtraRegsNum()
     }
 }
 
+struct GPUWavesRegsTestCase
+{
+    GPUArchitecture arch;
+    cxuint regType;
+    cxuint wavesNum;
+    cxuint regsNum;
+};
+
+// getGPUMaxRegistersNumForWaves testcase table
+static const GPUWavesRegsTestCase gpuWavesRegsTestTable[] =
+{
+    { GPUArchitecture::GCN1_0, REGTYPE_SGPR, 10, 48 },
+    { GPUArchitecture::GCN1_0, REGTYPE_SGPR, 8, 64 },
+    { GPUArchitecture::GCN1_0, REGTYPE_SGPR, 5, 96 },
+    { GPUArchitecture::GCN1_0, REGTYPE_SGPR, 1, 104 },
+    { GPUArchitecture::GCN1_0, REGTYPE_SGPR, 0, 104 },
+    { GPUArchitecture::GCN1_1, REGTYPE_SGPR, 12, 48 },
+    { GPUArchitecture::GCN1_2, REGTYPE_SGPR, 10, 80 },
+    { GPUArchitecture::GCN1_2, REGTYPE_SGPR, 8, 96 },
+    { GPUArchitecture::GCN1_4, REGTYPE_SGPR, 9, 80 },
+    { GPUArchitecture::GCN1_5, REGTYPE_SGPR, 20, 106 },
+    { GPUArchitecture::GCN1_1, REGTYPE_VGPR, 10, 24 },
+    { GPUArchitecture::GCN1_1, REGTYPE_VGPR, 4, 64 },
+    { GPUArchitecture::GCN1_1, REGTYPE_VGPR, 3, 84 },
+    { GPUArchitecture::GCN1_1, REGTYPE_VGPR, 1, 256 },
+    { GPUArchitecture::GCN1_5, REGTYPE_VGPR, 20, 48 },
+    { GPUArchitecture::GCN1_5, REGTYPE_VGPR, 4, 256 }
+};
+
+static void testGetGPUMaxRegistersNumForWaves()
+{
+    char descBuf[60];
+    for (cxuint i = 0; i < sizeof gpuWavesRegsTestTable/
+                sizeof(GPUWavesRegsTestCase); i++)
+    {
+        const GPUWavesRegsTestCase testCase = gpuWavesRegsTestTable[i];
+        snprintf(descBuf, sizeof descBuf, "Test %d", i);
+        const cxuint result = getGPUMaxRegistersNumForWaves(testCase.arch,
+                    testCase.regType, testCase.wavesNum);
+        assertValue("testGetGPUMaxRegistersNumForWaves", descBuf,
+                    testCase.regsNum, result);
+    }
+}
+
+struct GPUWavesTestCase
+{
+    GPUArchitecture arch;
+    cxuint sgprsNum;
+    cxuint vgprsNum;
+    cxuint wavesNum;
+};
+
+// getGPUWavesPerSIMD testcase table
+static const GPUWavesTestCase gpuWavesTestTable[] =
+{
+    { GPUArchitecture::GCN1_1, 0, 0, 10 },
+    { GPUArchitecture::GCN1_1, 48, 24, 10 },
+    { GPUArchitecture::GCN1_1, 50, 24, 9 },
+    { GPUArchitecture::GCN1_1, 48, 25, 9 },
+    { GPUArchitecture::GCN1_1, 104, 84, 3 },
+    { GPUArchitecture::GCN1_1, 104, 256, 1 },
+    { GPUArchitecture::GCN1_2, 80, 24, 10 },
+    { GPUArchitecture::GCN1_2, 81, 24, 8 },
+    { GPUArchitecture::GCN1_5, 106, 48, 20 },
+    { GPUArchitecture::GCN1_5, 106, 49, 18 }
+};
+
+static void testGetGPUWavesPerSIMD()
+{
+    char descBuf[60];
+    for (cxuint i = 0; i < sizeof gpuWavesTestTable/ sizeof(GPUWavesTestCase); i++)
+    {
+        const GPUWavesTestCase testCase = gpuWavesTestTable[i];
+        snprintf(descBuf, sizeof descBuf, "Test %d", i);
+        const cxuint result = getGPUWavesPerSIMD(testCase.arch, testCase.sgprsNum,
+                    testCase.vgprsNum);
+        assertValue("testGetGPUWavesPerSIMD", descBuf, testCase.wavesNum, result);
+    }
+}
 
 int main(int argc, const char** argv)
 {
@@ -315,5 +394,7 @@ int main(int argc, const char** argv)
     retVal |= callTest(testGetGPUArchitectureFromName);
     retVal |= callTest(testGetGPUMaxRegistersNum);
     retVal |= callTest(testGetGPUExtraRegsNum);
+    retVal |= callTest(testGetGPUMaxRegistersNumForWaves);
+    retVal |= callTest(testGetGPUWavesPerSIMD);
     return retVal;
 }
@@ -22,6 +22,7 @@
 #include <utility>
 #include <cstdint>
 #include <climits>
+#include <algorithm>
 #include <CLRX/utils/Utilities.h>
 #include <CLRX/utils/GPUId.h>
 
@@ -374,6 +375,72 @@ cxuint CLRX::getGPUExtraRegsNum(GPUArchitecture architecture, cxuint regType, Fl
     return 0;
 }
 
+// get size of register file per SIMD and granularity of the register allocation
+static void getGPURegFileParams(GPUArchitecture architecture, cxuint regType,
+            cxuint& regsPerSIMD, cxuint& granularity)
+{
+    if (regType == REGTYPE_VGPR)
+    {
+        regsPerSIMD = (architecture>=GPUArchitecture::GCN1_5) ? 1024 : 256;
+        granularity = (architecture>=GPUArchitecture::GCN1_5) ? 8 : 4;
+    }
+    else if (architecture < GPUArchitecture::GCN1_2)
+    {
+        regsPerSIMD = 512;
+        granularity = 8;
+    }
+    else if (architecture < GPUArchitecture::GCN1_5)
+    {
+        regsPerSIMD = 800;
+        granularity = 16;
+    }
+    else
+    {
+        // SGPRs do not limit number of waves (navi)
+        regsPerSIMD = 0;
+        granularity = 1;
+    }
+}
+
+cxuint CLRX::getGPUMaxWavesPerSIMD(GPUArchitecture architecture)
+{
+    if (architecture > GPUArchitecture::GPUARCH_MAX)
+        throw GPUIdException("Unknown GPU architecture");
+    return (architecture>=GPUArchitecture::GCN1_5) ? 20 : 10;
+}
+
+cxuint CLRX::getGPUMaxRegistersNumForWaves(GPUArchitecture architecture,
+            cxuint regType, cxuint wavesNum, Flags flags)
+{
+    const cxuint maxRegsNum = getGPUMaxRegistersNum(architecture, regType, flags);
+    cxuint regsPerSIMD, granularity;
+    getGPURegFileParams(architecture, regType, regsPerSIMD, granularity);
+    if (wavesNum == 0 || regsPerSIMD == 0)
+        return maxRegsNum;
+    wavesNum = std::min(wavesNum, getGPUMaxWavesPerSIMD(architecture));
+    const cxuint regsNum = (regsPerSIMD / wavesNum) / granularity * granularity;
+    return std::min(regsNum, maxRegsNum);
+}
+
+cxuint CLRX::getGPUWavesPerSIMD(GPUArchitecture architecture, cxuint sgprsNum,
+            cxuint vgprsNum)
+{
+    cxuint wavesNum = getGPUMaxWavesPerSIMD(architecture);
+    const cxuint regsNums[2] = { sgprsNum, vgprsNum };
+    for (cxuint regType = REGTYPE_SGPR; regType <= REGTYPE_VGPR; regType++)
+    {
+        cxuint regsPerSIMD, granularity;
+        getGPURegFileParams(architecture, regType, regsPerSIMD, granularity);
+        if (regsPerSIMD == 0 || regsNums[regType] == 0)
+            continue;
+        // registers are allocated in granules
+        const cxuint regsNum = (regsNums[regType] + granularity-1) /
+                    granularity * granularity;
+        wavesNum = std::min(wavesNum, regsPerSIMD / regsNum);
+    }
+    return wavesNum;
+}
+
 uint32_t CLRX::calculatePgmRSrc1(GPUArchitecture arch, cxuint vgprsNum, cxuint sgprsNum,
             cxuint priority, cxuint floatMode, bool privMode, bool dx10Clamp,
             bool debugMode, bool ieeeMode)
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #endif
 #include <fstream>
 #include <fcntl.h>
@@ -463,6 +464,140 @@ Array<cxbyte> CLRX::loadDataFromFile(const char* filename)
     return buf;
 }
 
+/*
+ * MappedFile
+ */
+
+MappedFile::MappedFile() : content(nullptr), size(0), mapped(false)
+#ifdef HAVE_WINDOWS
+    , mapHandle(nullptr)
+#endif
+{ }
+
+MappedFile::MappedFile(const char* filename) : content(nullptr), size(0), mapped(false)
+#ifdef HAVE_WINDOWS
+    , mapHandle(nullptr)
+#endif
+{
+    if (!map(filename))
+        throw Exception("This is not regular file");
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+bool MappedFile::map(const char* filename)
+{
+    unmap();
+    if (isDirectory(filename))
+        throw Exception("This is directory!");
+#ifdef HAVE_WINDOWS
+    HANDLE fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        throw Exception("Can't open file");
+    if (GetFileType(fileHandle) != FILE_TYPE_DISK)
+    {
+        // not regular file
+        CloseHandle(fileHandle);
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize))
+    {
+        CloseHandle(fileHandle);
+        throw Exception("Can't get size of file");
+    }
+    if (uint64_t(fileSize.QuadPart) > SIZE_MAX)
+    {
+        CloseHandle(fileHandle);
+        throw Exception("File is too big to map");
+    }
+    size = fileSize.QuadPart;
+    if (size != 0)
+    {
+        mapHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_WRITECOPY,
+                    0, 0, nullptr);
+        CloseHandle(fileHandle);
+        if (mapHandle == nullptr)
+            throw Exception("Can't map file");
+        content = (cxbyte*)MapViewOfFile(mapHandle, FILE_MAP_COPY, 0, 0, 0);
+        if (content == nullptr)
+        {
+            CloseHandle(mapHandle);
+            mapHandle = nullptr;
+            throw Exception("Can't map file");
+        }
+    }
+    else
+        CloseHandle(fileHandle);
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        throw Exception("Can't open file");
+    struct stat stBuf;
+    if (::fstat(fd, &stBuf) != 0)
+    {
+        ::close(fd);
+        throw Exception("Can't get size of file");
+    }
+    if (!S_ISREG(stBuf.st_mode))
+    {
+        // not regular file
+        ::close(fd);
+        return false;
+    }
+    if (uint64_t(stBuf.st_size) > SIZE_MAX)
+    {
+        ::close(fd);
+        throw Exception("File is too big to map");
+    }
+    size = stBuf.st_size;
+    if (size != 0)
+    {
+        void* addr = ::mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            throw Exception("Can't map file");
+        content = (cxbyte*)addr;
+    }
+    else
+        ::close(fd);
+#endif
+    mapped = true;
+    return true;
+}
+
+void MappedFile::mapOrLoad(const char* filename)
+{
+    if (map(filename))
+        return;
+    // if not regular file
+    loadedData = loadDataFromFile(filename);
+    content = loadedData.data();
+    size = loadedData.size();
+}
+
+void MappedFile::unmap()
+{
+    if (mapped && content != nullptr)
+    {
+#ifdef HAVE_WINDOWS
+        UnmapViewOfFile(content);
+        CloseHandle(mapHandle);
+        mapHandle = nullptr;
+#else
+        ::munmap((void*)content, size);
+#endif
+    }
+    loadedData.clear();
+    content = nullptr;
+    size = 0;
+    mapped = false;
+}
+
 void CLRX::filesystemPath(char* path)
 {
     while (*path != 0)  // change to native dir separator
@@ -539,6 +674,42 @@ std::string CLRX::getHomeDir()
     return "";
 }
 
+std::string CLRX::getCurrentDir()
+{
+#ifdef HAVE_WINDOWS
+    char path[MAX_PATH];
+    if (_getcwd(path, MAX_PATH) != nullptr)
+        return std::string(path);
+#else
+    Array<char> path(256);
+    errno = 0;
+    while (::getcwd(path.data(), path.size()) == nullptr)
+    {
+        if (errno != ERANGE)
+            throw Exception("Can't get current directory");
+        // buffer is too small
+        path.resize(path.size()<<1);
+        errno = 0;
+    }
+    return std::string(path.data());
+#endif
+    throw Exception("Can't get current directory");
+}
+
+std::string CLRX::getAbsolutePath(const std::string& path)
+{
+#ifdef HAVE_WINDOWS
+    // path from root of drive or with drive letter
+    if ((!path.empty() && (path[0] == CLRX_NATIVE_DIR_SEP ||
+            path[0] == CLRX_ALT_DIR_SEP)) || (path.size() >= 2 && path[1] == ':'))
+        return path;
+#else
+    if (!path.empty() && path[0] == CLRX_NATIVE_DIR_SEP)
+        return path;
+#endif
+    return joinPaths(getCurrentDir(), path);
+}
+
 void CLRX::makeDir(const char* dirname)
 {
     errno = 0;